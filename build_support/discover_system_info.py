@@ -82,6 +82,22 @@ def _discover_semtimedop():
     return _does_build_succeed("discover_semtimedop.c")
 
 
+def _discover_getrandom():
+    '''Returns True if the host system supports getrandom(), False otherwise.'''
+    return _does_build_succeed("discover_getrandom.c")
+
+
+def _discover_futex():
+    '''Returns True if the host system supports futexes (i.e. it's Linux), False otherwise.'''
+    return _does_build_succeed("discover_futex.c")
+
+
+def _discover_mbind():
+    '''Returns True if the host system supports mbind() and move_pages() (i.e. it's Linux), False
+    otherwise.'''
+    return _does_build_succeed("discover_mbind.c")
+
+
 def _discover_semun_union_defined():
     '''Returns True if the semun union is defined in a system header file, False otherwise.'''
     return _does_build_succeed("discover_semun_union_defined.c")
@@ -152,6 +168,21 @@ def discover():
         if _discover_semtimedop():
             sys_info["SEMTIMEDOP_EXISTS"] = ""
 
+        # getrandom() seeds the generator behind randomly chosen keys. Where it doesn't exist,
+        # the module falls back to weaker sources.
+        if _discover_getrandom():
+            sys_info["GETRANDOM_EXISTS"] = ""
+
+        # SharedMutex and SharedCondition sleep on futexes where they exist. Elsewhere they fall
+        # back to yielding the CPU while they wait.
+        if _discover_futex():
+            sys_info["FUTEX_EXISTS"] = ""
+
+        # SharedMemory's numa_node and interleave options and numa_stat() need the NUMA memory
+        # policy system calls.
+        if _discover_mbind():
+            sys_info["MBIND_EXISTS"] = ""
+
         # I hardcode the max value of a sempahore. I expect that this value is fine for most
         # users, and those that need something different can use their own system_info.h.
         # Details: https://github.com/osvenskan/sysv_ipc/issues/3
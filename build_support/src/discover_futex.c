@@ -0,0 +1,12 @@
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdint.h>
+
+int main(void) {
+    uint32_t word = 0;
+
+    syscall(SYS_futex, &word, FUTEX_WAKE, 1, NULL, NULL, 0);
+
+    return 0;
+}
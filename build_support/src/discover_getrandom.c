@@ -0,0 +1,10 @@
+#include <sys/random.h>
+#include <stdlib.h>
+
+int main(void) {
+    char buffer[8];
+
+    getrandom(buffer, sizeof(buffer), GRND_NONBLOCK);
+
+    return 0;
+}
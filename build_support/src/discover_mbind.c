@@ -0,0 +1,15 @@
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+int main(void) {
+    unsigned long nodemask = 1;
+    int status;
+    void *page = NULL;
+
+    syscall(SYS_mbind, NULL, 0, MPOL_BIND, &nodemask, 2, 0);
+    syscall(SYS_get_mempolicy, NULL, &nodemask, 64, NULL, MPOL_F_MEMS_ALLOWED);
+    syscall(SYS_move_pages, 0, 1, &page, NULL, &status, 0);
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include <sys/ipc.h>		/* for system's IPC_xxx definitions */
+#include <sys/shm.h>		/* for shmget, shmat, shmdt, shmctl */
+#include <sys/sem.h>		/* for semget, semctl, semop */
+#include <sys/wait.h>		/* for waitpid */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+// This is the raw C counterpart of benchmark.py. Both programs run the same
+// tests with the same defaults and print their results in the same format, so
+// the cost that sysv_ipc adds on top of the underlying system calls can be
+// read off by running the two side by side.
+//
+// Usage: ./benchmark [iterations [size]]
+
+#define DEFAULT_ITERATIONS 100000
+#define DEFAULT_SIZE 65536
+
+static double now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+
+static void report(const char *name, long iterations, double elapsed_ns, long bytes_per_op) {
+    double ns_per_op = elapsed_ns / iterations;
+
+    if (bytes_per_op)
+        // bytes/ns * 1e9 / 1e6 == bytes/ns * 1000 == MB/s
+        printf("%-26s %12.1f ns/op %12.1f MB/s\n", name, ns_per_op,
+               (double)bytes_per_op / ns_per_op * 1000);
+    else
+        printf("%-26s %12.1f ns/op\n", name, ns_per_op);
+}
+
+
+static int semaphore_op(int sem_id, short delta) {
+    struct sembuf op[1];
+
+    op[0].sem_num = 0;
+    op[0].sem_op = delta;
+    op[0].sem_flg = 0;
+
+    return semop(sem_id, op, (size_t)1);
+}
+
+
+static int semaphore_create(void) {
+    int sem_id = semget(IPC_PRIVATE, 1, IPC_CREAT | IPC_EXCL | 0600);
+
+    if (-1 == sem_id)
+        fprintf(stderr, "Creating a semaphore failed; errno is %d\n", errno);
+
+    return sem_id;
+}
+
+
+// Two processes bounce a token between two semaphores. Each round trip is
+// two semop() calls in each process.
+static void semaphore_ping_pong(long iterations) {
+    int ping_id;
+    int pong_id;
+    long i;
+    pid_t pid;
+    double start;
+
+    ping_id = semaphore_create();
+    pong_id = semaphore_create();
+
+    if ((-1 == ping_id) || (-1 == pong_id))
+        exit(1);
+
+    pid = fork();
+
+    if (!pid) {
+        // child
+        for (i = 0; i < iterations; i++) {
+            semaphore_op(ping_id, -1);
+            semaphore_op(pong_id, 1);
+        }
+        _exit(0);
+    }
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+        semaphore_op(ping_id, 1);
+        semaphore_op(pong_id, -1);
+    }
+    report("semaphore ping-pong", iterations, now_ns() - start, 0);
+
+    waitpid(pid, NULL, 0);
+
+    semctl(ping_id, 0, IPC_RMID);
+    semctl(pong_id, 0, IPC_RMID);
+}
+
+
+// Uncontended acquire/release pairs in a single process.
+static void semaphore_acquire_release(long iterations) {
+    int sem_id;
+    long i;
+    double start;
+
+    if (-1 == (sem_id = semaphore_create()))
+        exit(1);
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+        semaphore_op(sem_id, 1);
+        semaphore_op(sem_id, -1);
+    }
+    report("semaphore release+acquire", iterations, now_ns() - start, 0);
+
+    semctl(sem_id, 0, IPC_RMID);
+}
+
+
+static void shared_memory_bandwidth(long iterations, long size) {
+    int shm_id;
+    char *address;
+    char *buffer;
+    long i;
+    // The checksum keeps the compiler from discarding the reads.
+    unsigned long checksum = 0;
+    double start;
+    struct shmid_ds shm_info;
+
+    shm_id = shmget(IPC_PRIVATE, size, IPC_CREAT | IPC_EXCL | 0600);
+
+    if (-1 == shm_id) {
+        fprintf(stderr, "Creating the shared memory failed; errno is %d\n", errno);
+        exit(1);
+    }
+
+    address = shmat(shm_id, NULL, 0);
+
+    if ((void *)-1 == address) {
+        fprintf(stderr, "Attaching the shared memory failed; errno is %d\n", errno);
+        exit(1);
+    }
+
+    buffer = malloc(size);
+    memset(buffer, 'x', size);
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++)
+        memcpy(address, buffer, size);
+    report("shared memory write", iterations, now_ns() - start, size);
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+        memcpy(buffer, address, size);
+        checksum += (unsigned char)buffer[i % size];
+    }
+    report("shared memory read", iterations, now_ns() - start, size);
+
+    if (checksum != (unsigned long)iterations * 'x')
+        fprintf(stderr, "Unexpected checksum %lu\n", checksum);
+
+    free(buffer);
+    shmdt(address);
+    shmctl(shm_id, IPC_RMID, &shm_info);
+}
+
+
+int main(int argc, char *argv[]) {
+    long iterations = DEFAULT_ITERATIONS;
+    long size = DEFAULT_SIZE;
+
+    if (argc > 1)
+        iterations = atol(argv[1]);
+    if (argc > 2)
+        size = atol(argv[2]);
+
+    if ((iterations <= 0) || (size <= 0)) {
+        fprintf(stderr, "usage: %s [iterations [size]]\n", argv[0]);
+        return 1;
+    }
+
+    printf("C baseline: %ld iterations, %ld byte segment\n", iterations, size);
+
+    semaphore_acquire_release(iterations);
+    semaphore_ping_pong(iterations);
+    // Bulk copies are much slower than semaphore operations, so they
+    // get fewer iterations.
+    shared_memory_bandwidth(iterations / 10 ? iterations / 10 : 1, size);
+
+    return 0;
+}
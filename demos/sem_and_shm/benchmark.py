@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+
+# This is the Python counterpart of benchmark.c. Both programs run the same
+# tests with the same defaults and print their results in the same format, so
+# the cost that sysv_ipc adds on top of the underlying system calls can be
+# read off by running the two side by side.
+#
+# Usage: python benchmark.py [iterations [size]]
+
+# Python modules
+import os
+import sys
+import time
+
+# 3rd party modules
+import sysv_ipc
+
+DEFAULT_ITERATIONS = 100000
+DEFAULT_SIZE = 65536
+
+
+def report(name, iterations, elapsed_ns, bytes_per_op=0):
+    ns_per_op = elapsed_ns / iterations
+
+    if bytes_per_op:
+        # bytes/ns * 1e9 / 1e6 == bytes/ns * 1000 == MB/s
+        print(f"{name:<26s} {ns_per_op:12.1f} ns/op {bytes_per_op / ns_per_op * 1000:12.1f} MB/s")
+    else:
+        print(f"{name:<26s} {ns_per_op:12.1f} ns/op")
+
+
+def semaphore_ping_pong(iterations):
+    """Two processes bounce a token between two semaphores. Each round trip is
+    two semop() calls in each process."""
+    ping = sysv_ipc.Semaphore(sysv_ipc.IPC_PRIVATE, sysv_ipc.IPC_CREX)
+    pong = sysv_ipc.Semaphore(sysv_ipc.IPC_PRIVATE, sysv_ipc.IPC_CREX)
+
+    pid = os.fork()
+
+    if not pid:
+        # child
+        for _ in range(iterations):
+            ping.acquire()
+            pong.release()
+        os._exit(0)
+
+    start = time.perf_counter_ns()
+    for _ in range(iterations):
+        ping.release()
+        pong.acquire()
+    report("semaphore ping-pong", iterations, time.perf_counter_ns() - start)
+
+    os.waitpid(pid, 0)
+
+    ping.remove()
+    pong.remove()
+
+
+def semaphore_acquire_release(iterations):
+    """Uncontended acquire/release pairs in a single process."""
+    semaphore = sysv_ipc.Semaphore(sysv_ipc.IPC_PRIVATE, sysv_ipc.IPC_CREX)
+
+    start = time.perf_counter_ns()
+    for _ in range(iterations):
+        semaphore.release()
+        semaphore.acquire()
+    report("semaphore release+acquire", iterations, time.perf_counter_ns() - start)
+
+    semaphore.remove()
+
+
+def shared_memory_bandwidth(iterations, size):
+    memory = sysv_ipc.SharedMemory(sysv_ipc.IPC_PRIVATE, sysv_ipc.IPC_CREX, size=size)
+
+    buffer = b'x' * size
+
+    start = time.perf_counter_ns()
+    for _ in range(iterations):
+        memory.write(buffer)
+    report("shared memory write", iterations, time.perf_counter_ns() - start, size)
+
+    start = time.perf_counter_ns()
+    for _ in range(iterations):
+        memory.read(size)
+    report("shared memory read", iterations, time.perf_counter_ns() - start, size)
+
+    memory.detach()
+    memory.remove()
+
+
+iterations = int(sys.argv[1]) if len(sys.argv) > 1 else DEFAULT_ITERATIONS
+size = int(sys.argv[2]) if len(sys.argv) > 2 else DEFAULT_SIZE
+
+print(f"sysv_ipc {sysv_ipc.VERSION}: {iterations} iterations, {size} byte segment")
+
+semaphore_acquire_release(iterations)
+semaphore_ping_pong(iterations)
+# Bulk copies are much slower than semaphore operations, so they get fewer
+# iterations.
+shared_memory_bandwidth(max(iterations // 10, 1), size)
@@ -5,3 +5,4 @@ gcc -Wall -c -o utils.o utils.c
 gcc -Wall -L. md5.o utils.o -o premise premise.c
 gcc -Wall -L. md5.o utils.o -o conclusion conclusion.c
 
+gcc -Wall -o benchmark benchmark.c
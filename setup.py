@@ -19,19 +19,61 @@ SOURCE_FILES = [
     "src/common.c",
     "src/semaphore.c",
     "src/memory.c",
-    "src/mq.c"
+    "src/mq.c",
+    "src/stats.c",
+    "src/arena.c",
+    "src/hashmap.c",
+    "src/rwlock.c",
+    "src/barrier.c",
+    "src/event.c",
+    "src/futex.c",
+    "src/waitany.c",
+    "src/notifier.c",
+    "src/spill.c",
+    "src/schema.c",
+    "src/coalesce.c",
+    "src/checksum.c",
+    "src/snapshot.c",
 ]
 DEPENDS = [
     "src/system_info.h",
+    "src/arena.c",
+    "src/arena.h",
+    "src/barrier.c",
+    "src/barrier.h",
+    "src/checksum.c",
+    "src/checksum.h",
+    "src/coalesce.c",
+    "src/coalesce.h",
     "src/common.c",
     "src/common.h",
+    "src/event.c",
+    "src/event.h",
+    "src/futex.c",
+    "src/futex.h",
+    "src/hashmap.c",
+    "src/hashmap.h",
     "src/memory.c",
     "src/memory.h",
     "src/mq.c",
     "src/mq.h",
+    "src/notifier.c",
+    "src/notifier.h",
+    "src/rwlock.c",
+    "src/rwlock.h",
+    "src/schema.c",
+    "src/schema.h",
     "src/semaphore.c",
     "src/semaphore.h",
+    "src/snapshot.c",
+    "src/snapshot.h",
+    "src/spill.c",
+    "src/spill.h",
+    "src/stats.c",
+    "src/stats.h",
     "src/sysv_ipc_module.c",
+    "src/waitany.c",
+    "src/waitany.h",
 ]
 
 # Run discovery to create system_info.h (if needed).
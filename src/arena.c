@@ -0,0 +1,563 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "stats.h"
+#include "memory.h"
+#include "arena.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+
+// How many times to retry a held lock before yielding the CPU, and how many
+// yields between checks on whether the lock's owner is still alive.
+#define SPIN_TRIES 100
+#define YIELDS_PER_OWNER_CHECK 1000
+
+
+/******************    Internal use only     **********************/
+
+static uint64_t
+align_up(uint64_t value, uint64_t alignment) {
+    // alignment must be a power of 2
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+
+static int
+size_class_for(uint64_t needed) {
+    // Returns the smallest size class whose blocks hold at least needed
+    // bytes, or -1 if there's no such class.
+    int size_class = 0;
+    uint64_t block_size = ARENA_MIN_BLOCK;
+
+    while (block_size < needed) {
+        if (++size_class == ARENA_SIZE_CLASSES)
+            return -1;
+        block_size <<= 1;
+    }
+
+    return size_class;
+}
+
+
+static ArenaHeader *
+arena_header(SharedArena *self) {
+    // Returns the arena's header, or NULL with a Python error set if the
+    // segment isn't attached or isn't writable.
+    if (!self->memory) {
+        PyErr_SetString(pInternalException, "The arena was not initialized");
+        return NULL;
+    }
+
+    if (!self->memory->address) {
+        PyErr_SetString(pNotAttachedException, "The arena's memory segment is not attached");
+        return NULL;
+    }
+
+    if (self->memory->read_only) {
+        // Even reads take the lock, which means writing to the segment.
+        PyErr_SetString(PyExc_OSError, "The arena's memory segment is attached read-only");
+        return NULL;
+    }
+
+    return (ArenaHeader *)((char *)self->memory->address + self->offset);
+}
+
+
+static ArenaBlockHeader *
+find_block(ArenaHeader *header, char *base, uint64_t offset, uint64_t *p_block) {
+    // Given an offset returned by alloc(), returns the header of the block
+    // that contains it. Returns NULL if offset doesn't point into a block
+    // that's currently allocated. The caller must hold the arena's lock.
+    ArenaBlockLink *link;
+    ArenaBlockHeader *block_header;
+    uint64_t block;
+
+    if ((offset < header->start + sizeof(ArenaBlockHeader)) || (offset > header->top) ||
+        (offset % sizeof(uint64_t)))
+        return NULL;
+
+    link = (ArenaBlockLink *)(base + offset - sizeof(ArenaBlockLink));
+
+    if ((ARENA_BLOCK_MAGIC != link->magic) || (link->gap > offset - header->start) ||
+        (link->gap < sizeof(ArenaBlockHeader)))
+        return NULL;
+
+    block = offset - link->gap;
+    block_header = (ArenaBlockHeader *)(base + block);
+
+    if ((ARENA_BLOCK_MAGIC != block_header->link.magic) ||
+        (ARENA_BLOCK_USED != block_header->state) ||
+        (block_header->size_class >= ARENA_SIZE_CLASSES) ||
+        ((uint64_t)ARENA_MIN_BLOCK << block_header->size_class) > header->top - block)
+        return NULL;
+
+    if (p_block)
+        *p_block = block;
+
+    return block_header;
+}
+
+
+static int
+convert_offset(PyObject *py_offset, uint64_t *p_offset) {
+    // Returns 0 on success, -1 with a Python error set otherwise.
+    if (!PyLong_Check(py_offset)) {
+        PyErr_SetString(PyExc_TypeError, "The offset must be an integer");
+        return -1;
+    }
+
+    *p_offset = PyLong_AsUnsignedLongLong(py_offset);
+
+    if (PyErr_Occurred()) {
+        PyErr_Clear();
+        PyErr_SetString(PyExc_ValueError, "The offset must be a non-negative integer");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void
+shm_spin_lock(uint32_t *lock) {
+    uint32_t me = (uint32_t)getpid();
+    uint32_t expected;
+    uint32_t owner;
+    int tries = 0;
+    int yields = 0;
+
+    for (;;) {
+        expected = 0;
+        if (__atomic_compare_exchange_n(lock, &expected, me, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return;
+
+        if (++tries < SPIN_TRIES)
+            continue;
+
+        tries = 0;
+        sched_yield();
+
+        if (++yields < YIELDS_PER_OWNER_CHECK)
+            continue;
+
+        yields = 0;
+
+        // The lock has been held for a long time. If the process that holds
+        // it is gone, take the lock over.
+        owner = __atomic_load_n(lock, __ATOMIC_RELAXED);
+        if (owner && (owner != me) && (-1 == kill((pid_t)owner, 0)) && (ESRCH == errno)) {
+            DPRINTF("taking over spinlock held by dead process %u\n", owner);
+            if (__atomic_compare_exchange_n(lock, &owner, me, 0,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                return;
+        }
+    }
+}
+
+
+void
+shm_spin_unlock(uint32_t *lock) {
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+
+uint64_t
+arena_alloc(SharedArena *self, uint64_t size, uint64_t align) {
+    ArenaHeader *header;
+    ArenaBlockHeader *block_header;
+    ArenaBlockLink *link;
+    char *base;
+    int size_class;
+    uint64_t block_size;
+    uint64_t block;
+    uint64_t offset;
+
+    if (!(header = arena_header(self)))
+        return 0;
+
+    base = (char *)self->memory->address;
+
+    if (align < ARENA_DEFAULT_ALIGN)
+        align = ARENA_DEFAULT_ALIGN;
+
+    // Blocks are 16-byte aligned, so the data never starts more than align
+    // bytes past the start of its block.
+    if ((size > header->end - header->start) ||
+        (-1 == (size_class = size_class_for(size + align)))) {
+        PyErr_SetString(PyExc_MemoryError, "Not enough space in the arena");
+        return 0;
+    }
+
+    block_size = (uint64_t)ARENA_MIN_BLOCK << size_class;
+
+    shm_spin_lock(&header->lock);
+
+    if ((block = header->free_lists[size_class])) {
+        header->free_lists[size_class] =
+            *(uint64_t *)(base + block + sizeof(ArenaBlockHeader));
+    }
+    else {
+        if (block_size > header->end - header->top) {
+            shm_spin_unlock(&header->lock);
+            PyErr_SetString(PyExc_MemoryError, "Not enough space in the arena");
+            return 0;
+        }
+        block = header->top;
+        header->top += block_size;
+        ((ArenaBlockHeader *)(base + block))->generation = 0;
+    }
+
+    block_header = (ArenaBlockHeader *)(base + block);
+    block_header->generation++;
+    block_header->size_class = (uint8_t)size_class;
+    block_header->state = ARENA_BLOCK_USED;
+    block_header->reserved = 0;
+
+    offset = align_up(block + sizeof(ArenaBlockHeader), align);
+
+    block_header->link.magic = ARENA_BLOCK_MAGIC;
+    block_header->link.gap = (uint32_t)(offset - block);
+
+    link = (ArenaBlockLink *)(base + offset - sizeof(ArenaBlockLink));
+    if (link != &block_header->link)
+        *link = block_header->link;
+
+    header->bytes_in_use += block_size;
+    header->blocks_in_use++;
+
+    shm_spin_unlock(&header->lock);
+
+    DPRINTF("arena alloc size=%llu align=%llu -> block %llu, offset %llu\n",
+            (unsigned long long)size, (unsigned long long)align,
+            (unsigned long long)block, (unsigned long long)offset);
+
+    return offset;
+}
+
+
+int
+arena_free(SharedArena *self, uint64_t offset) {
+    ArenaHeader *header;
+    ArenaBlockHeader *block_header;
+    char *base;
+    uint64_t block;
+
+    if (!(header = arena_header(self)))
+        return -1;
+
+    base = (char *)self->memory->address;
+
+    shm_spin_lock(&header->lock);
+
+    if (!(block_header = find_block(header, base, offset, &block))) {
+        shm_spin_unlock(&header->lock);
+        PyErr_Format(PyExc_ValueError,
+                     "Offset %llu is not an allocated block in this arena",
+                     (unsigned long long)offset);
+        return -1;
+    }
+
+    block_header->state = ARENA_BLOCK_FREE;
+    block_header->generation++;
+
+    *(uint64_t *)(base + block + sizeof(ArenaBlockHeader)) =
+        header->free_lists[block_header->size_class];
+    header->free_lists[block_header->size_class] = block;
+
+    header->bytes_in_use -= (uint64_t)ARENA_MIN_BLOCK << block_header->size_class;
+    header->blocks_in_use--;
+
+    shm_spin_unlock(&header->lock);
+
+    return 0;
+}
+
+
+int
+arena_generation(SharedArena *self, uint64_t offset, uint32_t *generation, uint64_t *capacity) {
+    ArenaHeader *header;
+    ArenaBlockHeader *block_header;
+    uint64_t block;
+
+    if (!(header = arena_header(self)))
+        return -1;
+
+    shm_spin_lock(&header->lock);
+
+    block_header = find_block(header, (char *)self->memory->address, offset, &block);
+    if (block_header) {
+        *generation = block_header->generation;
+        if (capacity)
+            *capacity = block + ((uint64_t)ARENA_MIN_BLOCK << block_header->size_class) - offset;
+    }
+
+    shm_spin_unlock(&header->lock);
+
+    if (!block_header) {
+        PyErr_Format(PyExc_ValueError,
+                     "Offset %llu is not an allocated block in this arena",
+                     (unsigned long long)offset);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/************ SharedArena methods ************/
+
+PyObject *
+SharedArena_new(PyTypeObject *type, PyObject *args, PyObject *kwlist) {
+    SharedArena *self;
+
+    self = (SharedArena *)type->tp_alloc(type, 0);
+
+    if (NULL != self) {
+        self->memory = NULL;
+        self->offset = 0;
+    }
+
+    return (PyObject *)self;
+}
+
+
+int
+SharedArena_init(SharedArena *self, PyObject *args, PyObject *keywords) {
+    SharedMemory *memory = NULL;
+    unsigned long offset = 0;
+    unsigned long size = 0;
+    unsigned long segment_size;
+    int init = 0;
+    PyObject *py_size;
+    ArenaHeader *header;
+    char *keyword_list[ ] = {"memory", "offset", "size", "init", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O!|kkp", keyword_list,
+                                     &SharedMemoryType, &memory,
+                                     &offset, &size, &init))
+        goto error_return;
+
+    if (!memory->address) {
+        PyErr_SetString(pNotAttachedException, "The memory segment is not attached");
+        goto error_return;
+    }
+
+    if (offset % ARENA_DEFAULT_ALIGN) {
+        PyErr_Format(PyExc_ValueError, "The offset must be a multiple of %d",
+                     ARENA_DEFAULT_ALIGN);
+        goto error_return;
+    }
+
+    if ( (py_size = shm_get_size(memory)) ) {
+        segment_size = PyLong_AsUnsignedLongMask(py_size);
+        Py_DECREF(py_size);
+    }
+    else
+        goto error_return;
+
+    if (offset >= segment_size) {
+        PyErr_SetString(PyExc_ValueError, "The offset must be less than the segment size");
+        goto error_return;
+    }
+
+    header = (ArenaHeader *)((char *)memory->address + offset);
+
+    if (memory->read_only) {
+        PyErr_SetString(PyExc_OSError, "An arena's memory segment can't be attached read-only");
+        goto error_return;
+    }
+
+    if (init) {
+        if (!size)
+            size = segment_size - offset;
+
+        // Blocks start at the first 64-byte boundary after the header, so
+        // the room the header takes depends on the offset.
+        if ((size > segment_size - offset) ||
+            (align_up(offset + sizeof(ArenaHeader), 64) + ARENA_MIN_BLOCK > offset + size)) {
+            PyErr_SetString(PyExc_ValueError,
+                            "The arena must be large enough to hold its header and fit within the segment");
+            goto error_return;
+        }
+
+        memset(header, 0, sizeof(ArenaHeader));
+        header->version = ARENA_VERSION;
+        header->start = align_up(offset + sizeof(ArenaHeader), 64);
+        header->end = offset + size;
+        header->top = header->start;
+        // The magic goes in last so that no other process uses the arena
+        // until its header is complete.
+        __atomic_store_n(&header->magic, ARENA_MAGIC, __ATOMIC_RELEASE);
+    }
+    else {
+        if ((segment_size - offset < sizeof(ArenaHeader)) ||
+            (ARENA_MAGIC != __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE))) {
+            PyErr_Format(PyExc_ValueError, "There's no arena at offset %lu", offset);
+            goto error_return;
+        }
+
+        if (ARENA_VERSION != header->version) {
+            PyErr_Format(PyExc_ValueError, "Unsupported arena version %u",
+                         (unsigned int)header->version);
+            goto error_return;
+        }
+
+        if ((header->end > segment_size) || (size && (size != header->end - offset))) {
+            PyErr_SetString(PyExc_ValueError, "The arena's size doesn't match the segment");
+            goto error_return;
+        }
+
+        if ((header->start < offset + sizeof(ArenaHeader)) || (header->end < header->start) ||
+            (header->top < header->start) || (header->top > header->end)) {
+            PyErr_SetString(PyExc_ValueError, "The arena's header is corrupt");
+            goto error_return;
+        }
+    }
+
+    Py_INCREF(memory);
+    Py_XSETREF(self->memory, memory);
+    self->offset = offset;
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+
+void
+SharedArena_dealloc(SharedArena *self) {
+    Py_XDECREF(self->memory);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+SharedArena_alloc(SharedArena *self, PyObject *args, PyObject *keywords) {
+    Py_ssize_t size;
+    Py_ssize_t align = ARENA_DEFAULT_ALIGN;
+    uint64_t offset;
+    char *keyword_list[ ] = {"size", "align", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "n|n", keyword_list,
+                                     &size, &align))
+        goto error_return;
+
+    if (size < 0) {
+        PyErr_SetString(PyExc_ValueError, "The size cannot be negative");
+        goto error_return;
+    }
+
+    if ((align <= 0) || (align > ARENA_MAX_ALIGN) || (align & (align - 1))) {
+        PyErr_SetString(PyExc_ValueError, "The alignment must be a power of 2 no larger than 2**30");
+        goto error_return;
+    }
+
+    if (!(offset = arena_alloc(self, (uint64_t)size, (uint64_t)align)))
+        goto error_return;
+
+    return PyLong_FromUnsignedLongLong(offset);
+
+    error_return:
+    return NULL;
+}
+
+
+PyObject *
+SharedArena_free(SharedArena *self, PyObject *py_offset) {
+    uint64_t offset;
+
+    if (-1 == convert_offset(py_offset, &offset))
+        goto error_return;
+
+    if (-1 == arena_free(self, offset))
+        goto error_return;
+
+    Py_RETURN_NONE;
+
+    error_return:
+    return NULL;
+}
+
+
+PyObject *
+SharedArena_generation(SharedArena *self, PyObject *py_offset) {
+    uint64_t offset;
+    uint32_t generation;
+
+    if (-1 == convert_offset(py_offset, &offset))
+        goto error_return;
+
+    if (-1 == arena_generation(self, offset, &generation, NULL))
+        goto error_return;
+
+    return PyLong_FromUnsignedLong(generation);
+
+    error_return:
+    return NULL;
+}
+
+
+PyObject *
+arena_repr(SharedArena *self) {
+    if (self->memory)
+        return PyUnicode_FromFormat("sysv_ipc.SharedArena(%R, offset=%lu)",
+                                    (PyObject *)self->memory, self->offset);
+    else
+        return PyUnicode_FromString("sysv_ipc.SharedArena()");
+}
+
+
+PyObject *
+arena_get_memory(SharedArena *self) {
+    if (self->memory) {
+        Py_INCREF(self->memory);
+        return (PyObject *)self->memory;
+    }
+    else
+        Py_RETURN_NONE;
+}
+
+
+PyObject *
+arena_get_offset(SharedArena *self) {
+    return PyLong_FromUnsignedLong(self->offset);
+}
+
+
+PyObject *
+arena_get_size(SharedArena *self) {
+    ArenaHeader *header;
+
+    if (!(header = arena_header(self)))
+        return NULL;
+
+    return PyLong_FromUnsignedLongLong(header->end - self->offset);
+}
+
+
+PyObject *
+arena_get_bytes_in_use(SharedArena *self) {
+    ArenaHeader *header;
+
+    if (!(header = arena_header(self)))
+        return NULL;
+
+    return PyLong_FromUnsignedLongLong(__atomic_load_n(&header->bytes_in_use, __ATOMIC_RELAXED));
+}
+
+
+PyObject *
+arena_get_blocks_in_use(SharedArena *self) {
+    ArenaHeader *header;
+
+    if (!(header = arena_header(self)))
+        return NULL;
+
+    return PyLong_FromUnsignedLongLong(__atomic_load_n(&header->blocks_in_use, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,121 @@
+#include <stdint.h>
+
+/* SharedArena is an allocator for the space inside a SharedMemory segment.
+
+The arena's bookkeeping lives in the segment itself, so every process that
+attaches the segment sees the same allocations. alloc() and free() deal in
+offsets from the start of the segment rather than in addresses because each
+process may attach the segment at a different address.
+
+Block sizes are powers of two from ARENA_MIN_BLOCK up. Each size class has
+its own free list. A request that can't be satisfied from its size class's
+free list is carved from the never-used space at the top of the arena. Blocks
+are never split or merged, so space freed in one size class is only reused
+by allocations in the same class.
+
+A small spinlock in the arena header serializes alloc() and free(). The
+critical sections are a handful of loads and stores so the lock is held only
+briefly. The lock word holds the owner's pid so that a waiter can take over a
+lock whose owner has died.
+*/
+
+#define ARENA_MAGIC 0x52415653          // "SVAR" in little-endian ASCII
+#define ARENA_BLOCK_MAGIC 0x4b4c4256    // "VBLK" in little-endian ASCII
+#define ARENA_VERSION 1
+
+#define ARENA_MIN_BLOCK 32
+#define ARENA_SIZE_CLASSES 40
+#define ARENA_DEFAULT_ALIGN 16
+#define ARENA_MAX_ALIGN (1 << 30)
+
+/* The arena header is at the arena's offset in the segment. Blocks start at
+the first 64-byte boundary after it. All offsets are from the start of the
+segment. A free list entry of 0 means the list is empty (offset 0 can't be a
+block because the header is always before the first block).
+*/
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t lock;
+    uint32_t reserved;
+    uint64_t start;
+    uint64_t end;
+    uint64_t top;
+    uint64_t bytes_in_use;
+    uint64_t blocks_in_use;
+    uint64_t free_lists[ARENA_SIZE_CLASSES];
+} ArenaHeader;
+
+/* The 8 bytes immediately before the offset returned by alloc(). They give
+the distance back to the start of the block. */
+typedef struct {
+    uint32_t magic;
+    uint32_t gap;
+} ArenaBlockLink;
+
+/* The header at the start of every block. When the caller asks for an
+alignment of 16 or less, the link is the last member of this header.
+Otherwise, there's a second copy of the link just before the caller's data.
+
+The generation is incremented each time the block is allocated or freed, so
+an offset paired with its generation identifies one particular allocation.
+A free block stores the offset of the next free block right after this
+header.
+*/
+#define ARENA_BLOCK_FREE 0
+#define ARENA_BLOCK_USED 1
+
+typedef struct {
+    uint32_t generation;
+    uint8_t size_class;
+    uint8_t state;
+    uint16_t reserved;
+    ArenaBlockLink link;
+} ArenaBlockHeader;
+
+typedef struct {
+    PyObject_HEAD
+    SharedMemory *memory;
+    unsigned long offset;
+} SharedArena;
+
+// Other code (e.g. MessageQueue's spill_arena) checks its arguments against this
+extern PyTypeObject SharedArenaType;
+
+/* Object methods */
+PyObject *SharedArena_new(PyTypeObject *, PyObject *, PyObject *);
+int SharedArena_init(SharedArena *, PyObject *, PyObject *);
+void SharedArena_dealloc(SharedArena *);
+PyObject *SharedArena_alloc(SharedArena *, PyObject *, PyObject *);
+PyObject *SharedArena_free(SharedArena *, PyObject *);
+PyObject *SharedArena_generation(SharedArena *, PyObject *);
+
+/* Object attributes (read-only) */
+PyObject *arena_get_memory(SharedArena *);
+PyObject *arena_get_offset(SharedArena *);
+PyObject *arena_get_size(SharedArena *);
+PyObject *arena_get_bytes_in_use(SharedArena *);
+PyObject *arena_get_blocks_in_use(SharedArena *);
+
+PyObject *arena_repr(SharedArena *);
+
+/* Utility functions */
+
+/* Returns the segment offset of a new block of at least size bytes with the
+given alignment, or 0 with a Python error set. */
+uint64_t arena_alloc(SharedArena *, uint64_t size, uint64_t align);
+
+/* Frees the block at offset. Returns -1 with a Python error set if offset
+doesn't refer to an allocated block. */
+int arena_free(SharedArena *, uint64_t offset);
+
+/* Sets *generation to the generation of the block at offset and, if
+capacity isn't NULL, *capacity to the number of bytes from offset to the end
+of the block. Returns -1 with a Python error set if offset doesn't refer to
+an allocated block. */
+int arena_generation(SharedArena *, uint64_t offset, uint32_t *generation, uint64_t *capacity);
+
+/* A process-shared spinlock. The lock word is 0 when the lock is free and
+holds the owner's pid otherwise. */
+void shm_spin_lock(uint32_t *);
+void shm_spin_unlock(uint32_t *);
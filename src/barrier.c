@@ -0,0 +1,411 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "stats.h"
+#include "semaphore.h"
+#include "barrier.h"
+
+#include <string.h>
+
+
+/******************    Internal use only     **********************/
+
+static int
+find_phase(unsigned short *values) {
+    // The current phase is the counter that's non-zero and follows a zero
+    // counter. (Parties arriving move the count from it into the next one.)
+    int i;
+
+    for (i = 0; i < BARRIER_COUNTERS; i++) {
+        if (values[i] && !values[(i + BARRIER_COUNTERS - 1) % BARRIER_COUNTERS])
+            return i;
+    }
+
+    return 0;
+}
+
+
+static int
+arrive(Barrier *self) {
+    /* Decrements the current phase's counter and increments the next one's.
+       Returns the phase, or -1 with a Python error set.
+
+       self->phase is only a guess because other parties may have used the
+       barrier through other objects since this object last did. The semop
+       checks the guess: it requires the previous counter to be zero and the
+       current one to be non-zero, which is only true of the current phase
+       while this party hasn't arrived. If the guess is wrong, this rereads
+       the counters and tries again.
+    */
+    struct sembuf ops[3];
+    unsigned short values[BARRIER_SEMAPHORE_COUNT];
+    union semun arg;
+    unsigned short phase;
+
+    arg.array = values;
+
+    while (1) {
+        phase = (unsigned short)self->phase;
+
+        sem_set_op(&ops[0], (phase + BARRIER_COUNTERS - 1) % BARRIER_COUNTERS, 0, IPC_NOWAIT);
+        sem_set_op(&ops[1], phase, -1, IPC_NOWAIT);
+        sem_set_op(&ops[2], (phase + 1) % BARRIER_COUNTERS, 1, IPC_NOWAIT);
+
+        if (-1 != sem_semop(self->id, ops, 3, NULL, NULL))
+            return phase;
+
+        if (EAGAIN != errno) {
+            sem_set_error();
+            return -1;
+        }
+
+        if (-1 == semctl(self->id, 0, GETALL, arg)) {
+            sem_set_error();
+            return -1;
+        }
+
+        self->phase = find_phase(values);
+    }
+}
+
+
+/******************    Barrier     **********************/
+
+void
+Barrier_dealloc(Barrier *self) {
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+Barrier_new(PyTypeObject *type, PyObject *args, PyObject *keywords) {
+    Barrier *self;
+
+    self = (Barrier *)type->tp_alloc(type, 0);
+
+    return (PyObject *)self;
+}
+
+
+int
+Barrier_init(Barrier *self, PyObject *args, PyObject *keywords) {
+    int parties = 0;
+    int flags = 0;
+    int mode = 0600;
+    unsigned short values[BARRIER_SEMAPHORE_COUNT] = {0};
+    union semun arg;
+    char *keyword_list[ ] = {"key", "parties", "flags", "mode", NULL};
+    NoneableKey key;
+
+    //Barrier(key, [parties = 0, [flags = 0, [mode = 0600]]])
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O&|iii", keyword_list,
+                                     &convert_key_param, &key, &parties,
+                                     &flags, &mode))
+        goto error_return;
+
+    if (!sem_check_flags(&key, &flags))
+        goto error_return;
+
+    if ((parties < 0) || (parties > SEMVMX)) {
+        PyErr_Format(PyExc_ValueError,
+                     "parties must be between 0 and SEMAPHORE_VALUE_MAX (%d)",
+                     SEMVMX);
+        goto error_return;
+    }
+
+    // Check this before creating a set that would be left uninitialized.
+    if (((flags & IPC_CREX) == IPC_CREX) && !parties) {
+        PyErr_SetString(PyExc_ValueError, "A new barrier needs parties");
+        goto error_return;
+    }
+
+    self->id = sem_get_set(&key, BARRIER_SEMAPHORE_COUNT, mode, flags, &self->key);
+    if (-1 == self->id)
+        goto error_return;
+
+    arg.array = values;
+
+    if ((flags & IPC_CREX) != IPC_CREX) {
+        if (-1 == semctl(self->id, 0, GETALL, arg)) {
+            sem_set_error();
+            goto error_return;
+        }
+    }
+
+    // A set with no parties hasn't been initialized. That's always true
+    // with IPC_CREX, and it's true with IPC_CREAT if this call created it.
+    if ((flags & IPC_CREAT) && !values[BARRIER_PARTIES]) {
+        if (!parties) {
+            PyErr_SetString(PyExc_ValueError, "A new barrier needs parties");
+            goto error_return;
+        }
+
+        // Phase 0 starts with every party yet to arrive.
+        memset(values, 0, sizeof(values));
+        values[0] = (unsigned short)parties;
+        values[BARRIER_PARTIES] = (unsigned short)parties;
+
+        if (-1 == semctl(self->id, 0, SETALL, arg)) {
+            sem_set_error();
+            goto error_return;
+        }
+    }
+
+    if (!values[BARRIER_PARTIES]) {
+        PyErr_SetString(PyExc_ValueError, "The barrier hasn't been initialized");
+        goto error_return;
+    }
+
+    if (parties && (parties != values[BARRIER_PARTIES])) {
+        PyErr_Format(PyExc_ValueError,
+                     "parties (%d) doesn't match the existing barrier (%d)",
+                     parties, (int)values[BARRIER_PARTIES]);
+        goto error_return;
+    }
+
+    self->parties = values[BARRIER_PARTIES];
+
+    self->phase = find_phase(values);
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+
+PyObject *
+Barrier_wait(Barrier *self, PyObject *args, PyObject *keywords) {
+    NoneableTimeout timeout;
+    struct sembuf ops[3];
+    int phase;
+    unsigned short current;
+    unsigned short next;
+    int saved_errno;
+    char *keyword_list[ ] = {"timeout", NULL};
+
+    timeout.is_none = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|O&", keyword_list,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    if (-1 == (phase = arrive(self)))
+        return NULL;
+
+    current = (unsigned short)phase;
+    next = (unsigned short)((phase + 1) % BARRIER_COUNTERS);
+
+    // Wait for the rest of the parties.
+    sem_set_op(&ops[0], current, 0, sem_wait_flags(&timeout));
+    if (-1 == sem_semop(self->id, ops, 1, &timeout, NULL)) {
+        saved_errno = errno;
+
+        // Withdraw, but only if the barrier hasn't tripped in the meantime.
+        // The -1 fails (and so does the whole semop) if the counter is 0.
+        sem_set_op(&ops[0], current, -1, IPC_NOWAIT);
+        sem_set_op(&ops[1], current, 2, IPC_NOWAIT);
+        sem_set_op(&ops[2], next, -1, IPC_NOWAIT);
+
+        if (-1 == sem_semop(self->id, ops, 3, NULL, NULL)) {
+            if (EAGAIN != errno) {
+                sem_set_error();
+                return NULL;
+            }
+            // else
+            // The last party arrived after all, so this party is through.
+        }
+        else {
+            errno = saved_errno;
+            sem_set_error();
+            return NULL;
+        }
+    }
+
+    self->phase = next;
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+Barrier_remove(Barrier *self) {
+    return sem_remove(self->id);
+}
+
+
+PyObject *
+barrier_get_key(Barrier *self) {
+    return KEY_T_TO_PY(self->key);
+}
+
+
+PyObject *
+barrier_get_n_waiting(Barrier *self) {
+    int i;
+    int rc;
+    long n_waiting = 0;
+
+    for (i = 0; i < BARRIER_COUNTERS; i++) {
+        if (-1 == (rc = semctl(self->id, i, GETZCNT))) {
+            sem_set_error();
+            return NULL;
+        }
+        n_waiting += rc;
+    }
+
+    return PyLong_FromLong(n_waiting);
+}
+
+
+PyObject *
+barrier_repr(Barrier *self) {
+    return PyUnicode_FromFormat("sysv_ipc.Barrier(%ld, %d)", (long)self->key,
+                                self->parties);
+}
+
+
+/******************    CountDownLatch     **********************/
+
+void
+CountDownLatch_dealloc(CountDownLatch *self) {
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+CountDownLatch_new(PyTypeObject *type, PyObject *args, PyObject *keywords) {
+    CountDownLatch *self;
+
+    self = (CountDownLatch *)type->tp_alloc(type, 0);
+
+    return (PyObject *)self;
+}
+
+
+int
+CountDownLatch_init(CountDownLatch *self, PyObject *args, PyObject *keywords) {
+    int count = 0;
+    int flags = 0;
+    int mode = 0600;
+    union semun arg;
+    char *keyword_list[ ] = {"key", "count", "flags", "mode", NULL};
+    NoneableKey key;
+
+    //CountDownLatch(key, [count = 0, [flags = 0, [mode = 0600]]])
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O&|iii", keyword_list,
+                                     &convert_key_param, &key, &count,
+                                     &flags, &mode))
+        goto error_return;
+
+    if (!sem_check_flags(&key, &flags))
+        goto error_return;
+
+    if ((count < 0) || (count > SEMVMX)) {
+        PyErr_Format(PyExc_ValueError,
+                     "count must be between 0 and SEMAPHORE_VALUE_MAX (%d)",
+                     SEMVMX);
+        goto error_return;
+    }
+
+    // A count of 0 is legitimate, so unlike Barrier there's no way to tell
+    // whether IPC_CREAT alone created the latch. Only IPC_CREX sets the
+    // count, and a count that would be ignored is an error.
+    if (count && ((flags & IPC_CREX) != IPC_CREX)) {
+        PyErr_SetString(PyExc_ValueError, "count can only be set when flags is IPC_CREX");
+        goto error_return;
+    }
+
+    self->id = sem_get_set(&key, 1, mode, flags, &self->key);
+    if (-1 == self->id)
+        goto error_return;
+
+    if ((flags & IPC_CREX) == IPC_CREX) {
+        arg.val = count;
+
+        if (-1 == semctl(self->id, 0, SETVAL, arg)) {
+            sem_set_error();
+            goto error_return;
+        }
+    }
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+
+PyObject *
+CountDownLatch_count_down(CountDownLatch *self) {
+    struct sembuf op[1];
+
+    sem_set_op(&op[0], 0, -1, IPC_NOWAIT);
+
+    // EAGAIN means the count is already zero, in which case there's
+    // nothing to do.
+    if ((-1 == sem_semop(self->id, op, 1, NULL, NULL)) && (EAGAIN != errno)) {
+        sem_set_error();
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+CountDownLatch_wait(CountDownLatch *self, PyObject *args, PyObject *keywords) {
+    NoneableTimeout timeout;
+    struct sembuf op[1];
+    char *keyword_list[ ] = {"timeout", NULL};
+
+    timeout.is_none = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|O&", keyword_list,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    sem_set_op(&op[0], 0, 0, sem_wait_flags(&timeout));
+
+    if (-1 == sem_semop(self->id, op, 1, &timeout, NULL)) {
+        sem_set_error();
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+CountDownLatch_remove(CountDownLatch *self) {
+    return sem_remove(self->id);
+}
+
+
+PyObject *
+latch_get_key(CountDownLatch *self) {
+    return KEY_T_TO_PY(self->key);
+}
+
+
+PyObject *
+latch_get_count(CountDownLatch *self) {
+    int rc;
+
+    if (-1 == (rc = semctl(self->id, 0, GETVAL))) {
+        sem_set_error();
+        return NULL;
+    }
+
+    return PyLong_FromLong(rc);
+}
+
+
+PyObject *
+latch_repr(CountDownLatch *self) {
+    return PyUnicode_FromFormat("sysv_ipc.CountDownLatch(%ld)", (long)self->key);
+}
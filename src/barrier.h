@@ -0,0 +1,63 @@
+/* Barrier and CountDownLatch are built on sets of SysV semaphores and the
+wait-for-zero semop.
+
+A Barrier uses four semaphores. BARRIER_PARTIES holds the number of parties.
+The other three are arrival counters, and phase N of the barrier uses
+counter N % 3. At the start of a phase its counter holds the number of
+parties and the other two hold 0. Arriving at the barrier is a single semop
+that decrements the current phase's counter and increments the next
+phase's. Waiting is a wait for the current counter to reach zero.
+
+By the time any party arrives at phase N + 2, every party has finished
+waiting in phase N, so counter N % 3 can be refilled (by arrivals at phase
+N + 2) without waking anyone who's still waiting for it to reach zero. The
+counters always sum to the number of parties.
+
+Each object remembers the phase it expects next, but another object may have
+moved the barrier on since, so arriving checks the guess (see arrive()).
+*/
+
+#define BARRIER_COUNTERS 3
+#define BARRIER_PARTIES 3
+#define BARRIER_SEMAPHORE_COUNT 4
+
+typedef struct {
+    PyObject_HEAD
+    key_t key;
+    int id;
+    int parties;
+    int phase;
+} Barrier;
+
+typedef struct {
+    PyObject_HEAD
+    key_t key;
+    int id;
+} CountDownLatch;
+
+/* Barrier methods */
+PyObject *Barrier_new(PyTypeObject *, PyObject *, PyObject *);
+int Barrier_init(Barrier *, PyObject *, PyObject *);
+void Barrier_dealloc(Barrier *);
+PyObject *Barrier_wait(Barrier *, PyObject *, PyObject *);
+PyObject *Barrier_remove(Barrier *);
+
+/* Barrier attributes (read-only) */
+PyObject *barrier_get_key(Barrier *);
+PyObject *barrier_get_n_waiting(Barrier *);
+
+PyObject *barrier_repr(Barrier *);
+
+/* CountDownLatch methods */
+PyObject *CountDownLatch_new(PyTypeObject *, PyObject *, PyObject *);
+int CountDownLatch_init(CountDownLatch *, PyObject *, PyObject *);
+void CountDownLatch_dealloc(CountDownLatch *);
+PyObject *CountDownLatch_count_down(CountDownLatch *);
+PyObject *CountDownLatch_wait(CountDownLatch *, PyObject *, PyObject *);
+PyObject *CountDownLatch_remove(CountDownLatch *);
+
+/* CountDownLatch attributes (read-only) */
+PyObject *latch_get_key(CountDownLatch *);
+PyObject *latch_get_count(CountDownLatch *);
+
+PyObject *latch_repr(CountDownLatch *);
@@ -0,0 +1,410 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+
+#include "common.h"
+#include "stats.h"
+#include "memory.h"
+#include "checksum.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CRC32C_SSE42
+#include <nmmintrin.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define CHECKSUM_LITTLE_ENDIAN
+#endif
+
+// The CRC-32C polynomial, bit-reflected
+#define CRC32C_POLY 0x82f63b78
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+typedef uint32_t (*Crc32cKernel)(uint32_t, const unsigned char *, size_t);
+
+static uint32_t crc32c_table[8][256];
+
+// Chosen by the first call to crc32c(), with the GIL held
+static Crc32cKernel crc32c_kernel = NULL;
+
+#ifdef CRC32C_SSE42
+// Shifts a CRC past one lane of zeros; see zeros_operator()
+static uint32_t crc32c_lane_shift;
+#endif
+
+
+/******************    Internal use only     **********************/
+
+static uint64_t
+read_le64(const unsigned char *p) {
+    uint64_t value;
+
+#ifdef CHECKSUM_LITTLE_ENDIAN
+    memcpy(&value, p, sizeof(value));
+#else
+    int i;
+
+    value = 0;
+    for (i = 7; i >= 0; i--)
+        value = (value << 8) | p[i];
+#endif
+
+    return value;
+}
+
+
+static uint32_t
+read_le32(const unsigned char *p) {
+    uint32_t value;
+
+#ifdef CHECKSUM_LITTLE_ENDIAN
+    memcpy(&value, p, sizeof(value));
+#else
+    value = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+            ((uint32_t)p[3] << 24);
+#endif
+
+    return value;
+}
+
+
+static void
+build_crc32c_table(void) {
+    // Table k holds the CRC of each byte followed by k zero bytes.
+    uint32_t crc;
+    int n;
+    int k;
+
+    for (n = 0; n < 256; n++) {
+        crc = n;
+        for (k = 0; k < 8; k++)
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        crc32c_table[0][n] = crc;
+    }
+
+    for (n = 0; n < 256; n++) {
+        crc = crc32c_table[0][n];
+        for (k = 1; k < 8; k++) {
+            crc = crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+            crc32c_table[k][n] = crc;
+        }
+    }
+}
+
+
+static uint32_t
+crc32c_software(uint32_t crc, const unsigned char *p, size_t length) {
+#ifdef CHECKSUM_LITTLE_ENDIAN
+    uint32_t low;
+    uint32_t high;
+    uint64_t word;
+
+    while (length >= 8) {
+        word = read_le64(p);
+        low = (uint32_t)word ^ crc;
+        high = (uint32_t)(word >> 32);
+        crc = crc32c_table[7][low & 0xff] ^ crc32c_table[6][(low >> 8) & 0xff] ^
+              crc32c_table[5][(low >> 16) & 0xff] ^ crc32c_table[4][low >> 24] ^
+              crc32c_table[3][high & 0xff] ^ crc32c_table[2][(high >> 8) & 0xff] ^
+              crc32c_table[1][(high >> 16) & 0xff] ^ crc32c_table[0][high >> 24];
+        p += 8;
+        length -= 8;
+    }
+#endif
+
+    while (length--)
+        crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
+
+
+#ifdef CRC32C_SSE42
+static uint32_t
+multiply_mod_poly(uint32_t a, uint32_t b) {
+    // Returns a * b modulo the CRC polynomial, with both bit-reflected.
+    uint32_t m = 0x80000000;
+    uint32_t product = 0;
+
+    while (m) {
+        if (a & m)
+            product ^= b;
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+
+    return product;
+}
+
+
+static uint32_t
+zeros_operator(size_t byte_count) {
+    // Returns x^(8 * byte_count) modulo the CRC polynomial. Multiplying a CRC
+    // by it gives the CRC after byte_count more zero bytes.
+    uint32_t result = 0x80000000;   // x^0
+    uint32_t square = 0x00800000;   // x^8
+
+    while (byte_count) {
+        if (byte_count & 1)
+            result = multiply_mod_poly(square, result);
+        square = multiply_mod_poly(square, square);
+        byte_count >>= 1;
+    }
+
+    return result;
+}
+
+
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_sse42(uint32_t crc, const unsigned char *p, size_t length) {
+    uint64_t crc0;
+    uint64_t crc1;
+    uint64_t crc2;
+    size_t i;
+
+    // A CRC is linear, so the CRC of three lanes is the first lane's CRC
+    // shifted past the other two, XORed with the others' CRCs from zero.
+    while (length >= 3 * CRC32C_LANE_SIZE) {
+        crc0 = crc;
+        crc1 = 0;
+        crc2 = 0;
+        for (i = 0; i < CRC32C_LANE_SIZE; i += 8) {
+            crc0 = _mm_crc32_u64(crc0, read_le64(p + i));
+            crc1 = _mm_crc32_u64(crc1, read_le64(p + CRC32C_LANE_SIZE + i));
+            crc2 = _mm_crc32_u64(crc2, read_le64(p + 2 * CRC32C_LANE_SIZE + i));
+        }
+        crc = multiply_mod_poly(crc32c_lane_shift, (uint32_t)crc0) ^ (uint32_t)crc1;
+        crc = multiply_mod_poly(crc32c_lane_shift, crc) ^ (uint32_t)crc2;
+        p += 3 * CRC32C_LANE_SIZE;
+        length -= 3 * CRC32C_LANE_SIZE;
+    }
+
+    crc0 = crc;
+    while (length >= 8) {
+        crc0 = _mm_crc32_u64(crc0, read_le64(p));
+        p += 8;
+        length -= 8;
+    }
+    crc = (uint32_t)crc0;
+
+    while (length--)
+        crc = _mm_crc32_u8(crc, *p++);
+
+    return crc;
+}
+#endif
+
+
+static Crc32cKernel
+get_crc32c_kernel(void) {
+    if (!crc32c_kernel) {
+#ifdef CRC32C_SSE42
+        if (__builtin_cpu_supports("sse4.2")) {
+            DPRINTF("crc32c is using SSE4.2\n");
+            crc32c_lane_shift = zeros_operator(CRC32C_LANE_SIZE);
+            crc32c_kernel = crc32c_sse42;
+            return crc32c_kernel;
+        }
+#endif
+        DPRINTF("crc32c is using the table\n");
+        build_crc32c_table();
+        crc32c_kernel = crc32c_software;
+    }
+
+    return crc32c_kernel;
+}
+
+
+static uint64_t
+rotl64(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+
+static uint64_t
+xxh64_round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * XXH_PRIME64_2;
+    accumulator = rotl64(accumulator, 31);
+    return accumulator * XXH_PRIME64_1;
+}
+
+
+static uint64_t
+xxh64_merge_round(uint64_t hash, uint64_t accumulator) {
+    hash ^= xxh64_round(0, accumulator);
+    return hash * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+
+static uint64_t
+xxh64(const unsigned char *p, size_t length, uint64_t seed) {
+    const unsigned char *end = p + length;
+    uint64_t v1, v2, v3, v4;
+    uint64_t hash;
+
+    if (length >= 32) {
+        v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        v2 = seed + XXH_PRIME64_2;
+        v3 = seed;
+        v4 = seed - XXH_PRIME64_1;
+
+        do {
+            v1 = xxh64_round(v1, read_le64(p));
+            v2 = xxh64_round(v2, read_le64(p + 8));
+            v3 = xxh64_round(v3, read_le64(p + 16));
+            v4 = xxh64_round(v4, read_le64(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = xxh64_merge_round(hash, v1);
+        hash = xxh64_merge_round(hash, v2);
+        hash = xxh64_merge_round(hash, v3);
+        hash = xxh64_merge_round(hash, v4);
+    }
+    else
+        hash = seed + XXH_PRIME64_5;
+
+    hash += (uint64_t)length;
+
+    while (end - p >= 8) {
+        hash ^= xxh64_round(0, read_le64(p));
+        hash = rotl64(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+
+    if (end - p >= 4) {
+        hash ^= (uint64_t)read_le32(p) * XXH_PRIME64_1;
+        hash = rotl64(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+
+    while (p < end) {
+        hash ^= (*p++) * XXH_PRIME64_5;
+        hash = rotl64(hash, 11) * XXH_PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+
+static const unsigned char *
+get_range(SharedMemory *self, unsigned long offset, PyObject *py_length, size_t *p_length) {
+    // Returns the address of the range, or NULL with a Python error set if
+    // it's not in the segment. A length of None means the rest of the segment.
+    Py_ssize_t length;
+
+    if (!self->address) {
+        PyErr_SetString(pNotAttachedException, "The memory segment is not attached");
+        return NULL;
+    }
+
+    if (offset > self->attached_size) {
+        PyErr_SetString(PyExc_ValueError, "The offset is outside of the segment");
+        return NULL;
+    }
+
+    if (!py_length || (py_length == Py_None))
+        *p_length = self->attached_size - offset;
+    else {
+        length = PyLong_AsSsize_t(py_length);
+        if ((-1 == length) && PyErr_Occurred())
+            return NULL;
+        if (length < 0) {
+            PyErr_SetString(PyExc_ValueError, "The length cannot be negative");
+            return NULL;
+        }
+        if ((size_t)length > self->attached_size - offset) {
+            PyErr_SetString(PyExc_ValueError, "The range extends past the end of the segment");
+            return NULL;
+        }
+        *p_length = (size_t)length;
+    }
+
+    return (const unsigned char *)self->address + offset;
+}
+
+
+/******************    SharedMemory crc32c() and xxhash64()     **********************/
+
+PyObject *
+SharedMemory_crc32c(SharedMemory *self, PyObject *args, PyObject *keywords) {
+    const unsigned char *start;
+    unsigned long offset = 0;
+    PyObject *py_length = NULL;
+    unsigned int value = 0;
+    size_t length;
+    Crc32cKernel kernel;
+    uint32_t crc;
+    char *keyword_list[ ] = {"offset", "length", "value", NULL};
+
+    // crc32c([offset = 0, [length = None, [value = 0]]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|kOI", keyword_list,
+                                     &offset, &py_length, &value))
+        return NULL;
+
+    if (!(start = get_range(self, offset, py_length, &length)))
+        return NULL;
+
+    kernel = get_crc32c_kernel();
+
+    // As with zlib.crc32(), value is a previous result to continue from.
+    crc = ~(uint32_t)value;
+
+    if (length >= self->gil_release_threshold) {
+        self->copies_in_progress++;
+        Py_BEGIN_ALLOW_THREADS
+        crc = kernel(crc, start, length);
+        Py_END_ALLOW_THREADS
+        self->copies_in_progress--;
+    }
+    else
+        crc = kernel(crc, start, length);
+
+    return PyLong_FromUnsignedLong(~crc);
+}
+
+
+PyObject *
+SharedMemory_xxhash64(SharedMemory *self, PyObject *args, PyObject *keywords) {
+    const unsigned char *start;
+    unsigned long offset = 0;
+    PyObject *py_length = NULL;
+    unsigned long long seed = 0;
+    size_t length;
+    uint64_t hash;
+    char *keyword_list[ ] = {"offset", "length", "seed", NULL};
+
+    // xxhash64([offset = 0, [length = None, [seed = 0]]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|kOK", keyword_list,
+                                     &offset, &py_length, &seed))
+        return NULL;
+
+    if (!(start = get_range(self, offset, py_length, &length)))
+        return NULL;
+
+    if (length >= self->gil_release_threshold) {
+        self->copies_in_progress++;
+        Py_BEGIN_ALLOW_THREADS
+        hash = xxh64(start, length, (uint64_t)seed);
+        Py_END_ALLOW_THREADS
+        self->copies_in_progress--;
+    }
+    else
+        hash = xxh64(start, length, (uint64_t)seed);
+
+    return PyLong_FromUnsignedLongLong(hash);
+}
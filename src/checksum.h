@@ -0,0 +1,22 @@
+#include <stdint.h>
+
+/* SharedMemory.crc32c() and xxhash64() hash a range of the segment where it
+lies, without copying it into a bytes object first.
+
+CRC-32C (the Castagnoli polynomial used by iSCSI, ext4 and others) uses the
+SSE4.2 crc32 instruction when the CPU has it. The choice is made at run time
+so that the module still loads on CPUs that don't. The instruction's result
+isn't available for a few cycles, so the kernel runs three independent CRCs
+over adjacent lanes of CRC32C_LANE_SIZE bytes and combines them. Elsewhere,
+a table-driven version that handles 8 bytes per step is used.
+
+XXH64 is the 64-bit xxHash. It's four independent streams of 64-bit
+multiplies and rotates, which already keeps a core busy; SIMD doesn't help
+because SSE and AVX2 have no 64-bit multiply.
+*/
+
+#define CRC32C_LANE_SIZE 8192
+
+/* SharedMemory methods */
+PyObject *SharedMemory_crc32c(SharedMemory *, PyObject *, PyObject *);
+PyObject *SharedMemory_xxhash64(SharedMemory *, PyObject *, PyObject *);
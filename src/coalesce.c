@@ -0,0 +1,650 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "stats.h"
+#include "semaphore.h"
+#include "memory.h"
+#include "arena.h"
+#include "mq.h"
+#include "waitany.h"
+#include "spill.h"
+#include "coalesce.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/******************    Internal use only     **********************/
+
+static void
+add_ns(struct timespec *timestamp, long long ns) {
+    timestamp->tv_sec += (time_t)(ns / 1000000000);
+    timestamp->tv_nsec += (long)(ns % 1000000000);
+    if (timestamp->tv_nsec >= 1000000000) {
+        timestamp->tv_sec++;
+        timestamp->tv_nsec -= 1000000000;
+    }
+}
+
+
+static int
+is_before(struct timespec *a, struct timespec *b) {
+    return (a->tv_sec < b->tv_sec) ||
+           ((a->tv_sec == b->tv_sec) && (a->tv_nsec < b->tv_nsec));
+}
+
+
+static void *
+flusher_main(void *arg) {
+    // Sends frames whose deadline has passed. Never blocks in msgsnd().
+    WriterState *state = (WriterState *)arg;
+    struct timespec now;
+
+    pthread_mutex_lock(&state->lock);
+
+    while (!state->closing) {
+        if (!state->pending || state->stalled) {
+            pthread_cond_wait(&state->changed, &state->lock);
+            continue;
+        }
+
+        clock_gettime(CLOCK_REALTIME, &now);
+
+        if (is_before(&now, &state->deadline)) {
+            pthread_cond_timedwait(&state->changed, &state->lock, &state->deadline);
+            continue;
+        }
+
+        if (0 == msgsnd(state->queue_id, state->p_msg, state->used, IPC_NOWAIT)) {
+            DPRINTF("Sent a frame of %zd messages after its deadline\n", state->pending);
+            state->pending = 0;
+            state->used = 0;
+        }
+        else if ((EAGAIN == errno) || (EINTR == errno)) {
+            state->deadline = now;
+            add_ns(&state->deadline, COALESCE_RETRY_INTERVAL_NS);
+        }
+        else {
+            // The next foreground send will report the problem.
+            DPRINTF("msgsnd() of a frame failed, errno=%d\n", errno);
+            state->stalled = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&state->lock);
+
+    return NULL;
+}
+
+
+static void
+lock_state(WriterState *state) {
+    // Another Python thread might hold the lock while it sends, so the GIL
+    // is released while waiting for it.
+    if (pthread_mutex_trylock(&state->lock)) {
+        Py_BEGIN_ALLOW_THREADS
+        pthread_mutex_lock(&state->lock);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+
+static int
+send_frame(CoalescingWriter *self, int flags, NoneableTimeout *timeout) {
+    // Sends the frame, if there is one. The caller must hold the lock.
+    // Returns -1 with a Python error set if the frame couldn't be sent, in
+    // which case it's kept.
+    WriterState *state = self->state;
+
+    if (!state->pending)
+        return 0;
+
+    if (-1 == queue_send(self->queue, state->p_msg, state->used, flags, timeout))
+        return -1;
+
+    state->pending = 0;
+    state->used = 0;
+    state->stalled = 0;
+
+    return 0;
+}
+
+
+static void
+free_state(CoalescingWriter *self) {
+    WriterState *state = self->state;
+
+    self->state = NULL;
+
+    if (getpid() == self->pid) {
+        if (self->has_thread) {
+            Py_BEGIN_ALLOW_THREADS
+            pthread_mutex_lock(&state->lock);
+            state->closing = 1;
+            pthread_cond_signal(&state->changed);
+            pthread_mutex_unlock(&state->lock);
+            pthread_join(state->thread, NULL);
+            Py_END_ALLOW_THREADS
+        }
+
+        pthread_cond_destroy(&state->changed);
+        pthread_mutex_destroy(&state->lock);
+        free(state->p_msg);
+        free(state);
+    }
+    // Otherwise, this is a forked child. The thread doesn't exist here and
+    // the lock might have been held at the moment of the fork, so the state
+    // is abandoned. Its frame belongs to the parent and isn't sent.
+}
+
+
+static int
+check_open(CoalescingWriter *self) {
+    if (!self->state) {
+        PyErr_SetString(PyExc_ValueError, "The writer is closed");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+split_frame(CoalescingReader *self, size_t length) {
+    // Validates a frame that was just received and counts its messages.
+    // Returns -1 with a Python error set if it isn't a valid frame.
+    char *message = self->p_msg->message;
+    size_t position = 0;
+    Py_ssize_t count = 0;
+    uint32_t item_length;
+
+    if (self->queue->spill_arena) {
+        if ((length < 1) || (SPILL_FRAME_INLINE != message[0]))
+            goto error_return;
+        position = 1;
+    }
+
+    self->position = position;
+
+    while (position < length) {
+        if (length - position < COALESCE_LENGTH_SIZE)
+            goto error_return;
+        memcpy(&item_length, message + position, COALESCE_LENGTH_SIZE);
+        position += COALESCE_LENGTH_SIZE;
+        if (item_length > length - position)
+            goto error_return;
+        position += item_length;
+        count++;
+    }
+
+    if (!count)
+        goto error_return;
+
+    self->length = length;
+    self->pending = count;
+
+    return 0;
+
+    error_return:
+    PyErr_SetString(PyExc_ValueError, "The message wasn't sent by a CoalescingWriter");
+    return -1;
+}
+
+
+/******************    Exposed methods     **********************/
+
+void
+CoalescingWriter_dealloc(CoalescingWriter *self) {
+    PyObject *type, *value, *traceback;
+    NoneableTimeout timeout;
+
+    if (self->state) {
+        // Sending what's left is worth a try, but not worth blocking for.
+        if (getpid() == self->pid) {
+            timeout.is_none = 1;
+            PyErr_Fetch(&type, &value, &traceback);
+            lock_state(self->state);
+            if (-1 == send_frame(self, IPC_NOWAIT, &timeout))
+                PyErr_WriteUnraisable((PyObject *)self);
+            pthread_mutex_unlock(&self->state->lock);
+            PyErr_Restore(type, value, traceback);
+        }
+        free_state(self);
+    }
+    Py_XDECREF(self->queue);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+CoalescingWriter_new(PyTypeObject *type, PyObject *args, PyObject *kwlist) {
+    CoalescingWriter *self;
+
+    self = (CoalescingWriter *)type->tp_alloc(type, 0);
+
+    if (NULL != self) {
+        self->queue = NULL;
+        self->state = NULL;
+        self->type = 1;
+        self->max_delay = -1;
+        self->has_thread = 0;
+        self->pid = 0;
+    }
+
+    return (PyObject *)self;
+}
+
+
+int
+CoalescingWriter_init(CoalescingWriter *self, PyObject *args, PyObject *keywords) {
+    MessageQueue *queue;
+    PyObject *py_max_delay = Py_None;
+    WriterState *state = NULL;
+    double max_delay = -1;
+    long type = 1;
+    int rc;
+    char *keyword_list[ ] = {"queue", "type", "max_delay", NULL};
+
+    // CoalescingWriter(queue, [type = 1, [max_delay = None]])
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O!|lO", keyword_list,
+                                     &MessageQueueType, &queue, &type, &py_max_delay))
+        goto error_return;
+
+    if (self->state) {
+        PyErr_SetString(PyExc_ValueError, "The writer is already open");
+        goto error_return;
+    }
+
+    if (type <= 0) {
+        PyErr_SetString(PyExc_ValueError, "The type must be > 0");
+        goto error_return;
+    }
+
+    if (Py_None != py_max_delay) {
+        max_delay = PyFloat_AsDouble(py_max_delay);
+        if ((-1 == max_delay) && PyErr_Occurred())
+            goto error_return;
+        // Also catches NaN
+        if (!(max_delay >= 0) || (max_delay > 86400)) {
+            PyErr_SetString(PyExc_ValueError,
+                            "The max_delay must be None or between 0 and 86400 seconds");
+            goto error_return;
+        }
+    }
+
+    if (!(state = (WriterState *)calloc(1, sizeof(WriterState)))) {
+        PyErr_NoMemory();
+        goto error_return;
+    }
+
+    state->capacity = queue->max_message_size;
+    state->queue_id = queue->id;
+    state->p_msg = (struct queue_message *)malloc(offsetof(struct queue_message, message) +
+                                                  state->capacity);
+    if (!state->p_msg) {
+        PyErr_NoMemory();
+        goto error_return;
+    }
+
+    pthread_mutex_init(&state->lock, NULL);
+    pthread_cond_init(&state->changed, NULL);
+
+    if (max_delay >= 0) {
+        if ((rc = wait_start_thread(&state->thread, flusher_main, state))) {
+            pthread_cond_destroy(&state->changed);
+            pthread_mutex_destroy(&state->lock);
+            errno = rc;
+            PyErr_SetFromErrno(PyExc_OSError);
+            goto error_return;
+        }
+    }
+
+    Py_INCREF(queue);
+    Py_XSETREF(self->queue, queue);
+    self->state = state;
+    self->type = type;
+    self->max_delay = max_delay;
+    self->has_thread = (max_delay >= 0);
+    self->pid = getpid();
+
+    return 0;
+
+    error_return:
+    if (state)
+        free(state->p_msg);
+    free(state);
+    return -1;
+}
+
+
+PyObject *
+CoalescingWriter_write(CoalescingWriter *self, PyObject *args, PyObject *keywords) {
+    Py_buffer user_msg;
+    PyObject *py_block = NULL;
+    NoneableTimeout timeout;
+    WriterState *state;
+    struct timespec now;
+    size_t frame;
+    size_t item_size;
+    uint32_t item_length;
+    char *keyword_list[ ] = {"message", "block", "timeout", NULL};
+
+    timeout.is_none = 1;
+
+    // write(message, [block = True, [timeout = None]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "y*|OO&", keyword_list,
+                                     &user_msg, &py_block,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    if (-1 == check_open(self))
+        goto error_return;
+
+    state = self->state;
+    frame = self->queue->spill_arena ? 1 : 0;
+
+    // The largest message is one that fills a frame on its own.
+    if ((state->capacity < frame + COALESCE_LENGTH_SIZE) ||
+        ((size_t)user_msg.len > state->capacity - frame - COALESCE_LENGTH_SIZE) ||
+        ((size_t)user_msg.len > UINT32_MAX)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "The message is too large to fit in a frame");
+        goto error_return;
+    }
+
+    item_size = COALESCE_LENGTH_SIZE + user_msg.len;
+    item_length = (uint32_t)user_msg.len;
+
+    lock_state(state);
+
+    if (state->pending && (state->used + item_size > state->capacity)) {
+        if (-1 == send_frame(self, queue_get_flags(py_block, &timeout), &timeout)) {
+            pthread_mutex_unlock(&state->lock);
+            goto error_return;
+        }
+    }
+
+    if (!state->pending) {
+        state->used = 0;
+        if (frame)
+            state->p_msg->message[state->used++] = SPILL_FRAME_INLINE;
+        state->p_msg->type = self->type;
+        state->stalled = 0;
+        if (self->has_thread) {
+            clock_gettime(CLOCK_REALTIME, &now);
+            state->deadline = now;
+            add_ns(&state->deadline, (long long)(self->max_delay * 1e9));
+        }
+    }
+
+    memcpy(state->p_msg->message + state->used, &item_length, COALESCE_LENGTH_SIZE);
+    memcpy(state->p_msg->message + state->used + COALESCE_LENGTH_SIZE, user_msg.buf,
+           user_msg.len);
+    state->used += item_size;
+    state->pending++;
+
+    // The thread starts timing the frame.
+    if (self->has_thread && (1 == state->pending))
+        pthread_cond_signal(&state->changed);
+
+    pthread_mutex_unlock(&state->lock);
+
+    PyBuffer_Release(&user_msg);
+    Py_RETURN_NONE;
+
+    error_return:
+    PyBuffer_Release(&user_msg);
+    return NULL;
+}
+
+
+PyObject *
+CoalescingWriter_flush(CoalescingWriter *self, PyObject *args, PyObject *keywords) {
+    PyObject *py_block = NULL;
+    NoneableTimeout timeout;
+    int rc;
+    char *keyword_list[ ] = {"block", "timeout", NULL};
+
+    timeout.is_none = 1;
+
+    // flush([block = True, [timeout = None]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|OO&", keyword_list,
+                                     &py_block, convert_timeout, &timeout))
+        return NULL;
+
+    if (-1 == check_open(self))
+        return NULL;
+
+    lock_state(self->state);
+    rc = send_frame(self, queue_get_flags(py_block, &timeout), &timeout);
+    pthread_mutex_unlock(&self->state->lock);
+
+    if (-1 == rc)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+CoalescingWriter_close(CoalescingWriter *self) {
+    NoneableTimeout timeout;
+    int rc = 0;
+
+    if (!self->state)
+        Py_RETURN_NONE;
+
+    if (getpid() == self->pid) {
+        timeout.is_none = 1;
+        lock_state(self->state);
+        rc = send_frame(self, 0, &timeout);
+        pthread_mutex_unlock(&self->state->lock);
+    }
+
+    // If the frame couldn't be sent, the writer stays open so the caller
+    // can try again.
+    if (-1 == rc)
+        return NULL;
+
+    free_state(self);
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+CoalescingWriter_enter(CoalescingWriter *self) {
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
+
+
+PyObject *
+CoalescingWriter_exit(CoalescingWriter *self, PyObject *args) {
+    return CoalescingWriter_close(self);
+}
+
+
+PyObject *
+writer_get_queue(CoalescingWriter *self) {
+    if (self->queue) {
+        Py_INCREF(self->queue);
+        return (PyObject *)self->queue;
+    }
+    else
+        Py_RETURN_NONE;
+}
+
+
+PyObject *
+writer_get_max_delay(CoalescingWriter *self) {
+    if (self->max_delay < 0)
+        Py_RETURN_NONE;
+    else
+        return PyFloat_FromDouble(self->max_delay);
+}
+
+
+PyObject *
+writer_get_pending(CoalescingWriter *self) {
+    Py_ssize_t pending;
+
+    if (!self->state)
+        return PyLong_FromLong(0);
+
+    lock_state(self->state);
+    pending = self->state->pending;
+    pthread_mutex_unlock(&self->state->lock);
+
+    return PyLong_FromSsize_t(pending);
+}
+
+
+PyObject *
+writer_get_closed(CoalescingWriter *self) {
+    return PyBool_FromLong(!self->state);
+}
+
+
+void
+CoalescingReader_dealloc(CoalescingReader *self) {
+    free(self->p_msg);
+    Py_XDECREF(self->queue);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+CoalescingReader_new(PyTypeObject *type, PyObject *args, PyObject *kwlist) {
+    CoalescingReader *self;
+
+    self = (CoalescingReader *)type->tp_alloc(type, 0);
+
+    if (NULL != self) {
+        self->queue = NULL;
+        self->p_msg = NULL;
+        self->pending = 0;
+        self->type = 0;
+        self->receiving = 0;
+    }
+
+    return (PyObject *)self;
+}
+
+
+int
+CoalescingReader_init(CoalescingReader *self, PyObject *args, PyObject *keywords) {
+    MessageQueue *queue;
+    struct queue_message *p_msg;
+    long type = 0;
+    char *keyword_list[ ] = {"queue", "type", NULL};
+
+    // CoalescingReader(queue, [type = 0])
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O!|l", keyword_list,
+                                     &MessageQueueType, &queue, &type))
+        goto error_return;
+
+    if (self->receiving) {
+        PyErr_SetString(PyExc_RuntimeError, "read() is in progress");
+        goto error_return;
+    }
+
+    p_msg = (struct queue_message *)malloc(offsetof(struct queue_message, message) +
+                                           queue->max_message_size);
+    if (!p_msg) {
+        PyErr_NoMemory();
+        goto error_return;
+    }
+
+    free(self->p_msg);
+    self->p_msg = p_msg;
+    self->capacity = queue->max_message_size;
+    self->pending = 0;
+    self->type = type;
+    Py_INCREF(queue);
+    Py_XSETREF(self->queue, queue);
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+
+PyObject *
+CoalescingReader_read(CoalescingReader *self, PyObject *args, PyObject *keywords) {
+    PyObject *py_block = NULL;
+    PyObject *py_message;
+    NoneableTimeout timeout;
+    ssize_t rc;
+    uint32_t item_length;
+    char *keyword_list[ ] = {"block", "timeout", NULL};
+
+    timeout.is_none = 1;
+
+    // read([block = True, [timeout = None]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|OO&", keyword_list,
+                                     &py_block, convert_timeout, &timeout))
+        return NULL;
+
+    if (!self->queue) {
+        PyErr_SetString(PyExc_ValueError, "The reader isn't initialized");
+        return NULL;
+    }
+
+    // The buffer is filled without the GIL, so only one thread can use it.
+    if (self->receiving) {
+        PyErr_SetString(PyExc_RuntimeError, "read() is in progress in another thread");
+        return NULL;
+    }
+
+    if (!self->pending) {
+        self->receiving = 1;
+        rc = queue_receive(self->queue, self->p_msg, self->capacity, (int)self->type,
+                           queue_get_flags(py_block, &timeout), &timeout);
+        self->receiving = 0;
+
+        if (-1 == rc)
+            return NULL;
+
+        if (-1 == split_frame(self, (size_t)rc))
+            return NULL;
+    }
+
+    memcpy(&item_length, self->p_msg->message + self->position, COALESCE_LENGTH_SIZE);
+    self->position += COALESCE_LENGTH_SIZE;
+
+    py_message = PyBytes_FromStringAndSize(self->p_msg->message + self->position,
+                                           item_length);
+    if (!py_message)
+        return NULL;
+
+    self->position += item_length;
+    self->pending--;
+
+    return py_message;
+}
+
+
+PyObject *
+reader_get_queue(CoalescingReader *self) {
+    if (self->queue) {
+        Py_INCREF(self->queue);
+        return (PyObject *)self->queue;
+    }
+    else
+        Py_RETURN_NONE;
+}
+
+
+PyObject *
+reader_get_pending(CoalescingReader *self) {
+    return PyLong_FromSsize_t(self->pending);
+}
@@ -0,0 +1,83 @@
+/* A CoalescingWriter packs many small messages into one queue message (a
+frame) so that they cost one msgsnd() and one kernel message header between
+them. A CoalescingReader splits frames back into messages.
+
+Each message in a frame is a native-endian uint32_t length followed by that
+many bytes, copied with memcpy() because nothing in a frame is aligned. If
+the queue had a spill_arena when the frame was started, the frame begins
+with SPILL_FRAME_INLINE so that it's framed like the queue's other messages.
+
+A frame is sent when the next message doesn't fit, when flush() or close()
+is called, or, if the writer has a max_delay, when the frame's first
+message has waited that long. The last is done by a thread that sends
+without blocking and, if the queue is full, tries again every
+COALESCE_RETRY_INTERVAL_NS until the frame is sent or someone else sends
+it. The thread never touches Python objects.
+*/
+
+#define COALESCE_RETRY_INTERVAL_NS 1000000
+
+#define COALESCE_LENGTH_SIZE sizeof(uint32_t)
+
+/* Shared between the writer and its thread. Everything is protected by
+lock. The writer holds the lock while it sends, so the thread waits
+rather than sending the same frame twice. */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+    struct queue_message *p_msg;
+    size_t capacity;            // the queue's max_message_size
+    size_t used;                // bytes of p_msg->message in use
+    Py_ssize_t pending;         // messages in the frame
+    int queue_id;
+    struct timespec deadline;   // when the frame must be sent by
+    int stalled;                // the thread's last try failed for good
+    int closing;
+} WriterState;
+
+typedef struct {
+    PyObject_HEAD
+    MessageQueue *queue;
+    WriterState *state;         // NULL after close()
+    long type;
+    double max_delay;           // negative means None
+    int has_thread;
+    pid_t pid;                  // the process that started the thread
+} CoalescingWriter;
+
+typedef struct {
+    PyObject_HEAD
+    MessageQueue *queue;
+    struct queue_message *p_msg;
+    size_t capacity;
+    size_t length;              // bytes of p_msg->message received
+    size_t position;            // where the next message starts
+    Py_ssize_t pending;         // messages not yet read from the frame
+    long type;
+    int receiving;
+} CoalescingReader;
+
+/* Object methods */
+PyObject *CoalescingWriter_new(PyTypeObject *, PyObject *, PyObject *);
+int CoalescingWriter_init(CoalescingWriter *, PyObject *, PyObject *);
+void CoalescingWriter_dealloc(CoalescingWriter *);
+PyObject *CoalescingWriter_write(CoalescingWriter *, PyObject *, PyObject *);
+PyObject *CoalescingWriter_flush(CoalescingWriter *, PyObject *, PyObject *);
+PyObject *CoalescingWriter_close(CoalescingWriter *);
+PyObject *CoalescingWriter_enter(CoalescingWriter *);
+PyObject *CoalescingWriter_exit(CoalescingWriter *, PyObject *);
+
+PyObject *CoalescingReader_new(PyTypeObject *, PyObject *, PyObject *);
+int CoalescingReader_init(CoalescingReader *, PyObject *, PyObject *);
+void CoalescingReader_dealloc(CoalescingReader *);
+PyObject *CoalescingReader_read(CoalescingReader *, PyObject *, PyObject *);
+
+/* Object attributes (read-only) */
+PyObject *writer_get_queue(CoalescingWriter *);
+PyObject *writer_get_max_delay(CoalescingWriter *);
+PyObject *writer_get_pending(CoalescingWriter *);
+PyObject *writer_get_closed(CoalescingWriter *);
+
+PyObject *reader_get_queue(CoalescingReader *);
+PyObject *reader_get_pending(CoalescingReader *);
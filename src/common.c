@@ -4,11 +4,65 @@
 
 #include "common.h"
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef GETRANDOM_EXISTS
+#include <sys/random.h>
+#endif
+
+/* Random keys come from a splitmix64 generator that's private to this module.
+It's seeded once per process from getrandom() (or, where that's missing, from
+the clock, the pid and an address) and reseeded after a fork so that parent
+and child don't walk the same sequence. Callers hold the GIL, so the state
+needs no other protection.
+*/
+static uint64_t random_state;
+static pid_t random_state_pid = 0;
+
+
+static uint64_t
+splitmix64_next(void) {
+    // ref: https://prng.di.unimi.it/splitmix64.c
+    uint64_t z = (random_state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+    return z ^ (z >> 31);
+}
+
+
+static void
+seed_random_state(void) {
+    uint64_t seed = 0;
+    int seeded = 0;
+    struct timespec now;
+
+#ifdef GETRANDOM_EXISTS
+    seeded = (sizeof(seed) == getrandom(&seed, sizeof(seed), GRND_NONBLOCK));
+#endif
+
+    if (!seeded) {
+        clock_gettime(CLOCK_REALTIME, &now);
+        seed = ((uint64_t)now.tv_sec * 1000000000) + (uint64_t)now.tv_nsec;
+        seed ^= (uint64_t)getpid() << 32;
+        seed ^= (uint64_t)(uintptr_t)&seed;
+    }
+
+    random_state = seed;
+    random_state_pid = getpid();
+
+    DPRINTF("random key generator seeded (getrandom: %s)\n", seeded ? "yes" : "no");
+}
+
 
 key_t
 get_random_key(void) {
-    int key;
+    long key;
 
     /* ******************************************************************
     The inability to know the range of a key_t requires careful code here.
@@ -16,25 +70,113 @@ get_random_key(void) {
     variable type I use internally when turning a key into a Python object and
     vice versa. Those limits may exceed the operating system's limits of key_t.
 
-    For instance, if key_t is typedef-ed as uint, I should generate a key
-    where 0 <= key <= UINT_MAX.
-
-    Since I can't know what key_t is typedef-ed as, I take a conservative
-    approach and generate only keys where
-    1 <= key <= SHRT_MAX.
+    Since I can't know what key_t is typedef-ed as, I generate keys where
+    1 <= key <= INT_MAX if key_t is at least as wide as an int, and
+    1 <= key <= SHRT_MAX otherwise.
 
     Such values will work if key_t is typedef-ed as a short, int, uint,
-    long or ulong.
+    long or ulong. Drawing from the wider range makes collisions with
+    existing keys (and the retries they cost) rare even on systems with
+    many IPC objects.
     ****************************************************************** */
+    long key_max = (sizeof(key_t) >= sizeof(int)) ? INT_MAX : SHRT_MAX;
+
+    if (getpid() != random_state_pid)
+        seed_random_state();
+
     do {
-        // ref: http://www.c-faq.com/lib/randrange.html
-        key = ((int)((double)rand() / ((double)RAND_MAX + 1) * (SHRT_MAX - 1))) + 1;
+        key = (long)(splitmix64_next() % (uint64_t)key_max) + 1;
     } while (key == IPC_PRIVATE);
 
     return (key_t)key;
 }
 
 
+PyObject *
+ipc_create_many(PyObject *cls, PyObject *args, PyObject *keywords) {
+    /* Creates n new IPC objects of type cls with randomly chosen keys and
+       returns them in a list. Keyword arguments go to the constructor. If
+       any creation fails, the objects already created are removed (and
+       detached, for shared memory) before the error is raised.
+    */
+    Py_ssize_t n;
+    Py_ssize_t i;
+    PyObject *py_list = NULL;
+    PyObject *py_args = NULL;
+    PyObject *py_object;
+    PyObject *py_result;
+    PyObject *error_type, *error_value, *error_traceback;
+
+    if (!PyArg_ParseTuple(args, "n:create_many", &n))
+        goto error_return;
+
+    if (n < 0) {
+        PyErr_SetString(PyExc_ValueError, "n cannot be negative");
+        goto error_return;
+    }
+
+    if (keywords && (PyDict_GetItemString(keywords, "key") ||
+                     PyDict_GetItemString(keywords, "flags"))) {
+        PyErr_SetString(PyExc_TypeError,
+                        "create_many() chooses the key and flags; don't pass them");
+        goto error_return;
+    }
+
+    if (!(py_args = Py_BuildValue("(Oi)", Py_None, IPC_CREX)))
+        goto error_return;
+
+    if (!(py_list = PyList_New(0)))
+        goto error_return;
+
+    for (i = 0; i < n; i++) {
+        if (!(py_object = PyObject_Call(cls, py_args, keywords)))
+            goto cleanup_return;
+
+        if (-1 == PyList_Append(py_list, py_object)) {
+            // The object isn't in the list, so clean it up here.
+            PyErr_Fetch(&error_type, &error_value, &error_traceback);
+            py_result = PyObject_CallMethod(py_object, "remove", NULL);
+            Py_XDECREF(py_result);
+            PyErr_Restore(error_type, error_value, error_traceback);
+            Py_DECREF(py_object);
+            goto cleanup_return;
+        }
+
+        Py_DECREF(py_object);
+    }
+
+    Py_DECREF(py_args);
+
+    return py_list;
+
+    cleanup_return:
+    // Undo the creations. Errors here are ignored so that the caller sees
+    // the error that caused the cleanup.
+    PyErr_Fetch(&error_type, &error_value, &error_traceback);
+
+    for (i = 0; i < PyList_GET_SIZE(py_list); i++) {
+        py_object = PyList_GET_ITEM(py_list, i);
+
+        if (PyObject_HasAttrString(py_object, "detach")) {
+            py_result = PyObject_CallMethod(py_object, "detach", NULL);
+            Py_XDECREF(py_result);
+            PyErr_Clear();
+        }
+
+        py_result = PyObject_CallMethod(py_object, "remove", NULL);
+        Py_XDECREF(py_result);
+        PyErr_Clear();
+    }
+
+    PyErr_Restore(error_type, error_value, error_traceback);
+
+    error_return:
+    Py_XDECREF(py_args);
+    Py_XDECREF(py_list);
+    return NULL;
+}
+
+
 int
 convert_key_param(PyObject *py_key, void *converted_key) {
     // Converts a PyObject into a key if possible. Returns 0 on failure.
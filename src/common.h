@@ -145,6 +145,7 @@ Freebsd - l_int (int)
 /* Utility functions */
 key_t get_random_key(void);
 int convert_key_param(PyObject *, void *);
+PyObject *ipc_create_many(PyObject *, PyObject *, PyObject *);
 
 /* Custom Exceptions/Errors */
 extern PyObject *pBaseException;
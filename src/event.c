@@ -0,0 +1,179 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "stats.h"
+#include "semaphore.h"
+#include "event.h"
+
+
+/******************    Internal use only     **********************/
+
+static PyObject *
+get_semctl_value(Event *self, int cmd) {
+    int rc;
+
+    if (-1 == (rc = semctl(self->id, 0, cmd))) {
+        sem_set_error();
+        return NULL;
+    }
+
+    return PyLong_FromLong(rc);
+}
+
+
+/******************    Exposed methods     **********************/
+
+void
+Event_dealloc(Event *self) {
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+Event_new(PyTypeObject *type, PyObject *args, PyObject *keywords) {
+    Event *self;
+
+    self = (Event *)type->tp_alloc(type, 0);
+
+    return (PyObject *)self;
+}
+
+
+int
+Event_init(Event *self, PyObject *args, PyObject *keywords) {
+    int flags = 0;
+    int mode = 0600;
+    union semun arg;
+    char *keyword_list[ ] = {"key", "flags", "mode", NULL};
+    NoneableKey key;
+
+    //Event(key, [flags = 0, [mode = 0600]])
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O&|ii", keyword_list,
+                                     &convert_key_param, &key, &flags, &mode))
+        goto error_return;
+
+    if (!sem_check_flags(&key, &flags))
+        goto error_return;
+
+    self->id = sem_get_set(&key, 1, mode, flags, &self->key);
+    if (-1 == self->id)
+        goto error_return;
+
+    // Linux zeroes new semaphores, but POSIX leaves their values undefined.
+    if (((flags & IPC_CREX) == IPC_CREX) && (mode & 0200)) {
+        arg.val = 0;
+
+        if (-1 == semctl(self->id, 0, SETVAL, arg)) {
+            sem_set_error();
+            goto error_return;
+        }
+    }
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+
+PyObject *
+Event_set(Event *self) {
+    struct sembuf ops[2];
+
+    // Raise the value from 0 to 1. If it's already 1, the zero test fails
+    // with EAGAIN and there's nothing to do.
+    sem_set_op(&ops[0], 0, 0, IPC_NOWAIT);
+    sem_set_op(&ops[1], 0, 1, IPC_NOWAIT);
+
+    if ((-1 == sem_semop(self->id, ops, 2, NULL, NULL)) && (EAGAIN != errno)) {
+        sem_set_error();
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+Event_clear(Event *self) {
+    struct sembuf op[1];
+
+    // EAGAIN means the event is already clear.
+    sem_set_op(&op[0], 0, -1, IPC_NOWAIT);
+
+    if ((-1 == sem_semop(self->id, op, 1, NULL, NULL)) && (EAGAIN != errno)) {
+        sem_set_error();
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+Event_is_set(Event *self) {
+    PyObject *py_value = get_semctl_value(self, GETVAL);
+    PyObject *py_result = NULL;
+
+    if (py_value) {
+        py_result = PyBool_FromLong(PyLong_AsLong(py_value));
+        Py_DECREF(py_value);
+    }
+
+    return py_result;
+}
+
+
+PyObject *
+Event_wait(Event *self, PyObject *args, PyObject *keywords) {
+    NoneableTimeout timeout;
+    struct sembuf ops[2];
+    short flags;
+    char *keyword_list[ ] = {"timeout", NULL};
+
+    timeout.is_none = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|O&", keyword_list,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    flags = sem_wait_flags(&timeout);
+
+    // Wait for the value to be 1 and leave it as it was.
+    sem_set_op(&ops[0], 0, -1, flags);
+    sem_set_op(&ops[1], 0, 1, flags);
+
+    if (-1 == sem_semop(self->id, ops, 2, &timeout, NULL)) {
+        sem_set_error();
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+Event_remove(Event *self) {
+    return sem_remove(self->id);
+}
+
+
+PyObject *
+event_get_key(Event *self) {
+    return KEY_T_TO_PY(self->key);
+}
+
+
+PyObject *
+event_get_n_waiting(Event *self) {
+    return get_semctl_value(self, GETNCNT);
+}
+
+
+PyObject *
+event_repr(Event *self) {
+    return PyUnicode_FromFormat("sysv_ipc.Event(%ld)", (long)self->key);
+}
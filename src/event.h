@@ -0,0 +1,30 @@
+/* Event is a single SysV semaphore that's 0 while the event is clear and 1
+while it's set. Waiters wait for the semaphore to be at least 1 with a semop
+that takes 1 and puts it back, so it never changes the value. When set()
+raises the value to 1, every waiter's semop can complete, and the kernel
+wakes them all in response to that one call.
+
+A new semaphore is 0, so a newly created event is clear.
+*/
+
+typedef struct {
+    PyObject_HEAD
+    key_t key;
+    int id;
+} Event;
+
+/* Object methods */
+PyObject *Event_new(PyTypeObject *, PyObject *, PyObject *);
+int Event_init(Event *, PyObject *, PyObject *);
+void Event_dealloc(Event *);
+PyObject *Event_set(Event *);
+PyObject *Event_clear(Event *);
+PyObject *Event_is_set(Event *);
+PyObject *Event_wait(Event *, PyObject *, PyObject *);
+PyObject *Event_remove(Event *);
+
+/* Object attributes (read-only) */
+PyObject *event_get_key(Event *);
+PyObject *event_get_n_waiting(Event *);
+
+PyObject *event_repr(Event *);
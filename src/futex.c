@@ -0,0 +1,846 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "stats.h"
+#include "memory.h"
+#include "semaphore.h"
+#include "futex.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef FUTEX_EXISTS
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define ONE_BILLION 1000000000
+
+// How often a waiter on a robust mutex checks whether the owner is alive
+#define ROBUST_CHECK_NS 100000000
+
+
+/******************    Internal use only     **********************/
+
+static int
+futex_wait(uint32_t *address, uint32_t expected, const struct timespec *timeout) {
+    /* Sleeps until woken if *address == expected. Returns 0 or an errno
+       value (EAGAIN if *address != expected, ETIMEDOUT or EINTR). Spurious
+       wakeups are possible so the caller must recheck its condition.
+    */
+#ifdef FUTEX_EXISTS
+    if (-1 == syscall(SYS_futex, address, FUTEX_WAIT, expected, timeout, NULL, 0))
+        return errno;
+#else
+    // Without futexes, give up the CPU and let the caller poll.
+    sched_yield();
+#endif
+    return 0;
+}
+
+
+static int
+futex_wake(uint32_t *address, int count) {
+    // Returns the number of waiters that were woken, or 0 if it's not known.
+#ifdef FUTEX_EXISTS
+    long rc;
+
+    rc = syscall(SYS_futex, address, FUTEX_WAKE, count, NULL, NULL, 0);
+
+    return (-1 == rc) ? 0 : (int)rc;
+#else
+    return 0;
+#endif
+}
+
+
+static void
+get_deadline(NoneableTimeout *timeout, struct timespec *deadline) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout->timestamp.tv_sec;
+    deadline->tv_nsec += timeout->timestamp.tv_nsec;
+    if (deadline->tv_nsec >= ONE_BILLION) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= ONE_BILLION;
+    }
+}
+
+
+static int
+get_remaining(const struct timespec *deadline, struct timespec *remaining) {
+    // Sets remaining to the time left before the deadline. Returns 0 if the
+    // deadline has passed.
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    remaining->tv_sec = deadline->tv_sec - now.tv_sec;
+    remaining->tv_nsec = deadline->tv_nsec - now.tv_nsec;
+    if (remaining->tv_nsec < 0) {
+        remaining->tv_sec--;
+        remaining->tv_nsec += ONE_BILLION;
+    }
+
+    return (remaining->tv_sec > 0) || ((0 == remaining->tv_sec) && remaining->tv_nsec);
+}
+
+
+static void *
+get_data(SharedMemory *memory, unsigned long offset, const char *name) {
+    // Returns the address of the object's data in the segment, or NULL with
+    // a Python error set if the segment isn't attached.
+    if (!memory) {
+        PyErr_Format(pInternalException, "The %s was not initialized", name);
+        return NULL;
+    }
+
+    if (!memory->address) {
+        PyErr_Format(pNotAttachedException, "The %s's memory segment is not attached", name);
+        return NULL;
+    }
+
+    return (char *)memory->address + offset;
+}
+
+
+static void *
+open_data(SharedMemory *memory, unsigned long offset, size_t size, uint32_t magic,
+          int init, const char *name) {
+    /* Validates the constructor's memory and offset and returns the address
+       of the data. If init is true, zeroes the data and stamps it with the
+       magic number. Otherwise checks that the magic number is there.
+       Returns NULL with a Python error set on failure.
+    */
+    PyObject *py_size;
+    unsigned long segment_size;
+    uint32_t *data;
+
+    if (!memory->address) {
+        PyErr_SetString(pNotAttachedException, "The memory segment is not attached");
+        return NULL;
+    }
+
+    if (memory->read_only) {
+        PyErr_Format(PyExc_OSError, "A %s's memory segment can't be attached read-only", name);
+        return NULL;
+    }
+
+    if (offset % FUTEX_ALIGN) {
+        PyErr_Format(PyExc_ValueError, "The offset must be a multiple of %d", FUTEX_ALIGN);
+        return NULL;
+    }
+
+    if ( (py_size = shm_get_size(memory)) ) {
+        segment_size = PyLong_AsUnsignedLongMask(py_size);
+        Py_DECREF(py_size);
+    }
+    else
+        return NULL;
+
+    if ((offset > segment_size) || (segment_size - offset < size)) {
+        PyErr_Format(PyExc_ValueError, "The %s doesn't fit in the segment at offset %lu",
+                     name, offset);
+        return NULL;
+    }
+
+    data = (uint32_t *)((char *)memory->address + offset);
+
+    if (init) {
+        memset(data, 0, size);
+        // The magic goes in last so that no other process uses the object
+        // until it's ready.
+        __atomic_store_n(data, magic, __ATOMIC_RELEASE);
+    }
+    else {
+        if (magic != __atomic_load_n(data, __ATOMIC_ACQUIRE)) {
+            PyErr_Format(PyExc_ValueError, "There's no %s at offset %lu", name, offset);
+            return NULL;
+        }
+    }
+
+    return data;
+}
+
+
+static int
+owner_is_dead(uint32_t owner) {
+    return owner && (owner != (uint32_t)getpid()) &&
+           (-1 == kill((pid_t)owner, 0)) && (ESRCH == errno);
+}
+
+
+static int
+try_lock(uint32_t *word) {
+    uint32_t expected = 0;
+
+    return __atomic_compare_exchange_n(word, &expected, (uint32_t)getpid(), 0,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+
+static int
+lock_slow(uint32_t *word, NoneableTimeout *timeout, int robust, int *p_owner_died) {
+    /* The contended path of acquiring the mutex. The caller has released
+       the GIL. Returns 0 once the mutex is held, or ETIMEDOUT or EINTR.
+    */
+    uint32_t me = (uint32_t)getpid();
+    uint32_t value;
+    uint32_t expected;
+    struct timespec deadline;
+    struct timespec wait_time;
+    struct timespec *p_wait_time;
+    int rc;
+
+    if (!timeout->is_none)
+        get_deadline(timeout, &deadline);
+
+    for (;;) {
+        value = __atomic_load_n(word, __ATOMIC_RELAXED);
+
+        if (!value) {
+            // Take the mutex, but since other processes might still be
+            // waiting, leave the waiters bit set so that they're woken.
+            expected = 0;
+            if (__atomic_compare_exchange_n(word, &expected, me | MUTEX_WAITERS, 0,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                return 0;
+            continue;
+        }
+
+        if (!(value & MUTEX_WAITERS)) {
+            // Tell the owner that someone needs to be woken on release.
+            if (!__atomic_compare_exchange_n(word, &value, value | MUTEX_WAITERS, 0,
+                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                continue;
+            value |= MUTEX_WAITERS;
+        }
+
+        if (robust && owner_is_dead(value & MUTEX_OWNER_MASK)) {
+            DPRINTF("taking over mutex held by dead process %u\n", value & MUTEX_OWNER_MASK);
+            if (__atomic_compare_exchange_n(word, &value, me | MUTEX_WAITERS, 0,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                *p_owner_died = 1;
+                return 0;
+            }
+            continue;
+        }
+
+        if (timeout->is_none)
+            p_wait_time = NULL;
+        else {
+            if (!get_remaining(&deadline, &wait_time))
+                return ETIMEDOUT;
+            p_wait_time = &wait_time;
+        }
+
+        if (robust && (!p_wait_time || wait_time.tv_sec || (wait_time.tv_nsec > ROBUST_CHECK_NS))) {
+            // Wake up now and then to check on the owner.
+            wait_time.tv_sec = 0;
+            wait_time.tv_nsec = ROBUST_CHECK_NS;
+            p_wait_time = &wait_time;
+        }
+
+        rc = futex_wait(word, value, p_wait_time);
+
+        if (EINTR == rc)
+            return EINTR;
+        // Otherwise the mutex changed, a release woke this process, or
+        // the wait timed out. The loop sorts out which.
+    }
+}
+
+
+static int
+unlock(uint32_t *word) {
+    /* Releases the mutex if this process holds it. Returns 0 if it did,
+       -1 if not.
+    */
+    uint32_t me = (uint32_t)getpid();
+    uint32_t value = me;
+
+    // No waiters is the common case and needs no system call.
+    if (__atomic_compare_exchange_n(word, &value, 0, 0,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        return 0;
+
+    if ((value & MUTEX_OWNER_MASK) != me)
+        return -1;
+
+    __atomic_store_n(word, 0, __ATOMIC_RELEASE);
+    futex_wake(word, 1);
+
+    return 0;
+}
+
+
+static int
+lock(SharedMutex *self, uint32_t *word, NoneableTimeout *timeout) {
+    /* Acquires the mutex, releasing the GIL if it has to wait. Returns 0,
+       ETIMEDOUT or EINTR.
+    */
+    int rc = 0;
+    int owner_died = 0;
+
+    self->owner_died = 0;
+
+    if (try_lock(word))
+        return 0;
+
+    if (!timeout->is_none && timeout->is_zero) {
+        if (!(self->robust &&
+              owner_is_dead(__atomic_load_n(word, __ATOMIC_RELAXED) & MUTEX_OWNER_MASK)))
+            return ETIMEDOUT;
+        // else
+        // The slow path will take the mutex over without waiting.
+    }
+
+    self->memory->copies_in_progress++;
+    Py_BEGIN_ALLOW_THREADS
+    rc = lock_slow(word, timeout, self->robust, &owner_died);
+    Py_END_ALLOW_THREADS
+    self->memory->copies_in_progress--;
+
+    self->owner_died = owner_died;
+
+    return rc;
+}
+
+
+static void
+set_wait_error(int rc) {
+    if (ETIMEDOUT == rc)
+        PyErr_SetString(pBusyException, "The wait timed out");
+    else if (EINTR == rc)
+        PyErr_SetString(pBaseException, "Signaled while waiting");
+    else {
+        errno = rc;
+        PyErr_SetFromErrno(PyExc_OSError);
+    }
+}
+
+
+/******************    SharedMutex     **********************/
+
+void
+SharedMutex_dealloc(SharedMutex *self) {
+    Py_XDECREF(self->memory);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+SharedMutex_new(PyTypeObject *type, PyObject *args, PyObject *kwlist) {
+    SharedMutex *self;
+
+    self = (SharedMutex *)type->tp_alloc(type, 0);
+
+    if (NULL != self) {
+        self->memory = NULL;
+        self->offset = 0;
+        self->robust = 0;
+        self->owner_died = 0;
+    }
+
+    return (PyObject *)self;
+}
+
+
+int
+SharedMutex_init(SharedMutex *self, PyObject *args, PyObject *keywords) {
+    SharedMemory *memory = NULL;
+    unsigned long offset = 0;
+    int init = 0;
+    int robust = 0;
+    char *keyword_list[ ] = {"memory", "offset", "init", "robust", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O!|kpp", keyword_list,
+                                     &SharedMemoryType, &memory,
+                                     &offset, &init, &robust))
+        return -1;
+
+    if (!open_data(memory, offset, sizeof(SharedMutexData), SHARED_MUTEX_MAGIC,
+                   init, "mutex"))
+        return -1;
+
+    Py_INCREF(memory);
+    Py_XSETREF(self->memory, memory);
+    self->offset = offset;
+    self->robust = robust;
+
+    return 0;
+}
+
+
+PyObject *
+SharedMutex_acquire(SharedMutex *self, PyObject *args, PyObject *keywords) {
+    NoneableTimeout timeout;
+    SharedMutexData *data;
+    int rc;
+    char *keyword_list[ ] = {"timeout", NULL};
+
+    timeout.is_none = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|O&", keyword_list,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    if (!(data = get_data(self->memory, self->offset, "mutex")))
+        return NULL;
+
+    if ((rc = lock(self, &data->word, &timeout))) {
+        set_wait_error(rc);
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+SharedMutex_release(SharedMutex *self) {
+    SharedMutexData *data;
+
+    if (!(data = get_data(self->memory, self->offset, "mutex")))
+        return NULL;
+
+    if (-1 == unlock(&data->word)) {
+        PyErr_SetString(PyExc_ValueError, "The mutex isn't held by this process");
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+SharedMutex_enter(SharedMutex *self) {
+    PyObject *args = PyTuple_New(0);
+    PyObject *retval = NULL;
+
+    if (SharedMutex_acquire(self, args, NULL)) {
+        retval = (PyObject *)self;
+        Py_INCREF(self);
+    }
+
+    Py_DECREF(args);
+
+    return retval;
+}
+
+
+PyObject *
+SharedMutex_exit(SharedMutex *self, PyObject *args) {
+    return SharedMutex_release(self);
+}
+
+
+PyObject *
+mutex_get_memory(SharedMutex *self) {
+    if (self->memory) {
+        Py_INCREF(self->memory);
+        return (PyObject *)self->memory;
+    }
+    else
+        Py_RETURN_NONE;
+}
+
+
+PyObject *
+mutex_get_offset(SharedMutex *self) {
+    return PyLong_FromUnsignedLong(self->offset);
+}
+
+
+PyObject *
+mutex_get_robust(SharedMutex *self) {
+    return PyBool_FromLong(self->robust);
+}
+
+
+PyObject *
+mutex_get_locked(SharedMutex *self) {
+    SharedMutexData *data;
+
+    if (!(data = get_data(self->memory, self->offset, "mutex")))
+        return NULL;
+
+    return PyBool_FromLong(0 != __atomic_load_n(&data->word, __ATOMIC_RELAXED));
+}
+
+
+PyObject *
+mutex_get_owner(SharedMutex *self) {
+    SharedMutexData *data;
+    uint32_t owner;
+
+    if (!(data = get_data(self->memory, self->offset, "mutex")))
+        return NULL;
+
+    owner = __atomic_load_n(&data->word, __ATOMIC_RELAXED) & MUTEX_OWNER_MASK;
+
+    if (owner)
+        return PyLong_FromUnsignedLong(owner);
+    else
+        Py_RETURN_NONE;
+}
+
+
+PyObject *
+mutex_get_owner_died(SharedMutex *self) {
+    return PyBool_FromLong(self->owner_died);
+}
+
+
+PyObject *
+mutex_repr(SharedMutex *self) {
+    if (self->memory)
+        return PyUnicode_FromFormat("sysv_ipc.SharedMutex(%R, offset=%lu)",
+                                    (PyObject *)self->memory, self->offset);
+    else
+        return PyUnicode_FromString("sysv_ipc.SharedMutex()");
+}
+
+
+/******************    SharedCondition     **********************/
+
+void
+SharedCondition_dealloc(SharedCondition *self) {
+    Py_XDECREF(self->memory);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+SharedCondition_new(PyTypeObject *type, PyObject *args, PyObject *kwlist) {
+    SharedCondition *self;
+
+    self = (SharedCondition *)type->tp_alloc(type, 0);
+
+    if (NULL != self) {
+        self->memory = NULL;
+        self->offset = 0;
+    }
+
+    return (PyObject *)self;
+}
+
+
+int
+SharedCondition_init(SharedCondition *self, PyObject *args, PyObject *keywords) {
+    SharedMemory *memory = NULL;
+    unsigned long offset = 0;
+    int init = 0;
+    char *keyword_list[ ] = {"memory", "offset", "init", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O!|kp", keyword_list,
+                                     &SharedMemoryType, &memory,
+                                     &offset, &init))
+        return -1;
+
+    if (!open_data(memory, offset, sizeof(SharedConditionData),
+                   SHARED_CONDITION_MAGIC, init, "condition"))
+        return -1;
+
+    Py_INCREF(memory);
+    Py_XSETREF(self->memory, memory);
+    self->offset = offset;
+
+    return 0;
+}
+
+
+PyObject *
+SharedCondition_wait(SharedCondition *self, PyObject *args, PyObject *keywords) {
+    SharedMutex *mutex = NULL;
+    NoneableTimeout timeout;
+    NoneableTimeout no_timeout;
+    SharedConditionData *data;
+    SharedMutexData *mutex_data;
+    struct timespec deadline;
+    struct timespec wait_time;
+    uint32_t sequence;
+    int rc = 0;
+    int owner_died = 0;
+    char *keyword_list[ ] = {"mutex", "timeout", NULL};
+
+    timeout.is_none = 1;
+    no_timeout.is_none = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O!|O&", keyword_list,
+                                     &SharedMutexType, &mutex,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    if (!(data = get_data(self->memory, self->offset, "condition")))
+        return NULL;
+
+    if (!(mutex_data = get_data(mutex->memory, mutex->offset, "mutex")))
+        return NULL;
+
+    if ((__atomic_load_n(&mutex_data->word, __ATOMIC_RELAXED) & MUTEX_OWNER_MASK) !=
+        (uint32_t)getpid()) {
+        PyErr_SetString(PyExc_ValueError, "The mutex isn't held by this process");
+        return NULL;
+    }
+
+    // Register as a waiter and note the sequence number while the mutex is
+    // still held, so that no notification can be missed.
+    __atomic_add_fetch(&data->waiters, 1, __ATOMIC_SEQ_CST);
+    sequence = __atomic_load_n(&data->sequence, __ATOMIC_SEQ_CST);
+
+    if (!timeout.is_none)
+        get_deadline(&timeout, &deadline);
+
+    self->memory->copies_in_progress++;
+    mutex->memory->copies_in_progress++;
+    Py_BEGIN_ALLOW_THREADS
+
+    unlock(&mutex_data->word);
+
+    // Sleep until notified. With futexes that's usually a single wait;
+    // without, this polls the sequence number.
+    while (sequence == __atomic_load_n(&data->sequence, __ATOMIC_SEQ_CST)) {
+        if (!timeout.is_none) {
+            if (!get_remaining(&deadline, &wait_time)) {
+                rc = ETIMEDOUT;
+                break;
+            }
+        }
+
+        rc = futex_wait(&data->sequence, sequence, timeout.is_none ? NULL : &wait_time);
+
+        if (EINTR == rc)
+            break;
+        rc = 0;
+    }
+
+    __atomic_sub_fetch(&data->waiters, 1, __ATOMIC_SEQ_CST);
+
+    // Whatever happened, the caller gets the mutex back, even if a signal
+    // arrives meanwhile. The signal is reported once the mutex is held.
+    if (!try_lock(&mutex_data->word)) {
+        while (EINTR == lock_slow(&mutex_data->word, &no_timeout, mutex->robust, &owner_died))
+            rc = EINTR;
+    }
+
+    Py_END_ALLOW_THREADS
+    mutex->memory->copies_in_progress--;
+    self->memory->copies_in_progress--;
+
+    mutex->owner_died = owner_died;
+
+    if (rc) {
+        set_wait_error(rc);
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+SharedCondition_notify(SharedCondition *self, PyObject *args, PyObject *keywords) {
+    SharedConditionData *data;
+    int n = 1;
+    char *keyword_list[ ] = {"n", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|i", keyword_list, &n))
+        return NULL;
+
+    if (n < 1) {
+        PyErr_SetString(PyExc_ValueError, "n must be at least 1");
+        return NULL;
+    }
+
+    if (!(data = get_data(self->memory, self->offset, "condition")))
+        return NULL;
+
+    __atomic_add_fetch(&data->sequence, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&data->waiters, __ATOMIC_SEQ_CST))
+        futex_wake(&data->sequence, n);
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+SharedCondition_notify_all(SharedCondition *self) {
+    SharedConditionData *data;
+
+    if (!(data = get_data(self->memory, self->offset, "condition")))
+        return NULL;
+
+    __atomic_add_fetch(&data->sequence, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&data->waiters, __ATOMIC_SEQ_CST))
+        futex_wake(&data->sequence, INT_MAX);
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+condition_get_memory(SharedCondition *self) {
+    if (self->memory) {
+        Py_INCREF(self->memory);
+        return (PyObject *)self->memory;
+    }
+    else
+        Py_RETURN_NONE;
+}
+
+
+PyObject *
+condition_get_offset(SharedCondition *self) {
+    return PyLong_FromUnsignedLong(self->offset);
+}
+
+
+PyObject *
+condition_get_n_waiting(SharedCondition *self) {
+    SharedConditionData *data;
+
+    if (!(data = get_data(self->memory, self->offset, "condition")))
+        return NULL;
+
+    return PyLong_FromUnsignedLong(__atomic_load_n(&data->waiters, __ATOMIC_RELAXED));
+}
+
+
+PyObject *
+condition_repr(SharedCondition *self) {
+    if (self->memory)
+        return PyUnicode_FromFormat("sysv_ipc.SharedCondition(%R, offset=%lu)",
+                                    (PyObject *)self->memory, self->offset);
+    else
+        return PyUnicode_FromString("sysv_ipc.SharedCondition()");
+}
+
+
+/******************    SharedMemory wait() and wake()     **********************/
+
+static uint32_t *
+get_word(SharedMemory *memory, unsigned long offset) {
+    // Returns the address of the 32-bit word at offset, or NULL with a Python
+    // error set if it can't be used.
+    if (!memory->address) {
+        PyErr_SetString(pNotAttachedException, "The memory segment is not attached");
+        return NULL;
+    }
+
+    if (offset % sizeof(uint32_t)) {
+        PyErr_Format(PyExc_ValueError, "The offset must be a multiple of %d",
+                     (int)sizeof(uint32_t));
+        return NULL;
+    }
+
+    if ((offset > memory->attached_size) ||
+        (memory->attached_size - offset < sizeof(uint32_t))) {
+        PyErr_SetString(PyExc_ValueError, "The offset is outside of the segment");
+        return NULL;
+    }
+
+    return (uint32_t *)((char *)memory->address + offset);
+}
+
+
+PyObject *
+SharedMemory_wait(SharedMemory *self, PyObject *args, PyObject *keywords) {
+    NoneableTimeout timeout;
+    struct timespec deadline;
+    struct timespec wait_time;
+    unsigned long offset;
+    long long expected;
+    uint32_t *word;
+    int32_t value;
+    int rc = 0;
+    char *keyword_list[ ] = {"offset", "expected", "timeout", NULL};
+
+    timeout.is_none = 1;
+
+    // wait(offset, expected, [timeout = None])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "kL|O&", keyword_list,
+                                     &offset, &expected, convert_timeout, &timeout))
+        return NULL;
+
+    if (!(word = get_word(self, offset)))
+        return NULL;
+
+    if ((expected < INT32_MIN) || (expected > INT32_MAX)) {
+        PyErr_SetString(PyExc_OverflowError, "The value doesn't fit in 4 bytes");
+        return NULL;
+    }
+
+    if (!timeout.is_none)
+        get_deadline(&timeout, &deadline);
+
+    self->copies_in_progress++;
+    Py_BEGIN_ALLOW_THREADS
+
+    // A wake() that doesn't change the word isn't enough to return, so
+    // spurious wakeups don't reach the caller. Without futexes this polls.
+    while ((value = (int32_t)__atomic_load_n(word, __ATOMIC_SEQ_CST)) == (int32_t)expected) {
+        if (!timeout.is_none) {
+            if (!get_remaining(&deadline, &wait_time)) {
+                rc = ETIMEDOUT;
+                break;
+            }
+        }
+
+        rc = futex_wait(word, (uint32_t)expected, timeout.is_none ? NULL : &wait_time);
+
+        if (EINTR == rc)
+            break;
+        rc = 0;
+    }
+
+    Py_END_ALLOW_THREADS
+    self->copies_in_progress--;
+
+    if (rc) {
+        set_wait_error(rc);
+        return NULL;
+    }
+
+    return PyLong_FromLong(value);
+}
+
+
+PyObject *
+SharedMemory_wake(SharedMemory *self, PyObject *args, PyObject *keywords) {
+    PyObject *py_count = NULL;
+    unsigned long offset;
+    uint32_t *word;
+    long count = 1;
+    char *keyword_list[ ] = {"offset", "count", NULL};
+
+    // wake(offset, [count = 1])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "k|O", keyword_list,
+                                     &offset, &py_count))
+        return NULL;
+
+    if (py_count == Py_None)
+        count = INT_MAX;
+    else if (py_count) {
+        count = PyLong_AsLong(py_count);
+        if ((-1 == count) && PyErr_Occurred())
+            return NULL;
+        if (count < 1) {
+            PyErr_SetString(PyExc_ValueError, "The count must be at least 1 or None");
+            return NULL;
+        }
+        if (count > INT_MAX)
+            count = INT_MAX;
+    }
+
+    if (!(word = get_word(self, offset)))
+        return NULL;
+
+    return PyLong_FromLong(futex_wake(word, (int)count));
+}
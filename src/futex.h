@@ -0,0 +1,98 @@
+#include <stdint.h>
+
+/* SharedMutex and SharedCondition live inside a SharedMemory segment. Their
+uncontended paths are a single atomic instruction in user space. Only a
+process that has to wait makes a system call, and it sleeps on a futex
+(FUTEX_WAIT and FUTEX_WAKE without FUTEX_PRIVATE_FLAG, since the waiters are
+in different processes). Where futexes don't exist, waiters yield the CPU and
+poll instead.
+
+The mutex word is 0 when the mutex is unlocked. Otherwise it holds the pid
+of the owner, plus MUTEX_WAITERS if another process might be waiting. The
+owner only makes a FUTEX_WAKE call on release if that bit is set. Because
+the owner's pid is in the same word as the lock, a waiter in robust mode can
+check whether the owner is still alive and take the mutex over from a dead
+owner with a single compare and swap.
+
+The condition has a sequence number that every notification increments.
+A waiter reads it before releasing the mutex and sleeps only if it hasn't
+changed, so a notification can't slip in between. The condition also
+counts its waiters so that notifying a condition that no one is waiting on
+doesn't need a system call.
+*/
+
+#define SHARED_MUTEX_MAGIC 0x5854554d        // "MUTX" in little-endian ASCII
+#define SHARED_CONDITION_MAGIC 0x444e4f43    // "COND" in little-endian ASCII
+
+#define MUTEX_WAITERS 0x80000000
+#define MUTEX_OWNER_MASK 0x7fffffff
+
+// The offset of a mutex or condition in its segment must be a multiple of this
+#define FUTEX_ALIGN 8
+
+typedef struct {
+    uint32_t magic;
+    uint32_t word;
+} SharedMutexData;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t waiters;
+    uint32_t reserved;
+} SharedConditionData;
+
+typedef struct {
+    PyObject_HEAD
+    SharedMemory *memory;
+    unsigned long offset;
+    int robust;
+    int owner_died;
+} SharedMutex;
+
+typedef struct {
+    PyObject_HEAD
+    SharedMemory *memory;
+    unsigned long offset;
+} SharedCondition;
+
+// SharedCondition.wait() checks its argument against this
+extern PyTypeObject SharedMutexType;
+
+/* SharedMutex methods */
+PyObject *SharedMutex_new(PyTypeObject *, PyObject *, PyObject *);
+int SharedMutex_init(SharedMutex *, PyObject *, PyObject *);
+void SharedMutex_dealloc(SharedMutex *);
+PyObject *SharedMutex_acquire(SharedMutex *, PyObject *, PyObject *);
+PyObject *SharedMutex_release(SharedMutex *);
+PyObject *SharedMutex_enter(SharedMutex *);
+PyObject *SharedMutex_exit(SharedMutex *, PyObject *);
+
+/* SharedMutex attributes (read-only) */
+PyObject *mutex_get_memory(SharedMutex *);
+PyObject *mutex_get_offset(SharedMutex *);
+PyObject *mutex_get_robust(SharedMutex *);
+PyObject *mutex_get_locked(SharedMutex *);
+PyObject *mutex_get_owner(SharedMutex *);
+PyObject *mutex_get_owner_died(SharedMutex *);
+
+PyObject *mutex_repr(SharedMutex *);
+
+/* SharedCondition methods */
+PyObject *SharedCondition_new(PyTypeObject *, PyObject *, PyObject *);
+int SharedCondition_init(SharedCondition *, PyObject *, PyObject *);
+void SharedCondition_dealloc(SharedCondition *);
+PyObject *SharedCondition_wait(SharedCondition *, PyObject *, PyObject *);
+PyObject *SharedCondition_notify(SharedCondition *, PyObject *, PyObject *);
+PyObject *SharedCondition_notify_all(SharedCondition *);
+
+/* SharedCondition attributes (read-only) */
+PyObject *condition_get_memory(SharedCondition *);
+PyObject *condition_get_offset(SharedCondition *);
+PyObject *condition_get_n_waiting(SharedCondition *);
+
+PyObject *condition_repr(SharedCondition *);
+
+/* SharedMemory methods that sleep on and wake a word in the segment */
+PyObject *SharedMemory_wait(SharedMemory *, PyObject *, PyObject *);
+PyObject *SharedMemory_wake(SharedMemory *, PyObject *, PyObject *);
@@ -0,0 +1,856 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "stats.h"
+#include "memory.h"
+#include "arena.h"
+#include "hashmap.h"
+
+#include <sched.h>
+
+// A reader that finds a bucket mid-write retries this many times before
+// yielding the CPU, and gives up with BusyError after this many yields.
+// A writer only holds a bucket for a few stores, so a bucket that stays
+// busy that long most likely belonged to a process that died mid-write.
+#define READ_TRIES 100
+#define READ_YIELDS_MAX 100000
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+
+/******************    Internal use only     **********************/
+
+static uint64_t
+align_up(uint64_t value, uint64_t alignment) {
+    // alignment must be a power of 2
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+
+static uint64_t
+fnv1a(const unsigned char *data, Py_ssize_t length) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    Py_ssize_t i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+
+static uint64_t
+buckets_offset(void) {
+    // The buckets start on the first cache line after the header.
+    return align_up(sizeof(HashMapHeader), 64);
+}
+
+
+static uint64_t
+bucket_size_for(uint64_t key_size, uint64_t value_size) {
+    return align_up(sizeof(HashMapBucket) + key_size + value_size, 8);
+}
+
+
+static int
+round_capacity(unsigned long capacity, uint64_t *p_table_size) {
+    // Rounds the capacity up to a power of 2 so that probing can mask
+    // rather than divide. Returns 0, or -1 with a ValueError set if the
+    // capacity is too large.
+    uint64_t table_size = 1;
+
+    if (capacity > (1UL << (sizeof(unsigned long) * 8 - 2))) {
+        PyErr_SetString(PyExc_ValueError, "The capacity is too large");
+        return -1;
+    }
+
+    while (table_size < capacity)
+        table_size <<= 1;
+
+    *p_table_size = table_size;
+
+    return 0;
+}
+
+
+static HashMapBucket *
+bucket_at(HashMapHeader *header, uint64_t index) {
+    return (HashMapBucket *)((char *)header + buckets_offset() +
+                             (index * header->bucket_size));
+}
+
+
+static char *
+bucket_key(HashMapBucket *bucket) {
+    return (char *)bucket + sizeof(HashMapBucket);
+}
+
+
+static char *
+bucket_value(HashMapHeader *header, HashMapBucket *bucket) {
+    return (char *)bucket + sizeof(HashMapBucket) + header->key_size;
+}
+
+
+static uint32_t *
+stripe_lock(HashMapHeader *header, uint64_t hash) {
+    // The low bits of the hash choose the bucket, so the high bits choose
+    // the lock. Otherwise neighboring buckets would always share a lock.
+    return &header->locks[(hash >> 32) % HASHMAP_LOCK_STRIPES];
+}
+
+
+static HashMapHeader *
+hashmap_header(SharedHashMap *self, int writing) {
+    // Returns the table's header, or NULL with a Python error set if the
+    // segment isn't attached (or is attached read-only and the caller
+    // wants to write).
+    if (!self->memory) {
+        PyErr_SetString(pInternalException, "The hash map was not initialized");
+        return NULL;
+    }
+
+    if (!self->memory->address) {
+        PyErr_SetString(pNotAttachedException, "The hash map's memory segment is not attached");
+        return NULL;
+    }
+
+    if (writing && self->memory->read_only) {
+        PyErr_SetString(PyExc_OSError, "Write attempt on read-only memory segment");
+        return NULL;
+    }
+
+    return (HashMapHeader *)((char *)self->memory->address + self->offset);
+}
+
+
+static int
+get_sized_buffer(PyObject *py_object, Py_buffer *buffer, uint32_t size, const char *what) {
+    // Gets a buffer for a key or value and checks that its size is right.
+    // Returns 0 on success, -1 with a Python error set otherwise.
+    if (-1 == PyObject_GetBuffer(py_object, buffer, PyBUF_SIMPLE))
+        return -1;
+
+    if (buffer->len != (Py_ssize_t)size) {
+        PyErr_Format(PyExc_ValueError, "The %s must be exactly %u bytes long",
+                     what, (unsigned int)size);
+        PyBuffer_Release(buffer);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+snapshot_bucket(HashMapHeader *header, HashMapBucket *bucket, HashMapBucket *snapshot) {
+    // Copies a consistent snapshot of the bucket. Returns 0 on success or -1
+    // with BusyError set if the bucket stays mid-write for too long.
+    uint32_t before;
+    int tries = 0;
+    long yields = 0;
+
+    for (;;) {
+        before = __atomic_load_n(&bucket->version, __ATOMIC_ACQUIRE);
+
+        if (!(before & 1)) {
+            memcpy(snapshot, bucket, header->bucket_size);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (before == __atomic_load_n(&bucket->version, __ATOMIC_RELAXED))
+                return 0;
+        }
+
+        if (++tries < READ_TRIES)
+            continue;
+
+        tries = 0;
+        sched_yield();
+
+        if (++yields == READ_YIELDS_MAX) {
+            PyErr_SetString(pBusyException, "A hash map bucket has been busy for too long");
+            return -1;
+        }
+    }
+}
+
+
+static int
+lookup(HashMapHeader *header, Py_buffer *key, HashMapBucket *snapshot) {
+    // Looks for the key without taking any locks. Returns 1 and leaves the
+    // entry in snapshot if the key is found, 0 if it isn't, and -1 with a
+    // Python error set on failure.
+    uint64_t hash = fnv1a(key->buf, key->len);
+    uint64_t mask = header->capacity - 1;
+    uint64_t i;
+
+    for (i = 0; i < header->capacity; i++) {
+        if (-1 == snapshot_bucket(header, bucket_at(header, (hash + i) & mask), snapshot))
+            return -1;
+
+        if (HASHMAP_EMPTY == snapshot->state)
+            return 0;
+
+        if ((HASHMAP_FULL == snapshot->state) && (hash == snapshot->hash) &&
+            !memcmp(bucket_key(snapshot), key->buf, key->len))
+            return 1;
+    }
+
+    return 0;
+}
+
+
+static int
+claim_bucket(HashMapBucket *bucket, uint32_t expected_state) {
+    // Claims an empty or tombstoned bucket. Returns non-zero if this writer
+    // now owns the bucket.
+    return __atomic_compare_exchange_n(&bucket->state, &expected_state, HASHMAP_BUSY, 0,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+
+static void
+begin_write(HashMapBucket *bucket) {
+    __atomic_fetch_add(&bucket->version, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+
+static void
+end_write(HashMapBucket *bucket, uint32_t new_state) {
+    // The version has to be even before the state changes. Once the state is
+    // EMPTY or TOMBSTONE, another writer may claim the bucket and start its
+    // own write.
+    __atomic_fetch_add(&bucket->version, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&bucket->state, new_state, __ATOMIC_RELEASE);
+}
+
+
+static void
+find_for_write(HashMapHeader *header, Py_buffer *key, uint64_t hash,
+               HashMapBucket **p_found, HashMapBucket **p_free, uint32_t *p_free_state) {
+    /* Scans the key's probe chain on behalf of a writer that holds the key's
+       stripe lock. On return, *p_found is the bucket that holds the key or
+       NULL if the key isn't in the table. If the key isn't in the table,
+       *p_free is the first empty or tombstoned bucket in the chain or NULL
+       if the table is full. That bucket isn't claimed yet.
+
+       Only writers that hold this key's stripe lock ever write this key, so
+       once the key is found its bucket stays put until the lock is released.
+       Writers of other keys only claim empty and tombstoned buckets. A bucket
+       that's mid-write belongs to one of those writers, so it can't hold this
+       key and it doesn't end the chain.
+    */
+    uint64_t mask = header->capacity - 1;
+    uint64_t i;
+    uint32_t version;
+    uint32_t state;
+    HashMapBucket *bucket;
+
+    *p_found = NULL;
+    *p_free = NULL;
+
+    for (i = 0; i < header->capacity; i++) {
+        bucket = bucket_at(header, (hash + i) & mask);
+        version = __atomic_load_n(&bucket->version, __ATOMIC_ACQUIRE);
+
+        if (version & 1)
+            continue;
+
+        state = __atomic_load_n(&bucket->state, __ATOMIC_ACQUIRE);
+
+        if ((HASHMAP_EMPTY == state) || (HASHMAP_TOMBSTONE == state)) {
+            if (!*p_free) {
+                *p_free = bucket;
+                *p_free_state = state;
+            }
+            if (HASHMAP_EMPTY == state)
+                return;
+        }
+        else if ((HASHMAP_FULL == state) && (hash == bucket->hash) &&
+                 !memcmp(bucket_key(bucket), key->buf, key->len)) {
+            // Make sure the comparison didn't see a half-written key.
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (version == __atomic_load_n(&bucket->version, __ATOMIC_RELAXED)) {
+                *p_found = bucket;
+                return;
+            }
+        }
+    }
+}
+
+
+static int
+put_entry(HashMapHeader *header, Py_buffer *key, Py_buffer *value) {
+    // Returns 0 on success, -1 with a Python error set otherwise.
+    uint64_t hash = fnv1a(key->buf, key->len);
+    uint32_t *lock = stripe_lock(header, hash);
+    HashMapBucket *found;
+    HashMapBucket *free_bucket;
+    uint32_t free_state = HASHMAP_EMPTY;
+
+    shm_spin_lock(lock);
+
+    for (;;) {
+        find_for_write(header, key, hash, &found, &free_bucket, &free_state);
+
+        if (found) {
+            begin_write(found);
+            memcpy(bucket_value(header, found), value->buf, value->len);
+            end_write(found, HASHMAP_FULL);
+            break;
+        }
+
+        if (!free_bucket) {
+            shm_spin_unlock(lock);
+            PyErr_SetString(PyExc_MemoryError, "The hash map is full");
+            return -1;
+        }
+
+        if (!claim_bucket(free_bucket, free_state))
+            // A writer of another stripe took it first.
+            continue;
+
+        begin_write(free_bucket);
+        free_bucket->hash = hash;
+        memcpy(bucket_key(free_bucket), key->buf, key->len);
+        memcpy(bucket_value(header, free_bucket), value->buf, value->len);
+        end_write(free_bucket, HASHMAP_FULL);
+
+        __atomic_fetch_add(&header->count, 1, __ATOMIC_RELAXED);
+        if (HASHMAP_TOMBSTONE == free_state)
+            __atomic_fetch_sub(&header->tombstones, 1, __ATOMIC_RELAXED);
+        break;
+    }
+
+    shm_spin_unlock(lock);
+
+    return 0;
+}
+
+
+static int
+delete_entry(HashMapHeader *header, Py_buffer *key) {
+    // Returns 1 if the key was deleted, 0 if it wasn't in the table.
+    uint64_t hash = fnv1a(key->buf, key->len);
+    uint32_t *lock = stripe_lock(header, hash);
+    HashMapBucket *found;
+    HashMapBucket *free_bucket;
+    uint32_t free_state;
+
+    shm_spin_lock(lock);
+
+    find_for_write(header, key, hash, &found, &free_bucket, &free_state);
+
+    if (found) {
+        // The tombstone count goes up first so that it never undercounts
+        // when another writer reuses the tombstone right away.
+        __atomic_fetch_add(&header->tombstones, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_sub(&header->count, 1, __ATOMIC_RELAXED);
+        begin_write(found);
+        end_write(found, HASHMAP_TOMBSTONE);
+    }
+
+    shm_spin_unlock(lock);
+
+    return found ? 1 : 0;
+}
+
+
+static PyObject *
+get_value(SharedHashMap *self, PyObject *py_key, PyObject *py_default) {
+    // Returns a new reference to the value for py_key, or to py_default if
+    // the key isn't in the table. If py_default is NULL, a missing key
+    // raises KeyError.
+    HashMapHeader *header;
+    HashMapBucket *snapshot = NULL;
+    PyObject *py_value = NULL;
+    Py_buffer key;
+    int found;
+
+    if (!(header = hashmap_header(self, 0)))
+        return NULL;
+
+    if (-1 == get_sized_buffer(py_key, &key, header->key_size, "key"))
+        return NULL;
+
+    if (!(snapshot = PyMem_Malloc(header->bucket_size))) {
+        PyErr_SetString(PyExc_MemoryError, "Out of memory");
+        goto error_return;
+    }
+
+    if (-1 == (found = lookup(header, &key, snapshot)))
+        goto error_return;
+
+    if (found)
+        py_value = PyBytes_FromStringAndSize(bucket_value(header, snapshot), header->value_size);
+    else if (py_default) {
+        Py_INCREF(py_default);
+        py_value = py_default;
+    }
+    else
+        PyErr_SetObject(PyExc_KeyError, py_key);
+
+    PyMem_Free(snapshot);
+    PyBuffer_Release(&key);
+
+    return py_value;
+
+    error_return:
+    PyMem_Free(snapshot);
+    PyBuffer_Release(&key);
+    return NULL;
+}
+
+
+static int
+set_value(SharedHashMap *self, PyObject *py_key, PyObject *py_value) {
+    HashMapHeader *header;
+    Py_buffer key;
+    Py_buffer value;
+    int rc;
+
+    if (!(header = hashmap_header(self, 1)))
+        return -1;
+
+    if (-1 == get_sized_buffer(py_key, &key, header->key_size, "key"))
+        return -1;
+
+    if (-1 == get_sized_buffer(py_value, &value, header->value_size, "value")) {
+        PyBuffer_Release(&key);
+        return -1;
+    }
+
+    rc = put_entry(header, &key, &value);
+
+    PyBuffer_Release(&value);
+    PyBuffer_Release(&key);
+
+    return rc;
+}
+
+
+static int
+delete_value(SharedHashMap *self, PyObject *py_key) {
+    // Returns 0 on success, -1 with a Python error (KeyError if the key
+    // isn't in the table) set otherwise.
+    HashMapHeader *header;
+    Py_buffer key;
+    int deleted;
+
+    if (!(header = hashmap_header(self, 1)))
+        return -1;
+
+    if (-1 == get_sized_buffer(py_key, &key, header->key_size, "key"))
+        return -1;
+
+    deleted = delete_entry(header, &key);
+
+    PyBuffer_Release(&key);
+
+    if (!deleted) {
+        PyErr_SetObject(PyExc_KeyError, py_key);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/************ SharedHashMap methods ************/
+
+PyObject *
+SharedHashMap_new(PyTypeObject *type, PyObject *args, PyObject *kwlist) {
+    SharedHashMap *self;
+
+    self = (SharedHashMap *)type->tp_alloc(type, 0);
+
+    if (NULL != self) {
+        self->memory = NULL;
+        self->offset = 0;
+    }
+
+    return (PyObject *)self;
+}
+
+
+int
+SharedHashMap_init(SharedHashMap *self, PyObject *args, PyObject *keywords) {
+    SharedMemory *memory = NULL;
+    unsigned long offset = 0;
+    unsigned long capacity = 0;
+    unsigned long key_size = 0;
+    unsigned long value_size = 0;
+    unsigned long segment_size;
+    uint64_t table_size;
+    int init = 0;
+    PyObject *py_size;
+    HashMapHeader *header;
+    char *keyword_list[ ] = {"memory", "offset", "capacity", "key_size", "value_size",
+                             "init", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O!|kkkkp", keyword_list,
+                                     &SharedMemoryType, &memory,
+                                     &offset, &capacity, &key_size, &value_size, &init))
+        goto error_return;
+
+    if (!memory->address) {
+        PyErr_SetString(pNotAttachedException, "The memory segment is not attached");
+        goto error_return;
+    }
+
+    if (offset % 8) {
+        PyErr_SetString(PyExc_ValueError, "The offset must be a multiple of 8");
+        goto error_return;
+    }
+
+    if ( (py_size = shm_get_size(memory)) ) {
+        segment_size = PyLong_AsUnsignedLongMask(py_size);
+        Py_DECREF(py_size);
+    }
+    else
+        goto error_return;
+
+    if ((offset >= segment_size) || (segment_size - offset < sizeof(HashMapHeader))) {
+        PyErr_SetString(PyExc_ValueError, "The offset leaves no room for the hash map");
+        goto error_return;
+    }
+
+    header = (HashMapHeader *)((char *)memory->address + offset);
+
+    if (init) {
+        if (memory->read_only) {
+            PyErr_SetString(PyExc_OSError, "Can't create a hash map in a read-only memory segment");
+            goto error_return;
+        }
+
+        if ((!capacity) || (!key_size) || (key_size > UINT32_MAX) || (value_size > UINT32_MAX)) {
+            PyErr_SetString(PyExc_ValueError,
+                            "A new hash map needs a capacity and key_size greater than 0");
+            goto error_return;
+        }
+
+        if (-1 == round_capacity(capacity, &table_size))
+            goto error_return;
+
+        if (table_size > (segment_size - offset - buckets_offset()) /
+                                        bucket_size_for(key_size, value_size)) {
+            PyErr_SetString(PyExc_ValueError, "The hash map doesn't fit in the segment");
+            goto error_return;
+        }
+
+        memset(header, 0, buckets_offset() + table_size * bucket_size_for(key_size, value_size));
+        header->version = HASHMAP_VERSION;
+        header->key_size = (uint32_t)key_size;
+        header->value_size = (uint32_t)value_size;
+        header->capacity = table_size;
+        header->bucket_size = bucket_size_for(key_size, value_size);
+        // The magic goes in last so that no other process uses the table
+        // until its header is complete.
+        __atomic_store_n(&header->magic, HASHMAP_MAGIC, __ATOMIC_RELEASE);
+    }
+    else {
+        if (HASHMAP_MAGIC != __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE)) {
+            PyErr_Format(PyExc_ValueError, "There's no hash map at offset %lu", offset);
+            goto error_return;
+        }
+
+        if (HASHMAP_VERSION != header->version) {
+            PyErr_Format(PyExc_ValueError, "Unsupported hash map version %u",
+                         (unsigned int)header->version);
+            goto error_return;
+        }
+
+        if ((header->bucket_size != bucket_size_for(header->key_size, header->value_size)) ||
+            (!header->capacity) || (header->capacity & (header->capacity - 1)) ||
+            (header->capacity > (segment_size - offset - buckets_offset()) / header->bucket_size)) {
+            PyErr_SetString(PyExc_ValueError, "The hash map's size doesn't match the segment");
+            goto error_return;
+        }
+
+        if ((capacity && (capacity > header->capacity)) ||
+            (key_size && (key_size != header->key_size)) ||
+            (value_size && (value_size != header->value_size))) {
+            PyErr_SetString(PyExc_ValueError,
+                            "The capacity, key_size or value_size doesn't match the existing hash map");
+            goto error_return;
+        }
+    }
+
+    Py_INCREF(memory);
+    Py_XSETREF(self->memory, memory);
+    self->offset = offset;
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+
+void
+SharedHashMap_dealloc(SharedHashMap *self) {
+    Py_XDECREF(self->memory);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+SharedHashMap_get(SharedHashMap *self, PyObject *args, PyObject *keywords) {
+    PyObject *py_key;
+    PyObject *py_default = Py_None;
+    char *keyword_list[ ] = {"key", "default", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O|O", keyword_list,
+                                     &py_key, &py_default))
+        return NULL;
+
+    return get_value(self, py_key, py_default);
+}
+
+
+PyObject *
+SharedHashMap_put(SharedHashMap *self, PyObject *args, PyObject *keywords) {
+    PyObject *py_key;
+    PyObject *py_value;
+    char *keyword_list[ ] = {"key", "value", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "OO", keyword_list,
+                                     &py_key, &py_value))
+        return NULL;
+
+    if (-1 == set_value(self, py_key, py_value))
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+SharedHashMap_delete(SharedHashMap *self, PyObject *py_key) {
+    if (-1 == delete_value(self, py_key))
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+SharedHashMap_items(SharedHashMap *self) {
+    /* Returns a list of (key, value) tuples. Each entry is read consistently
+       but the table as a whole isn't locked, so entries written while this
+       runs may or may not be included.
+    */
+    HashMapHeader *header;
+    HashMapBucket *snapshot = NULL;
+    PyObject *py_items = NULL;
+    PyObject *py_item;
+    uint64_t i;
+
+    if (!(header = hashmap_header(self, 0)))
+        goto error_return;
+
+    if (!(snapshot = PyMem_Malloc(header->bucket_size))) {
+        PyErr_SetString(PyExc_MemoryError, "Out of memory");
+        goto error_return;
+    }
+
+    if (!(py_items = PyList_New(0)))
+        goto error_return;
+
+    for (i = 0; i < header->capacity; i++) {
+        if (-1 == snapshot_bucket(header, bucket_at(header, i), snapshot))
+            goto error_return;
+
+        if (HASHMAP_FULL != snapshot->state)
+            continue;
+
+        py_item = Py_BuildValue("(y#y#)",
+                                bucket_key(snapshot), (Py_ssize_t)header->key_size,
+                                bucket_value(header, snapshot), (Py_ssize_t)header->value_size);
+
+        if (!py_item)
+            goto error_return;
+
+        if (-1 == PyList_Append(py_items, py_item)) {
+            Py_DECREF(py_item);
+            goto error_return;
+        }
+
+        Py_DECREF(py_item);
+    }
+
+    PyMem_Free(snapshot);
+
+    return py_items;
+
+    error_return:
+    PyMem_Free(snapshot);
+    Py_XDECREF(py_items);
+    return NULL;
+}
+
+
+PyObject *
+SharedHashMap_required_size(PyObject *unused, PyObject *args, PyObject *keywords) {
+    // Returns the number of bytes a new table with these parameters needs.
+    unsigned long capacity;
+    unsigned long key_size;
+    unsigned long value_size;
+    uint64_t table_size;
+    uint64_t bucket_size;
+    char *keyword_list[ ] = {"capacity", "key_size", "value_size", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "kkk", keyword_list,
+                                     &capacity, &key_size, &value_size))
+        return NULL;
+
+    if ((key_size > UINT32_MAX) || (value_size > UINT32_MAX)) {
+        PyErr_SetString(PyExc_ValueError, "The key_size and value_size must fit in 32 bits");
+        return NULL;
+    }
+
+    if (-1 == round_capacity(capacity, &table_size))
+        return NULL;
+
+    bucket_size = bucket_size_for(key_size, value_size);
+
+    if (table_size > (UINT64_MAX - buckets_offset()) / bucket_size) {
+        PyErr_SetString(PyExc_ValueError, "The hash map is too large");
+        return NULL;
+    }
+
+    return PyLong_FromUnsignedLongLong(buckets_offset() + table_size * bucket_size);
+}
+
+
+/************ Mapping and sequence protocol ************/
+
+Py_ssize_t
+hashmap_length(SharedHashMap *self) {
+    HashMapHeader *header;
+
+    if (!(header = hashmap_header(self, 0)))
+        return -1;
+
+    return (Py_ssize_t)__atomic_load_n(&header->count, __ATOMIC_RELAXED);
+}
+
+
+PyObject *
+hashmap_subscript(SharedHashMap *self, PyObject *py_key) {
+    return get_value(self, py_key, NULL);
+}
+
+
+int
+hashmap_ass_subscript(SharedHashMap *self, PyObject *py_key, PyObject *py_value) {
+    if (py_value)
+        return set_value(self, py_key, py_value);
+    else
+        return delete_value(self, py_key);
+}
+
+
+int
+hashmap_contains(SharedHashMap *self, PyObject *py_key) {
+    HashMapHeader *header;
+    HashMapBucket *snapshot;
+    Py_buffer key;
+    int found;
+
+    if (!(header = hashmap_header(self, 0)))
+        return -1;
+
+    if (-1 == get_sized_buffer(py_key, &key, header->key_size, "key"))
+        return -1;
+
+    if ((snapshot = PyMem_Malloc(header->bucket_size)))
+        found = lookup(header, &key, snapshot);
+    else {
+        PyErr_SetString(PyExc_MemoryError, "Out of memory");
+        found = -1;
+    }
+
+    PyMem_Free(snapshot);
+    PyBuffer_Release(&key);
+
+    return found;
+}
+
+
+/************ Attributes ************/
+
+PyObject *
+hashmap_repr(SharedHashMap *self) {
+    if (self->memory)
+        return PyUnicode_FromFormat("sysv_ipc.SharedHashMap(%R, offset=%lu)",
+                                    (PyObject *)self->memory, self->offset);
+    else
+        return PyUnicode_FromString("sysv_ipc.SharedHashMap()");
+}
+
+
+PyObject *
+hashmap_get_memory(SharedHashMap *self) {
+    if (self->memory) {
+        Py_INCREF(self->memory);
+        return (PyObject *)self->memory;
+    }
+    else
+        Py_RETURN_NONE;
+}
+
+
+PyObject *
+hashmap_get_offset(SharedHashMap *self) {
+    return PyLong_FromUnsignedLong(self->offset);
+}
+
+
+PyObject *
+hashmap_get_capacity(SharedHashMap *self) {
+    HashMapHeader *header;
+
+    if (!(header = hashmap_header(self, 0)))
+        return NULL;
+
+    return PyLong_FromUnsignedLongLong(header->capacity);
+}
+
+
+PyObject *
+hashmap_get_key_size(SharedHashMap *self) {
+    HashMapHeader *header;
+
+    if (!(header = hashmap_header(self, 0)))
+        return NULL;
+
+    return PyLong_FromUnsignedLong(header->key_size);
+}
+
+
+PyObject *
+hashmap_get_value_size(SharedHashMap *self) {
+    HashMapHeader *header;
+
+    if (!(header = hashmap_header(self, 0)))
+        return NULL;
+
+    return PyLong_FromUnsignedLong(header->value_size);
+}
+
+
+PyObject *
+hashmap_get_tombstones(SharedHashMap *self) {
+    HashMapHeader *header;
+
+    if (!(header = hashmap_header(self, 0)))
+        return NULL;
+
+    return PyLong_FromUnsignedLongLong(__atomic_load_n(&header->tombstones, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,83 @@
+#include <stdint.h>
+
+/* SharedHashMap is a fixed-capacity hash table that lives inside a
+SharedMemory segment. Keys and values are byte strings of a fixed size that's
+chosen when the table is created.
+
+The table uses open addressing with linear probing. Each bucket has a version
+stamp that works as a seqlock: a writer makes it odd before it changes the
+bucket and even again afterwards. Readers don't lock anything. They copy the
+bucket and retry if the version was odd or changed during the copy.
+
+Writers serialize on one of HASHMAP_LOCK_STRIPES spinlocks chosen by the
+key's hash, so writers of different keys rarely wait on each other. Because
+keys from different stripes can probe into the same bucket, a writer also
+claims a bucket by changing its state to HASHMAP_BUSY with a compare and
+swap before touching it.
+
+Deleted entries leave tombstones behind so that probe chains stay intact.
+put() reuses tombstones, but a table that sees many deletes and few inserts
+will have longer lookups than its count suggests.
+*/
+
+#define HASHMAP_MAGIC 0x50414d48     // "HMAP" in little-endian ASCII
+#define HASHMAP_VERSION 1
+
+#define HASHMAP_LOCK_STRIPES 64
+
+#define HASHMAP_EMPTY 0
+#define HASHMAP_BUSY 1
+#define HASHMAP_FULL 2
+#define HASHMAP_TOMBSTONE 3
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t key_size;
+    uint32_t value_size;
+    uint64_t capacity;
+    uint64_t bucket_size;
+    uint64_t count;
+    uint64_t tombstones;
+    uint32_t locks[HASHMAP_LOCK_STRIPES];
+} HashMapHeader;
+
+/* Each bucket is this header followed by the key and then the value, padded
+to a multiple of 8 bytes. The buckets follow the table header. */
+typedef struct {
+    uint32_t version;
+    uint32_t state;
+    uint64_t hash;
+} HashMapBucket;
+
+typedef struct {
+    PyObject_HEAD
+    SharedMemory *memory;
+    unsigned long offset;
+} SharedHashMap;
+
+/* Object methods */
+PyObject *SharedHashMap_new(PyTypeObject *, PyObject *, PyObject *);
+int SharedHashMap_init(SharedHashMap *, PyObject *, PyObject *);
+void SharedHashMap_dealloc(SharedHashMap *);
+PyObject *SharedHashMap_get(SharedHashMap *, PyObject *, PyObject *);
+PyObject *SharedHashMap_put(SharedHashMap *, PyObject *, PyObject *);
+PyObject *SharedHashMap_delete(SharedHashMap *, PyObject *);
+PyObject *SharedHashMap_items(SharedHashMap *);
+PyObject *SharedHashMap_required_size(PyObject *, PyObject *, PyObject *);
+
+/* Mapping and sequence protocol */
+Py_ssize_t hashmap_length(SharedHashMap *);
+PyObject *hashmap_subscript(SharedHashMap *, PyObject *);
+int hashmap_ass_subscript(SharedHashMap *, PyObject *, PyObject *);
+int hashmap_contains(SharedHashMap *, PyObject *);
+
+/* Object attributes (read-only) */
+PyObject *hashmap_get_memory(SharedHashMap *);
+PyObject *hashmap_get_offset(SharedHashMap *);
+PyObject *hashmap_get_capacity(SharedHashMap *);
+PyObject *hashmap_get_key_size(SharedHashMap *);
+PyObject *hashmap_get_value_size(SharedHashMap *);
+PyObject *hashmap_get_tombstones(SharedHashMap *);
+
+PyObject *hashmap_repr(SharedHashMap *);
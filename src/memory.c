@@ -3,8 +3,16 @@
 #include "structmember.h"
 
 #include "common.h"
+#include "stats.h"
 #include "memory.h"
 
+#ifdef MBIND_EXISTS
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+#define NODEMASK_LONGS (SHM_NUMA_MAX_NODES / (8 * sizeof(unsigned long)))
+
 
 /******************    Internal use only     **********************/
 PyObject *
@@ -19,6 +27,8 @@ shm_repr(SharedMemory *self) {
 
 PyObject *
 shm_attach(SharedMemory *self, void *address, int shmat_flags) {
+    struct shmid_ds shm_info;
+
     DPRINTF("attaching memory @ address %p with id %d using flags 0x%x\n",
              address, self->id, shmat_flags);
 
@@ -50,6 +60,13 @@ shm_attach(SharedMemory *self, void *address, int shmat_flags) {
         // memory was attached successfully
         self->read_only = (shmat_flags & SHM_RDONLY) ? 1 : 0;
         DPRINTF("set memory's internal read_only flag to %d\n", self->read_only);
+
+        // The atomic operations check their offsets against this rather than
+        // calling IPC_STAT every time. A segment's size never changes.
+        if (-1 == shmctl(self->id, IPC_STAT, &shm_info))
+            self->attached_size = 0;
+        else
+            self->attached_size = shm_info.shm_segsz;
     }
 
     Py_RETURN_NONE;
@@ -290,6 +307,7 @@ shm_get_buffer(SharedMemory *self, Py_buffer *view, int flags)
 
 void
 SharedMemory_dealloc(SharedMemory *self) {
+    stats_free(&self->stats, &self->stats_segment);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
@@ -304,12 +322,77 @@ SharedMemory_new(PyTypeObject *type, PyObject *args, PyObject *kwlist) {
         self->id = 0;
         self->read_only = 0;
         self->address = NULL;
+        self->attached_size = 0;
+        self->copies_in_progress = 0;
+        self->gil_release_threshold = SHM_GIL_RELEASE_THRESHOLD;
+        self->stats = NULL;
+        self->stats_segment = NULL;
     }
 
     return (PyObject *)self;
 }
 
 
+static int
+set_numa_policy(SharedMemory *self, size_t size, PyObject *py_node, int interleave) {
+    /* Binds the attached segment to one NUMA node or interleaves it across
+       all of the nodes this process may use. The policy belongs to the
+       segment, not the mapping, so it applies to pages that any process
+       touches from now on. Returns 0 or -1 with a Python error set.
+    */
+#ifdef MBIND_EXISTS
+    unsigned long nodemask[NODEMASK_LONGS];
+    long node;
+    int mode;
+
+    memset(nodemask, 0, sizeof(nodemask));
+
+    if (interleave) {
+        mode = MPOL_INTERLEAVE;
+        if (-1 == syscall(SYS_get_mempolicy, NULL, nodemask, SHM_NUMA_MAX_NODES,
+                          NULL, MPOL_F_MEMS_ALLOWED)) {
+            PyErr_SetFromErrno(PyExc_OSError);
+            goto error_return;
+        }
+    }
+    else {
+        mode = MPOL_BIND;
+        node = PyLong_AsLong(py_node);
+        if ((-1 == node) && PyErr_Occurred())
+            goto error_return;
+        if ((node < 0) || (node >= SHM_NUMA_MAX_NODES)) {
+            PyErr_Format(PyExc_ValueError, "The numa_node must be between 0 and %d",
+                         SHM_NUMA_MAX_NODES - 1);
+            goto error_return;
+        }
+        nodemask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    }
+
+    DPRINTF("Calling mbind(), address=%p, size=%zu, mode=%d\n", self->address, size, mode);
+
+    // mbind() reads one bit fewer than maxnode.
+    if (-1 == syscall(SYS_mbind, self->address, size, mode, nodemask,
+                      SHM_NUMA_MAX_NODES + 1, 0)) {
+        if (EINVAL == errno)
+            PyErr_SetString(PyExc_ValueError,
+                            "The numa_node doesn't exist or isn't available to this process");
+        else
+            PyErr_SetFromErrno(PyExc_OSError);
+        goto error_return;
+    }
+
+    return 0;
+
+    error_return:
+    return -1;
+#else
+    PyErr_SetString(PyExc_NotImplementedError,
+                    "NUMA placement isn't supported on this platform");
+    return -1;
+#endif
+}
+
+
 int
 SharedMemory_init(SharedMemory *self, PyObject *args, PyObject *keywords) {
     NoneableKey key;
@@ -318,17 +401,30 @@ SharedMemory_init(SharedMemory *self, PyObject *args, PyObject *keywords) {
     int shmget_flags = 0;
     int shmat_flags = 0;
     char init_character = ' ';
-    char *keyword_list[ ] = {"key", "flags", "mode", "size", "init_character", NULL};
+    PyObject *py_numa_node = Py_None;
+    int interleave = 0;
+    char *keyword_list[ ] = {"key", "flags", "mode", "size", "init_character",
+                             "numa_node", "interleave", NULL};
     PyObject *py_size = NULL;
 
     DPRINTF("Inside SharedMemory_init()\n");
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O&|iikc", keyword_list,
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O&|iikcOp", keyword_list,
                                      &convert_key_param, &key,
                                      &shmget_flags, &mode, &size,
-                                     &init_character))
+                                     &init_character, &py_numa_node, &interleave))
         goto error_return;
 
+    if ((py_numa_node != Py_None) && (!PyLong_Check(py_numa_node))) {
+        PyErr_SetString(PyExc_TypeError, "The numa_node must be None or an integer");
+        goto error_return;
+    }
+
+    if ((py_numa_node != Py_None) && interleave) {
+        PyErr_SetString(PyExc_ValueError, "numa_node and interleave can't both be used");
+        goto error_return;
+    }
+
     mode &= 0777;
     shmget_flags &= ~0777;
 
@@ -418,6 +514,25 @@ SharedMemory_init(SharedMemory *self, PyObject *args, PyObject *keywords) {
         goto error_return;
     }
 
+    if ((py_numa_node != Py_None) || interleave) {
+        // The policy has to be in place before the memset() below touches
+        // the pages for the first time.
+        if (!(py_size = shm_get_value(self->id, SVIFP_SHM_SIZE)))
+            goto error_return;
+        size = PyLong_AsUnsignedLongMask(py_size);
+        Py_CLEAR(py_size);
+
+        if (-1 == set_numa_policy(self, size, py_numa_node, interleave)) {
+            // Don't leave behind a segment that was created for nothing.
+            if ((shmget_flags & IPC_CREX) == IPC_CREX) {
+                shmdt(self->address);
+                self->address = NULL;
+                shmctl(self->id, IPC_RMID, NULL);
+            }
+            goto error_return;
+        }
+    }
+
     if ( ((shmget_flags & IPC_CREX) == IPC_CREX) && (!(shmat_flags & SHM_RDONLY)) ) {
         // Initialize the memory.
 
@@ -476,6 +591,15 @@ SharedMemory_attach(SharedMemory *self, PyObject *args, PyObject *keywords) {
 
 PyObject *
 SharedMemory_detach(SharedMemory *self) {
+    if (self->copies_in_progress) {
+        // Another thread is using the segment with the GIL released (e.g.
+        // copying or waiting on a SharedMutex in it). Pulling the memory out
+        // from under it would crash.
+        PyErr_SetString(pBusyException,
+                        "The segment can't be detached while another thread is using it");
+        goto error_return;
+    }
+
     if (-1 == shmdt(self->address)) {
         self->address = NULL;
         switch (errno) {
@@ -499,6 +623,23 @@ SharedMemory_detach(SharedMemory *self) {
 }
 
 
+void
+shm_copy(SharedMemory *self, void *destination, const void *source, size_t count) {
+    /* memcpy() with the GIL released if the copy is big enough. The caller
+       must keep both buffers alive (e.g. with a Py_buffer) until this returns.
+    */
+    if (count >= self->gil_release_threshold) {
+        self->copies_in_progress++;
+        Py_BEGIN_ALLOW_THREADS
+        memcpy(destination, source, count);
+        Py_END_ALLOW_THREADS
+        self->copies_in_progress--;
+    }
+    else
+        memcpy(destination, source, count);
+}
+
+
 PyObject *
 SharedMemory_read(SharedMemory *self, PyObject *args, PyObject *keywords) {
     /* Tricky business here. A memory segment's size is a size_t which is
@@ -511,7 +652,9 @@ SharedMemory_read(SharedMemory *self, PyObject *args, PyObject *keywords) {
     long byte_count = 0;
     unsigned long offset = 0;
     unsigned long size;
+    uint64_t start_ns;
     PyObject *py_size;
+    PyObject *py_data;
     char *keyword_list[ ] = {"byte_count", "offset", NULL};
 
     if (!PyArg_ParseTupleAndKeywords(args, keywords, "|lk", keyword_list,
@@ -565,7 +708,19 @@ SharedMemory_read(SharedMemory *self, PyObject *args, PyObject *keywords) {
         }
     }
 
-    return PyBytes_FromStringAndSize(self->address + offset, byte_count);
+    // Allocate first and copy second so that a large copy can be done
+    // without the GIL.
+    if (!(py_data = PyBytes_FromStringAndSize(NULL, byte_count)))
+        goto error_return;
+
+    start_ns = stats_start(self->stats);
+
+    shm_copy(self, PyBytes_AS_STRING(py_data), self->address + offset, byte_count);
+
+    if (start_ns && self->stats)
+        stats_record(self->stats, start_ns, (size_t)byte_count, 0, 0);
+
+    return py_data;
 
     error_return:
     return NULL;
@@ -579,6 +734,7 @@ SharedMemory_write(SharedMemory *self, PyObject *args, PyObject *kw) {
     */
     unsigned long offset = 0;
     unsigned long size;
+    uint64_t start_ns;
     PyObject *py_size;
     char *keyword_list[ ] = {"s", "offset", NULL};
     static char args_format[] = "s*|k";
@@ -617,7 +773,12 @@ SharedMemory_write(SharedMemory *self, PyObject *args, PyObject *kw) {
         goto error_return;
     }
 
-    memcpy((self->address + offset), data.buf, data.len);
+    start_ns = stats_start(self->stats);
+
+    shm_copy(self, self->address + offset, data.buf, data.len);
+
+    if (start_ns && self->stats)
+        stats_record(self->stats, start_ns, (size_t)data.len, 0, 0);
 
     PyBuffer_Release(&data);
 
@@ -628,12 +789,639 @@ SharedMemory_write(SharedMemory *self, PyObject *args, PyObject *kw) {
     return NULL;
 }
 
+PyObject *
+SharedMemory_readv(SharedMemory *self, PyObject *args, PyObject *keywords) {
+    /* Reads several ranges of the segment with one size check. Each range is
+       an (offset, length) tuple and must lie entirely within the segment.
+       Returns a list of bytes objects, one per range.
+    */
+    PyObject *py_ranges = NULL;
+    PyObject *py_fast = NULL;
+    PyObject *py_list = NULL;
+    PyObject *py_size;
+    PyObject *py_range;
+    unsigned long *offsets = NULL;
+    char **destinations = NULL;
+    Py_ssize_t *lengths = NULL;
+    Py_ssize_t count;
+    Py_ssize_t i;
+    unsigned long size;
+    unsigned long total = 0;
+    uint64_t start_ns;
+    char *keyword_list[ ] = {"ranges", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O", keyword_list, &py_ranges))
+        goto error_return;
+
+    if (self->address == NULL) {
+        PyErr_SetString(pNotAttachedException,
+                        "Read attempt on unattached memory segment");
+        goto error_return;
+    }
+
+    if (!(py_fast = PySequence_Fast(py_ranges, "ranges must be a sequence of (offset, length) tuples")))
+        goto error_return;
+
+    count = PySequence_Fast_GET_SIZE(py_fast);
+
+    offsets = PyMem_New(unsigned long, count + 1);
+    lengths = PyMem_New(Py_ssize_t, count + 1);
+    destinations = PyMem_New(char *, count + 1);
+
+    if (!offsets || !lengths || !destinations) {
+        PyErr_SetString(PyExc_MemoryError, "Out of memory");
+        goto error_return;
+    }
+
+    if ( (py_size = shm_get_value(self->id, SVIFP_SHM_SIZE)) ) {
+        size = PyLong_AsUnsignedLongMask(py_size);
+        Py_DECREF(py_size);
+    }
+    else
+        goto error_return;
+
+    for (i = 0; i < count; i++) {
+        py_range = PySequence_Fast_GET_ITEM(py_fast, i);
+
+        if (!PyTuple_Check(py_range)) {
+            PyErr_SetString(PyExc_TypeError, "Each range must be an (offset, length) tuple");
+            goto error_return;
+        }
+
+        if (!PyArg_ParseTuple(py_range, "kn", &offsets[i], &lengths[i]))
+            goto error_return;
+
+        if (lengths[i] < 0) {
+            PyErr_SetString(PyExc_ValueError, "The length cannot be negative");
+            goto error_return;
+        }
+
+        // See write() for why this isn't expressed as offset + length > size
+        if ((offsets[i] > size) || ((unsigned long)lengths[i] > size - offsets[i])) {
+            PyErr_SetString(PyExc_ValueError, "Attempt to read past end of memory segment");
+            goto error_return;
+        }
+
+        total += lengths[i];
+    }
+
+    // Allocate all of the bytes objects up front so that the copies can
+    // happen without the GIL.
+    if (!(py_list = PyList_New(count)))
+        goto error_return;
+
+    for (i = 0; i < count; i++) {
+        PyObject *py_bytes = PyBytes_FromStringAndSize(NULL, lengths[i]);
+
+        if (!py_bytes)
+            goto error_return;
+
+        PyList_SET_ITEM(py_list, i, py_bytes);
+        destinations[i] = PyBytes_AS_STRING(py_bytes);
+    }
+
+    start_ns = stats_start(self->stats);
+
+    if (total >= self->gil_release_threshold) {
+        self->copies_in_progress++;
+        Py_BEGIN_ALLOW_THREADS
+        for (i = 0; i < count; i++)
+            memcpy(destinations[i], self->address + offsets[i], lengths[i]);
+        Py_END_ALLOW_THREADS
+        self->copies_in_progress--;
+    }
+    else {
+        for (i = 0; i < count; i++)
+            memcpy(destinations[i], self->address + offsets[i], lengths[i]);
+    }
+
+    if (start_ns && self->stats)
+        stats_record(self->stats, start_ns, (size_t)total, 0, 0);
+
+    Py_DECREF(py_fast);
+    PyMem_Free(offsets);
+    PyMem_Free(lengths);
+    PyMem_Free(destinations);
+
+    return py_list;
+
+    error_return:
+    Py_XDECREF(py_list);
+    Py_XDECREF(py_fast);
+    PyMem_Free(offsets);
+    PyMem_Free(lengths);
+    PyMem_Free(destinations);
+    return NULL;
+}
+
+
+PyObject *
+SharedMemory_writev(SharedMemory *self, PyObject *args, PyObject *keywords) {
+    /* Writes several buffers to the segment with one size check. Each item
+       is an (offset, bytes) tuple. Nothing is written unless every item
+       fits within the segment.
+    */
+    PyObject *py_chunks = NULL;
+    PyObject *py_fast = NULL;
+    PyObject *py_size;
+    PyObject *py_chunk;
+    unsigned long *offsets = NULL;
+    Py_buffer *buffers = NULL;
+    Py_ssize_t count;
+    Py_ssize_t buffers_filled = 0;
+    Py_ssize_t i;
+    unsigned long size;
+    unsigned long total = 0;
+    uint64_t start_ns;
+    char *keyword_list[ ] = {"chunks", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O", keyword_list, &py_chunks))
+        goto error_return;
+
+    if (self->read_only) {
+        PyErr_SetString(PyExc_OSError, "Write attempt on read-only memory segment");
+        goto error_return;
+    }
+
+    if (self->address == NULL) {
+        PyErr_SetString(pNotAttachedException, "Write attempt on unattached memory segment");
+        goto error_return;
+    }
+
+    if (!(py_fast = PySequence_Fast(py_chunks, "chunks must be a sequence of (offset, bytes) tuples")))
+        goto error_return;
+
+    count = PySequence_Fast_GET_SIZE(py_fast);
+
+    offsets = PyMem_New(unsigned long, count + 1);
+    buffers = PyMem_New(Py_buffer, count + 1);
+
+    if (!offsets || !buffers) {
+        PyErr_SetString(PyExc_MemoryError, "Out of memory");
+        goto error_return;
+    }
+
+    if ( (py_size = shm_get_value(self->id, SVIFP_SHM_SIZE)) ) {
+        size = PyLong_AsUnsignedLongMask(py_size);
+        Py_DECREF(py_size);
+    }
+    else
+        goto error_return;
+
+    for (i = 0; i < count; i++) {
+        py_chunk = PySequence_Fast_GET_ITEM(py_fast, i);
+
+        if (!PyTuple_Check(py_chunk)) {
+            PyErr_SetString(PyExc_TypeError, "Each chunk must be an (offset, bytes) tuple");
+            goto error_return;
+        }
+
+        if (!PyArg_ParseTuple(py_chunk, "ks*", &offsets[i], &buffers[i]))
+            goto error_return;
+
+        buffers_filled++;
+
+        // See write() for why this isn't expressed as offset + len > size
+        if ((offsets[i] > size) || ((unsigned long)buffers[i].len > size - offsets[i])) {
+            PyErr_SetString(PyExc_ValueError, "Attempt to write past end of memory segment");
+            goto error_return;
+        }
+
+        total += buffers[i].len;
+    }
+
+    start_ns = stats_start(self->stats);
+
+    if (total >= self->gil_release_threshold) {
+        // The Py_buffers keep the source objects pinned while the GIL is released.
+        self->copies_in_progress++;
+        Py_BEGIN_ALLOW_THREADS
+        for (i = 0; i < count; i++)
+            memcpy(self->address + offsets[i], buffers[i].buf, buffers[i].len);
+        Py_END_ALLOW_THREADS
+        self->copies_in_progress--;
+    }
+    else {
+        for (i = 0; i < count; i++)
+            memcpy(self->address + offsets[i], buffers[i].buf, buffers[i].len);
+    }
+
+    if (start_ns && self->stats)
+        stats_record(self->stats, start_ns, (size_t)total, 0, 0);
+
+    for (i = 0; i < buffers_filled; i++)
+        PyBuffer_Release(&buffers[i]);
+    Py_DECREF(py_fast);
+    PyMem_Free(offsets);
+    PyMem_Free(buffers);
+
+    Py_RETURN_NONE;
+
+    error_return:
+    for (i = 0; i < buffers_filled; i++)
+        PyBuffer_Release(&buffers[i]);
+    Py_XDECREF(py_fast);
+    PyMem_Free(offsets);
+    PyMem_Free(buffers);
+    return NULL;
+}
+
+
 PyObject *
 SharedMemory_remove(SharedMemory *self) {
     return shm_remove(self->id);
 }
 
 
+PyObject *
+SharedMemory_stats(SharedMemory *self) {
+    return stats_as_dict(self->stats);
+}
+
+
+PyObject *
+SharedMemory_reset_stats(SharedMemory *self) {
+    stats_reset(self->stats);
+    Py_RETURN_NONE;
+}
+
+
+/* The __atomic builtins only honor a memory order that's a compile-time
+constant (anything else is treated as __ATOMIC_SEQ_CST), so each operation
+is spelled out once per order. OP is a macro that takes the order. The
+order has already been checked by get_atomic_target(). */
+#define WITH_MEMORY_ORDER(order, OP)                            \
+    switch (order) {                                            \
+        case __ATOMIC_RELAXED: OP(__ATOMIC_RELAXED); break;     \
+        case __ATOMIC_ACQUIRE: OP(__ATOMIC_ACQUIRE); break;     \
+        case __ATOMIC_RELEASE: OP(__ATOMIC_RELEASE); break;     \
+        case __ATOMIC_ACQ_REL: OP(__ATOMIC_ACQ_REL); break;     \
+        default: OP(__ATOMIC_SEQ_CST); break;                   \
+    }
+
+#define WITH_LOAD_ORDER(order, OP)                              \
+    switch (order) {                                            \
+        case __ATOMIC_RELAXED: OP(__ATOMIC_RELAXED); break;     \
+        case __ATOMIC_ACQUIRE: OP(__ATOMIC_ACQUIRE); break;     \
+        default: OP(__ATOMIC_SEQ_CST); break;                   \
+    }
+
+#define WITH_STORE_ORDER(order, OP)                             \
+    switch (order) {                                            \
+        case __ATOMIC_RELAXED: OP(__ATOMIC_RELAXED); break;     \
+        case __ATOMIC_RELEASE: OP(__ATOMIC_RELEASE); break;     \
+        default: OP(__ATOMIC_SEQ_CST); break;                   \
+    }
+
+enum ATOMIC_KIND {ATOMIC_KIND_LOAD, ATOMIC_KIND_STORE, ATOMIC_KIND_RMW};
+
+
+static void *
+get_atomic_target(SharedMemory *self, unsigned long offset, int size, int order,
+                  enum ATOMIC_KIND kind) {
+    // Returns the address of the integer at offset, or NULL with a Python
+    // error set if it can't be used.
+    if ((4 != size) && (8 != size)) {
+        PyErr_SetString(PyExc_ValueError, "The size must be 4 or 8");
+        return NULL;
+    }
+
+    if (((__ATOMIC_RELAXED != order) && (__ATOMIC_ACQUIRE != order) &&
+         (__ATOMIC_RELEASE != order) && (__ATOMIC_ACQ_REL != order) &&
+         (__ATOMIC_SEQ_CST != order)) ||
+        ((ATOMIC_KIND_LOAD == kind) && ((__ATOMIC_RELEASE == order) || (__ATOMIC_ACQ_REL == order))) ||
+        ((ATOMIC_KIND_STORE == kind) && ((__ATOMIC_ACQUIRE == order) || (__ATOMIC_ACQ_REL == order)))) {
+        PyErr_SetString(PyExc_ValueError, "The memory order isn't valid for this operation");
+        return NULL;
+    }
+
+    if (self->address == NULL) {
+        PyErr_SetString(pNotAttachedException,
+                        "Atomic operation on unattached memory segment");
+        return NULL;
+    }
+
+    if ((ATOMIC_KIND_LOAD != kind) && self->read_only) {
+        PyErr_SetString(PyExc_OSError, "Write attempt on read-only memory segment");
+        return NULL;
+    }
+
+    if (offset % size) {
+        PyErr_Format(PyExc_ValueError, "The offset must be a multiple of %d", size);
+        return NULL;
+    }
+
+    if ((offset > self->attached_size) || (self->attached_size - offset < (size_t)size)) {
+        PyErr_SetString(PyExc_ValueError, "The offset is outside of the segment");
+        return NULL;
+    }
+
+    return (char *)self->address + offset;
+}
+
+
+static int
+check_atomic_value(long long value, int size) {
+    // Returns 0 if the value fits in size bytes, otherwise -1 with a Python
+    // error set.
+    if ((4 == size) && ((value < INT32_MIN) || (value > INT32_MAX))) {
+        PyErr_SetString(PyExc_OverflowError, "The value doesn't fit in 4 bytes");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+PyObject *
+SharedMemory_atomic_load(SharedMemory *self, PyObject *args, PyObject *keywords) {
+    unsigned long offset;
+    int size = 8;
+    int order = __ATOMIC_SEQ_CST;
+    void *target;
+    long long value = 0;
+    char *keyword_list[ ] = {"offset", "size", "order", NULL};
+
+    // atomic_load(offset, [size = 8, [order = ATOMIC_SEQ_CST]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "k|ii", keyword_list,
+                                     &offset, &size, &order))
+        return NULL;
+
+    if (!(target = get_atomic_target(self, offset, size, order, ATOMIC_KIND_LOAD)))
+        return NULL;
+
+#define LOAD32(o) value = __atomic_load_n((int32_t *)target, o)
+#define LOAD64(o) value = __atomic_load_n((int64_t *)target, o)
+    if (4 == size)
+        WITH_LOAD_ORDER(order, LOAD32)
+    else
+        WITH_LOAD_ORDER(order, LOAD64)
+#undef LOAD32
+#undef LOAD64
+
+    return PyLong_FromLongLong(value);
+}
+
+
+PyObject *
+SharedMemory_atomic_store(SharedMemory *self, PyObject *args, PyObject *keywords) {
+    unsigned long offset;
+    long long value;
+    int size = 8;
+    int order = __ATOMIC_SEQ_CST;
+    void *target;
+    char *keyword_list[ ] = {"offset", "value", "size", "order", NULL};
+
+    // atomic_store(offset, value, [size = 8, [order = ATOMIC_SEQ_CST]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "kL|ii", keyword_list,
+                                     &offset, &value, &size, &order))
+        return NULL;
+
+    if (!(target = get_atomic_target(self, offset, size, order, ATOMIC_KIND_STORE)))
+        return NULL;
+
+    if (-1 == check_atomic_value(value, size))
+        return NULL;
+
+#define STORE32(o) __atomic_store_n((int32_t *)target, (int32_t)value, o)
+#define STORE64(o) __atomic_store_n((int64_t *)target, (int64_t)value, o)
+    if (4 == size)
+        WITH_STORE_ORDER(order, STORE32)
+    else
+        WITH_STORE_ORDER(order, STORE64)
+#undef STORE32
+#undef STORE64
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+SharedMemory_fetch_add(SharedMemory *self, PyObject *args, PyObject *keywords) {
+    unsigned long offset;
+    long long value;
+    long long previous = 0;
+    int size = 8;
+    int order = __ATOMIC_SEQ_CST;
+    void *target;
+    char *keyword_list[ ] = {"offset", "value", "size", "order", NULL};
+
+    // fetch_add(offset, value, [size = 8, [order = ATOMIC_SEQ_CST]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "kL|ii", keyword_list,
+                                     &offset, &value, &size, &order))
+        return NULL;
+
+    if (!(target = get_atomic_target(self, offset, size, order, ATOMIC_KIND_RMW)))
+        return NULL;
+
+    if (-1 == check_atomic_value(value, size))
+        return NULL;
+
+    // The builtins wrap around on overflow, as two's complement does.
+#define ADD32(o) previous = __atomic_fetch_add((int32_t *)target, (int32_t)value, o)
+#define ADD64(o) previous = __atomic_fetch_add((int64_t *)target, (int64_t)value, o)
+    if (4 == size)
+        WITH_MEMORY_ORDER(order, ADD32)
+    else
+        WITH_MEMORY_ORDER(order, ADD64)
+#undef ADD32
+#undef ADD64
+
+    return PyLong_FromLongLong(previous);
+}
+
+
+PyObject *
+SharedMemory_exchange(SharedMemory *self, PyObject *args, PyObject *keywords) {
+    unsigned long offset;
+    long long value;
+    long long previous = 0;
+    int size = 8;
+    int order = __ATOMIC_SEQ_CST;
+    void *target;
+    char *keyword_list[ ] = {"offset", "value", "size", "order", NULL};
+
+    // exchange(offset, value, [size = 8, [order = ATOMIC_SEQ_CST]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "kL|ii", keyword_list,
+                                     &offset, &value, &size, &order))
+        return NULL;
+
+    if (!(target = get_atomic_target(self, offset, size, order, ATOMIC_KIND_RMW)))
+        return NULL;
+
+    if (-1 == check_atomic_value(value, size))
+        return NULL;
+
+#define EXCHANGE32(o) previous = __atomic_exchange_n((int32_t *)target, (int32_t)value, o)
+#define EXCHANGE64(o) previous = __atomic_exchange_n((int64_t *)target, (int64_t)value, o)
+    if (4 == size)
+        WITH_MEMORY_ORDER(order, EXCHANGE32)
+    else
+        WITH_MEMORY_ORDER(order, EXCHANGE64)
+#undef EXCHANGE32
+#undef EXCHANGE64
+
+    return PyLong_FromLongLong(previous);
+}
+
+
+PyObject *
+SharedMemory_compare_exchange(SharedMemory *self, PyObject *args, PyObject *keywords) {
+    unsigned long offset;
+    long long expected;
+    long long desired;
+    int size = 8;
+    int order = __ATOMIC_SEQ_CST;
+    int swapped = 0;
+    int32_t expected32;
+    int64_t expected64;
+    void *target;
+    char *keyword_list[ ] = {"offset", "expected", "desired", "size", "order", NULL};
+
+    // compare_exchange(offset, expected, desired, [size = 8, [order = ATOMIC_SEQ_CST]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "kLL|ii", keyword_list,
+                                     &offset, &expected, &desired, &size, &order))
+        return NULL;
+
+    if (!(target = get_atomic_target(self, offset, size, order, ATOMIC_KIND_RMW)))
+        return NULL;
+
+    if ((-1 == check_atomic_value(expected, size)) || (-1 == check_atomic_value(desired, size)))
+        return NULL;
+
+    expected32 = (int32_t)expected;
+    expected64 = (int64_t)expected;
+
+    // As in C++, a failed exchange is only a load, so it uses the strongest
+    // load order that the given order implies.
+#define CAS32(o, failure_o) swapped = __atomic_compare_exchange_n((int32_t *)target, &expected32, \
+                                                                   (int32_t)desired, 0, o, failure_o)
+#define CAS64(o, failure_o) swapped = __atomic_compare_exchange_n((int64_t *)target, &expected64, \
+                                                                   (int64_t)desired, 0, o, failure_o)
+#define CAS(o) if (4 == size) CAS32(o, FAILURE_ORDER_##o); else CAS64(o, FAILURE_ORDER_##o)
+#define FAILURE_ORDER___ATOMIC_RELAXED __ATOMIC_RELAXED
+#define FAILURE_ORDER___ATOMIC_ACQUIRE __ATOMIC_ACQUIRE
+#define FAILURE_ORDER___ATOMIC_RELEASE __ATOMIC_RELAXED
+#define FAILURE_ORDER___ATOMIC_ACQ_REL __ATOMIC_ACQUIRE
+#define FAILURE_ORDER___ATOMIC_SEQ_CST __ATOMIC_SEQ_CST
+    WITH_MEMORY_ORDER(order, CAS)
+#undef CAS32
+#undef CAS64
+#undef CAS
+#undef FAILURE_ORDER___ATOMIC_RELAXED
+#undef FAILURE_ORDER___ATOMIC_ACQUIRE
+#undef FAILURE_ORDER___ATOMIC_RELEASE
+#undef FAILURE_ORDER___ATOMIC_ACQ_REL
+#undef FAILURE_ORDER___ATOMIC_SEQ_CST
+
+    // On failure, expected holds the value that was found.
+    return Py_BuildValue("(NL)", PyBool_FromLong(swapped),
+                         (4 == size) ? (long long)expected32 : (long long)expected64);
+}
+
+
+PyObject *
+SharedMemory_numa_stat(SharedMemory *self) {
+    /* Returns a dict that maps each NUMA node to the number of the segment's
+       pages that are resident on it. move_pages() only sees pages that are
+       mapped into this process, so pages that haven't been touched through
+       this attachment aren't counted.
+    */
+#ifdef MBIND_EXISTS
+    PyObject *py_size;
+    PyObject *py_counts = NULL;
+    PyObject *py_node = NULL;
+    PyObject *py_pages = NULL;
+    unsigned long *counts = NULL;
+    void *pages[SHM_NUMA_STAT_BATCH];
+    int status[SHM_NUMA_STAT_BATCH];
+    size_t page_size;
+    size_t page_count;
+    size_t done;
+    size_t batch;
+    size_t i;
+    long rc = 0;
+    int node;
+
+    if (self->address == NULL) {
+        PyErr_SetString(pNotAttachedException,
+                        "numa_stat() on unattached memory segment");
+        goto error_return;
+    }
+
+    if (!(py_size = shm_get_value(self->id, SVIFP_SHM_SIZE)))
+        goto error_return;
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+    page_count = (PyLong_AsUnsignedLongMask(py_size) + page_size - 1) / page_size;
+    Py_DECREF(py_size);
+
+    if (!(counts = (unsigned long *)calloc(SHM_NUMA_MAX_NODES, sizeof(unsigned long)))) {
+        PyErr_SetString(PyExc_MemoryError, "Out of memory");
+        goto error_return;
+    }
+
+    // move_pages() without a list of nodes only reports where each page is.
+    // A big segment takes many calls, so they're made without the GIL.
+    self->copies_in_progress++;
+    Py_BEGIN_ALLOW_THREADS
+    for (done = 0; (done < page_count) && (-1 != rc); done += batch) {
+        batch = page_count - done;
+        if (batch > SHM_NUMA_STAT_BATCH)
+            batch = SHM_NUMA_STAT_BATCH;
+
+        for (i = 0; i < batch; i++)
+            pages[i] = (char *)self->address + (done + i) * page_size;
+
+        rc = syscall(SYS_move_pages, 0, batch, pages, NULL, status, 0);
+
+        for (i = 0; (-1 != rc) && (i < batch); i++) {
+            // Untouched pages report a negative errno (-ENOENT).
+            if ((status[i] >= 0) && (status[i] < SHM_NUMA_MAX_NODES))
+                counts[status[i]]++;
+        }
+    }
+    Py_END_ALLOW_THREADS
+    self->copies_in_progress--;
+
+    if (-1 == rc) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error_return;
+    }
+
+    if (!(py_counts = PyDict_New()))
+        goto error_return;
+
+    for (node = 0; node < SHM_NUMA_MAX_NODES; node++) {
+        if (counts[node]) {
+            if (!(py_node = PyLong_FromLong(node)))
+                goto error_return;
+            if (!(py_pages = PyLong_FromUnsignedLong(counts[node])))
+                goto error_return;
+            if (-1 == PyDict_SetItem(py_counts, py_node, py_pages))
+                goto error_return;
+            Py_CLEAR(py_node);
+            Py_CLEAR(py_pages);
+        }
+    }
+
+    free(counts);
+
+    return py_counts;
+
+    error_return:
+    Py_XDECREF(py_node);
+    Py_XDECREF(py_pages);
+    Py_XDECREF(py_counts);
+    free(counts);
+    return NULL;
+#else
+    PyErr_SetString(PyExc_NotImplementedError,
+                    "NUMA placement isn't supported on this platform");
+    return NULL;
+#endif
+}
+
+
 PyObject *
 shm_get_key(SharedMemory *self) {
     return KEY_T_TO_PY(self->key);
@@ -702,6 +1490,51 @@ shm_get_cgid(SharedMemory *self) {
     return shm_get_value(self->id, SVIFP_IPC_PERM_CGID);
 }
 
+PyObject *
+shm_get_collect_stats(SharedMemory *self) {
+    return stats_get_enabled(self->stats);
+}
+
+int
+shm_set_collect_stats(SharedMemory *self, PyObject *py_value) {
+    return stats_set_enabled(&self->stats, &self->stats_segment, py_value);
+}
+
+PyObject *
+shm_get_gil_release_threshold(SharedMemory *self) {
+    return PyLong_FromUnsignedLong(self->gil_release_threshold);
+}
+
+int
+shm_set_gil_release_threshold(SharedMemory *self, PyObject *py_value) {
+    unsigned long threshold;
+
+    if (!py_value) {
+        PyErr_SetString(PyExc_AttributeError, "Attribute 'gil_release_threshold' can't be deleted");
+        goto error_return;
+    }
+
+    if (!PyLong_Check(py_value)) {
+        PyErr_SetString(PyExc_TypeError, "Attribute 'gil_release_threshold' must be an integer");
+        goto error_return;
+    }
+
+    threshold = PyLong_AsUnsignedLong(py_value);
+
+    if (PyErr_Occurred()) {
+        PyErr_Clear();
+        PyErr_SetString(PyExc_ValueError, "Attribute 'gil_release_threshold' must be non-negative");
+        goto error_return;
+    }
+
+    self->gil_release_threshold = threshold;
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
 PyObject *
 shm_get_mode(SharedMemory *self) {
     return shm_get_value(self->id, SVIFP_IPC_PERM_MODE);
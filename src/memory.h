@@ -4,8 +4,30 @@ typedef struct {
     int id;
     int read_only;
     void *address;
+    size_t attached_size;       // the segment's size, read when it was attached
+    int copies_in_progress;
+    unsigned long gil_release_threshold;
+    IpcStats *stats;
+    void *stats_segment;
 } SharedMemory;
 
+// Other types (e.g. SharedArena) check their arguments against this
+extern PyTypeObject SharedMemoryType;
+
+/* Copies that move at least gil_release_threshold bytes in total are done
+with the GIL released so that other threads can run in the meantime. Below
+that, releasing and reacquiring the GIL costs more than it's worth. This is
+the default for new SharedMemory objects.
+*/
+#define SHM_GIL_RELEASE_THRESHOLD (256 * 1024)
+
+/* The numa_node and interleave options and numa_stat() describe nodes with
+a bitmask of this many bits, so node numbers must be below it. */
+#define SHM_NUMA_MAX_NODES 1024
+
+/* numa_stat() asks the kernel about this many pages per move_pages() call. */
+#define SHM_NUMA_STAT_BATCH 1024
+
 /* Union for passing values to shm_set_ipc_perm_value() */
 union ipc_perm_value {
     uid_t uid;
@@ -21,11 +43,25 @@ PyObject *SharedMemory_attach(SharedMemory *, PyObject *, PyObject *);
 PyObject *SharedMemory_detach(SharedMemory *);
 PyObject *SharedMemory_read(SharedMemory *, PyObject *, PyObject *);
 PyObject *SharedMemory_write(SharedMemory *, PyObject *, PyObject *);
+PyObject *SharedMemory_readv(SharedMemory *, PyObject *, PyObject *);
+PyObject *SharedMemory_writev(SharedMemory *, PyObject *, PyObject *);
 PyObject *SharedMemory_remove(SharedMemory *);
+PyObject *SharedMemory_stats(SharedMemory *);
+PyObject *SharedMemory_reset_stats(SharedMemory *);
+PyObject *SharedMemory_numa_stat(SharedMemory *);
+PyObject *SharedMemory_atomic_load(SharedMemory *, PyObject *, PyObject *);
+PyObject *SharedMemory_atomic_store(SharedMemory *, PyObject *, PyObject *);
+PyObject *SharedMemory_fetch_add(SharedMemory *, PyObject *, PyObject *);
+PyObject *SharedMemory_exchange(SharedMemory *, PyObject *, PyObject *);
+PyObject *SharedMemory_compare_exchange(SharedMemory *, PyObject *, PyObject *);
 
 /* Python buffer implementation */
 int shm_get_buffer(SharedMemory *, Py_buffer *, int);
 
+/* memcpy() that releases the GIL for copies of gil_release_threshold bytes
+or more. Other types that copy in and out of a segment use this too. */
+void shm_copy(SharedMemory *, void *, const void *, size_t);
+
 /* Object attributes (read-write & read-only) */
 
 PyObject *shm_get_uid(SharedMemory *);
@@ -37,6 +73,11 @@ int shm_set_gid(SharedMemory *, PyObject *);
 PyObject *shm_get_mode(SharedMemory *);
 int shm_set_mode(SharedMemory *, PyObject *);
 
+PyObject *shm_get_collect_stats(SharedMemory *);
+int shm_set_collect_stats(SharedMemory *, PyObject *);
+PyObject *shm_get_gil_release_threshold(SharedMemory *);
+int shm_set_gil_release_threshold(SharedMemory *, PyObject *);
+
 PyObject *shm_get_key(SharedMemory *);
 PyObject *shm_get_size(SharedMemory *);
 PyObject *shm_get_address(SharedMemory *);
@@ -3,7 +3,14 @@
 #include "structmember.h"
 
 #include "common.h"
+#include "stats.h"
+#include "semaphore.h"
+#include "memory.h"
+#include "arena.h"
 #include "mq.h"
+#include "waitany.h"
+#include "spill.h"
+#include "schema.h"
 
 
 PyObject *
@@ -238,6 +245,119 @@ mq_set_max_size(MessageQueue *self, PyObject *py_value) {
     return set_a_value(self->id, SVIFP_MQ_QUEUE_BYTES_MAX, py_value);
 }
 
+PyObject *
+mq_get_collect_stats(MessageQueue *self) {
+    return stats_get_enabled(self->stats);
+}
+
+int
+mq_set_collect_stats(MessageQueue *self, PyObject *py_value) {
+    return stats_set_enabled(&self->stats, &self->stats_segment, py_value);
+}
+
+PyObject *
+mq_get_spill_arena(MessageQueue *self) {
+    if (self->spill_arena) {
+        Py_INCREF(self->spill_arena);
+        return self->spill_arena;
+    }
+    else
+        Py_RETURN_NONE;
+}
+
+int
+mq_set_spill_arena(MessageQueue *self, PyObject *py_value) {
+    if (!py_value) {
+        PyErr_SetString(PyExc_AttributeError, "Attribute 'spill_arena' can't be deleted");
+        goto error_return;
+    }
+
+    if (Py_None == py_value)
+        Py_CLEAR(self->spill_arena);
+    else if (PyObject_TypeCheck(py_value, &SharedArenaType)) {
+        Py_INCREF(py_value);
+        Py_XSETREF(self->spill_arena, py_value);
+    }
+    else {
+        PyErr_SetString(PyExc_TypeError, "Attribute 'spill_arena' must be a SharedArena or None");
+        goto error_return;
+    }
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+PyObject *
+mq_get_spill_threshold(MessageQueue *self) {
+    return PyLong_FromUnsignedLong(self->spill_threshold);
+}
+
+int
+mq_set_spill_threshold(MessageQueue *self, PyObject *py_value) {
+    unsigned long threshold;
+
+    if (!py_value) {
+        PyErr_SetString(PyExc_AttributeError, "Attribute 'spill_threshold' can't be deleted");
+        goto error_return;
+    }
+
+    if (!PyLong_Check(py_value)) {
+        PyErr_SetString(PyExc_TypeError, "Attribute 'spill_threshold' must be an integer");
+        goto error_return;
+    }
+
+    threshold = PyLong_AsUnsignedLong(py_value);
+
+    if (PyErr_Occurred()) {
+        PyErr_Clear();
+        PyErr_SetString(PyExc_ValueError, "Attribute 'spill_threshold' must be non-negative");
+        goto error_return;
+    }
+
+    self->spill_threshold = threshold;
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+PyObject *
+mq_get_record_schema(MessageQueue *self) {
+    if (self->record_schema) {
+        Py_INCREF(self->record_schema);
+        return self->record_schema;
+    }
+    else
+        Py_RETURN_NONE;
+}
+
+int
+mq_set_record_schema(MessageQueue *self, PyObject *py_value) {
+    if (!py_value) {
+        PyErr_SetString(PyExc_AttributeError, "Attribute 'record_schema' can't be deleted");
+        goto error_return;
+    }
+
+    if (Py_None == py_value)
+        Py_CLEAR(self->record_schema);
+    else if (PyObject_TypeCheck(py_value, &MessageSchemaType)) {
+        Py_INCREF(py_value);
+        Py_XSETREF(self->record_schema, py_value);
+    }
+    else {
+        PyErr_SetString(PyExc_TypeError, "Attribute 'record_schema' must be a MessageSchema or None");
+        goto error_return;
+    }
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
 PyObject *
 mq_get_mode(MessageQueue *self) {
     return get_a_value(self->id, SVIFP_IPC_PERM_MODE);
@@ -311,9 +431,26 @@ mq_remove(int queue_id) {
 }
 
 
+static void
+discard_streams(MessageQueue *self) {
+    // Frees receive_stream()'s incomplete streams.
+    int i;
+
+    if (self->streams) {
+        for (i = 0; i < QUEUE_STREAM_MAX_PARTIAL; i++)
+            Py_XDECREF(self->streams[i].buffer);
+        free(self->streams);
+        self->streams = NULL;
+    }
+}
+
 
 void
 MessageQueue_dealloc(MessageQueue *self) {
+    stats_free(&self->stats, &self->stats_segment);
+    Py_XDECREF(self->spill_arena);
+    Py_XDECREF(self->record_schema);
+    discard_streams(self);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
@@ -361,6 +498,7 @@ MessageQueue_init(MessageQueue *self, PyObject *args, PyObject *keywords) {
     }
 
     self->max_message_size = max_message_size;
+    self->spill_threshold = QUEUE_SPILL_THRESHOLD_DEFAULT;
 
     // I mask the caller's flags against the two IPC_* flags to ensure that
     // nothing funky sneaks into the flags.
@@ -428,40 +566,202 @@ MessageQueue_init(MessageQueue *self, PyObject *args, PyObject *keywords) {
 }
 
 
-PyObject *
-MessageQueue_send(MessageQueue *self, PyObject *args, PyObject *keywords) {
-    static char args_format[] = "s*|Oi";
-    Py_buffer user_msg;
-    PyObject *py_block = NULL;
-    int flags = 0;
-    int type = 1;
-    int rc;
-    struct queue_message *p_msg = NULL;
-    char *keyword_list[ ] = {"message", "block", "type", NULL};
+static int
+start_timeout(NoneableTimeout *timeout, int flags, WaitAlarm **p_alarm) {
+    /* msgsnd() and msgrcv() have no timeout, so a blocking call with a
+       timeout gets an alarm that interrupts it. Doesn't need the GIL.
+       Returns 0 or an errno value.
+    */
+    *p_alarm = NULL;
 
-    // send(message, [block = True, [type = 1]])
-    if (!PyArg_ParseTupleAndKeywords(args, keywords, args_format, keyword_list,
-                                     &user_msg, &py_block, &type))
+    if ((flags & IPC_NOWAIT) || timeout->is_none)
+        return 0;
+
+    return wait_alarm_start(p_alarm, timeout->timestamp.tv_sec,
+                            timeout->timestamp.tv_nsec);
+}
+
+
+static int
+stop_timeout(WaitAlarm *alarm, int failed) {
+    // Stops the alarm, if there is one, and returns 1 if the call failed
+    // because the alarm interrupted it. Doesn't need the GIL. Preserves errno.
+    int saved_errno = errno;
+    int timed_out = 0;
+
+    if (alarm)
+        timed_out = wait_alarm_stop(alarm) && failed && (EINTR == saved_errno);
+
+    errno = saved_errno;
+
+    return timed_out;
+}
+
+
+static void
+set_send_error(void) {
+    // Sets the Python error for a failed msgsnd() from errno.
+    switch (errno) {
+        case EACCES:
+            PyErr_SetString(pPermissionsException, "Permission denied");
+        break;
+
+        case EAGAIN:
+            PyErr_SetString(pBusyException,
+                    "The queue is full, or a system-wide limit on the number of queue messages has been reached");
+        break;
+
+        case EIDRM:
+            PyErr_SetString(pExistentialException,
+                            "The queue no longer exists");
+        break;
+
+        case EINTR:
+            PyErr_SetString(pBaseException, "Signaled while waiting");
+        break;
+
+        default:
+            PyErr_SetFromErrno(PyExc_OSError);
+        break;
+    }
+}
+
+
+static void
+set_receive_error(void) {
+    // Sets the Python error for a failed msgrcv() from errno.
+    switch (errno) {
+        case EACCES:
+            PyErr_SetString(pPermissionsException, "Permission denied");
+        break;
+
+        case EIDRM:
+        case EINVAL:
+            PyErr_SetString(pExistentialException,
+                                            "The queue no longer exists");
+        break;
+
+        case EINTR:
+            PyErr_SetString(pBaseException, "Signaled while waiting");
+        break;
+
+        case ENOMSG:
+            PyErr_SetString(pBusyException,
+                        "No available messages of the specified type");
+        break;
+
+        default:
+            PyErr_SetFromErrno(PyExc_OSError);
+        break;
+    }
+}
+
+
+int
+queue_get_flags(PyObject *py_block, NoneableTimeout *timeout) {
+    // default behavior (when py_block == NULL) is to block/wait.
+    if ((py_block && PyObject_Not(py_block)) || ((!timeout->is_none) && timeout->is_zero))
+        return IPC_NOWAIT;
+
+    return 0;
+}
+
+
+int
+queue_send(MessageQueue *self, struct queue_message *p_msg, size_t message_length,
+           int flags, NoneableTimeout *timeout) {
+    // Calls msgsnd() without the GIL and records the call's stats. Returns 0
+    // or -1 with a Python error set.
+    WaitAlarm *alarm;
+    int rc = -1;
+    int alarm_error;
+    int timed_out = 0;
+    uint64_t start_ns;
+
+    start_ns = stats_start(self->stats);
+
+    Py_BEGIN_ALLOW_THREADS
+    DPRINTF("Calling msgsnd(), id=%ld, p_msg=%p, p_msg->type=%ld, length=%lu, flags=0x%x\n",
+            (long)self->id, p_msg, p_msg->type, message_length, flags);
+    if (!(alarm_error = start_timeout(timeout, flags, &alarm))) {
+        rc = msgsnd(self->id, p_msg, message_length, flags);
+        timed_out = stop_timeout(alarm, -1 == rc);
+    }
+    Py_END_ALLOW_THREADS
+
+    if (alarm_error) {
+        errno = alarm_error;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error_return;
+    }
+
+    if (timed_out)
+        errno = EAGAIN;
+
+    if (start_ns && self->stats)
+        stats_record(self->stats, start_ns, message_length, (-1 == rc) ? errno : 0, timed_out);
+
+    if (-1 == rc) {
+        DPRINTF("msgsnd() returned -1, id=%ld, errno=%d\n", (long)self->id,
+                errno);
+        set_send_error();
         goto error_return;
+    }
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+
+static PyObject *
+send_message(MessageQueue *self, const void *payload, Py_ssize_t length,
+             PyObject *py_block, int type, NoneableTimeout *timeout) {
+    // The guts of send(), shared with the other methods that send messages.
+    // Returns None or NULL with a Python error set.
+    int spilled = 0;
+    struct queue_message *p_msg = NULL;
+    SharedArena *arena = NULL;
+    SpillDescriptor descriptor;
+    const void *body;
+    size_t body_length;
+    size_t message_length;
 
     if (type <= 0) {
         PyErr_SetString(PyExc_ValueError, "The type must be > 0");
         goto error_return;
     }
 
-    // self->max_message_size is a ulong while user_msg.len is a long. Casting the latter to
-    // unsigned long is safe because the length will never be negative.
-    if ((unsigned long)user_msg.len > self->max_message_size) {
+    // The queue's reference is copied because spill_arena can be changed
+    // while msgsnd() runs without the GIL.
+    arena = (SharedArena *)self->spill_arena;
+    Py_XINCREF(arena);
+
+    body = payload;
+    body_length = (size_t)length;
+
+    if (arena && ((unsigned long)length > self->spill_threshold)) {
+        if (-1 == spill_write(arena, payload, length, &descriptor))
+            goto error_return;
+        spilled = 1;
+        body = &descriptor;
+        body_length = sizeof(descriptor);
+    }
+
+    // With spilling on, every message starts with a frame byte.
+    message_length = body_length + (arena ? 1 : 0);
+
+    // self->max_message_size is a ulong while message_length is a size_t,
+    // and the latter is never larger.
+    if (message_length > self->max_message_size) {
         PyErr_Format(PyExc_ValueError,
             "The message length exceeds queue's max_message_size (%lu)",
             self->max_message_size);
         goto error_return;
     }
-    // default behavior (when py_block == NULL) is to block/wait.
-    if (py_block && PyObject_Not(py_block))
-        flags |= IPC_NOWAIT;
 
-    p_msg = (struct queue_message *)malloc(offsetof(struct queue_message, message) + user_msg.len);
+    p_msg = (struct queue_message *)malloc(offsetof(struct queue_message, message) + message_length);
 
     DPRINTF("p_msg is %p\n", p_msg);
 
@@ -470,140 +770,1064 @@ MessageQueue_send(MessageQueue *self, PyObject *args, PyObject *keywords) {
         goto error_return;
     }
 
-    memcpy(p_msg->message, user_msg.buf, user_msg.len);
+    if (arena) {
+        p_msg->message[0] = spilled ? SPILL_FRAME_SPILLED : SPILL_FRAME_INLINE;
+        memcpy(p_msg->message + 1, body, body_length);
+    }
+    else
+        memcpy(p_msg->message, body, body_length);
     p_msg->type = type;
 
-    Py_BEGIN_ALLOW_THREADS
-    DPRINTF("Calling msgsnd(), id=%ld, p_msg=%p, p_msg->type=%ld, length=%lu, flags=0x%x\n",
-            (long)self->id, p_msg, p_msg->type, user_msg.len, flags);
-    rc = msgsnd(self->id, p_msg, (size_t)user_msg.len, flags);
-    Py_END_ALLOW_THREADS
-
-    if (-1 == rc) {
-        DPRINTF("msgsnd() returned -1, id=%ld, errno=%d\n", (long)self->id,
-                errno);
-        switch (errno) {
-            case EACCES:
-                PyErr_SetString(pPermissionsException, "Permission denied");
-            break;
-
-            case EAGAIN:
-                PyErr_SetString(pBusyException,
-                        "The queue is full, or a system-wide limit on the number of queue messages has been reached");
-            break;
-
-            case EIDRM:
-                PyErr_SetString(pExistentialException,
-                                "The queue no longer exists");
-            break;
-
-            case EINTR:
-                PyErr_SetString(pBaseException, "Signaled while waiting");
-            break;
-
-            default:
-                PyErr_SetFromErrno(PyExc_OSError);
-            break;
-        }
-
+    if (-1 == queue_send(self, p_msg, message_length, queue_get_flags(py_block, timeout), timeout))
         goto error_return;
-    }
 
-    PyBuffer_Release(&user_msg);
     free(p_msg);
+    Py_XDECREF(arena);
     Py_RETURN_NONE;
 
     error_return:
-    PyBuffer_Release(&user_msg);
+    // A block that was spilled but never sent would otherwise leak.
+    if (spilled)
+        spill_discard(arena, &descriptor);
     free(p_msg);
+    Py_XDECREF(arena);
     return NULL;
 }
 
 
 PyObject *
-MessageQueue_receive(MessageQueue *self, PyObject *args, PyObject *keywords) {
+MessageQueue_send(MessageQueue *self, PyObject *args, PyObject *keywords) {
+    static char args_format[] = "s*|OiO&";
+    Py_buffer user_msg;
     PyObject *py_block = NULL;
-    PyObject *py_return_tuple = NULL;
-    int flags = 0;
-    int type = 0;
-    ssize_t rc;
-    struct queue_message *p_msg = NULL;
-    char *keyword_list[ ] = {"block", "type", NULL};
+    PyObject *py_rc;
+    NoneableTimeout timeout;
+    int type = 1;
+    char *keyword_list[ ] = {"message", "block", "type", "timeout", NULL};
 
-    // receive([block = True, [type = 0]])
-    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|Oi", keyword_list,
-                                     &py_block, &type))
-        goto error_return;
+    timeout.is_none = 1;
 
-    // default behavior (when py_block == NULL) is to block/wait.
-    if (py_block && PyObject_Not(py_block))
-        flags |= IPC_NOWAIT;
+    // send(message, [block = True, [type = 1, [timeout = None]]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, args_format, keyword_list,
+                                     &user_msg, &py_block, &type,
+                                     convert_timeout, &timeout))
+        return NULL;
 
-    p_msg = (struct queue_message *)malloc(sizeof(struct queue_message) + self->max_message_size);
+    py_rc = send_message(self, user_msg.buf, user_msg.len, py_block, type, &timeout);
 
-    DPRINTF("p_msg is %p, size = %lu\n",
-        p_msg, sizeof(struct queue_message) + self->max_message_size);
+    PyBuffer_Release(&user_msg);
 
-    if (!p_msg) {
-        PyErr_SetString(PyExc_MemoryError, "Out of memory");
-        goto error_return;
-    }
+    return py_rc;
+}
+
+
+ssize_t
+queue_receive(MessageQueue *self, struct queue_message *p_msg, size_t max_length,
+              int type, int flags, NoneableTimeout *timeout) {
+    // Calls msgrcv() without the GIL and records the call's stats. Returns
+    // the message's length or -1 with a Python error set.
+    WaitAlarm *alarm;
+    int alarm_error;
+    int timed_out = 0;
+    ssize_t rc = -1;
+    uint64_t start_ns;
 
     p_msg->type = type;
 
+    start_ns = stats_start(self->stats);
+
     Py_BEGIN_ALLOW_THREADS;
-    rc = msgrcv(self->id, p_msg, (size_t)self->max_message_size,
-                type, flags);
+    if (!(alarm_error = start_timeout(timeout, flags, &alarm))) {
+        rc = msgrcv(self->id, p_msg, max_length, type, flags);
+        timed_out = stop_timeout(alarm, (ssize_t)-1 == rc);
+    }
     Py_END_ALLOW_THREADS;
 
-    DPRINTF("after msgrcv, p_msg->type=%ld, rc (size)=%ld\n",
-                p_msg->type, (long)rc);
-
-    if ((ssize_t)-1 == rc) {
-        switch (errno) {
-            case EACCES:
-                PyErr_SetString(pPermissionsException, "Permission denied");
-            break;
+    if (alarm_error) {
+        errno = alarm_error;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error_return;
+    }
 
-            case EIDRM:
-            case EINVAL:
-                PyErr_SetString(pExistentialException,
-                                                "The queue no longer exists");
-            break;
+    if (timed_out)
+        errno = EAGAIN;
 
-            case EINTR:
-                PyErr_SetString(pBaseException, "Signaled while waiting");
-            break;
+    if (start_ns && self->stats)
+        stats_record(self->stats, start_ns, (size_t)rc, ((ssize_t)-1 == rc) ? errno : 0, timed_out);
 
-            case ENOMSG:
-                PyErr_SetString(pBusyException,
-                            "No available messages of the specified type");
-            break;
+    // A timed out receive is reported the same way as a non-blocking
+    // receive that finds no message.
+    if (timed_out)
+        errno = ENOMSG;
 
-            default:
-                PyErr_SetFromErrno(PyExc_OSError);
-            break;
-        }
+    DPRINTF("after msgrcv, p_msg->type=%ld, rc (size)=%ld\n",
+                p_msg->type, (long)rc);
 
+    if ((ssize_t)-1 == rc) {
+        set_receive_error();
         goto error_return;
     }
 
-    py_return_tuple = Py_BuildValue("NN",
-                                    PyBytes_FromStringAndSize(p_msg->message, rc),
-                                    PyLong_FromLong(p_msg->type)
-                                   );
-
-    free(p_msg);
-
-    return py_return_tuple;
+    return rc;
 
     error_return:
-    free(p_msg);
-    return NULL;
+    return -1;
 }
 
 
-PyObject *
-MessageQueue_remove(MessageQueue *self) {
-    return mq_remove(self->id);
+static PyObject *
+receive_message(MessageQueue *self, PyObject *py_block, int type,
+                NoneableTimeout *timeout) {
+    // The guts of receive(), shared with the other methods that receive
+    // messages. Returns a (message, type) tuple or NULL with a Python error set.
+    PyObject *py_return_tuple = NULL;
+    ssize_t rc;
+    struct queue_message *p_msg = NULL;
+    SharedArena *arena = NULL;
+    SpillDescriptor descriptor;
+    PyObject *py_message = NULL;
+
+    arena = (SharedArena *)self->spill_arena;
+    Py_XINCREF(arena);
+
+    p_msg = (struct queue_message *)malloc(sizeof(struct queue_message) + self->max_message_size);
+
+    DPRINTF("p_msg is %p, size = %lu\n",
+        p_msg, sizeof(struct queue_message) + self->max_message_size);
+
+    if (!p_msg) {
+        PyErr_SetString(PyExc_MemoryError, "Out of memory");
+        goto error_return;
+    }
+
+    rc = queue_receive(self, p_msg, (size_t)self->max_message_size, type,
+                       queue_get_flags(py_block, timeout), timeout);
+    if (-1 == rc)
+        goto error_return;
+
+    if (!arena)
+        py_message = PyBytes_FromStringAndSize(p_msg->message, rc);
+    else if ((rc >= 1) && (SPILL_FRAME_INLINE == p_msg->message[0]))
+        py_message = PyBytes_FromStringAndSize(p_msg->message + 1, rc - 1);
+    else if ((rc == 1 + (ssize_t)sizeof(descriptor)) &&
+             (SPILL_FRAME_SPILLED == p_msg->message[0])) {
+        memcpy(&descriptor, p_msg->message + 1, sizeof(descriptor));
+        py_message = spill_open(arena, &descriptor);
+    }
+    else
+        PyErr_SetString(PyExc_ValueError,
+                        "The message wasn't sent with spilling enabled");
+
+    if (!py_message)
+        goto error_return;
+
+    py_return_tuple = Py_BuildValue("NN",
+                                    py_message,
+                                    PyLong_FromLong(p_msg->type)
+                                   );
+
+    free(p_msg);
+    Py_XDECREF(arena);
+
+    return py_return_tuple;
+
+    error_return:
+    free(p_msg);
+    Py_XDECREF(arena);
+    return NULL;
+}
+
+
+PyObject *
+MessageQueue_receive(MessageQueue *self, PyObject *args, PyObject *keywords) {
+    PyObject *py_block = NULL;
+    NoneableTimeout timeout;
+    int type = 0;
+    char *keyword_list[ ] = {"block", "type", "timeout", NULL};
+
+    timeout.is_none = 1;
+
+    // receive([block = True, [type = 0, [timeout = None]]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|OiO&", keyword_list,
+                                     &py_block, &type,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    return receive_message(self, py_block, type, &timeout);
+}
+
+
+static MessageSchema *
+get_record_schema(MessageQueue *self) {
+    // Returns a new reference to the queue's record_schema, or NULL with a
+    // Python error set if it has none.
+    if (!self->record_schema) {
+        PyErr_SetString(PyExc_ValueError, "The queue has no record_schema");
+        return NULL;
+    }
+
+    Py_INCREF(self->record_schema);
+    return (MessageSchema *)self->record_schema;
+}
+
+
+PyObject *
+MessageQueue_send_record(MessageQueue *self, PyObject *args, PyObject *keywords) {
+    PyObject *py_block = NULL;
+    PyObject *py_no_args;
+    NoneableTimeout timeout;
+    MessageSchema *schema = NULL;
+    long stack_buffer[QUEUE_RECORD_STACK_BUFFER_SIZE / sizeof(long)];
+    struct queue_message *p_msg = (struct queue_message *)stack_buffer;
+    size_t frame;
+    size_t message_length;
+    int type = 1;
+    int ok;
+    char *keyword_list[ ] = {"block", "type", "timeout", NULL};
+
+    timeout.is_none = 1;
+
+    // send_record(*fields, [block = True, [type = 1, [timeout = None]]])
+    // The positional arguments are the fields, so the rest are keyword-only.
+    if (!(py_no_args = PyTuple_New(0)))
+        return NULL;
+    ok = PyArg_ParseTupleAndKeywords(py_no_args, keywords, "|OiO&", keyword_list,
+                                     &py_block, &type, convert_timeout, &timeout);
+    Py_DECREF(py_no_args);
+    if (!ok)
+        goto error_return;
+
+    if (!(schema = get_record_schema(self)))
+        goto error_return;
+
+    if (type <= 0) {
+        PyErr_SetString(PyExc_ValueError, "The type must be > 0");
+        goto error_return;
+    }
+
+    // Records are never spilled, but a queue that spills frames every message.
+    frame = self->spill_arena ? 1 : 0;
+    message_length = frame + (size_t)schema->size;
+
+    if (message_length > self->max_message_size) {
+        PyErr_Format(PyExc_ValueError,
+            "The message length exceeds queue's max_message_size (%lu)",
+            self->max_message_size);
+        goto error_return;
+    }
+
+    if (offsetof(struct queue_message, message) + message_length > sizeof(stack_buffer)) {
+        p_msg = (struct queue_message *)malloc(offsetof(struct queue_message, message) + message_length);
+        if (!p_msg) {
+            PyErr_SetString(PyExc_MemoryError, "Out of memory");
+            goto error_return;
+        }
+    }
+
+    if (frame)
+        p_msg->message[0] = SPILL_FRAME_INLINE;
+
+    if (-1 == schema_encode(schema, args, p_msg->message + frame))
+        goto error_return;
+
+    p_msg->type = type;
+
+    if (-1 == queue_send(self, p_msg, message_length, queue_get_flags(py_block, &timeout), &timeout))
+        goto error_return;
+
+    if (p_msg != (struct queue_message *)stack_buffer)
+        free(p_msg);
+    Py_DECREF(schema);
+    Py_RETURN_NONE;
+
+    error_return:
+    if (p_msg != (struct queue_message *)stack_buffer)
+        free(p_msg);
+    Py_XDECREF(schema);
+    return NULL;
+}
+
+
+PyObject *
+MessageQueue_receive_record(MessageQueue *self, PyObject *args, PyObject *keywords) {
+    PyObject *py_block = NULL;
+    PyObject *py_fields;
+    NoneableTimeout timeout;
+    MessageSchema *schema = NULL;
+    long stack_buffer[QUEUE_RECORD_STACK_BUFFER_SIZE / sizeof(long)];
+    struct queue_message *p_msg = (struct queue_message *)stack_buffer;
+    size_t frame;
+    size_t message_length;
+    ssize_t rc;
+    long received_type;
+    int type = 0;
+    char *keyword_list[ ] = {"block", "type", "timeout", NULL};
+
+    timeout.is_none = 1;
+
+    // receive_record([block = True, [type = 0, [timeout = None]]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|OiO&", keyword_list,
+                                     &py_block, &type,
+                                     convert_timeout, &timeout))
+        goto error_return;
+
+    if (!(schema = get_record_schema(self)))
+        goto error_return;
+
+    frame = self->spill_arena ? 1 : 0;
+    message_length = frame + (size_t)schema->size;
+
+    if (offsetof(struct queue_message, message) + message_length > sizeof(stack_buffer)) {
+        p_msg = (struct queue_message *)malloc(offsetof(struct queue_message, message) + message_length);
+        if (!p_msg) {
+            PyErr_SetString(PyExc_MemoryError, "Out of memory");
+            goto error_return;
+        }
+    }
+
+    // A message that's longer than a record fails with E2BIG and stays on
+    // the queue.
+    rc = queue_receive(self, p_msg, message_length, type,
+                       queue_get_flags(py_block, &timeout), &timeout);
+    if (-1 == rc)
+        goto error_return;
+
+    if (((size_t)rc != message_length) ||
+        (frame && (SPILL_FRAME_INLINE != p_msg->message[0]))) {
+        PyErr_SetString(PyExc_ValueError, "The message doesn't match the record_schema");
+        goto error_return;
+    }
+
+    if (!(py_fields = schema_decode(schema, p_msg->message + frame)))
+        goto error_return;
+
+    received_type = p_msg->type;
+
+    if (p_msg != (struct queue_message *)stack_buffer)
+        free(p_msg);
+    Py_DECREF(schema);
+
+    return Py_BuildValue("(Nl)", py_fields, received_type);
+
+    error_return:
+    if (p_msg != (struct queue_message *)stack_buffer)
+        free(p_msg);
+    Py_XDECREF(schema);
+    return NULL;
+}
+
+
+/* Every stream this process sends gets the next sequence number. */
+static uint64_t stream_sequence = 0;
+
+
+PyObject *
+MessageQueue_send_stream(MessageQueue *self, PyObject *args, PyObject *keywords) {
+    Py_buffer user_msg;
+    PyObject *py_block = NULL;
+    NoneableTimeout timeout;
+    StreamChunkHeader header;
+    struct queue_message *p_msg = NULL;
+    WaitAlarm *alarm = NULL;
+    size_t frame;
+    size_t chunk_capacity;
+    size_t chunk_length;
+    int type = 1;
+    int flags;
+    int rc = 0;
+    int alarm_error;
+    int timed_out = 0;
+    uint64_t start_ns;
+    IpcStats tally;
+    IpcStats *p_tally;
+    char *keyword_list[ ] = {"buffer", "block", "type", "timeout", NULL};
+
+    timeout.is_none = 1;
+
+    // send_stream(buffer, [block = True, [type = 1, [timeout = None]]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "y*|OiO&", keyword_list,
+                                     &user_msg, &py_block, &type,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    if (type <= 0) {
+        PyErr_SetString(PyExc_ValueError, "The type must be > 0");
+        goto error_return;
+    }
+
+    // Chunks are never spilled, but a queue that spills frames every message.
+    frame = self->spill_arena ? 1 : 0;
+
+    if (self->max_message_size <= frame + sizeof(header)) {
+        PyErr_Format(PyExc_ValueError,
+            "The queue's max_message_size must be > %lu to send streams",
+            (unsigned long)(frame + sizeof(header)));
+        goto error_return;
+    }
+
+    chunk_capacity = self->max_message_size - frame - sizeof(header);
+
+    p_msg = (struct queue_message *)malloc(offsetof(struct queue_message, message) +
+                                           self->max_message_size);
+    if (!p_msg) {
+        PyErr_SetString(PyExc_MemoryError, "Out of memory");
+        goto error_return;
+    }
+
+    p_msg->type = type;
+    if (frame)
+        p_msg->message[0] = SPILL_FRAME_INLINE;
+
+    header.magic = STREAM_MAGIC;
+    header.pid = (int32_t)getpid();
+    header.sequence = __atomic_fetch_add(&stream_sequence, 1, __ATOMIC_RELAXED);
+    header.total_length = (uint64_t)user_msg.len;
+    header.offset = 0;
+
+    flags = queue_get_flags(py_block, &timeout);
+
+    // Another thread can free self->stats while the GIL is released, so the
+    // chunks are counted here and added to self->stats afterwards.
+    memset(&tally, 0, sizeof(tally));
+    p_tally = self->stats ? &tally : NULL;
+
+    // All of the chunks are sent without the GIL, and the timeout applies to
+    // the stream as a whole. An empty stream is one empty chunk.
+    Py_BEGIN_ALLOW_THREADS
+    if (!(alarm_error = start_timeout(&timeout, flags, &alarm))) {
+        do {
+            chunk_length = MIN(chunk_capacity, (size_t)(header.total_length - header.offset));
+
+            memcpy(p_msg->message + frame, &header, sizeof(header));
+            memcpy(p_msg->message + frame + sizeof(header),
+                   (char *)user_msg.buf + header.offset, chunk_length);
+
+            start_ns = stats_start(p_tally);
+            rc = msgsnd(self->id, p_msg, frame + sizeof(header) + chunk_length, flags);
+            if (p_tally && (0 == rc))
+                stats_record(p_tally, start_ns, frame + sizeof(header) + chunk_length, 0, 0);
+
+            header.offset += chunk_length;
+        } while ((0 == rc) && (header.offset < header.total_length));
+
+        timed_out = stop_timeout(alarm, -1 == rc);
+
+        if (p_tally && (-1 == rc))
+            stats_record(p_tally, start_ns, 0, timed_out ? EAGAIN : errno, timed_out);
+    }
+    Py_END_ALLOW_THREADS
+
+    if (p_tally && self->stats)
+        stats_add(self->stats, p_tally);
+
+    if (alarm_error) {
+        errno = alarm_error;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error_return;
+    }
+
+    if (-1 == rc) {
+        // Chunks that were already sent can't be taken back. The receiver
+        // discards the incomplete stream eventually.
+        if (timed_out)
+            errno = EAGAIN;
+        set_send_error();
+        goto error_return;
+    }
+
+    free(p_msg);
+    PyBuffer_Release(&user_msg);
+    Py_RETURN_NONE;
+
+    error_return:
+    free(p_msg);
+    PyBuffer_Release(&user_msg);
+    return NULL;
+}
+
+
+static PartialStream *
+find_stream(MessageQueue *self, StreamChunkHeader *header, long type, int *p_bad_chunk) {
+    // Returns the stream that the chunk belongs to, starting a new one if
+    // necessary, or NULL with a Python error set. If the chunk's total length
+    // doesn't match its stream's, returns NULL with *p_bad_chunk set instead.
+    // Needs the GIL.
+    PartialStream *stream;
+    PartialStream *stalest = NULL;
+    PyObject *py_buffer;
+    int i;
+
+    for (i = 0; i < QUEUE_STREAM_MAX_PARTIAL; i++) {
+        stream = &self->streams[i];
+        if (stream->buffer && (stream->pid == header->pid) &&
+            (stream->sequence == header->sequence)) {
+            // Pids are reused and every process numbers its streams from 0,
+            // so a match isn't proof that the chunk belongs to this stream.
+            if (header->total_length != (uint64_t)PyBytes_GET_SIZE(stream->buffer)) {
+                *p_bad_chunk = 1;
+                return NULL;
+            }
+            return stream;
+        }
+        if ((!stalest) || (stalest->buffer && ((!stream->buffer) ||
+                                               (stream->last_used < stalest->last_used))))
+            stalest = stream;
+    }
+
+    if (header->total_length > PY_SSIZE_T_MAX) {
+        PyErr_SetString(PyExc_ValueError, "The stream is too large");
+        return NULL;
+    }
+
+    if (!(py_buffer = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)header->total_length)))
+        return NULL;
+
+    if (stalest->buffer) {
+        DPRINTF("discarding incomplete stream %ld:%llu\n", (long)stalest->pid,
+                (unsigned long long)stalest->sequence);
+    }
+    Py_XSETREF(stalest->buffer, py_buffer);
+    stalest->pid = header->pid;
+    stalest->sequence = header->sequence;
+    stalest->received = 0;
+    stalest->type = type;
+
+    return stalest;
+}
+
+
+PyObject *
+MessageQueue_receive_stream(MessageQueue *self, PyObject *args, PyObject *keywords) {
+    PyObject *py_block = NULL;
+    PyObject *py_return_tuple = NULL;
+    PyThreadState *thread_state;
+    NoneableTimeout timeout;
+    StreamChunkHeader header;
+    PartialStream *stream = NULL;
+    struct queue_message *p_msg = NULL;
+    WaitAlarm *alarm = NULL;
+    size_t frame;
+    size_t max_length;
+    size_t chunk_length;
+    ssize_t rc = 0;
+    int type = 0;
+    int flags;
+    int alarm_error;
+    int timed_out = 0;
+    int bad_chunk = 0;
+    uint64_t start_ns = 0;
+    IpcStats tally;
+    IpcStats *p_tally;
+    char *keyword_list[ ] = {"block", "type", "timeout", NULL};
+
+    timeout.is_none = 1;
+
+    // receive_stream([block = True, [type = 0, [timeout = None]]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|OiO&", keyword_list,
+                                     &py_block, &type,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    // The incomplete streams are filled without the GIL, so only one thread
+    // can use them.
+    if (self->receiving_stream) {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "receive_stream() is in progress in another thread");
+        return NULL;
+    }
+
+    if (!self->streams) {
+        self->streams = (PartialStream *)calloc(QUEUE_STREAM_MAX_PARTIAL, sizeof(PartialStream));
+        if (!self->streams) {
+            PyErr_SetString(PyExc_MemoryError, "Out of memory");
+            return NULL;
+        }
+    }
+
+    // Both can change while the GIL is released.
+    frame = self->spill_arena ? 1 : 0;
+    max_length = (size_t)self->max_message_size;
+
+    p_msg = (struct queue_message *)malloc(offsetof(struct queue_message, message) + max_length);
+    if (!p_msg) {
+        PyErr_SetString(PyExc_MemoryError, "Out of memory");
+        return NULL;
+    }
+
+    flags = queue_get_flags(py_block, &timeout);
+
+    self->receiving_stream = 1;
+
+    // As in send_stream(), the chunks are counted here and added to
+    // self->stats once the GIL is back for good.
+    memset(&tally, 0, sizeof(tally));
+    p_tally = self->stats ? &tally : NULL;
+
+    // Chunks are received and copied into place without the GIL until one
+    // completes a stream. The GIL is taken back only to start a new stream.
+    thread_state = PyEval_SaveThread();
+
+    if (!(alarm_error = start_timeout(&timeout, flags, &alarm))) {
+        while (1) {
+            start_ns = stats_start(p_tally);
+            rc = msgrcv(self->id, p_msg, max_length, type, flags);
+            if (-1 == rc)
+                break;
+
+            if (p_tally)
+                stats_record(p_tally, start_ns, (size_t)rc, 0, 0);
+
+            memcpy(&header, p_msg->message + frame, MIN(sizeof(header), (size_t)rc));
+            chunk_length = (size_t)rc - frame - sizeof(header);
+
+            if (((size_t)rc < frame + sizeof(header)) ||
+                (frame && (SPILL_FRAME_INLINE != p_msg->message[0])) ||
+                (STREAM_MAGIC != header.magic) ||
+                (header.offset > header.total_length) ||
+                (chunk_length > header.total_length - header.offset)) {
+                bad_chunk = 1;
+                break;
+            }
+
+            PyEval_RestoreThread(thread_state);
+            stream = find_stream(self, &header, p_msg->type, &bad_chunk);
+            thread_state = PyEval_SaveThread();
+            if (!stream)
+                break;
+
+            if (chunk_length > (size_t)PyBytes_GET_SIZE(stream->buffer) - header.offset) {
+                stream = NULL;
+                bad_chunk = 1;
+                break;
+            }
+
+            memcpy(PyBytes_AS_STRING(stream->buffer) + header.offset,
+                   p_msg->message + frame + sizeof(header), chunk_length);
+            stream->received += chunk_length;
+            stream->last_used = ++self->stream_clock;
+
+            if (stream->received >= header.total_length)
+                break;
+            stream = NULL;
+        }
+
+        timed_out = stop_timeout(alarm, -1 == rc);
+
+        if (p_tally && (-1 == rc))
+            stats_record(p_tally, start_ns, 0, timed_out ? EAGAIN : errno, timed_out);
+    }
+
+    PyEval_RestoreThread(thread_state);
+
+    if (p_tally && self->stats)
+        stats_add(self->stats, p_tally);
+
+    self->receiving_stream = 0;
+
+    if (alarm_error) {
+        errno = alarm_error;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error_return;
+    }
+
+    if (-1 == rc) {
+        // A stream that's partly received is kept for the next call.
+        // A timed out receive is reported the same way as a non-blocking
+        // receive that finds no message.
+        if (timed_out)
+            errno = ENOMSG;
+        set_receive_error();
+        goto error_return;
+    }
+
+    if (bad_chunk) {
+        PyErr_SetString(PyExc_ValueError, "The message wasn't sent by send_stream()");
+        goto error_return;
+    }
+
+    // find_stream() failed.
+    if (!stream)
+        goto error_return;
+
+    py_return_tuple = Py_BuildValue("(Ol)", stream->buffer, stream->type);
+    Py_CLEAR(stream->buffer);
+
+    error_return:
+    free(p_msg);
+    return py_return_tuple;
+}
+
+
+
+static PyObject *
+keep_in_band(PyObject *state, PyObject *pickle_buffer) {
+    /* The buffer_callback that send_object() passes to pickle.dumps(). The
+       state is a (list, threshold) tuple. Buffers larger than the threshold
+       are appended to the list and sent out of band (the callback returns
+       False); smaller ones stay in the pickle. */
+    PyObject *buffers = PyTuple_GET_ITEM(state, 0);
+    unsigned long threshold = PyLong_AsUnsignedLong(PyTuple_GET_ITEM(state, 1));
+    Py_buffer view;
+    int in_band;
+
+    // A non-contiguous buffer can't be spilled as one block. Leaving it in
+    // band lets pickle report the problem in its own words.
+    if (-1 == PyObject_GetBuffer(pickle_buffer, &view, PyBUF_ANY_CONTIGUOUS)) {
+        PyErr_Clear();
+        Py_RETURN_TRUE;
+    }
+
+    in_band = ((unsigned long)view.len <= threshold);
+    PyBuffer_Release(&view);
+
+    if (in_band)
+        Py_RETURN_TRUE;
+
+    if (-1 == PyList_Append(buffers, pickle_buffer))
+        return NULL;
+
+    Py_RETURN_FALSE;
+}
+
+static PyMethodDef keep_in_band_def = {
+    "keep_in_band", (PyCFunction)keep_in_band, METH_O, NULL
+};
+
+
+static PyObject *
+call_pickle(const char *function_name, PyObject *args, PyObject *kwargs) {
+    // Calls pickle.dumps() or pickle.loads().
+    PyObject *pickle;
+    PyObject *function = NULL;
+    PyObject *py_rc = NULL;
+
+    if ((pickle = PyImport_ImportModule("pickle"))) {
+        if ((function = PyObject_GetAttrString(pickle, function_name)))
+            py_rc = PyObject_Call(function, args, kwargs);
+    }
+
+    Py_XDECREF(function);
+    Py_XDECREF(pickle);
+
+    return py_rc;
+}
+
+
+PyObject *
+MessageQueue_send_object(MessageQueue *self, PyObject *args, PyObject *keywords) {
+    PyObject *obj;
+    PyObject *py_block = NULL;
+    PyObject *py_rc = NULL;
+    PyObject *py_args = NULL;
+    PyObject *py_kwargs = NULL;
+    PyObject *state = NULL;
+    PyObject *callback = NULL;
+    PyObject *buffers = NULL;
+    PyObject *py_pickle = NULL;
+    NoneableTimeout timeout;
+    SharedArena *arena;
+    SpillDescriptor *descriptors = NULL;
+    ObjectHeader header;
+    Py_buffer view;
+    Py_ssize_t buffer_count = 0;
+    Py_ssize_t spilled = 0;
+    Py_ssize_t i;
+    size_t body_length;
+    char *body = NULL;
+    int type = 1;
+    char *keyword_list[ ] = {"obj", "block", "type", "timeout", NULL};
+
+    timeout.is_none = 1;
+
+    // send_object(obj, [block = True, [type = 1, [timeout = None]]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O|OiO&", keyword_list,
+                                     &obj, &py_block, &type,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    // The queue's reference is copied for the same reason that
+    // send_message() copies it.
+    arena = (SharedArena *)self->spill_arena;
+    Py_XINCREF(arena);
+
+    if (!(py_args = PyTuple_Pack(1, obj)))
+        goto error_return;
+
+    // Without a spill arena, everything goes in band.
+    if (arena) {
+        if (!(buffers = PyList_New(0)))
+            goto error_return;
+        if (!(state = Py_BuildValue("(Ok)", buffers, self->spill_threshold)))
+            goto error_return;
+        if (!(callback = PyCFunction_New(&keep_in_band_def, state)))
+            goto error_return;
+        py_kwargs = Py_BuildValue("{s:i,s:O}", "protocol", 5,
+                                  "buffer_callback", callback);
+    }
+    else
+        py_kwargs = Py_BuildValue("{s:i}", "protocol", 5);
+
+    if (!py_kwargs)
+        goto error_return;
+
+    if (!(py_pickle = call_pickle("dumps", py_args, py_kwargs)))
+        goto error_return;
+
+    if (!PyBytes_Check(py_pickle)) {
+        PyErr_SetString(PyExc_TypeError, "pickle.dumps() didn't return bytes");
+        goto error_return;
+    }
+
+    if (buffers)
+        buffer_count = PyList_GET_SIZE(buffers);
+
+    if (buffer_count > UINT32_MAX) {
+        PyErr_SetString(PyExc_ValueError, "The object has too many buffers");
+        goto error_return;
+    }
+
+    if (buffer_count) {
+        descriptors = (SpillDescriptor *)malloc(buffer_count * sizeof(SpillDescriptor));
+        if (!descriptors) {
+            PyErr_NoMemory();
+            goto error_return;
+        }
+    }
+
+    // Each out-of-band buffer is copied straight from the object into its
+    // own block in the arena.
+    for (i = 0; i < buffer_count; i++) {
+        if (-1 == PyObject_GetBuffer(PyList_GET_ITEM(buffers, i), &view, PyBUF_ANY_CONTIGUOUS))
+            goto error_return;
+        if (-1 == spill_write(arena, view.buf, view.len, &descriptors[i])) {
+            PyBuffer_Release(&view);
+            goto error_return;
+        }
+        PyBuffer_Release(&view);
+        spilled++;
+    }
+
+    header.magic = OBJECT_MAGIC;
+    header.buffer_count = (uint32_t)buffer_count;
+
+    body_length = sizeof(header) + (buffer_count * sizeof(SpillDescriptor)) +
+                  PyBytes_GET_SIZE(py_pickle);
+
+    if (body_length > PY_SSIZE_T_MAX) {
+        PyErr_SetString(PyExc_ValueError, "The pickled object is too large");
+        goto error_return;
+    }
+
+    if (!(body = (char *)malloc(body_length))) {
+        PyErr_NoMemory();
+        goto error_return;
+    }
+
+    memcpy(body, &header, sizeof(header));
+    if (buffer_count)
+        memcpy(body + sizeof(header), descriptors, buffer_count * sizeof(SpillDescriptor));
+    memcpy(body + sizeof(header) + (buffer_count * sizeof(SpillDescriptor)),
+           PyBytes_AS_STRING(py_pickle), PyBytes_GET_SIZE(py_pickle));
+
+    py_rc = send_message(self, body, (Py_ssize_t)body_length, py_block, type, &timeout);
+
+    // The success path ends here too.
+    error_return:
+    // Blocks that were spilled for a message that was never sent would
+    // otherwise leak.
+    if (!py_rc) {
+        for (i = 0; i < spilled; i++)
+            spill_discard(arena, &descriptors[i]);
+    }
+
+    free(body);
+    free(descriptors);
+    Py_XDECREF(py_pickle);
+    Py_XDECREF(callback);
+    Py_XDECREF(state);
+    Py_XDECREF(buffers);
+    Py_XDECREF(py_kwargs);
+    Py_XDECREF(py_args);
+    Py_XDECREF(arena);
+
+    return py_rc;
+}
+
+
+PyObject *
+MessageQueue_receive_object(MessageQueue *self, PyObject *args, PyObject *keywords) {
+    PyObject *py_block = NULL;
+    PyObject *py_received = NULL;
+    PyObject *py_message;
+    PyObject *py_rc = NULL;
+    PyObject *py_args = NULL;
+    PyObject *py_kwargs = NULL;
+    PyObject *buffers = NULL;
+    PyObject *py_pickle = NULL;
+    PyObject *obj = NULL;
+    PyObject *py_released;
+    PyObject *error_type, *error_value, *error_traceback;
+    NoneableTimeout timeout;
+    SharedArena *arena;
+    SpillDescriptor descriptor;
+    ObjectHeader header;
+    Py_buffer view;
+    int have_view = 0;
+    uint32_t i;
+    size_t offset;
+    int type = 0;
+    char *keyword_list[ ] = {"block", "type", "timeout", NULL};
+
+    timeout.is_none = 1;
+
+    // receive_object([block = True, [type = 0, [timeout = None]]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|OiO&", keyword_list,
+                                     &py_block, &type,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    arena = (SharedArena *)self->spill_arena;
+    Py_XINCREF(arena);
+
+    if (!(py_received = receive_message(self, py_block, type, &timeout)))
+        goto error_return;
+
+    // The message is bytes, or a SpilledMessage if the pickle was large.
+    py_message = PyTuple_GET_ITEM(py_received, 0);
+
+    if (-1 == PyObject_GetBuffer(py_message, &view, PyBUF_SIMPLE))
+        goto error_return;
+    have_view = 1;
+
+    if ((size_t)view.len < sizeof(header))
+        memset(&header, 0, sizeof(header));
+    else
+        memcpy(&header, view.buf, sizeof(header));
+
+    if ((OBJECT_MAGIC != header.magic) ||
+        (header.buffer_count > ((size_t)view.len - sizeof(header)) / sizeof(SpillDescriptor))) {
+        PyErr_SetString(PyExc_ValueError, "The message wasn't sent by send_object()");
+        goto error_return;
+    }
+
+    if (header.buffer_count && !arena) {
+        PyErr_SetString(PyExc_ValueError,
+                        "The object has out-of-band buffers but the queue has no spill_arena");
+        goto error_return;
+    }
+
+    if (!(buffers = PyList_New(header.buffer_count)))
+        goto error_return;
+
+    // Each buffer becomes a SpilledMessage that the unpickled object refers
+    // to directly. The block is freed when the object no longer needs it.
+    offset = sizeof(header);
+    for (i = 0; i < header.buffer_count; i++) {
+        memcpy(&descriptor, (char *)view.buf + offset, sizeof(descriptor));
+        offset += sizeof(descriptor);
+        if (!(obj = spill_open(arena, &descriptor)))
+            goto error_return;
+        PyList_SET_ITEM(buffers, i, obj);
+    }
+    obj = NULL;
+
+    py_pickle = PyMemoryView_FromMemory((char *)view.buf + offset,
+                                        view.len - offset, PyBUF_READ);
+    if (!py_pickle)
+        goto error_return;
+
+    if (!(py_args = PyTuple_Pack(1, py_pickle)))
+        goto error_return;
+
+    if (!(py_kwargs = Py_BuildValue("{s:O}", "buffers", buffers)))
+        goto error_return;
+
+    if (!(obj = call_pickle("loads", py_args, py_kwargs)))
+        goto error_return;
+
+    // A spilled pickle isn't needed any more. The memoryview over it must
+    // go first because it doesn't hold a buffer export.
+    if (!(py_released = PyObject_CallMethod(py_pickle, "release", NULL)))
+        goto error_return;
+    Py_DECREF(py_released);
+    Py_CLEAR(py_pickle);
+
+    PyBuffer_Release(&view);
+    have_view = 0;
+
+    if (PyObject_TypeCheck(py_message, &SpilledMessageType)) {
+        if (!(py_released = SpilledMessage_release((SpilledMessage *)py_message)))
+            goto error_return;
+        Py_DECREF(py_released);
+    }
+
+    py_rc = Py_BuildValue("(OO)", obj, PyTuple_GET_ITEM(py_received, 1));
+
+    // The success path ends here too.
+    error_return:
+    if (py_pickle) {
+        // This can only fail if something still uses the memoryview's
+        // buffer, in which case the error already being reported is the
+        // more useful one.
+        PyErr_Fetch(&error_type, &error_value, &error_traceback);
+        if ((py_released = PyObject_CallMethod(py_pickle, "release", NULL)))
+            Py_DECREF(py_released);
+        PyErr_Clear();
+        PyErr_Restore(error_type, error_value, error_traceback);
+    }
+    if (have_view)
+        PyBuffer_Release(&view);
+    Py_XDECREF(py_pickle);
+    Py_XDECREF(obj);
+    Py_XDECREF(buffers);
+    Py_XDECREF(py_kwargs);
+    Py_XDECREF(py_args);
+    Py_XDECREF(py_received);
+    Py_XDECREF(arena);
+
+    return py_rc;
+}
+
+
+PyObject *
+MessageQueue_remove(MessageQueue *self) {
+    return mq_remove(self->id);
+}
+
+
+PyObject *
+MessageQueue_stats(MessageQueue *self) {
+    return stats_as_dict(self->stats);
+}
+
+
+PyObject *
+MessageQueue_reset_stats(MessageQueue *self) {
+    stats_reset(self->stats);
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+MessageQueue_share_stats(MessageQueue *self, PyObject *args, PyObject *keywords) {
+    NoneableKey key;
+    int mode = 0600;
+    char *keyword_list[ ] = {"key", "mode", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O&|i", keyword_list,
+                                     &convert_key_param, &key, &mode))
+        goto error_return;
+
+    if (key.is_none) {
+        PyErr_SetString(PyExc_ValueError, "The key must not be None");
+        goto error_return;
+    }
+
+    if (-1 == stats_share(&self->stats, &self->stats_segment, key.value, mode))
+        goto error_return;
+
+    Py_RETURN_NONE;
+
+    error_return:
+    return NULL;
 }
@@ -1,12 +1,35 @@
 #include <limits.h>  // for definition of SSIZE_MAX
 
+/* receive_stream() reassembles each stream in a PartialStream until its
+last chunk arrives. buffer is the bytes object that receive_stream()
+returns, allocated at full size when the stream's first chunk arrives. */
+typedef struct {
+    PyObject *buffer;           // NULL if the slot is free
+    int32_t pid;
+    uint64_t sequence;
+    uint64_t received;          // bytes copied into buffer so far
+    unsigned long last_used;    // for discarding the stalest stream
+    long type;
+} PartialStream;
+
 typedef struct {
     PyObject_HEAD
     key_t key;
     int id;
     unsigned long max_message_size;
+    IpcStats *stats;
+    void *stats_segment;
+    PyObject *spill_arena;          // a SharedArena, or NULL if spilling is off
+    unsigned long spill_threshold;
+    PyObject *record_schema;        // a MessageSchema or NULL
+    PartialStream *streams;         // QUEUE_STREAM_MAX_PARTIAL slots, or NULL
+    unsigned long stream_clock;
+    int receiving_stream;
 } MessageQueue;
 
+// Other code (e.g. wait_any()) checks its arguments against this
+extern PyTypeObject MessageQueueType;
+
 /* Message queue message struct for send() & receive()
 On many systems this is defined in sys/msg.h already, but it's better
 for me to define it here. Name it something other than msgbuf to avoid
@@ -17,6 +40,39 @@ struct queue_message {
     char message[];
 };
 
+/* send_record() and receive_record() use a buffer on the stack rather than
+malloc() for messages up to this size (including the message type). */
+#define QUEUE_RECORD_STACK_BUFFER_SIZE 512
+
+/* send_object() sends an ObjectHeader, then a SpillDescriptor for each of
+the pickle's out-of-band buffers, then the pickle itself. Like a
+SpillDescriptor, the header is copied in and out with memcpy(). */
+typedef struct {
+    uint32_t magic;
+    uint32_t buffer_count;
+} ObjectHeader;
+
+#define OBJECT_MAGIC 0x4f425631     // "OBV1"
+
+/* send_stream() splits a payload into chunks that fill the queue's
+max_message_size. Each chunk is a StreamChunkHeader (copied in and out with
+memcpy()) followed by the bytes at offset. A stream is identified by the
+sender's pid and a per-process sequence number, so chunks of streams from
+several senders can be interleaved on the queue. */
+typedef struct {
+    uint32_t magic;
+    int32_t pid;
+    uint64_t sequence;
+    uint64_t total_length;
+    uint64_t offset;
+} StreamChunkHeader;
+
+#define STREAM_MAGIC 0x53545231     // "STR1"
+
+/* How many incomplete streams receive_stream() keeps. When another one
+starts, the stream that's gone longest without a chunk is discarded. */
+#define QUEUE_STREAM_MAX_PARTIAL 16
+
 /* Maximum message size is limited by (a) the largest Python string I can
 create and (b) SSIZE_MAX. The latter restriction comes from the spec which
 says, "If the value of msgsz is greater than {SSIZE_MAX}, the result is
@@ -37,13 +93,26 @@ change it here, change it there too.
 */
 #define QUEUE_MESSAGE_SIZE_MAX_DEFAULT 2048
 
+/* When spilling is on, payloads longer than this many bytes go through the
+spill arena rather than the queue (see spill.h). */
+#define QUEUE_SPILL_THRESHOLD_DEFAULT 4096
+
 /* Object methods */
 PyObject *MessageQueue_new(PyTypeObject *, PyObject *, PyObject *);
 int MessageQueue_init(MessageQueue *, PyObject *, PyObject *);
 void MessageQueue_dealloc(MessageQueue *);
 PyObject *MessageQueue_send(MessageQueue *, PyObject *, PyObject *);
 PyObject *MessageQueue_receive(MessageQueue *, PyObject *, PyObject *);
+PyObject *MessageQueue_send_object(MessageQueue *, PyObject *, PyObject *);
+PyObject *MessageQueue_receive_object(MessageQueue *, PyObject *, PyObject *);
+PyObject *MessageQueue_send_record(MessageQueue *, PyObject *, PyObject *);
+PyObject *MessageQueue_receive_record(MessageQueue *, PyObject *, PyObject *);
+PyObject *MessageQueue_send_stream(MessageQueue *, PyObject *, PyObject *);
+PyObject *MessageQueue_receive_stream(MessageQueue *, PyObject *, PyObject *);
 PyObject *MessageQueue_remove(MessageQueue *);
+PyObject *MessageQueue_stats(MessageQueue *);
+PyObject *MessageQueue_reset_stats(MessageQueue *);
+PyObject *MessageQueue_share_stats(MessageQueue *, PyObject *, PyObject *);
 
 /* Object attributes (read-write & read-only) */
 PyObject *mq_get_mode(MessageQueue *);
@@ -58,6 +127,18 @@ int mq_set_gid(MessageQueue *, PyObject *);
 PyObject *mq_get_max_size(MessageQueue *);
 int mq_set_max_size(MessageQueue *, PyObject *);
 
+PyObject *mq_get_collect_stats(MessageQueue *);
+int mq_set_collect_stats(MessageQueue *, PyObject *);
+
+PyObject *mq_get_spill_arena(MessageQueue *);
+int mq_set_spill_arena(MessageQueue *, PyObject *);
+
+PyObject *mq_get_spill_threshold(MessageQueue *);
+int mq_set_spill_threshold(MessageQueue *, PyObject *);
+
+PyObject *mq_get_record_schema(MessageQueue *);
+int mq_set_record_schema(MessageQueue *, PyObject *);
+
 PyObject *mq_get_key(MessageQueue *);
 PyObject *mq_get_last_send_time(MessageQueue *);
 PyObject *mq_get_last_receive_time(MessageQueue *);
@@ -73,3 +154,14 @@ PyObject *mq_repr(MessageQueue *);
 
 /* Misc. */
 PyObject *mq_remove(int);
+
+/* Utility functions for code that sends and receives its own messages */
+
+/* Returns IPC_NOWAIT if the call shouldn't block, otherwise 0. */
+int queue_get_flags(PyObject *py_block, NoneableTimeout *);
+
+/* msgsnd() and msgrcv() without the GIL, honoring the timeout and recording
+stats. These return -1 with a Python error set on failure. The caller must
+hold the GIL and is responsible for the message's framing. */
+int queue_send(MessageQueue *, struct queue_message *, size_t, int, NoneableTimeout *);
+ssize_t queue_receive(MessageQueue *, struct queue_message *, size_t, int, int, NoneableTimeout *);
@@ -0,0 +1,317 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "waitany.h"
+#include "notifier.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// How long close() waits between attempts to interrupt the watcher
+#define INTERRUPT_INTERVAL_NS 1000000
+
+
+/******************    Internal use only     **********************/
+
+static void *
+watcher_main(void *arg) {
+    NotifierState *state = (NotifierState *)arg;
+    int ready;
+    char byte = 0;
+
+    pthread_mutex_lock(&state->lock);
+
+    while (!state->closing) {
+        if (!state->armed) {
+            pthread_cond_wait(&state->changed, &state->lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&state->lock);
+        ready = wait_block_until_ready(state->kind, state->id);
+        pthread_mutex_lock(&state->lock);
+
+        if (ready && !state->closing) {
+            state->armed = 0;
+            // The pipe is empty because clear() emptied it before it rearmed
+            // the watcher, so this can't block.
+            while ((-1 == write(state->write_fd, &byte, 1)) && (EINTR == errno))
+                ;
+        }
+    }
+
+    state->finished = 1;
+    pthread_cond_signal(&state->changed);
+    pthread_mutex_unlock(&state->lock);
+
+    return NULL;
+}
+
+
+static void
+stop_watcher(NotifierState *state) {
+    // Called without the GIL. A signal can arrive just before the watcher
+    // blocks and be missed, so it's resent until the watcher has finished.
+    struct timespec until;
+
+    pthread_mutex_lock(&state->lock);
+
+    state->closing = 1;
+    pthread_cond_signal(&state->changed);
+
+    while (!state->finished) {
+        pthread_kill(state->thread, WAIT_ANY_SIGNAL);
+
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += INTERRUPT_INTERVAL_NS;
+        if (until.tv_nsec >= 1000000000) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&state->changed, &state->lock, &until);
+    }
+
+    pthread_mutex_unlock(&state->lock);
+
+    pthread_join(state->thread, NULL);
+}
+
+
+static void
+close_notifier(Notifier *self) {
+    // Calling this on a closed notifier is harmless.
+    NotifierState *state = self->state;
+
+    if (!state)
+        return;
+
+    self->state = NULL;
+
+    if (getpid() == self->pid) {
+        Py_BEGIN_ALLOW_THREADS
+        stop_watcher(state);
+        Py_END_ALLOW_THREADS
+
+        pthread_cond_destroy(&state->changed);
+        pthread_mutex_destroy(&state->lock);
+        close(state->write_fd);
+        free(state);
+    }
+    else {
+        // The watcher doesn't exist in a forked child, and the state's lock
+        // might have been held at the moment of the fork, so the state is
+        // abandoned rather than cleaned up.
+        close(state->write_fd);
+    }
+
+    close(self->read_fd);
+    self->read_fd = -1;
+}
+
+
+static int
+set_nonblocking(int fd) {
+    int flags;
+
+    if (-1 == (flags = fcntl(fd, F_GETFL)))
+        return -1;
+    if (-1 == fcntl(fd, F_SETFL, flags | O_NONBLOCK))
+        return -1;
+    if (-1 == fcntl(fd, F_SETFD, FD_CLOEXEC))
+        return -1;
+
+    return 0;
+}
+
+
+/******************    Exposed methods     **********************/
+
+void
+Notifier_dealloc(Notifier *self) {
+    close_notifier(self);
+    Py_XDECREF(self->object);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+Notifier_new(PyTypeObject *type, PyObject *args, PyObject *kwlist) {
+    Notifier *self;
+
+    self = (Notifier *)type->tp_alloc(type, 0);
+
+    if (NULL != self) {
+        self->object = NULL;
+        self->state = NULL;
+        self->read_fd = -1;
+        self->pid = 0;
+    }
+
+    return (PyObject *)self;
+}
+
+
+int
+Notifier_init(Notifier *self, PyObject *args, PyObject *keywords) {
+    PyObject *object = NULL;
+    NotifierState *state = NULL;
+    char *keyword_list[ ] = {"object", NULL};
+    int fds[2] = {-1, -1};
+    int kind;
+    int id;
+    int rc;
+
+    // Notifier(object)
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O", keyword_list, &object))
+        goto error_return;
+
+    if (self->state) {
+        PyErr_SetString(PyExc_ValueError, "The notifier is already open");
+        goto error_return;
+    }
+
+    if (-1 == wait_get_target(object, &kind, &id))
+        goto error_return;
+
+    if ((-1 == pipe(fds)) ||
+        (-1 == set_nonblocking(fds[0])) || (-1 == set_nonblocking(fds[1]))) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error_return;
+    }
+
+    if (!(state = (NotifierState *)malloc(sizeof(NotifierState)))) {
+        PyErr_NoMemory();
+        goto error_return;
+    }
+
+    pthread_mutex_init(&state->lock, NULL);
+    pthread_cond_init(&state->changed, NULL);
+    state->kind = kind;
+    state->id = id;
+    state->write_fd = fds[1];
+    state->armed = 1;
+    state->closing = 0;
+    state->finished = 0;
+
+    if ((rc = wait_start_thread(&state->thread, watcher_main, state))) {
+        pthread_cond_destroy(&state->changed);
+        pthread_mutex_destroy(&state->lock);
+        errno = rc;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error_return;
+    }
+
+    DPRINTF("Notifier started a watcher for id %d\n", id);
+
+    Py_INCREF(object);
+    Py_XSETREF(self->object, object);
+    self->state = state;
+    self->read_fd = fds[0];
+    self->pid = getpid();
+
+    return 0;
+
+    error_return:
+    free(state);
+    if (-1 != fds[0]) {
+        close(fds[0]);
+        close(fds[1]);
+    }
+    return -1;
+}
+
+
+PyObject *
+Notifier_fileno(Notifier *self) {
+    if (!self->state) {
+        PyErr_SetString(PyExc_ValueError, "The notifier is closed");
+        return NULL;
+    }
+
+    return PyLong_FromLong(self->read_fd);
+}
+
+
+PyObject *
+Notifier_clear(Notifier *self) {
+    NotifierState *state = self->state;
+    char buffer[16];
+    ssize_t rc;
+
+    if (!state) {
+        PyErr_SetString(PyExc_ValueError, "The notifier is closed");
+        return NULL;
+    }
+
+    do {
+        rc = read(self->read_fd, buffer, sizeof(buffer));
+    } while ((0 < rc) || ((-1 == rc) && (EINTR == errno)));
+
+    // The watcher takes the lock only when it isn't blocked on the object,
+    // so this never waits long.
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&state->lock);
+    Py_END_ALLOW_THREADS
+
+    if (!state->armed) {
+        state->armed = 1;
+        pthread_cond_signal(&state->changed);
+    }
+
+    pthread_mutex_unlock(&state->lock);
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+Notifier_close(Notifier *self) {
+    close_notifier(self);
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+Notifier_enter(Notifier *self) {
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
+
+
+PyObject *
+Notifier_exit(Notifier *self, PyObject *args) {
+    return Notifier_close(self);
+}
+
+
+PyObject *
+notifier_get_object(Notifier *self) {
+    if (self->object) {
+        Py_INCREF(self->object);
+        return self->object;
+    }
+    else
+        Py_RETURN_NONE;
+}
+
+
+PyObject *
+notifier_get_closed(Notifier *self) {
+    return PyBool_FromLong(!self->state);
+}
+
+
+PyObject *
+notifier_repr(Notifier *self) {
+    if (self->object)
+        return PyUnicode_FromFormat("sysv_ipc.Notifier(%R)", self->object);
+    else
+        return PyUnicode_FromString("sysv_ipc.Notifier()");
+}
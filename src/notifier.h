@@ -0,0 +1,53 @@
+/* A Notifier gives a MessageQueue or Semaphore a file descriptor that
+selectors, asyncio and the like can watch. The descriptor is the read end of
+a pipe. A watcher thread blocks on the object the same way wait_any()'s
+helpers do (see waitany.h) and writes a byte to the pipe when the object is
+ready, which makes the descriptor readable.
+
+After it writes the byte, the watcher waits for clear(), which empties the
+pipe and sends the watcher back to the object. If the object is still ready
+then, the descriptor becomes readable again right away, so from the caller's
+point of view the descriptor is level-triggered as long as clear() is called
+each time it's readable.
+
+close() interrupts the watcher with WAIT_ANY_SIGNAL and waits for it to exit.
+*/
+
+/* Shared between the Notifier object and its watcher thread. It's separate
+from the Python object so that the object never has to be touched without
+the GIL. Everything except write_fd is protected by lock. */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+    int kind;
+    int id;
+    int write_fd;
+    int armed;
+    int closing;
+    int finished;
+} NotifierState;
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *object;
+    NotifierState *state;       // NULL after close()
+    int read_fd;
+    pid_t pid;                  // the process that started the watcher
+} Notifier;
+
+/* Object methods */
+PyObject *Notifier_new(PyTypeObject *, PyObject *, PyObject *);
+int Notifier_init(Notifier *, PyObject *, PyObject *);
+void Notifier_dealloc(Notifier *);
+PyObject *Notifier_enter(Notifier *);
+PyObject *Notifier_exit(Notifier *, PyObject *);
+PyObject *Notifier_fileno(Notifier *);
+PyObject *Notifier_clear(Notifier *);
+PyObject *Notifier_close(Notifier *);
+
+/* Object attributes (read-only) */
+PyObject *notifier_get_object(Notifier *);
+PyObject *notifier_get_closed(Notifier *);
+
+PyObject *notifier_repr(Notifier *);
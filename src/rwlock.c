@@ -0,0 +1,338 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "stats.h"
+#include "semaphore.h"
+#include "rwlock.h"
+
+
+/******************    Internal use only     **********************/
+
+static PyObject *
+get_semaphore_value(RWLock *self, int sem_num) {
+    int rc;
+
+    rc = semctl(self->id, sem_num, GETVAL);
+
+    if (-1 == rc) {
+        sem_set_error();
+        return NULL;
+    }
+
+    return PyLong_FromLong(rc);
+}
+
+
+static PyObject *
+release(RWLock *self, int sem_num, const char *name) {
+    struct sembuf op[1];
+
+    // IPC_NOWAIT turns a release of a lock that isn't held (which would
+    // otherwise block forever) into EAGAIN.
+    sem_set_op(&op[0], sem_num, -1, self->op_flags | IPC_NOWAIT);
+
+    if (-1 == sem_semop(self->id, op, 1, NULL, NULL)) {
+        if (EAGAIN == errno)
+            PyErr_Format(PyExc_ValueError, "The lock isn't held for %s", name);
+        else
+            sem_set_error();
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+static int
+get_preference(RWLock *self, int prefer_writers) {
+    /* Adopts the preference recorded in the semaphore set, recording
+       prefer_writers first if nothing has been recorded yet. prefer_writers
+       is -1 if the caller didn't pass one. Returns 0, or -1 with a Python
+       error set.
+    */
+    struct sembuf ops[2];
+    int value;
+
+    // Record the preference only if the value is still 0, so that of two
+    // processes opening a lock created without IPC_EXCL, the first wins.
+    // A process without write permission can't record it, which is fine.
+    value = (1 == prefer_writers) ? RWLOCK_PREFER_WRITERS_VALUE : RWLOCK_PREFER_READERS_VALUE;
+    sem_set_op(&ops[0], RWLOCK_PREFERENCE, 0, IPC_NOWAIT);
+    sem_set_op(&ops[1], RWLOCK_PREFERENCE, (short)value, IPC_NOWAIT);
+    semop(self->id, ops, 2);
+
+    if (-1 == (value = semctl(self->id, RWLOCK_PREFERENCE, GETVAL))) {
+        sem_set_error();
+        return -1;
+    }
+
+    if ((RWLOCK_PREFER_READERS_VALUE != value) && (RWLOCK_PREFER_WRITERS_VALUE != value)) {
+        // Nothing usable is recorded, so go with the caller.
+        self->prefer_writers = (1 == prefer_writers);
+        return 0;
+    }
+
+    self->prefer_writers = (RWLOCK_PREFER_WRITERS_VALUE == value);
+
+    if ((-1 != prefer_writers) && (prefer_writers != self->prefer_writers)) {
+        PyErr_Format(PyExc_ValueError,
+                     "The lock was created with prefer_writers=%s",
+                     self->prefer_writers ? "True" : "False");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/******************    Exposed methods     **********************/
+
+void
+RWLock_dealloc(RWLock *self) {
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+RWLock_new(PyTypeObject *type, PyObject *args, PyObject *keywords) {
+    RWLock *self;
+
+    self = (RWLock *)type->tp_alloc(type, 0);
+
+    return (PyObject *)self;
+}
+
+
+int
+RWLock_init(RWLock *self, PyObject *args, PyObject *keywords) {
+    int mode = 0600;
+    int flags = 0;
+    int prefer_writers = -1;
+    PyObject *py_prefer_writers = NULL;
+    unsigned short initial_values[RWLOCK_SEMAPHORE_COUNT] = {0};
+    union semun arg;
+    char *keyword_list[ ] = {"key", "flags", "mode", "prefer_writers", NULL};
+    NoneableKey key;
+
+    //RWLock(key, [flags = 0, [mode = 0600, [prefer_writers = False]]])
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O&|iiO", keyword_list,
+                                     &convert_key_param, &key, &flags,
+                                     &mode, &py_prefer_writers))
+        goto error_return;
+
+    // prefer_writers stays -1 if the caller didn't pass it, so that opening
+    // an existing lock can adopt the lock's preference.
+    if (py_prefer_writers && (-1 == (prefer_writers = PyObject_IsTrue(py_prefer_writers))))
+        goto error_return;
+
+    if (!sem_check_flags(&key, &flags))
+        goto error_return;
+
+    self->op_flags = 0;
+    self->prefer_writers = (1 == prefer_writers);
+
+    self->id = sem_get_set(&key, RWLOCK_SEMAPHORE_COUNT, mode, flags, &self->key);
+    if (-1 == self->id)
+        goto error_return;
+
+    // Linux zeroes new semaphores, but POSIX leaves their values undefined.
+    // Only a caller that's sure it created the set may zero it; with
+    // IPC_CREAT alone, the lock might already exist and be held.
+    if (((flags & IPC_CREX) == IPC_CREX) && (mode & 0200)) {
+        initial_values[RWLOCK_PREFERENCE] = self->prefer_writers ?
+                                            RWLOCK_PREFER_WRITERS_VALUE :
+                                            RWLOCK_PREFER_READERS_VALUE;
+        arg.array = initial_values;
+
+        if (-1 == semctl(self->id, 0, SETALL, arg)) {
+            sem_set_error();
+            goto error_return;
+        }
+    }
+    else if (-1 == get_preference(self, prefer_writers))
+        goto error_return;
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+
+PyObject *
+RWLock_acquire_read(RWLock *self, PyObject *args, PyObject *keywords) {
+    NoneableTimeout timeout;
+    struct sembuf ops[3];
+    size_t op_count = 0;
+    short flags;
+    char *keyword_list[ ] = {"timeout", NULL};
+
+    timeout.is_none = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|O&", keyword_list,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    flags = self->op_flags | sem_wait_flags(&timeout);
+
+    // Wait until there's no writer (and, if writers are preferred, no writer
+    // waiting), then join the readers.
+    sem_set_op(&ops[op_count++], RWLOCK_WRITER, 0, flags);
+    if (self->prefer_writers)
+        sem_set_op(&ops[op_count++], RWLOCK_WAITING_WRITERS, 0, flags);
+    sem_set_op(&ops[op_count++], RWLOCK_READERS, 1, flags);
+
+    if (-1 == sem_semop(self->id, ops, op_count, &timeout, NULL)) {
+        sem_set_error();
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+RWLock_release_read(RWLock *self) {
+    return release(self, RWLOCK_READERS, "reading");
+}
+
+
+PyObject *
+RWLock_acquire_write(RWLock *self, PyObject *args, PyObject *keywords) {
+    NoneableTimeout timeout;
+    struct sembuf ops[4];
+    size_t op_count = 0;
+    int rc;
+    int saved_errno;
+    short flags;
+    char *keyword_list[ ] = {"timeout", NULL};
+
+    timeout.is_none = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|O&", keyword_list,
+                                     convert_timeout, &timeout))
+        return NULL;
+
+    flags = self->op_flags | sem_wait_flags(&timeout);
+
+    if (self->prefer_writers) {
+        // Announce this writer so that new readers hold off. Incrementing
+        // never blocks.
+        sem_set_op(&ops[0], RWLOCK_WAITING_WRITERS, 1, self->op_flags);
+        if (-1 == sem_semop(self->id, ops, 1, NULL, NULL)) {
+            sem_set_error();
+            return NULL;
+        }
+    }
+
+    // Wait until there are no readers and no writer, then take the gate.
+    sem_set_op(&ops[op_count++], RWLOCK_WRITER, 0, flags);
+    sem_set_op(&ops[op_count++], RWLOCK_READERS, 0, flags);
+    sem_set_op(&ops[op_count++], RWLOCK_WRITER, 1, flags);
+    if (self->prefer_writers)
+        sem_set_op(&ops[op_count++], RWLOCK_WAITING_WRITERS, -1, flags);
+
+    rc = sem_semop(self->id, ops, op_count, &timeout, NULL);
+
+    if (-1 == rc) {
+        saved_errno = errno;
+
+        if (self->prefer_writers) {
+            // Withdraw the announcement.
+            sem_set_op(&ops[0], RWLOCK_WAITING_WRITERS, -1, self->op_flags | IPC_NOWAIT);
+            sem_semop(self->id, ops, 1, NULL, NULL);
+        }
+
+        errno = saved_errno;
+        sem_set_error();
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+RWLock_release_write(RWLock *self) {
+    return release(self, RWLOCK_WRITER, "writing");
+}
+
+
+PyObject *
+RWLock_remove(RWLock *self) {
+    return sem_remove(self->id);
+}
+
+
+PyObject *
+rwlock_get_undo(RWLock *self) {
+    return PyBool_FromLong( (self->op_flags & SEM_UNDO) ? 1 : 0 );
+}
+
+
+int
+rwlock_set_undo(RWLock *self, PyObject *py_value) {
+    int undo;
+
+    if (!py_value) {
+        PyErr_SetString(PyExc_AttributeError, "Attribute 'undo' can't be deleted");
+        return -1;
+    }
+
+    if (-1 == (undo = PyObject_IsTrue(py_value)))
+        return -1;
+
+    if (undo)
+        self->op_flags |= SEM_UNDO;
+    else
+        self->op_flags &= ~SEM_UNDO;
+
+    return 0;
+}
+
+
+PyObject *
+rwlock_get_key(RWLock *self) {
+    return KEY_T_TO_PY(self->key);
+}
+
+
+PyObject *
+rwlock_get_prefer_writers(RWLock *self) {
+    return PyBool_FromLong(self->prefer_writers);
+}
+
+
+PyObject *
+rwlock_get_readers(RWLock *self) {
+    return get_semaphore_value(self, RWLOCK_READERS);
+}
+
+
+PyObject *
+rwlock_get_writer(RWLock *self) {
+    PyObject *py_value = get_semaphore_value(self, RWLOCK_WRITER);
+    PyObject *py_result = NULL;
+
+    if (py_value) {
+        py_result = PyBool_FromLong(PyLong_AsLong(py_value));
+        Py_DECREF(py_value);
+    }
+
+    return py_result;
+}
+
+
+PyObject *
+rwlock_get_waiting_writers(RWLock *self) {
+    return get_semaphore_value(self, RWLOCK_WAITING_WRITERS);
+}
+
+
+PyObject *
+rwlock_repr(RWLock *self) {
+    return PyUnicode_FromFormat("sysv_ipc.RWLock(%ld)", (long)self->key);
+}
@@ -0,0 +1,52 @@
+/* RWLock is a reader/writer lock built on a set of SysV semaphores.
+
+    RWLOCK_READERS counts the processes holding the lock for reading.
+    RWLOCK_WRITER is 1 while a writer holds the lock and 0 otherwise.
+    RWLOCK_WAITING_WRITERS counts writers that are waiting for the lock. Only
+        writer-preferring locks use it.
+    RWLOCK_PREFERENCE records whether the lock prefers writers so that every
+        process uses it the same way: RWLOCK_PREFER_READERS_VALUE or
+        RWLOCK_PREFER_WRITERS_VALUE, or 0 if it hasn't been recorded yet.
+
+Each acquire and release is a single semop() call, so the test of the gate and
+the change of the count happen atomically.
+*/
+
+#define RWLOCK_READERS 0
+#define RWLOCK_WRITER 1
+#define RWLOCK_WAITING_WRITERS 2
+#define RWLOCK_PREFERENCE 3
+#define RWLOCK_SEMAPHORE_COUNT 4
+
+#define RWLOCK_PREFER_READERS_VALUE 1
+#define RWLOCK_PREFER_WRITERS_VALUE 2
+
+typedef struct {
+    PyObject_HEAD
+    key_t key;
+    int id;
+    short op_flags;
+    int prefer_writers;
+} RWLock;
+
+/* Object methods */
+PyObject *RWLock_new(PyTypeObject *, PyObject *, PyObject *);
+int RWLock_init(RWLock *, PyObject *, PyObject *);
+void RWLock_dealloc(RWLock *);
+PyObject *RWLock_acquire_read(RWLock *, PyObject *, PyObject *);
+PyObject *RWLock_release_read(RWLock *);
+PyObject *RWLock_acquire_write(RWLock *, PyObject *, PyObject *);
+PyObject *RWLock_release_write(RWLock *);
+PyObject *RWLock_remove(RWLock *);
+
+/* Object attributes (read-write & read-only) */
+PyObject *rwlock_get_undo(RWLock *);
+int rwlock_set_undo(RWLock *, PyObject *);
+
+PyObject *rwlock_get_key(RWLock *);
+PyObject *rwlock_get_prefer_writers(RWLock *);
+PyObject *rwlock_get_readers(RWLock *);
+PyObject *rwlock_get_writer(RWLock *);
+PyObject *rwlock_get_waiting_writers(RWLock *);
+
+PyObject *rwlock_repr(RWLock *);
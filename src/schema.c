@@ -0,0 +1,545 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "schema.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Keeps offset arithmetic far away from overflow
+#define SCHEMA_SIZE_MAX (PY_SSIZE_T_MAX / 4)
+
+
+/******************    Internal use only     **********************/
+
+static int
+host_is_little_endian(void) {
+    uint16_t one = 1;
+
+    return *(unsigned char *)&one;
+}
+
+
+static Py_ssize_t
+item_size(char code, int native) {
+    // Returns the size of one item of the given format character, or -1 if
+    // the character isn't supported.
+    switch (code) {
+        case 'x':
+        case 'c':
+        case 'b':
+        case 'B':
+        case '?':
+        case 's':
+            return 1;
+
+        case 'h':
+        case 'H':
+            return native ? (Py_ssize_t)sizeof(short) : 2;
+
+        case 'i':
+        case 'I':
+            return native ? (Py_ssize_t)sizeof(int) : 4;
+
+        case 'l':
+        case 'L':
+            return native ? (Py_ssize_t)sizeof(long) : 4;
+
+        case 'q':
+        case 'Q':
+            return native ? (Py_ssize_t)sizeof(long long) : 8;
+
+        case 'f':
+            return 4;
+
+        case 'd':
+            return 8;
+
+        default:
+            return -1;
+    }
+}
+
+
+static int
+add_field(MessageSchema *self, Py_ssize_t *capacity, char code,
+          Py_ssize_t offset, Py_ssize_t size) {
+    SchemaField *fields;
+
+    if (self->field_count == *capacity) {
+        *capacity = *capacity ? (*capacity * 2) : 8;
+        fields = (SchemaField *)realloc(self->fields, *capacity * sizeof(SchemaField));
+        if (!fields) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        self->fields = fields;
+    }
+
+    self->fields[self->field_count].code = code;
+    self->fields[self->field_count].offset = offset;
+    self->fields[self->field_count].size = size;
+    self->field_count++;
+
+    return 0;
+}
+
+
+static int
+compile_format(MessageSchema *self, const char *format) {
+    // Fills in the schema's fields, size and byte order. Returns -1 with a
+    // Python error set if the format is invalid.
+    const char *p = format;
+    Py_ssize_t capacity = 0;
+    Py_ssize_t offset = 0;
+    Py_ssize_t count;
+    Py_ssize_t size;
+    Py_ssize_t i;
+    int native = 1;
+    char code;
+
+    self->little_endian = host_is_little_endian();
+
+    switch (*p) {
+        case '@':
+            p++;
+        break;
+
+        case '=':
+            native = 0;
+            p++;
+        break;
+
+        case '<':
+            native = 0;
+            self->little_endian = 1;
+            p++;
+        break;
+
+        case '>':
+        case '!':
+            native = 0;
+            self->little_endian = 0;
+            p++;
+        break;
+    }
+
+    while (*p) {
+        if (isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+
+        count = 1;
+        if (isdigit((unsigned char)*p)) {
+            count = 0;
+            while (isdigit((unsigned char)*p)) {
+                if (count > (SCHEMA_SIZE_MAX - 9) / 10)
+                    goto too_big;
+                count = (count * 10) + (*p - '0');
+                p++;
+            }
+            if (!*p) {
+                PyErr_SetString(PyExc_ValueError,
+                                "Repeat count given without format character");
+                return -1;
+            }
+        }
+
+        code = *p++;
+
+        if (-1 == (size = item_size(code, native))) {
+            PyErr_Format(PyExc_ValueError,
+                         "Unsupported format character '%c'", code);
+            return -1;
+        }
+
+        // In native mode, items are aligned as a C compiler would align them.
+        if (native && (size > 1))
+            offset = ((offset + size - 1) / size) * size;
+
+        if (count > (SCHEMA_SIZE_MAX - offset) / size)
+            goto too_big;
+
+        if ('s' == code) {
+            if (-1 == add_field(self, &capacity, code, offset, count))
+                return -1;
+            offset += count;
+        }
+        else if ('x' == code)
+            offset += count;
+        else {
+            for (i = 0; i < count; i++) {
+                if (-1 == add_field(self, &capacity, code, offset, size))
+                    return -1;
+                offset += size;
+            }
+        }
+    }
+
+    self->size = offset;
+
+    return 0;
+
+    too_big:
+    PyErr_SetString(PyExc_ValueError, "The format describes too many bytes");
+    return -1;
+}
+
+
+static void
+put_bits(char *buffer, uint64_t bits, Py_ssize_t size, int little_endian) {
+    unsigned char *p = (unsigned char *)buffer;
+    Py_ssize_t i;
+
+    for (i = 0; i < size; i++) {
+        p[little_endian ? i : (size - 1 - i)] = (unsigned char)(bits & 0xff);
+        bits >>= 8;
+    }
+}
+
+
+static uint64_t
+get_bits(const char *buffer, Py_ssize_t size, int little_endian) {
+    const unsigned char *p = (const unsigned char *)buffer;
+    uint64_t bits = 0;
+    Py_ssize_t i;
+
+    for (i = 0; i < size; i++)
+        bits = (bits << 8) | p[little_endian ? (size - 1 - i) : i];
+
+    return bits;
+}
+
+
+static int
+encode_integer(SchemaField *field, PyObject *py_value, uint64_t *bits) {
+    PyObject *py_index;
+    long long value;
+    unsigned long long unsigned_value;
+    int bit_count = (int)(field->size * 8);
+    int is_signed = islower((unsigned char)field->code);
+
+    if (!(py_index = PyNumber_Index(py_value)))
+        return -1;
+
+    if (is_signed) {
+        value = PyLong_AsLongLong(py_index);
+        Py_DECREF(py_index);
+        if ((-1 == value) && PyErr_Occurred())
+            goto out_of_range;
+        if ((bit_count < 64) &&
+            ((value < -(1LL << (bit_count - 1))) || (value > (1LL << (bit_count - 1)) - 1)))
+            goto out_of_range;
+        *bits = (uint64_t)value;
+    }
+    else {
+        unsigned_value = PyLong_AsUnsignedLongLong(py_index);
+        Py_DECREF(py_index);
+        if (((unsigned long long)-1 == unsigned_value) && PyErr_Occurred())
+            goto out_of_range;
+        if ((bit_count < 64) && (unsigned_value >> bit_count))
+            goto out_of_range;
+        *bits = (uint64_t)unsigned_value;
+    }
+
+    return 0;
+
+    out_of_range:
+    PyErr_Clear();
+    PyErr_Format(PyExc_OverflowError,
+                 "Value out of range for format character '%c'", field->code);
+    return -1;
+}
+
+
+static int
+encode_field(MessageSchema *self, SchemaField *field, PyObject *py_value,
+             char *buffer) {
+    Py_buffer view;
+    uint64_t bits;
+    uint32_t bits32;
+    double value;
+    float value32;
+    int truth;
+
+    switch (field->code) {
+        case 'c':
+            if (!PyBytes_Check(py_value) || (1 != PyBytes_GET_SIZE(py_value))) {
+                PyErr_SetString(PyExc_TypeError,
+                                "Format character 'c' requires a bytes object of length 1");
+                return -1;
+            }
+            *buffer = *PyBytes_AS_STRING(py_value);
+            return 0;
+
+        case 's':
+            if (-1 == PyObject_GetBuffer(py_value, &view, PyBUF_SIMPLE))
+                return -1;
+            // Like struct.pack(), this truncates long strings and pads short
+            // ones with zeroes. The buffer was zeroed by schema_encode().
+            memcpy(buffer, view.buf, (view.len < field->size) ? view.len : field->size);
+            PyBuffer_Release(&view);
+            return 0;
+
+        case '?':
+            if (-1 == (truth = PyObject_IsTrue(py_value)))
+                return -1;
+            *buffer = (char)truth;
+            return 0;
+
+        case 'f':
+        case 'd':
+            value = PyFloat_AsDouble(py_value);
+            if ((-1.0 == value) && PyErr_Occurred())
+                return -1;
+            if ('f' == field->code) {
+                value32 = (float)value;
+                if (isinf(value32) && !isinf(value)) {
+                    PyErr_SetString(PyExc_OverflowError,
+                                    "Value too large for format character 'f'");
+                    return -1;
+                }
+                memcpy(&bits32, &value32, sizeof(bits32));
+                bits = bits32;
+            }
+            else
+                memcpy(&bits, &value, sizeof(bits));
+            break;
+
+        default:
+            if (-1 == encode_integer(field, py_value, &bits))
+                return -1;
+            break;
+    }
+
+    put_bits(buffer, bits, field->size, self->little_endian);
+
+    return 0;
+}
+
+
+static PyObject *
+decode_field(MessageSchema *self, SchemaField *field, const char *buffer) {
+    uint64_t bits;
+    uint32_t bits32;
+    double value;
+    float value32;
+
+    switch (field->code) {
+        case 'c':
+        case 's':
+            return PyBytes_FromStringAndSize(buffer, field->size);
+
+        case '?':
+            return PyBool_FromLong(*buffer != 0);
+    }
+
+    bits = get_bits(buffer, field->size, self->little_endian);
+
+    switch (field->code) {
+        case 'f':
+            bits32 = (uint32_t)bits;
+            memcpy(&value32, &bits32, sizeof(value32));
+            return PyFloat_FromDouble(value32);
+
+        case 'd':
+            memcpy(&value, &bits, sizeof(value));
+            return PyFloat_FromDouble(value);
+
+        case 'b':
+        case 'h':
+        case 'i':
+        case 'l':
+        case 'q':
+            // Sign extension
+            if ((field->size < 8) && (bits >> ((field->size * 8) - 1)))
+                bits |= ~(uint64_t)0 << (field->size * 8);
+            return PyLong_FromLongLong((long long)bits);
+
+        default:
+            return PyLong_FromUnsignedLongLong((unsigned long long)bits);
+    }
+}
+
+
+/******************    Utility functions     **********************/
+
+int
+schema_encode(MessageSchema *self, PyObject *py_values, char *buffer) {
+    Py_ssize_t i;
+
+    if (PyTuple_GET_SIZE(py_values) != self->field_count) {
+        PyErr_Format(PyExc_TypeError, "The schema has %zd fields but %zd values were given",
+                     self->field_count, PyTuple_GET_SIZE(py_values));
+        return -1;
+    }
+
+    memset(buffer, 0, self->size);
+
+    for (i = 0; i < self->field_count; i++) {
+        if (-1 == encode_field(self, &self->fields[i], PyTuple_GET_ITEM(py_values, i),
+                               buffer + self->fields[i].offset))
+            return -1;
+    }
+
+    return 0;
+}
+
+
+PyObject *
+schema_decode(MessageSchema *self, const char *buffer) {
+    PyObject *py_values;
+    PyObject *py_value;
+    Py_ssize_t i;
+
+    if (!(py_values = PyTuple_New(self->field_count)))
+        return NULL;
+
+    for (i = 0; i < self->field_count; i++) {
+        py_value = decode_field(self, &self->fields[i], buffer + self->fields[i].offset);
+        if (!py_value) {
+            Py_DECREF(py_values);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(py_values, i, py_value);
+    }
+
+    return py_values;
+}
+
+
+/******************    Exposed methods     **********************/
+
+void
+MessageSchema_dealloc(MessageSchema *self) {
+    free(self->fields);
+    Py_XDECREF(self->format);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+MessageSchema_new(PyTypeObject *type, PyObject *args, PyObject *kwlist) {
+    MessageSchema *self;
+
+    self = (MessageSchema *)type->tp_alloc(type, 0);
+
+    if (NULL != self) {
+        self->format = NULL;
+        self->fields = NULL;
+        self->field_count = 0;
+        self->size = 0;
+    }
+
+    return (PyObject *)self;
+}
+
+
+int
+MessageSchema_init(MessageSchema *self, PyObject *args, PyObject *keywords) {
+    PyObject *py_format;
+    const char *format;
+    char *keyword_list[ ] = {"format", NULL};
+
+    // MessageSchema(format)
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "U", keyword_list, &py_format))
+        goto error_return;
+
+    if (!(format = PyUnicode_AsUTF8(py_format)))
+        goto error_return;
+
+    // Allow __init__() to be called again by starting over.
+    free(self->fields);
+    self->fields = NULL;
+    self->field_count = 0;
+    self->size = 0;
+
+    if (-1 == compile_format(self, format))
+        goto error_return;
+
+    DPRINTF("Compiled schema '%s': %zd fields, %zd bytes\n", format,
+            self->field_count, self->size);
+
+    Py_INCREF(py_format);
+    Py_XSETREF(self->format, py_format);
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+
+PyObject *
+MessageSchema_pack(MessageSchema *self, PyObject *args) {
+    PyObject *py_bytes;
+
+    if (!(py_bytes = PyBytes_FromStringAndSize(NULL, self->size)))
+        return NULL;
+
+    if (-1 == schema_encode(self, args, PyBytes_AS_STRING(py_bytes))) {
+        Py_DECREF(py_bytes);
+        return NULL;
+    }
+
+    return py_bytes;
+}
+
+
+PyObject *
+MessageSchema_unpack(MessageSchema *self, PyObject *py_buffer) {
+    Py_buffer view;
+    PyObject *py_values = NULL;
+
+    if (-1 == PyObject_GetBuffer(py_buffer, &view, PyBUF_SIMPLE))
+        return NULL;
+
+    if (view.len != self->size)
+        PyErr_Format(PyExc_ValueError, "unpack() requires a buffer of %zd bytes",
+                     self->size);
+    else
+        py_values = schema_decode(self, (const char *)view.buf);
+
+    PyBuffer_Release(&view);
+
+    return py_values;
+}
+
+
+PyObject *
+schema_get_format(MessageSchema *self) {
+    if (self->format) {
+        Py_INCREF(self->format);
+        return self->format;
+    }
+    else
+        Py_RETURN_NONE;
+}
+
+
+PyObject *
+schema_get_size(MessageSchema *self) {
+    return PyLong_FromSsize_t(self->size);
+}
+
+
+PyObject *
+schema_get_field_count(MessageSchema *self) {
+    return PyLong_FromSsize_t(self->field_count);
+}
+
+
+PyObject *
+schema_repr(MessageSchema *self) {
+    if (self->format)
+        return PyUnicode_FromFormat("sysv_ipc.MessageSchema(%R)", self->format);
+    else
+        return PyUnicode_FromString("sysv_ipc.MessageSchema()");
+}
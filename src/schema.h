@@ -0,0 +1,52 @@
+/* A MessageSchema is a struct module format string that's compiled once into
+a list of fields. MessageQueue.send_record() encodes its arguments straight
+into the message buffer and receive_record() decodes them straight out of
+it, so no bytes object is created on either side.
+
+The supported format characters are x c b B ? h H i I l L q Q f d s, with
+repeat counts, and the byte order characters @ = < > ! mean what they mean
+to the struct module. Records are therefore interchangeable with
+struct.pack() and struct.unpack() using the same format.
+*/
+
+typedef struct {
+    char code;
+    Py_ssize_t offset;
+    Py_ssize_t size;            // for 's', the length of the string
+} SchemaField;
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *format;
+    SchemaField *fields;        // pad bytes aren't fields
+    Py_ssize_t field_count;
+    Py_ssize_t size;
+    int little_endian;
+} MessageSchema;
+
+// Other code (e.g. MessageQueue's record_schema) checks its arguments against this
+extern PyTypeObject MessageSchemaType;
+
+/* Object methods */
+PyObject *MessageSchema_new(PyTypeObject *, PyObject *, PyObject *);
+int MessageSchema_init(MessageSchema *, PyObject *, PyObject *);
+void MessageSchema_dealloc(MessageSchema *);
+PyObject *MessageSchema_pack(MessageSchema *, PyObject *);
+PyObject *MessageSchema_unpack(MessageSchema *, PyObject *);
+
+/* Object attributes (read-only) */
+PyObject *schema_get_format(MessageSchema *);
+PyObject *schema_get_size(MessageSchema *);
+PyObject *schema_get_field_count(MessageSchema *);
+
+PyObject *schema_repr(MessageSchema *);
+
+/* Utility functions */
+
+/* Encodes a tuple of field_count values into schema->size bytes at buffer.
+Returns -1 with a Python error set if a value doesn't fit its field. */
+int schema_encode(MessageSchema *, PyObject *, char *);
+
+/* Returns a tuple of the values encoded at buffer, or NULL with a Python
+error set. */
+PyObject *schema_decode(MessageSchema *, const char *);
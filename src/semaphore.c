@@ -3,6 +3,7 @@
 #include "structmember.h"
 
 #include "common.h"
+#include "stats.h"
 #include "semaphore.h"
 
 #define ONE_BILLION 1000000000
@@ -15,32 +16,8 @@ enum SEMOP_TYPE {
     SEMOP_Z
 };
 
-/* Struct to contain a timeout which can be None */
-typedef struct {
-    int is_none;
-    int is_zero;
-    struct timespec timestamp;
-} NoneableTimeout;
-
-
-// It is recommended practice to define this union here in the .c module, but
-// it's been common practice for platforms to define it themselves in header
-// files. For instance, BSD and OS X do so (provisionally) in sem.h. As a
-// result, I need to surround this with an #ifdef. The value _SEM_SEMUN_UNDEFINED
-// is written to system_info.h as necessary.
-#ifdef _SEM_SEMUN_UNDEFINED
-union semun {
-    int val;                    /* used for SETVAL only */
-    struct semid_ds *buf;       /* for IPC_STAT and IPC_SET */
-    unsigned short *array;      /* used for GETALL and SETALL */
-#ifdef __linux__
-	struct seminfo  *__buf;  	/* Buffer for IPC_INFO (Linux-specific) */
-#endif
-};
-#endif
 
-
-static int
+int
 convert_timeout(PyObject *py_timeout, void *converted_timeout) {
     // Converts a PyObject into a timeout if possible. The PyObject should
     // be None or some sort of numeric value (e.g. int, float, etc.)
@@ -103,7 +80,7 @@ sem_repr(Semaphore *self) {
 }
 
 
-static void
+void
 sem_set_error(void) {
     switch (errno) {
         case ENOENT:
@@ -149,6 +126,134 @@ sem_set_error(void) {
 }
 
 
+int
+sem_semop(int id, struct sembuf *ops, size_t op_count, NoneableTimeout *timeout,
+          Semaphore *owner) {
+    /* Performs the ops atomically with the GIL released. Uses semtimedop()
+       if the timeout isn't None and the platform supports it. Records the
+       call in owner's stats if owner isn't NULL. Returns the result of
+       semop() with errno intact; the caller raises the error.
+    */
+    int rc;
+    uint64_t start_ns;
+
+    start_ns = stats_start(owner ? owner->stats : NULL);
+
+    Py_BEGIN_ALLOW_THREADS;
+#ifdef SEMTIMEDOP_EXISTS
+    // Call semtimedop() if appropriate, otherwise call semop()
+    if (timeout && !timeout->is_none) {
+        DPRINTF("calling semtimedop on id %d, %zu op(s), op[0].sem_op=%d, op[0].flags=0x%x\n",
+                id, op_count, ops[0].sem_op, ops[0].sem_flg);
+        DPRINTF("timeout tv_sec = %ld; timeout tv_nsec = %ld\n",
+                timeout->timestamp.tv_sec, timeout->timestamp.tv_nsec);
+        rc = semtimedop(id, ops, op_count, &timeout->timestamp);
+    }
+    else {
+        DPRINTF("calling semop on id %d, %zu op(s), op[0].sem_op = %d, op[0].flags=%x\n",
+                id, op_count, ops[0].sem_op, ops[0].sem_flg);
+        rc = semop(id, ops, op_count);
+    }
+#else
+    // no support for semtimedop(), always call semop() instead.
+    DPRINTF("calling semop on id %d, %zu op(s), op[0].sem_op = %d, op[0].flags=%x\n",
+            id, op_count, ops[0].sem_op, ops[0].sem_flg);
+    rc = semop(id, ops, op_count);
+#endif
+    Py_END_ALLOW_THREADS;
+
+    // While the GIL was released, another thread might have turned stats off
+    // (which frees them) or on, so they're looked up again. A call that
+    // started before stats were on isn't recorded.
+    if (start_ns && owner->stats)
+        stats_record(owner->stats, start_ns, 0, (-1 == rc) ? errno : 0,
+                     timeout && !timeout->is_none);
+
+    return rc;
+}
+
+
+void
+sem_set_op(struct sembuf *op, unsigned short sem_num, short sem_op, short sem_flg) {
+    op->sem_num = sem_num;
+    op->sem_op = sem_op;
+    op->sem_flg = sem_flg;
+}
+
+
+short
+sem_wait_flags(NoneableTimeout *timeout) {
+    // A zero timeout means don't wait at all. IPC_NOWAIT does that even on
+    // platforms without semtimedop().
+    return (!timeout->is_none && timeout->is_zero) ? IPC_NOWAIT : 0;
+}
+
+
+int
+sem_check_flags(NoneableKey *key, int *flags) {
+    /* Checks the key and flags passed to a semaphore constructor and masks
+       the flags down to IPC_CREAT and IPC_EXCL. Returns 0 with a Python
+       error set if they're invalid.
+    */
+    if ( !(*flags & IPC_CREAT) && (*flags & IPC_EXCL) ) {
+		PyErr_SetString(PyExc_ValueError,
+                "IPC_EXCL must be combined with IPC_CREAT");
+        return 0;
+    }
+
+    if (key->is_none && ((*flags & IPC_EXCL) != IPC_EXCL)) {
+		PyErr_SetString(PyExc_ValueError,
+                "Key can only be None if IPC_EXCL is set");
+        return 0;
+    }
+
+    // I mask the caller's flags against the two IPC_* flags to ensure that
+    // nothing funky sneaks into the flags.
+    *flags &= (IPC_CREAT | IPC_EXCL);
+
+    return 1;
+}
+
+
+int
+sem_get_set(NoneableKey *key, int sem_count, int mode, int flags, key_t *p_key) {
+    /* Opens or creates a set of sem_count semaphores. If the key is None,
+       generates keys until one is unused. Returns the set's id, or -1 with
+       a Python error set.
+    */
+    int id;
+
+    // Permissions and flags (i.e. IPC_CREAT | IPC_EXCL) are both crammed
+    // into the 3rd param.
+    if (key->is_none) {
+        // (key == None) ==> generate a key for the caller
+        do {
+            errno = 0;
+            *p_key = get_random_key();
+
+            DPRINTF("Calling semget, key=%ld, nsems=%d, mode=%o, flags=%x\n",
+                        (long)*p_key, sem_count, mode, flags);
+            id = semget(*p_key, sem_count, mode | flags);
+        } while ( (-1 == id) && (EEXIST == errno) );
+    }
+    else {
+        // (key != None) ==> use key supplied by the caller
+        *p_key = key->value;
+
+        DPRINTF("Calling semget, key=%ld, nsems=%d, mode=%o, flags=%x\n",
+                    (long)*p_key, sem_count, mode, flags);
+        id = semget(*p_key, sem_count, mode | flags);
+    }
+
+    DPRINTF("id == %d\n", id);
+
+    if (-1 == id)
+        sem_set_error();
+
+    return id;
+}
+
+
 static PyObject *
 sem_perform_semop(enum SEMOP_TYPE op_type, Semaphore *self, PyObject *args, PyObject *keywords) {
     int rc = 0;
@@ -228,28 +333,7 @@ sem_perform_semop(enum SEMOP_TYPE op_type, Semaphore *self, PyObject *args, PyOb
     op[0].sem_op = delta;
     op[0].sem_flg = self->op_flags;
 
-    Py_BEGIN_ALLOW_THREADS;
-#ifdef SEMTIMEDOP_EXISTS
-    // Call semtimedop() if appropriate, otherwise call semop()
-    if (!timeout.is_none) {
-        DPRINTF("calling semtimedop on id %d, op.sem_op=%d, op.flags=0x%x\n",
-                self->id, op[0].sem_op, op[0].sem_flg);
-        DPRINTF("timeout tv_sec = %ld; timeout tv_nsec = %ld\n",
-                timeout.timestamp.tv_sec, timeout.timestamp.tv_nsec);
-        rc = semtimedop(self->id, op, 1, &timeout.timestamp);
-    }
-    else {
-        DPRINTF("calling semop on id %d, op.sem_op = %d, op.flags=%x\n",
-                self->id, op[0].sem_op, op[0].sem_flg);
-        rc = semop(self->id, op, 1);
-    }
-#else
-    // no support for semtimedop(), always call semop() instead.
-    DPRINTF("calling semop on id %d, op.sem_op = %d, op.flags=%x\n",
-            self->id, op[0].sem_op, op[0].sem_flg);
-    rc = semop(self->id, op, 1);
-#endif
-    Py_END_ALLOW_THREADS;
+    rc = sem_semop(self->id, op, 1, &timeout, self);
 
     if (rc == -1) {
         sem_set_error();
@@ -410,6 +494,7 @@ sem_remove(int id) {
 
 void
 Semaphore_dealloc(Semaphore *self) {
+    stats_free(&self->stats, &self->stats_segment);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
@@ -441,54 +526,15 @@ Semaphore_init(Semaphore *self, PyObject *args, PyObject *keywords) {
 
     DPRINTF("key is none = %d, key value = %ld\n", key.is_none, (long)key.value);
 
-    if ( !(flags & IPC_CREAT) && (flags & IPC_EXCL) ) {
-		PyErr_SetString(PyExc_ValueError,
-                "IPC_EXCL must be combined with IPC_CREAT");
+    if (!sem_check_flags(&key, &flags))
         goto error_return;
-    }
-
-    if (key.is_none && ((flags & IPC_EXCL) != IPC_EXCL)) {
-		PyErr_SetString(PyExc_ValueError,
-                "Key can only be None if IPC_EXCL is set");
-        goto error_return;
-    }
 
     self->op_flags = 0;
 
-    // I mask the caller's flags against the two IPC_* flags to ensure that
-    // nothing funky sneaks into the flags.
-    flags &= (IPC_CREAT | IPC_EXCL);
-
     // Note that Sys V sems can be in "sets" (arrays) but I hardcode this
     // to always be a set with just one member.
-    // Permissions and flags (i.e. IPC_CREAT | IPC_EXCL) are both crammed
-    // into the 3rd param.
-    if (key.is_none) {
-        // (key == None) ==> generate a key for the caller
-        do {
-            errno = 0;
-            self->key = get_random_key();
-
-            DPRINTF("Calling semget, key=%ld, mode=%o, flags=%x\n",
-                        (long)self->key, mode, flags);
-            self->id = semget(self->key, 1, mode | flags);
-        } while ( (-1 == self->id) && (EEXIST == errno) );
-    }
-    else {
-        // (key != None) ==> use key supplied by the caller
-        self->key = key.value;
-
-        DPRINTF("Calling semget, key=%ld, mode=%o, flags=%x\n",
-                    (long)self->key, mode, flags);
-        self->id = semget(self->key, 1, mode | flags);
-    }
-
-    DPRINTF("id == %d\n", self->id);
-
-    if (self->id == -1) {
-        sem_set_error();
+    if (-1 == (self->id = sem_get_set(&key, 1, mode, flags, &self->key)))
         goto error_return;
-    }
 
     // Before attempting to set the initial value, I have to be sure that
     // I created this semaphore and that I have write access to it.
@@ -544,6 +590,44 @@ Semaphore_remove(Semaphore *self) {
     return sem_remove(self->id);
 }
 
+
+PyObject *
+Semaphore_stats(Semaphore *self) {
+    return stats_as_dict(self->stats);
+}
+
+
+PyObject *
+Semaphore_reset_stats(Semaphore *self) {
+    stats_reset(self->stats);
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+Semaphore_share_stats(Semaphore *self, PyObject *args, PyObject *keywords) {
+    NoneableKey key;
+    int mode = 0600;
+    char *keyword_list[ ] = {"key", "mode", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O&|i", keyword_list,
+                                     &convert_key_param, &key, &mode))
+        goto error_return;
+
+    if (key.is_none) {
+        PyErr_SetString(PyExc_ValueError, "The key must not be None");
+        goto error_return;
+    }
+
+    if (-1 == stats_share(&self->stats, &self->stats_segment, key.value, mode))
+        goto error_return;
+
+    Py_RETURN_NONE;
+
+    error_return:
+    return NULL;
+}
+
 PyObject *
 Semaphore_enter(Semaphore *self) {
     PyObject *args = PyTuple_New(0);
@@ -676,6 +760,18 @@ sem_set_undo(Semaphore *self, PyObject *py_value)
 }
 
 
+PyObject *
+sem_get_collect_stats(Semaphore *self) {
+    return stats_get_enabled(self->stats);
+}
+
+
+int
+sem_set_collect_stats(Semaphore *self, PyObject *py_value) {
+    return stats_set_enabled(&self->stats, &self->stats_segment, py_value);
+}
+
+
 PyObject *
 sem_get_uid(Semaphore *self) {
     return sem_get_ipc_perm_value(self->id, SVIFP_IPC_PERM_UID);
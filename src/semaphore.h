@@ -3,8 +3,37 @@ typedef struct {
     key_t key;
     int id;
     short op_flags;
+    IpcStats *stats;
+    void *stats_segment;
 } Semaphore;
 
+// Other code (e.g. wait_any()) checks its arguments against this
+extern PyTypeObject SemaphoreType;
+
+// It is recommended practice to define this union in the .c module, but
+// it's been common practice for platforms to define it themselves in header
+// files. For instance, BSD and OS X do so (provisionally) in sem.h. As a
+// result, I need to surround this with an #ifdef. The value _SEM_SEMUN_UNDEFINED
+// is written to system_info.h as necessary. It lives in this header because
+// rwlock.c needs it too.
+#ifdef _SEM_SEMUN_UNDEFINED
+union semun {
+    int val;                    /* used for SETVAL only */
+    struct semid_ds *buf;       /* for IPC_STAT and IPC_SET */
+    unsigned short *array;      /* used for GETALL and SETALL */
+#ifdef __linux__
+	struct seminfo  *__buf;  	/* Buffer for IPC_INFO (Linux-specific) */
+#endif
+};
+#endif
+
+/* Struct to contain a timeout which can be None */
+typedef struct {
+    int is_none;
+    int is_zero;
+    struct timespec timestamp;
+} NoneableTimeout;
+
 
 /* Object methods */
 PyObject *Semaphore_new(PyTypeObject *type, PyObject *, PyObject *);
@@ -18,6 +47,9 @@ PyObject *Semaphore_V(Semaphore *, PyObject *, PyObject *);
 PyObject *Semaphore_release(Semaphore *, PyObject *, PyObject *);
 PyObject *Semaphore_Z(Semaphore *, PyObject *, PyObject *);
 PyObject *Semaphore_remove(Semaphore *);
+PyObject *Semaphore_stats(Semaphore *);
+PyObject *Semaphore_reset_stats(Semaphore *);
+PyObject *Semaphore_share_stats(Semaphore *, PyObject *, PyObject *);
 
 /* Object attributes (read-write & read-only) */
 PyObject *sem_get_value(Semaphore *);
@@ -32,6 +64,9 @@ int sem_set_mode(Semaphore *, PyObject *);
 PyObject *sem_get_undo(Semaphore *);
 int sem_set_undo(Semaphore *self, PyObject *py_value);
 
+PyObject *sem_get_collect_stats(Semaphore *);
+int sem_set_collect_stats(Semaphore *, PyObject *);
+
 PyObject *sem_get_uid(Semaphore *);
 int sem_set_uid(Semaphore *, PyObject *);
 
@@ -51,3 +86,12 @@ PyObject *sem_repr(Semaphore *);
 
 /* Utility functions */
 PyObject *sem_remove(int);
+
+/* These are shared with the other semaphore-based types (e.g. RWLock) */
+int convert_timeout(PyObject *, void *);
+void sem_set_error(void);
+int sem_semop(int, struct sembuf *, size_t, NoneableTimeout *, Semaphore *);
+int sem_get_set(NoneableKey *, int, int, int, key_t *);
+void sem_set_op(struct sembuf *, unsigned short, short, short);
+int sem_check_flags(NoneableKey *, int *);
+short sem_wait_flags(NoneableTimeout *);
@@ -0,0 +1,845 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "stats.h"
+#include "memory.h"
+#include "snapshot.h"
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/******************    Internal use only     **********************/
+
+static uint64_t
+align_up(uint64_t value, uint64_t alignment) {
+    // alignment must be a power of 2
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+
+static SnapshotHeader *
+get_header(SharedMemory *memory, unsigned long offset) {
+    // Returns the header, or NULL with a Python error set if the segment
+    // isn't usable.
+    if (!memory) {
+        PyErr_SetString(pInternalException, "The object was not initialized");
+        return NULL;
+    }
+
+    if (!memory->address) {
+        PyErr_SetString(pNotAttachedException, "The memory segment is not attached");
+        return NULL;
+    }
+
+    return (SnapshotHeader *)((char *)memory->address + offset);
+}
+
+
+static SnapshotSlot *
+get_slot(SnapshotHeader *header, uint32_t index) {
+    return (SnapshotSlot *)(header + 1) + index;
+}
+
+
+static char *
+get_buffer(SharedMemory *memory, SnapshotHeader *header, uint32_t index) {
+    return (char *)memory->address + header->first_buffer + index * header->stride;
+}
+
+
+static int
+open_snapshots(SharedMemory *memory, unsigned long offset, int init,
+               unsigned long buffers, unsigned long buffer_size) {
+    // Checks (or with init, writes) the header at offset. Returns -1 with a
+    // Python error set on failure.
+    SnapshotHeader *header;
+    unsigned long segment_size;
+    uint64_t first_buffer;
+    uint64_t stride;
+    PyObject *py_size;
+
+    if (!memory->address) {
+        PyErr_SetString(pNotAttachedException, "The memory segment is not attached");
+        return -1;
+    }
+
+    // Readers change the reader counts, so they need write access too.
+    if (memory->read_only) {
+        PyErr_SetString(PyExc_OSError, "Snapshots can't be used in a read-only memory segment");
+        return -1;
+    }
+
+    if (offset % SNAPSHOT_ALIGN) {
+        PyErr_Format(PyExc_ValueError, "The offset must be a multiple of %d", SNAPSHOT_ALIGN);
+        return -1;
+    }
+
+    if ( (py_size = shm_get_size(memory)) ) {
+        segment_size = PyLong_AsUnsignedLongMask(py_size);
+        Py_DECREF(py_size);
+    }
+    else
+        return -1;
+
+    if ((offset >= segment_size) || (segment_size - offset < sizeof(SnapshotHeader))) {
+        PyErr_SetString(PyExc_ValueError, "The offset must leave room for the header in the segment");
+        return -1;
+    }
+
+    header = (SnapshotHeader *)((char *)memory->address + offset);
+
+    if (init) {
+        if ((buffers < SNAPSHOT_MIN_BUFFERS) || (buffers > SNAPSHOT_MAX_BUFFERS)) {
+            PyErr_Format(PyExc_ValueError, "The number of buffers must be between %d and %d",
+                         SNAPSHOT_MIN_BUFFERS, SNAPSHOT_MAX_BUFFERS);
+            return -1;
+        }
+
+        first_buffer = align_up(offset + sizeof(SnapshotHeader) + buffers * sizeof(SnapshotSlot),
+                                SNAPSHOT_ALIGN);
+        if (first_buffer >= segment_size) {
+            PyErr_SetString(PyExc_ValueError, "The segment is too small for that many buffers");
+            return -1;
+        }
+
+        // By default, the buffers share whatever space is left.
+        if (!buffer_size)
+            buffer_size = ((segment_size - first_buffer) / buffers) & ~(SNAPSHOT_ALIGN - 1);
+
+        if ((!buffer_size) || (buffer_size > segment_size - first_buffer)) {
+            PyErr_SetString(PyExc_ValueError, "The buffers must fit within the segment");
+            return -1;
+        }
+
+        stride = align_up(buffer_size, SNAPSHOT_ALIGN);
+
+        if (stride > (segment_size - first_buffer) / buffers) {
+            PyErr_SetString(PyExc_ValueError, "The buffers must fit within the segment");
+            return -1;
+        }
+
+        memset(header, 0, first_buffer - offset);
+        header->version = SNAPSHOT_VERSION;
+        header->buffer_count = (uint32_t)buffers;
+        header->buffer_size = buffer_size;
+        header->first_buffer = first_buffer;
+        header->stride = stride;
+        // The magic goes in last so that no other process uses the buffers
+        // until the header is complete.
+        __atomic_store_n(&header->magic, SNAPSHOT_MAGIC, __ATOMIC_RELEASE);
+    }
+    else {
+        if (SNAPSHOT_MAGIC != __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE)) {
+            PyErr_Format(PyExc_ValueError, "There are no snapshot buffers at offset %lu", offset);
+            return -1;
+        }
+
+        if (SNAPSHOT_VERSION != header->version) {
+            PyErr_Format(PyExc_ValueError, "Unsupported snapshot version %u",
+                         (unsigned int)header->version);
+            return -1;
+        }
+
+        if ((header->buffer_count < SNAPSHOT_MIN_BUFFERS) ||
+            (header->buffer_count > SNAPSHOT_MAX_BUFFERS) ||
+            (header->first_buffer < offset + sizeof(SnapshotHeader) +
+                                    header->buffer_count * sizeof(SnapshotSlot)) ||
+            (header->first_buffer > segment_size) ||
+            (header->stride < header->buffer_size) ||
+            (header->stride > (segment_size - header->first_buffer) / header->buffer_count)) {
+            PyErr_SetString(PyExc_ValueError, "The snapshot buffers don't fit in the segment");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+lock_writer(SnapshotHeader *header) {
+    // Claims the writer word for this process. Returns -1 with a Python
+    // error set if another publisher is writing.
+    uint32_t me = (uint32_t)getpid();
+    uint32_t owner = 0;
+
+    if (__atomic_compare_exchange_n(&header->writer, &owner, me, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return 0;
+
+    // If the publisher that was writing is gone, take over from it.
+    if ((owner != me) && (-1 == kill((pid_t)owner, 0)) && (ESRCH == errno)) {
+        DPRINTF("taking over snapshot writer %u\n", owner);
+        if (__atomic_compare_exchange_n(&header->writer, &owner, me, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return 0;
+    }
+
+    PyErr_SetString(pBusyException, "Another publisher is writing a snapshot");
+    return -1;
+}
+
+
+static void
+unlock_writer(SnapshotHeader *header) {
+    __atomic_store_n(&header->writer, 0, __ATOMIC_RELEASE);
+}
+
+
+static int
+choose_buffer(SnapshotHeader *header, uint32_t *p_index) {
+    // Picks the buffer to write the next snapshot into: the oldest one that
+    // isn't published and that no reader has pinned. The caller must hold
+    // the writer word. Returns -1 with a Python error set if there's none.
+    uint64_t current = __atomic_load_n(&header->current, __ATOMIC_SEQ_CST);
+    uint64_t oldest = UINT64_MAX;
+    SnapshotSlot *slot;
+    uint32_t i;
+    int found = 0;
+
+    for (i = 0; i < header->buffer_count; i++) {
+        if (current && (i == (current & SNAPSHOT_INDEX_MASK)))
+            continue;
+
+        slot = get_slot(header, i);
+
+        // This load is ordered after the store that unpublished the buffer,
+        // so a reader that pinned it after that has seen it's unpublished.
+        if (__atomic_load_n(&slot->readers, __ATOMIC_SEQ_CST))
+            continue;
+
+        if (slot->sequence < oldest) {
+            oldest = slot->sequence;
+            *p_index = i;
+            found = 1;
+        }
+    }
+
+    if (!found) {
+        PyErr_SetString(pBusyException, "Every unpublished buffer is in use by a reader");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static uint64_t
+publish_buffer(SnapshotHeader *header, uint32_t index, uint64_t length) {
+    // Publishes the buffer and releases the writer word. Returns the new
+    // snapshot's sequence number.
+    SnapshotSlot *slot = get_slot(header, index);
+    uint64_t sequence;
+
+    sequence = (__atomic_load_n(&header->current, __ATOMIC_RELAXED) >> SNAPSHOT_INDEX_BITS) + 1;
+
+    slot->length = length;
+    slot->sequence = sequence;
+
+    __atomic_store_n(&header->current, (sequence << SNAPSHOT_INDEX_BITS) | index,
+                     __ATOMIC_SEQ_CST);
+
+    unlock_writer(header);
+
+    return sequence;
+}
+
+
+static int
+check_open(Snapshot *self) {
+    // Returns -1 with a Python error set if the snapshot can't be accessed.
+    if (!self->memory) {
+        PyErr_SetString(PyExc_ValueError, "The snapshot has been released");
+        return -1;
+    }
+
+    if (!self->memory->address) {
+        PyErr_SetString(pNotAttachedException, "The snapshot's memory segment is not attached");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static Snapshot *
+new_snapshot(SharedMemory *memory, unsigned long offset, uint32_t index,
+             uint64_t sequence, uint64_t length) {
+    Snapshot *snapshot;
+
+    snapshot = (Snapshot *)SnapshotType.tp_alloc(&SnapshotType, 0);
+    if (!snapshot)
+        return NULL;
+
+    Py_INCREF(memory);
+    snapshot->memory = memory;
+    snapshot->publisher = NULL;
+    snapshot->offset = offset;
+    snapshot->index = index;
+    snapshot->sequence = sequence;
+    snapshot->length = length;
+    snapshot->pid = getpid();
+    snapshot->exports = 0;
+
+    return snapshot;
+}
+
+
+static void
+end_draft(Snapshot *draft) {
+    // Detaches a draft from its publisher and marks it released.
+    SnapshotPublisher *publisher = draft->publisher;
+
+    publisher->draft = NULL;
+    draft->publisher = NULL;
+    Py_CLEAR(draft->memory);
+    Py_DECREF(publisher);
+}
+
+
+/******************    SnapshotPublisher     **********************/
+
+PyObject *
+SnapshotPublisher_new(PyTypeObject *type, PyObject *args, PyObject *kwlist) {
+    SnapshotPublisher *self;
+
+    self = (SnapshotPublisher *)type->tp_alloc(type, 0);
+
+    if (NULL != self) {
+        self->memory = NULL;
+        self->offset = 0;
+        self->draft = NULL;
+    }
+
+    return (PyObject *)self;
+}
+
+
+int
+SnapshotPublisher_init(SnapshotPublisher *self, PyObject *args, PyObject *keywords) {
+    SharedMemory *memory;
+    unsigned long offset = 0;
+    unsigned long buffers = SNAPSHOT_MIN_BUFFERS;
+    unsigned long buffer_size = 0;
+    int init = 0;
+    char *keyword_list[ ] = {"memory", "offset", "buffers", "buffer_size", "init", NULL};
+
+    // SnapshotPublisher(memory, [offset = 0, [buffers = 2, [buffer_size = 0, [init = False]]]])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O!|kkkp", keyword_list,
+                                     &SharedMemoryType, &memory,
+                                     &offset, &buffers, &buffer_size, &init))
+        goto error_return;
+
+    if (self->draft) {
+        PyErr_SetString(PyExc_ValueError, "A snapshot is being written");
+        goto error_return;
+    }
+
+    if (-1 == open_snapshots(memory, offset, init, buffers, buffer_size))
+        goto error_return;
+
+    Py_INCREF(memory);
+    Py_XSETREF(self->memory, memory);
+    self->offset = offset;
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+
+void
+SnapshotPublisher_dealloc(SnapshotPublisher *self) {
+    // A draft holds a reference to its publisher, so there's none here.
+    Py_XDECREF(self->memory);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+SnapshotPublisher_begin(SnapshotPublisher *self) {
+    SnapshotHeader *header;
+    Snapshot *draft;
+    uint32_t index;
+
+    if (!(header = get_header(self->memory, self->offset)))
+        return NULL;
+
+    if (self->draft) {
+        PyErr_SetString(PyExc_ValueError, "begin() has already been called");
+        return NULL;
+    }
+
+    if (-1 == lock_writer(header))
+        return NULL;
+
+    if (-1 == choose_buffer(header, &index))
+        goto error_return;
+
+    DPRINTF("writing snapshot into buffer %u\n", index);
+
+    if (!(draft = new_snapshot(self->memory, self->offset, index, 0, header->buffer_size)))
+        goto error_return;
+
+    Py_INCREF(self);
+    draft->publisher = self;
+    self->draft = draft;
+
+    return (PyObject *)draft;
+
+    error_return:
+    unlock_writer(header);
+    return NULL;
+}
+
+
+PyObject *
+SnapshotPublisher_commit(SnapshotPublisher *self, PyObject *args, PyObject *keywords) {
+    SnapshotHeader *header;
+    Snapshot *draft = self->draft;
+    PyObject *py_length = Py_None;
+    Py_ssize_t length;
+    uint64_t sequence;
+    char *keyword_list[ ] = {"length", NULL};
+
+    // commit([length = None])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "|O", keyword_list, &py_length))
+        return NULL;
+
+    if (!draft) {
+        PyErr_SetString(PyExc_ValueError, "begin() hasn't been called");
+        return NULL;
+    }
+
+    if (-1 == check_open(draft))
+        return NULL;
+
+    header = get_header(self->memory, self->offset);
+
+    if (draft->pid != getpid()) {
+        PyErr_SetString(PyExc_ValueError, "begin() was called in another process");
+        return NULL;
+    }
+
+    if (draft->exports) {
+        PyErr_SetString(PyExc_BufferError,
+                "The snapshot can't be committed while its buffer is in use");
+        return NULL;
+    }
+
+    if (py_length == Py_None)
+        length = (Py_ssize_t)header->buffer_size;
+    else {
+        length = PyLong_AsSsize_t(py_length);
+        if ((-1 == length) && PyErr_Occurred())
+            return NULL;
+        if ((length < 0) || ((uint64_t)length > header->buffer_size)) {
+            PyErr_SetString(PyExc_ValueError, "The length must be between 0 and buffer_size");
+            return NULL;
+        }
+    }
+
+    sequence = publish_buffer(header, draft->index, (uint64_t)length);
+
+    draft->sequence = sequence;
+    draft->length = (uint64_t)length;
+    end_draft(draft);
+
+    return PyLong_FromUnsignedLongLong(sequence);
+}
+
+
+PyObject *
+SnapshotPublisher_abort(SnapshotPublisher *self) {
+    if (!self->draft)
+        Py_RETURN_NONE;
+
+    return Snapshot_release(self->draft);
+}
+
+
+PyObject *
+SnapshotPublisher_publish(SnapshotPublisher *self, PyObject *args, PyObject *keywords) {
+    SnapshotHeader *header;
+    Py_buffer data;
+    uint32_t index;
+    uint64_t sequence;
+    char *keyword_list[ ] = {"data", NULL};
+
+    // publish(data)
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "y*", keyword_list, &data))
+        return NULL;
+
+    if (!(header = get_header(self->memory, self->offset)))
+        goto error_return;
+
+    if (self->draft) {
+        PyErr_SetString(PyExc_ValueError, "begin() has already been called");
+        goto error_return;
+    }
+
+    if ((uint64_t)data.len > header->buffer_size) {
+        PyErr_Format(PyExc_ValueError, "The data is larger than buffer_size (%llu)",
+                     (unsigned long long)header->buffer_size);
+        goto error_return;
+    }
+
+    if (-1 == lock_writer(header))
+        goto error_return;
+
+    if (-1 == choose_buffer(header, &index)) {
+        unlock_writer(header);
+        goto error_return;
+    }
+
+    shm_copy(self->memory, get_buffer(self->memory, header, index), data.buf, data.len);
+
+    sequence = publish_buffer(header, index, (uint64_t)data.len);
+
+    PyBuffer_Release(&data);
+
+    return PyLong_FromUnsignedLongLong(sequence);
+
+    error_return:
+    PyBuffer_Release(&data);
+    return NULL;
+}
+
+
+PyObject *
+publisher_get_memory(SnapshotPublisher *self) {
+    if (self->memory) {
+        Py_INCREF(self->memory);
+        return (PyObject *)self->memory;
+    }
+    else
+        Py_RETURN_NONE;
+}
+
+
+PyObject *
+publisher_get_buffers(SnapshotPublisher *self) {
+    SnapshotHeader *header;
+
+    if (!(header = get_header(self->memory, self->offset)))
+        return NULL;
+
+    return PyLong_FromUnsignedLong(header->buffer_count);
+}
+
+
+PyObject *
+publisher_get_buffer_size(SnapshotPublisher *self) {
+    SnapshotHeader *header;
+
+    if (!(header = get_header(self->memory, self->offset)))
+        return NULL;
+
+    return PyLong_FromUnsignedLongLong(header->buffer_size);
+}
+
+
+PyObject *
+publisher_get_sequence(SnapshotPublisher *self) {
+    SnapshotHeader *header;
+
+    if (!(header = get_header(self->memory, self->offset)))
+        return NULL;
+
+    return PyLong_FromUnsignedLongLong(
+        __atomic_load_n(&header->current, __ATOMIC_ACQUIRE) >> SNAPSHOT_INDEX_BITS);
+}
+
+
+/******************    SnapshotReader     **********************/
+
+PyObject *
+SnapshotReader_new(PyTypeObject *type, PyObject *args, PyObject *kwlist) {
+    SnapshotReader *self;
+
+    self = (SnapshotReader *)type->tp_alloc(type, 0);
+
+    if (NULL != self) {
+        self->memory = NULL;
+        self->offset = 0;
+    }
+
+    return (PyObject *)self;
+}
+
+
+int
+SnapshotReader_init(SnapshotReader *self, PyObject *args, PyObject *keywords) {
+    SharedMemory *memory;
+    unsigned long offset = 0;
+    char *keyword_list[ ] = {"memory", "offset", NULL};
+
+    // SnapshotReader(memory, [offset = 0])
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O!|k", keyword_list,
+                                     &SharedMemoryType, &memory, &offset))
+        goto error_return;
+
+    if (-1 == open_snapshots(memory, offset, 0, 0, 0))
+        goto error_return;
+
+    Py_INCREF(memory);
+    Py_XSETREF(self->memory, memory);
+    self->offset = offset;
+
+    return 0;
+
+    error_return:
+    return -1;
+}
+
+
+void
+SnapshotReader_dealloc(SnapshotReader *self) {
+    Py_XDECREF(self->memory);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+SnapshotReader_acquire(SnapshotReader *self) {
+    SnapshotHeader *header;
+    SnapshotSlot *slot;
+    Snapshot *snapshot;
+    uint64_t current;
+    uint32_t index;
+
+    if (!(header = get_header(self->memory, self->offset)))
+        return NULL;
+
+    for (;;) {
+        current = __atomic_load_n(&header->current, __ATOMIC_SEQ_CST);
+        if (!current)
+            Py_RETURN_NONE;
+
+        index = current & SNAPSHOT_INDEX_MASK;
+        slot = get_slot(header, index);
+
+        __atomic_fetch_add(&slot->readers, 1, __ATOMIC_SEQ_CST);
+
+        // If the buffer is still published, the publisher will see the pin
+        // before it chooses this buffer again.
+        if (index == (__atomic_load_n(&header->current, __ATOMIC_SEQ_CST) & SNAPSHOT_INDEX_MASK))
+            break;
+
+        __atomic_fetch_sub(&slot->readers, 1, __ATOMIC_SEQ_CST);
+    }
+
+    snapshot = new_snapshot(self->memory, self->offset, index, slot->sequence, slot->length);
+    if (!snapshot)
+        __atomic_fetch_sub(&slot->readers, 1, __ATOMIC_SEQ_CST);
+
+    return (PyObject *)snapshot;
+}
+
+
+PyObject *
+snapshot_reader_get_memory(SnapshotReader *self) {
+    if (self->memory) {
+        Py_INCREF(self->memory);
+        return (PyObject *)self->memory;
+    }
+    else
+        Py_RETURN_NONE;
+}
+
+
+PyObject *
+snapshot_reader_get_buffers(SnapshotReader *self) {
+    SnapshotHeader *header;
+
+    if (!(header = get_header(self->memory, self->offset)))
+        return NULL;
+
+    return PyLong_FromUnsignedLong(header->buffer_count);
+}
+
+
+PyObject *
+snapshot_reader_get_buffer_size(SnapshotReader *self) {
+    SnapshotHeader *header;
+
+    if (!(header = get_header(self->memory, self->offset)))
+        return NULL;
+
+    return PyLong_FromUnsignedLongLong(header->buffer_size);
+}
+
+
+PyObject *
+snapshot_reader_get_sequence(SnapshotReader *self) {
+    SnapshotHeader *header;
+
+    if (!(header = get_header(self->memory, self->offset)))
+        return NULL;
+
+    return PyLong_FromUnsignedLongLong(
+        __atomic_load_n(&header->current, __ATOMIC_ACQUIRE) >> SNAPSHOT_INDEX_BITS);
+}
+
+
+/******************    Snapshot     **********************/
+
+void
+Snapshot_dealloc(Snapshot *self) {
+    PyObject *rc;
+
+    if (self->memory) {
+        if ((rc = Snapshot_release(self)))
+            Py_DECREF(rc);
+        else
+            PyErr_WriteUnraisable((PyObject *)self);
+    }
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+Snapshot_release(Snapshot *self) {
+    SnapshotHeader *header;
+
+    if (!self->memory)
+        Py_RETURN_NONE;
+
+    if (self->exports) {
+        PyErr_SetString(PyExc_BufferError,
+                "The snapshot can't be released while its buffer is in use");
+        return NULL;
+    }
+
+    if (-1 == check_open(self)) {
+        // The pin (or writer word) can't be given back, but the object is
+        // done with either way.
+        if (self->publisher)
+            end_draft(self);
+        else
+            Py_CLEAR(self->memory);
+        return NULL;
+    }
+
+    header = (SnapshotHeader *)((char *)self->memory->address + self->offset);
+
+    // A child process inherits the object but not the pin or writer word.
+    if (self->pid == getpid()) {
+        if (self->publisher)
+            unlock_writer(header);
+        else
+            __atomic_fetch_sub(&get_slot(header, self->index)->readers, 1, __ATOMIC_SEQ_CST);
+    }
+
+    if (self->publisher)
+        end_draft(self);
+    else
+        Py_CLEAR(self->memory);
+
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+Snapshot_tobytes(Snapshot *self) {
+    SnapshotHeader *header;
+    PyObject *py_bytes;
+
+    if (-1 == check_open(self))
+        return NULL;
+
+    header = (SnapshotHeader *)((char *)self->memory->address + self->offset);
+
+    if (!(py_bytes = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)self->length)))
+        return NULL;
+
+    shm_copy(self->memory, PyBytes_AS_STRING(py_bytes),
+             get_buffer(self->memory, header, self->index), self->length);
+
+    return py_bytes;
+}
+
+
+PyObject *
+Snapshot_enter(Snapshot *self) {
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
+
+
+PyObject *
+Snapshot_exit(Snapshot *self, PyObject *args) {
+    return Snapshot_release(self);
+}
+
+
+int
+snapshot_get_buffer(Snapshot *self, Py_buffer *view, int flags) {
+    // Implementation of buffer interface (getbufferproc). Only a draft is
+    // writable.
+    SnapshotHeader *header;
+
+    if (-1 == check_open(self)) {
+        view->obj = NULL;
+        return -1;
+    }
+
+    header = (SnapshotHeader *)((char *)self->memory->address + self->offset);
+
+    if (-1 == PyBuffer_FillInfo(view,
+                                (PyObject *)self,
+                                get_buffer(self->memory, header, self->index),
+                                (Py_ssize_t)self->length,
+                                !self->publisher,
+                                flags))
+        return -1;
+
+    self->exports++;
+
+    return 0;
+}
+
+
+void
+snapshot_release_buffer(Snapshot *self, Py_buffer *view) {
+    self->exports--;
+}
+
+
+Py_ssize_t
+snapshot_length(Snapshot *self) {
+    return (Py_ssize_t)self->length;
+}
+
+
+PyObject *
+snapshot_get_sequence(Snapshot *self) {
+    if (self->publisher)
+        Py_RETURN_NONE;
+
+    return PyLong_FromUnsignedLongLong(self->sequence);
+}
+
+
+PyObject *
+snapshot_get_released(Snapshot *self) {
+    return PyBool_FromLong(!self->memory);
+}
+
+
+PyObject *
+snapshot_repr(Snapshot *self) {
+    if (self->publisher)
+        return PyUnicode_FromFormat("<sysv_ipc.Snapshot draft, length=%llu>",
+                                    (unsigned long long)self->length);
+
+    return PyUnicode_FromFormat("<sysv_ipc.Snapshot sequence=%llu, length=%llu%s>",
+                                (unsigned long long)self->sequence,
+                                (unsigned long long)self->length,
+                                self->memory ? "" : ", released");
+}
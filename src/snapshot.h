@@ -0,0 +1,136 @@
+#include <stdint.h>
+#include <sys/types.h>
+
+/* A SnapshotPublisher publishes successive versions (snapshots) of a blob to
+SnapshotReaders in other processes through a SharedMemory segment, without
+readers ever seeing a half-written version.
+
+The segment holds a header, one slot per buffer and two or more buffers of
+the same size. The publisher writes a new snapshot into a buffer that isn't
+the published one and then publishes it by storing the buffer's index and
+the snapshot's sequence number in the header's current word, which is a
+single atomic store. The sequence number is 0 until something is published.
+
+A reader pins the published buffer by incrementing its slot's reader count
+and then checks that the buffer is still the published one; if not, it
+unpins it and tries again. The publisher only writes into a buffer that
+isn't published and has no readers, and it checks for readers after the
+buffer stopped being published, so it and a reader can't both succeed. A
+reader never waits for the publisher. The publisher never waits for
+readers either: if every unpublished buffer is pinned, begin() raises
+BusyError, so readers that hold snapshots for a long time need more
+buffers.
+
+Each slot has a cache line to itself so that readers pinning one buffer
+don't slow down readers of another. The writer word holds the pid of the
+publisher between begin() and commit(), so only one publisher writes at a
+time; a publisher that dies in between is taken over.
+*/
+
+#define SNAPSHOT_MAGIC 0x50414e53        // "SNAP" in little-endian ASCII
+#define SNAPSHOT_VERSION 1
+
+#define SNAPSHOT_ALIGN 64
+#define SNAPSHOT_INDEX_BITS 8
+#define SNAPSHOT_INDEX_MASK ((1 << SNAPSHOT_INDEX_BITS) - 1)
+#define SNAPSHOT_MIN_BUFFERS 2
+#define SNAPSHOT_MAX_BUFFERS SNAPSHOT_INDEX_MASK
+
+/* The header is at the publisher's offset in the segment. The slots follow
+it, and the buffers start at first_buffer, stride bytes apart. All offsets
+are from the start of the segment.
+*/
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t buffer_count;
+    uint32_t writer;
+    uint64_t buffer_size;
+    uint64_t current;           // (sequence << SNAPSHOT_INDEX_BITS) | index
+    uint64_t first_buffer;
+    uint64_t stride;
+    uint8_t reserved[16];
+} SnapshotHeader;
+
+typedef struct {
+    uint32_t readers;
+    uint32_t reserved;
+    uint64_t sequence;          // of the snapshot in this buffer
+    uint64_t length;            // bytes of the buffer that the snapshot uses
+    uint8_t padding[40];
+} SnapshotSlot;
+
+struct SnapshotPublisher;
+
+typedef struct {
+    PyObject_HEAD
+    SharedMemory *memory;       // NULL after release()
+    struct SnapshotPublisher *publisher;    // set if this is a draft
+    unsigned long offset;       // of the header
+    uint32_t index;
+    uint64_t sequence;          // 0 for a draft
+    uint64_t length;
+    pid_t pid;                  // the process that pinned the buffer
+    Py_ssize_t exports;
+} Snapshot;
+
+typedef struct SnapshotPublisher {
+    PyObject_HEAD
+    SharedMemory *memory;
+    unsigned long offset;
+    Snapshot *draft;            // borrowed; the draft holds a reference to us
+} SnapshotPublisher;
+
+typedef struct {
+    PyObject_HEAD
+    SharedMemory *memory;
+    unsigned long offset;
+} SnapshotReader;
+
+// SnapshotPublisher.begin() and SnapshotReader.acquire() create these
+extern PyTypeObject SnapshotType;
+
+/* SnapshotPublisher methods */
+PyObject *SnapshotPublisher_new(PyTypeObject *, PyObject *, PyObject *);
+int SnapshotPublisher_init(SnapshotPublisher *, PyObject *, PyObject *);
+void SnapshotPublisher_dealloc(SnapshotPublisher *);
+PyObject *SnapshotPublisher_begin(SnapshotPublisher *);
+PyObject *SnapshotPublisher_commit(SnapshotPublisher *, PyObject *, PyObject *);
+PyObject *SnapshotPublisher_abort(SnapshotPublisher *);
+PyObject *SnapshotPublisher_publish(SnapshotPublisher *, PyObject *, PyObject *);
+
+/* SnapshotPublisher attributes (read-only) */
+PyObject *publisher_get_memory(SnapshotPublisher *);
+PyObject *publisher_get_buffers(SnapshotPublisher *);
+PyObject *publisher_get_buffer_size(SnapshotPublisher *);
+PyObject *publisher_get_sequence(SnapshotPublisher *);
+
+/* SnapshotReader methods */
+PyObject *SnapshotReader_new(PyTypeObject *, PyObject *, PyObject *);
+int SnapshotReader_init(SnapshotReader *, PyObject *, PyObject *);
+void SnapshotReader_dealloc(SnapshotReader *);
+PyObject *SnapshotReader_acquire(SnapshotReader *);
+
+/* SnapshotReader attributes (read-only) */
+PyObject *snapshot_reader_get_memory(SnapshotReader *);
+PyObject *snapshot_reader_get_buffers(SnapshotReader *);
+PyObject *snapshot_reader_get_buffer_size(SnapshotReader *);
+PyObject *snapshot_reader_get_sequence(SnapshotReader *);
+
+/* Snapshot methods */
+void Snapshot_dealloc(Snapshot *);
+PyObject *Snapshot_release(Snapshot *);
+PyObject *Snapshot_tobytes(Snapshot *);
+PyObject *Snapshot_enter(Snapshot *);
+PyObject *Snapshot_exit(Snapshot *, PyObject *);
+
+/* Snapshot buffer and sequence implementation */
+int snapshot_get_buffer(Snapshot *, Py_buffer *, int);
+void snapshot_release_buffer(Snapshot *, Py_buffer *);
+Py_ssize_t snapshot_length(Snapshot *);
+
+/* Snapshot attributes (read-only) */
+PyObject *snapshot_get_sequence(Snapshot *);
+PyObject *snapshot_get_released(Snapshot *);
+
+PyObject *snapshot_repr(Snapshot *);
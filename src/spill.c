@@ -0,0 +1,249 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "stats.h"
+#include "memory.h"
+#include "arena.h"
+#include "spill.h"
+
+#include <string.h>
+
+// Spilled payloads are aligned for the benefit of receivers that hand the
+// buffer to something like numpy.
+#define SPILL_ALIGN 64
+
+
+/******************    Internal use only     **********************/
+
+static int
+check_open(SpilledMessage *self) {
+    // Returns -1 with a Python error set if the message can't be accessed.
+    if (!self->arena) {
+        PyErr_SetString(PyExc_ValueError, "The message has been released");
+        return -1;
+    }
+
+    if (!self->arena->memory->address) {
+        PyErr_SetString(pNotAttachedException, "The arena's memory segment is not attached");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/******************    Utility functions     **********************/
+
+int
+spill_write(SharedArena *arena, const void *payload, Py_ssize_t length,
+            SpillDescriptor *descriptor) {
+    uint64_t offset;
+
+    if (!(offset = arena_alloc(arena, (uint64_t)length, SPILL_ALIGN)))
+        return -1;
+
+    if (-1 == arena_generation(arena, offset, &descriptor->generation, NULL)) {
+        arena_free(arena, offset);
+        return -1;
+    }
+
+    shm_copy(arena->memory, (char *)arena->memory->address + offset, payload, length);
+
+    descriptor->shm_id = arena->memory->id;
+    descriptor->arena_offset = arena->offset;
+    descriptor->offset = offset;
+    descriptor->length = (uint64_t)length;
+
+    return 0;
+}
+
+
+void
+spill_discard(SharedArena *arena, SpillDescriptor *descriptor) {
+    PyObject *type, *value, *traceback;
+
+    // The caller is already reporting an error, so it takes precedence.
+    PyErr_Fetch(&type, &value, &traceback);
+    if (-1 == arena_free(arena, descriptor->offset))
+        PyErr_Clear();
+    PyErr_Restore(type, value, traceback);
+}
+
+
+PyObject *
+spill_open(SharedArena *arena, SpillDescriptor *descriptor) {
+    SpilledMessage *message;
+    uint32_t generation;
+    uint64_t capacity;
+
+    if ((descriptor->shm_id != arena->memory->id) ||
+        (descriptor->arena_offset != arena->offset)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "The message was spilled to a different arena");
+        return NULL;
+    }
+
+    if (-1 == arena_generation(arena, descriptor->offset, &generation, &capacity))
+        return NULL;
+
+    if (generation != descriptor->generation) {
+        PyErr_SetString(PyExc_ValueError,
+                        "The message's block has already been released");
+        return NULL;
+    }
+
+    // The block's size, not the descriptor, bounds what the message can see.
+    if ((descriptor->length > capacity) || (descriptor->length > PY_SSIZE_T_MAX)) {
+        PyErr_SetString(PyExc_ValueError, "The message's length is invalid");
+        return NULL;
+    }
+
+    message = (SpilledMessage *)SpilledMessageType.tp_alloc(&SpilledMessageType, 0);
+    if (!message)
+        return NULL;
+
+    Py_INCREF(arena);
+    message->arena = arena;
+    message->offset = descriptor->offset;
+    message->length = descriptor->length;
+    message->generation = descriptor->generation;
+    message->exports = 0;
+
+    return (PyObject *)message;
+}
+
+
+/******************    Exposed methods     **********************/
+
+void
+SpilledMessage_dealloc(SpilledMessage *self) {
+    PyObject *rc;
+
+    if (self->arena) {
+        if ((rc = SpilledMessage_release(self)))
+            Py_DECREF(rc);
+        else
+            PyErr_WriteUnraisable((PyObject *)self);
+    }
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+PyObject *
+SpilledMessage_release(SpilledMessage *self) {
+    SharedArena *arena = self->arena;
+    uint32_t generation;
+
+    if (!arena)
+        Py_RETURN_NONE;
+
+    if (self->exports) {
+        PyErr_SetString(PyExc_BufferError,
+                "The message can't be released while its buffer is in use");
+        return NULL;
+    }
+
+    self->arena = NULL;
+
+    if (-1 == arena_generation(arena, self->offset, &generation, NULL))
+        goto error_return;
+
+    // If the block's generation has changed, someone else freed it and it
+    // might already belong to another message, so it must not be freed.
+    if (generation != self->generation) {
+        PyErr_SetString(PyExc_ValueError,
+                        "The message's block has already been released");
+        goto error_return;
+    }
+
+    if (-1 == arena_free(arena, self->offset))
+        goto error_return;
+
+    Py_DECREF(arena);
+    Py_RETURN_NONE;
+
+    error_return:
+    Py_DECREF(arena);
+    return NULL;
+}
+
+
+PyObject *
+SpilledMessage_tobytes(SpilledMessage *self) {
+    PyObject *py_bytes;
+
+    if (-1 == check_open(self))
+        return NULL;
+
+    if (!(py_bytes = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)self->length)))
+        return NULL;
+
+    shm_copy(self->arena->memory, PyBytes_AS_STRING(py_bytes),
+             (char *)self->arena->memory->address + self->offset, self->length);
+
+    return py_bytes;
+}
+
+
+PyObject *
+SpilledMessage_enter(SpilledMessage *self) {
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
+
+
+PyObject *
+SpilledMessage_exit(SpilledMessage *self, PyObject *args) {
+    return SpilledMessage_release(self);
+}
+
+
+int
+spill_get_buffer(SpilledMessage *self, Py_buffer *view, int flags) {
+    // Implementation of buffer interface (getbufferproc).
+    if (-1 == check_open(self)) {
+        view->obj = NULL;
+        return -1;
+    }
+
+    if (-1 == PyBuffer_FillInfo(view,
+                                (PyObject *)self,
+                                (char *)self->arena->memory->address + self->offset,
+                                (Py_ssize_t)self->length,
+                                self->arena->memory->read_only,
+                                flags))
+        return -1;
+
+    self->exports++;
+
+    return 0;
+}
+
+
+void
+spill_release_buffer(SpilledMessage *self, Py_buffer *view) {
+    self->exports--;
+}
+
+
+Py_ssize_t
+spill_length(SpilledMessage *self) {
+    return (Py_ssize_t)self->length;
+}
+
+
+PyObject *
+spill_get_released(SpilledMessage *self) {
+    return PyBool_FromLong(!self->arena);
+}
+
+
+PyObject *
+spill_repr(SpilledMessage *self) {
+    return PyUnicode_FromFormat("<sysv_ipc.SpilledMessage offset=%llu, length=%llu%s>",
+                                (unsigned long long)self->offset,
+                                (unsigned long long)self->length,
+                                self->arena ? "" : ", released");
+}
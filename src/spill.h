@@ -0,0 +1,75 @@
+#include <stdint.h>
+
+/* Spilling lets a MessageQueue carry payloads that are too big for a System
+V message. When a queue has a spill_arena, every message it sends starts
+with a one-byte frame type:
+
+  - SPILL_FRAME_INLINE is followed by the payload, as usual.
+  - SPILL_FRAME_SPILLED is followed by a SpillDescriptor. The payload is in a
+    block allocated from the SharedArena that the descriptor identifies.
+
+Because of the frame byte, every process that uses the queue must turn
+spilling on (with the same arena); a process without it would see frame
+bytes and descriptors instead of payloads.
+
+The receiver gets a SpilledMessage, which exposes the block through the
+buffer protocol without copying it and frees the block when it's released.
+The descriptor carries the block's generation so that a receiver never
+frees a block that was already freed and reused.
+*/
+
+#define SPILL_FRAME_INLINE 0
+#define SPILL_FRAME_SPILLED 1
+
+// Descriptors are copied in and out with memcpy() because they follow the
+// frame byte and aren't aligned.
+typedef struct {
+    int32_t shm_id;
+    uint32_t generation;
+    uint64_t arena_offset;
+    uint64_t offset;
+    uint64_t length;
+} SpillDescriptor;
+
+typedef struct {
+    PyObject_HEAD
+    SharedArena *arena;         // NULL after release()
+    uint64_t offset;
+    uint64_t length;
+    uint32_t generation;
+    Py_ssize_t exports;
+} SpilledMessage;
+
+// mq.c creates these
+extern PyTypeObject SpilledMessageType;
+
+/* Object methods */
+void SpilledMessage_dealloc(SpilledMessage *);
+PyObject *SpilledMessage_release(SpilledMessage *);
+PyObject *SpilledMessage_tobytes(SpilledMessage *);
+PyObject *SpilledMessage_enter(SpilledMessage *);
+PyObject *SpilledMessage_exit(SpilledMessage *, PyObject *);
+
+/* Python buffer and sequence implementation */
+int spill_get_buffer(SpilledMessage *, Py_buffer *, int);
+void spill_release_buffer(SpilledMessage *, Py_buffer *);
+Py_ssize_t spill_length(SpilledMessage *);
+
+/* Object attributes (read-only) */
+PyObject *spill_get_released(SpilledMessage *);
+
+PyObject *spill_repr(SpilledMessage *);
+
+/* Utility functions */
+
+/* Copies a payload into a new block in the arena and fills in the
+descriptor. Returns -1 with a Python error set on failure. */
+int spill_write(SharedArena *, const void *, Py_ssize_t, SpillDescriptor *);
+
+/* Frees the block described by a descriptor that spill_write() filled in
+but that was never sent. */
+void spill_discard(SharedArena *, SpillDescriptor *);
+
+/* Returns a new SpilledMessage for a descriptor that was received, or NULL
+with a Python error set. */
+PyObject *spill_open(SharedArena *, SpillDescriptor *);
@@ -0,0 +1,331 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "stats.h"
+
+#include <time.h>
+
+
+static uint64_t
+monotonic_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000000) + (uint64_t)now.tv_nsec;
+}
+
+
+static int
+histogram_bucket(uint64_t elapsed_ns) {
+    // The bucket is the position of the highest set bit, i.e. floor(log2()).
+    int bucket = 0;
+
+    while ((elapsed_ns >>= 1) && (bucket < STATS_HISTOGRAM_BUCKETS - 1))
+        bucket++;
+
+    return bucket;
+}
+
+
+uint64_t
+stats_start(IpcStats *stats) {
+    return stats ? monotonic_ns() : 0;
+}
+
+
+void
+stats_record(IpcStats *stats, uint64_t start_ns, size_t bytes, int error, int timed_out) {
+    uint64_t elapsed_ns;
+    int saved_errno = errno;
+
+    elapsed_ns = monotonic_ns() - start_ns;
+
+    STATS_ADD(stats->ops, 1);
+    STATS_ADD(stats->wait_ns, elapsed_ns);
+    STATS_ADD(stats->histogram[histogram_bucket(elapsed_ns)], 1);
+
+    switch (error) {
+        case 0:
+            STATS_ADD(stats->bytes, bytes);
+        break;
+
+        case EAGAIN:
+            STATS_ADD(stats->errors, 1);
+            if (timed_out)
+                STATS_ADD(stats->timeouts, 1);
+            else
+                STATS_ADD(stats->eagain, 1);
+        break;
+
+        case ENOMSG:
+            STATS_ADD(stats->errors, 1);
+            STATS_ADD(stats->enomsg, 1);
+        break;
+
+        case EINTR:
+            STATS_ADD(stats->errors, 1);
+            STATS_ADD(stats->eintr, 1);
+        break;
+
+        default:
+            STATS_ADD(stats->errors, 1);
+        break;
+    }
+
+    errno = saved_errno;
+}
+
+
+void
+stats_add(IpcStats *stats, const IpcStats *tally) {
+    // Every member is a uint64_t counter, so the tally is added field by
+    // field the same way stats_reset() zeroes them.
+    uint64_t *counter;
+    const uint64_t *amount = (const uint64_t *)tally;
+
+    for (counter = (uint64_t *)stats; counter < (uint64_t *)(stats + 1); counter++, amount++)
+        if (*amount)
+            STATS_ADD(*counter, *amount);
+}
+
+
+PyObject *
+stats_get_enabled(IpcStats *stats) {
+    return PyBool_FromLong(stats ? 1 : 0);
+}
+
+
+int
+stats_set_enabled(IpcStats **p_stats, void **p_segment, PyObject *py_value) {
+    int enable;
+
+    if (!py_value) {
+        PyErr_SetString(PyExc_AttributeError, "Attribute 'collect_stats' can't be deleted");
+        return -1;
+    }
+
+    enable = PyObject_IsTrue(py_value);
+
+    if (-1 == enable)
+        return -1;
+
+    if (enable && !*p_stats) {
+        *p_stats = PyMem_Calloc(1, sizeof(IpcStats));
+        if (!*p_stats) {
+            PyErr_SetString(PyExc_MemoryError, "Out of memory");
+            return -1;
+        }
+    }
+    else if (!enable)
+        stats_free(p_stats, p_segment);
+
+    return 0;
+}
+
+
+static void
+shared_stats_set_error(key_t key) {
+    switch (errno) {
+        case EACCES:
+            PyErr_SetString(pPermissionsException, "Permission denied");
+        break;
+
+        case ENOENT:
+            PyErr_Format(pExistentialException,
+                "No shared memory exists with the key %ld", (long)key);
+        break;
+
+        case EINVAL:
+            PyErr_Format(PyExc_ValueError,
+                "The shared memory with the key %ld is too small to hold stats",
+                (long)key);
+        break;
+
+        case ENOMEM:
+            PyErr_SetString(PyExc_MemoryError, "Not enough memory");
+        break;
+
+        default:
+            PyErr_SetFromErrno(PyExc_OSError);
+        break;
+    }
+}
+
+
+static SharedStatsBlock *
+shared_stats_attach(key_t key, int shmget_flags, int shmat_flags) {
+    // Opens (and with IPC_CREAT, possibly creates) the stats segment
+    // identified by key and attaches it. Returns NULL and sets a Python
+    // error on failure.
+    int id;
+    int created = 0;
+    int tries;
+    struct shmid_ds shm_info;
+    struct timespec pause;
+    SharedStatsBlock *block;
+
+    // Only a segment that this call creates is initialized. Anything that
+    // already exists has to look like a stats segment.
+    id = -1;
+    if (shmget_flags & IPC_CREAT) {
+        id = shmget(key, sizeof(SharedStatsBlock), shmget_flags | IPC_EXCL);
+        if (-1 != id)
+            created = 1;
+        else if (EEXIST != errno) {
+            shared_stats_set_error(key);
+            return NULL;
+        }
+    }
+    if (-1 == id)
+        id = shmget(key, 0, shmget_flags & ~IPC_CREAT);
+
+    DPRINTF("shared stats segment key=%ld, id=%d, created=%d\n", (long)key, id, created);
+
+    if (-1 == id) {
+        shared_stats_set_error(key);
+        return NULL;
+    }
+
+    if (!created) {
+        if (-1 == shmctl(id, IPC_STAT, &shm_info)) {
+            shared_stats_set_error(key);
+            return NULL;
+        }
+
+        if (sizeof(SharedStatsBlock) != shm_info.shm_segsz)
+            goto not_stats;
+    }
+
+    block = shmat(id, NULL, shmat_flags);
+
+    if ((void *)-1 == block) {
+        shared_stats_set_error(key);
+        return NULL;
+    }
+
+    if (created) {
+        block->version = SHARED_STATS_VERSION;
+        __atomic_store_n(&block->magic, SHARED_STATS_MAGIC, __ATOMIC_SEQ_CST);
+    }
+    else {
+        // The process that created the segment might not have stamped it
+        // yet, so give it a moment.
+        pause.tv_sec = 0;
+        pause.tv_nsec = 1000000;
+        for (tries = 0;
+             (tries < 100) && !__atomic_load_n(&block->magic, __ATOMIC_SEQ_CST);
+             tries++)
+            nanosleep(&pause, NULL);
+    }
+
+    if (SHARED_STATS_MAGIC != __atomic_load_n(&block->magic, __ATOMIC_SEQ_CST)) {
+        shmdt(block);
+        goto not_stats;
+    }
+
+    return block;
+
+    not_stats:
+    PyErr_Format(PyExc_ValueError,
+        "The shared memory with the key %ld doesn't contain sysv_ipc stats",
+        (long)key);
+    return NULL;
+}
+
+
+int
+stats_share(IpcStats **p_stats, void **p_segment, key_t key, int mode) {
+    SharedStatsBlock *block;
+
+    if (!(block = shared_stats_attach(key, IPC_CREAT | (mode & 0777), 0)))
+        return -1;
+
+    stats_free(p_stats, p_segment);
+
+    *p_segment = block;
+    *p_stats = &block->stats;
+
+    return 0;
+}
+
+
+PyObject *
+stats_read_shared(key_t key) {
+    SharedStatsBlock *block;
+    PyObject *py_stats;
+
+    if (!(block = shared_stats_attach(key, 0, SHM_RDONLY)))
+        return NULL;
+
+    py_stats = stats_as_dict(&block->stats);
+
+    shmdt(block);
+
+    return py_stats;
+}
+
+
+PyObject *
+stats_as_dict(IpcStats *stats) {
+    PyObject *py_histogram = NULL;
+    int i;
+
+    if (!stats)
+        Py_RETURN_NONE;
+
+    if (!(py_histogram = PyTuple_New(STATS_HISTOGRAM_BUCKETS)))
+        goto error_return;
+
+    for (i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+        PyObject *py_count = PyLong_FromUnsignedLongLong(
+                                    __atomic_load_n(&stats->histogram[i], __ATOMIC_RELAXED));
+        if (!py_count)
+            goto error_return;
+        PyTuple_SET_ITEM(py_histogram, i, py_count);
+    }
+
+#define STATS_LOAD(field)  (unsigned long long)__atomic_load_n(&stats->field, __ATOMIC_RELAXED)
+    return Py_BuildValue("{s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:N}",
+                         "ops", STATS_LOAD(ops),
+                         "bytes", STATS_LOAD(bytes),
+                         "errors", STATS_LOAD(errors),
+                         "eagain", STATS_LOAD(eagain),
+                         "enomsg", STATS_LOAD(enomsg),
+                         "eintr", STATS_LOAD(eintr),
+                         "timeouts", STATS_LOAD(timeouts),
+                         "wait_ns", STATS_LOAD(wait_ns),
+                         "histogram", py_histogram);
+#undef STATS_LOAD
+
+    error_return:
+    Py_XDECREF(py_histogram);
+    return NULL;
+}
+
+
+void
+stats_reset(IpcStats *stats) {
+    // The counters might be shared with other processes, so each one
+    // is zeroed with an atomic store.
+    uint64_t *counter;
+
+    if (stats) {
+        for (counter = (uint64_t *)stats; counter < (uint64_t *)(stats + 1); counter++)
+            __atomic_store_n(counter, 0, __ATOMIC_RELAXED);
+    }
+}
+
+
+void
+stats_free(IpcStats **p_stats, void **p_segment) {
+    if (*p_segment)
+        shmdt(*p_segment);
+    else
+        PyMem_Free(*p_stats);
+
+    *p_segment = NULL;
+    *p_stats = NULL;
+}
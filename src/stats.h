@@ -0,0 +1,75 @@
+#include <stdint.h>
+
+/* Opt-in operation statistics for IPC objects.
+
+An object that isn't collecting statistics has a NULL IpcStats pointer, so
+the cost of instrumentation when it is turned off is one pointer test per
+operation. When it is turned on, each instrumented call is bracketed by two
+reads of the monotonic clock.
+
+Counters are updated with atomic adds because instrumented calls record their
+results from any thread that happens to call them and, when the counters live
+in a shared statistics segment, from any process that attached the segment.
+*/
+
+/* Bucket i of the wait time histogram counts calls that took between 2^i and
+2^(i+1) - 1 nanoseconds. Bucket 0 also holds calls that took 0 or 1 ns and
+the last bucket holds everything that took longer than 2^31 ns (~2 seconds).
+*/
+#define STATS_HISTOGRAM_BUCKETS 32
+
+typedef struct {
+    uint64_t ops;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t eagain;
+    uint64_t enomsg;
+    uint64_t eintr;
+    uint64_t timeouts;
+    uint64_t wait_ns;
+    uint64_t histogram[STATS_HISTOGRAM_BUCKETS];
+} IpcStats;
+
+/* The layout of a shared statistics segment. Every process that calls
+share_stats() with the same key adds to the same counters. The header lets
+a monitor (or share_stats() itself) recognize a segment that holds stats.
+*/
+#define SHARED_STATS_MAGIC 0x54535653    // "SVST" in little-endian ASCII
+#define SHARED_STATS_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    IpcStats stats;
+} SharedStatsBlock;
+
+#define STATS_ADD(field, n)  __atomic_fetch_add(&(field), (n), __ATOMIC_RELAXED)
+
+/* Returns the current monotonic time in ns if stats is non-NULL, 0 otherwise.
+Call this immediately before the instrumented system call. Another thread can
+turn stats on or off while the GIL is released, so after the call, record it
+only if start_ns is non-zero and the object's stats pointer (read again) is
+still non-NULL. */
+uint64_t stats_start(IpcStats *stats);
+
+/* Records one instrumented call that began at start_ns. error is the errno
+from the call (0 on success). If timed_out is non-zero, an EAGAIN error
+is counted as a timeout rather than as EAGAIN. Preserves errno. */
+void stats_record(IpcStats *stats, uint64_t start_ns, size_t bytes, int error, int timed_out);
+
+/* Adds the counters in tally to stats. A function that makes several calls
+without the GIL records them in a local IpcStats and adds that to the
+object's stats once it has the GIL back. */
+void stats_add(IpcStats *stats, const IpcStats *tally);
+
+/* Python glue shared by the Semaphore, SharedMemory and MessageQueue types.
+The void ** params point to the object's stats_segment member which holds
+the attach address of a shared statistics segment, or NULL if the object's
+counters are private. */
+PyObject *stats_get_enabled(IpcStats *);
+int stats_set_enabled(IpcStats **, void **, PyObject *);
+int stats_share(IpcStats **, void **, key_t, int);
+PyObject *stats_as_dict(IpcStats *);
+void stats_reset(IpcStats *);
+void stats_free(IpcStats **, void **);
+PyObject *stats_read_shared(key_t);
@@ -35,17 +35,27 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // For memset
 #include <string.h>
 
-// For srand
-#include <stdlib.h>
-#include <time.h>
-
 // For the math surrounding timeouts for semtimedop()
 #include <math.h>
 
 #include "common.h"
+#include "stats.h"
 #include "semaphore.h"
 #include "memory.h"
 #include "mq.h"
+#include "arena.h"
+#include "hashmap.h"
+#include "rwlock.h"
+#include "barrier.h"
+#include "event.h"
+#include "futex.h"
+#include "waitany.h"
+#include "notifier.h"
+#include "spill.h"
+#include "schema.h"
+#include "coalesce.h"
+#include "checksum.h"
+#include "snapshot.h"
 
 PyObject *pBaseException;
 PyObject *pInternalException;
@@ -55,7 +65,7 @@ PyObject *pBusyException;
 PyObject *pNotAttachedException;
 
 // sysv_ipc_attach() needs this forward declaration of SharedMemoryType
-static PyTypeObject SharedMemoryType;
+PyTypeObject SharedMemoryType;
 
 /*
 
@@ -99,6 +109,10 @@ sysv_ipc_attach(PyObject *self, PyObject *args, PyObject *keywords) {
     */
 	shm = (SharedMemory *)PyObject_New(SharedMemory, &SharedMemoryType);
 	shm->id = id;
+	shm->copies_in_progress = 0;
+	shm->gil_release_threshold = SHM_GIL_RELEASE_THRESHOLD;
+	shm->stats = NULL;
+	shm->stats_segment = NULL;
 
     DPRINTF("About to call shm_attach()\n");
 	if (Py_None == shm_attach(shm, address, flags))
@@ -148,6 +162,27 @@ sysv_ipc_ftok(PyObject *self, PyObject *args, PyObject *keywords) {
 }
 
 
+static PyObject *
+sysv_ipc_shared_stats(PyObject *self, PyObject *args, PyObject *keywords) {
+    NoneableKey key;
+    char *keyword_list[ ] = {"key", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O&", keyword_list,
+                                     &convert_key_param, &key))
+        goto error_return;
+
+    if (key.is_none) {
+        PyErr_SetString(PyExc_ValueError, "The key must not be None");
+        goto error_return;
+    }
+
+    return stats_read_shared(key.value);
+
+    error_return:
+    return NULL;
+}
+
+
 static PyObject *
 sysv_ipc_remove_semaphore(PyObject *self, PyObject *args) {
     int id;
@@ -207,6 +242,11 @@ static PyMemberDef Semaphore_members[] = {
 
 
 static PyMethodDef Semaphore_methods[] = {
+    {   "create_many",
+        (PyCFunction)ipc_create_many,
+        METH_VARARGS | METH_KEYWORDS | METH_CLASS,
+        "Create n new objects with randomly chosen keys and return them in a list"
+    },
     {   "__enter__",
         (PyCFunction)Semaphore_enter,
         METH_NOARGS,
@@ -245,6 +285,21 @@ static PyMethodDef Semaphore_methods[] = {
         METH_NOARGS,
         "Removes (deletes) the semaphore from the system"
     },
+    {   "stats",
+        (PyCFunction)Semaphore_stats,
+        METH_NOARGS,
+        "Returns a dict of operation statistics, or None if collect_stats is False"
+    },
+    {   "reset_stats",
+        (PyCFunction)Semaphore_reset_stats,
+        METH_NOARGS,
+        "Resets the operation statistics to zero"
+    },
+    {   "share_stats",
+        (PyCFunction)Semaphore_share_stats,
+        METH_VARARGS | METH_KEYWORDS,
+        "Collects operation statistics in the shared stats segment identified by key"
+    },
     {NULL, NULL, 0, NULL} /* Sentinel */
 };
 
@@ -275,6 +330,12 @@ static PyGetSetDef Semaphore_gets_and_sets[] = {
         "When True (the default), calls to acquire/release/P/V/Z will wait (block) if the semaphore is busy",
         NULL
     },
+    {   "collect_stats",
+        (getter)sem_get_collect_stats,
+        (setter)sem_set_collect_stats,
+        "When True, acquire/release/P/V/Z calls are counted and timed. Defaults to False.",
+        NULL
+    },
     {   "mode",
         (getter)sem_get_mode,
         (setter)sem_set_mode,
@@ -335,7 +396,7 @@ static PyGetSetDef Semaphore_gets_and_sets[] = {
 
 
 
-static PyTypeObject SemaphoreType = {
+PyTypeObject SemaphoreType = {
     PyVarObject_HEAD_INIT(NULL, 0)
     "sysv_ipc.Semaphore",                   	// tp_name
     sizeof(Semaphore),                      	// tp_basicsize
@@ -391,6 +452,11 @@ static PyMemberDef SharedMemory_members[] = {
 
 
 static PyMethodDef SharedMemory_methods[] = {
+    {   "create_many",
+        (PyCFunction)ipc_create_many,
+        METH_VARARGS | METH_KEYWORDS | METH_CLASS,
+        "Create n new objects with randomly chosen keys and return them in a list"
+    },
     {   "read",
         (PyCFunction)SharedMemory_read,
         METH_VARARGS | METH_KEYWORDS,
@@ -401,11 +467,81 @@ static PyMethodDef SharedMemory_methods[] = {
         METH_VARARGS | METH_KEYWORDS,
         "Write the string to the shared memory at the offset given"
     },
+    {   "readv",
+        (PyCFunction)SharedMemory_readv,
+        METH_VARARGS | METH_KEYWORDS,
+        "Read each (offset, length) range of the shared memory into a list of Python strings"
+    },
+    {   "writev",
+        (PyCFunction)SharedMemory_writev,
+        METH_VARARGS | METH_KEYWORDS,
+        "Write each (offset, string) pair to the shared memory"
+    },
+    {   "atomic_load",
+        (PyCFunction)SharedMemory_atomic_load,
+        METH_VARARGS | METH_KEYWORDS,
+        "Atomically read the 4- or 8-byte integer at the offset"
+    },
+    {   "atomic_store",
+        (PyCFunction)SharedMemory_atomic_store,
+        METH_VARARGS | METH_KEYWORDS,
+        "Atomically write the 4- or 8-byte integer at the offset"
+    },
+    {   "fetch_add",
+        (PyCFunction)SharedMemory_fetch_add,
+        METH_VARARGS | METH_KEYWORDS,
+        "Atomically add to the integer at the offset and return its previous value"
+    },
+    {   "exchange",
+        (PyCFunction)SharedMemory_exchange,
+        METH_VARARGS | METH_KEYWORDS,
+        "Atomically replace the integer at the offset and return its previous value"
+    },
+    {   "compare_exchange",
+        (PyCFunction)SharedMemory_compare_exchange,
+        METH_VARARGS | METH_KEYWORDS,
+        "Atomically replace the integer at the offset if it equals expected"
+    },
+    {   "wait",
+        (PyCFunction)SharedMemory_wait,
+        METH_VARARGS | METH_KEYWORDS,
+        "Sleep while the 4-byte integer at the offset equals expected"
+    },
+    {   "wake",
+        (PyCFunction)SharedMemory_wake,
+        METH_VARARGS | METH_KEYWORDS,
+        "Wake processes that are waiting on the integer at the offset"
+    },
+    {   "crc32c",
+        (PyCFunction)SharedMemory_crc32c,
+        METH_VARARGS | METH_KEYWORDS,
+        "Return the CRC-32C of a range of the segment"
+    },
+    {   "xxhash64",
+        (PyCFunction)SharedMemory_xxhash64,
+        METH_VARARGS | METH_KEYWORDS,
+        "Return the 64-bit xxHash of a range of the segment"
+    },
     {   "remove",
         (PyCFunction)SharedMemory_remove,
         METH_NOARGS,
         "Removes (deletes) the shared memory from the system"
     },
+    {   "stats",
+        (PyCFunction)SharedMemory_stats,
+        METH_NOARGS,
+        "Returns a dict of operation statistics, or None if collect_stats is False"
+    },
+    {   "reset_stats",
+        (PyCFunction)SharedMemory_reset_stats,
+        METH_NOARGS,
+        "Resets the operation statistics to zero"
+    },
+    {   "numa_stat",
+        (PyCFunction)SharedMemory_numa_stat,
+        METH_NOARGS,
+        "Returns a dict of the number of the segment's resident pages on each NUMA node"
+    },
     {   "attach",
         (PyCFunction)SharedMemory_attach,
         METH_VARARGS | METH_KEYWORDS,
@@ -446,6 +582,18 @@ static PyGetSetDef SharedMemory_gets_and_sets[] = {
         "True if the segment is attached. Read only.",
         NULL
     },
+    {   "collect_stats",
+        (getter)shm_get_collect_stats,
+        (setter)shm_set_collect_stats,
+        "When True, read() and write() calls are counted and timed. Defaults to False.",
+        NULL
+    },
+    {   "gil_release_threshold",
+        (getter)shm_get_gil_release_threshold,
+        (setter)shm_set_gil_release_threshold,
+        "Copies of at least this many bytes are done with the GIL released",
+        NULL
+    },
     {   "last_attach_time",
         (getter)shm_get_last_attach_time,
         (setter)NULL,
@@ -520,7 +668,7 @@ PyBufferProcs SharedMemory_as_buffer = {
     (releasebufferproc)NULL,
 };
 
-static PyTypeObject SharedMemoryType = {
+PyTypeObject SharedMemoryType = {
     PyVarObject_HEAD_INIT(NULL, 0)
     "sysv_ipc.SharedMemory",                    // tp_name
     sizeof(SharedMemory),                       // tp_basicsize
@@ -576,6 +724,11 @@ static PyMemberDef MessageQueue_members[] = {
 
 
 static PyMethodDef MessageQueue_methods[] = {
+    {   "create_many",
+        (PyCFunction)ipc_create_many,
+        METH_VARARGS | METH_KEYWORDS | METH_CLASS,
+        "Create n new objects with randomly chosen keys and return them in a list"
+    },
     {   "send",
         (PyCFunction)MessageQueue_send,
         METH_VARARGS | METH_KEYWORDS,
@@ -586,11 +739,56 @@ static PyMethodDef MessageQueue_methods[] = {
         METH_VARARGS | METH_KEYWORDS,
         "Receive a message from the queue"
     },
+    {   "send_object",
+        (PyCFunction)MessageQueue_send_object,
+        METH_VARARGS | METH_KEYWORDS,
+        "Pickle an object and place it on the queue, spilling large buffers out of band"
+    },
+    {   "receive_object",
+        (PyCFunction)MessageQueue_receive_object,
+        METH_VARARGS | METH_KEYWORDS,
+        "Receive an object sent by send_object()"
+    },
+    {   "send_record",
+        (PyCFunction)MessageQueue_send_record,
+        METH_VARARGS | METH_KEYWORDS,
+        "Encode the arguments with the queue's record_schema and place them on the queue"
+    },
+    {   "receive_record",
+        (PyCFunction)MessageQueue_receive_record,
+        METH_VARARGS | METH_KEYWORDS,
+        "Receive a message and decode it with the queue's record_schema"
+    },
+    {   "send_stream",
+        (PyCFunction)MessageQueue_send_stream,
+        METH_VARARGS | METH_KEYWORDS,
+        "Place a buffer of any size on the queue as a stream of chunks"
+    },
+    {   "receive_stream",
+        (PyCFunction)MessageQueue_receive_stream,
+        METH_VARARGS | METH_KEYWORDS,
+        "Receive a buffer sent by send_stream()"
+    },
     {   "remove",
         (PyCFunction)MessageQueue_remove,
         METH_NOARGS,
         "Removes (deletes) the queue from the system"
     },
+    {   "stats",
+        (PyCFunction)MessageQueue_stats,
+        METH_NOARGS,
+        "Returns a dict of operation statistics, or None if collect_stats is False"
+    },
+    {   "reset_stats",
+        (PyCFunction)MessageQueue_reset_stats,
+        METH_NOARGS,
+        "Resets the operation statistics to zero"
+    },
+    {   "share_stats",
+        (PyCFunction)MessageQueue_share_stats,
+        METH_VARARGS | METH_KEYWORDS,
+        "Collects operation statistics in the shared stats segment identified by key"
+    },
     {NULL, NULL, 0, NULL} /* Sentinel */
 };
 
@@ -644,6 +842,30 @@ static PyGetSetDef MessageQueue_gets_and_sets[] = {
         "The maximum size of the queue (in bytes). Read-write if you have sufficient privileges.",
         NULL
     },
+    {   "collect_stats",
+        (getter)mq_get_collect_stats,
+        (setter)mq_set_collect_stats,
+        "When True, send() and receive() calls are counted and timed. Defaults to False.",
+        NULL
+    },
+    {   "spill_arena",
+        (getter)mq_get_spill_arena,
+        (setter)mq_set_spill_arena,
+        "The SharedArena that large messages are spilled to, or None. Defaults to None.",
+        NULL
+    },
+    {   "spill_threshold",
+        (getter)mq_get_spill_threshold,
+        (setter)mq_set_spill_threshold,
+        "Messages longer than this many bytes are spilled when spill_arena is set.",
+        NULL
+    },
+    {   "record_schema",
+        (getter)mq_get_record_schema,
+        (setter)mq_set_record_schema,
+        "The MessageSchema used by send_record() and receive_record(), or None.",
+        NULL
+    },
     {   "mode",
         (getter)mq_get_mode,
         (setter)mq_set_mode,
@@ -678,7 +900,7 @@ static PyGetSetDef MessageQueue_gets_and_sets[] = {
 };
 
 
-static PyTypeObject MessageQueueType = {
+PyTypeObject MessageQueueType = {
     PyVarObject_HEAD_INIT(NULL, 0)
     "sysv_ipc.MessageQueue",                    // tp_name
     sizeof(MessageQueue),                       // tp_basicsize
@@ -722,121 +944,1865 @@ static PyTypeObject MessageQueueType = {
 
 /*
 
-    Module level stuff
+    Shared arena stuff
 
 */
 
-static PyMethodDef module_methods[ ] = {
-   {   "attach",
-        (PyCFunction)sysv_ipc_attach,
+
+static PyMethodDef SharedArena_methods[] = {
+    {   "alloc",
+        (PyCFunction)SharedArena_alloc,
         METH_VARARGS | METH_KEYWORDS,
-        "Attaches the memory identified by the id and returns a new SharedMemory object."
+        "Allocate a block and return its offset in the memory segment"
     },
-   {   "ftok",
-        (PyCFunction)sysv_ipc_ftok,
-        METH_VARARGS | METH_KEYWORDS,
-        "Calls ftok(). Not recommended; see sysv_ipc documentation."
+    {   "free",
+        (PyCFunction)SharedArena_free,
+        METH_O,
+        "Free the block at the given offset"
     },
-    {   "remove_semaphore",
-        (PyCFunction)sysv_ipc_remove_semaphore,
-        METH_VARARGS,
-        "Remove (delete) the semaphore identified by id"
+    {   "generation",
+        (PyCFunction)SharedArena_generation,
+        METH_O,
+        "Return the generation number of the block at the given offset"
     },
-    {   "remove_shared_memory",
-        (PyCFunction)sysv_ipc_remove_shared_memory,
-        METH_VARARGS,
-        "Remove shared memory identified by id"
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef SharedArena_gets_and_sets[] = {
+    {   "memory",
+        (getter)arena_get_memory,
+        (setter)NULL,
+        "The SharedMemory object that holds the arena. Read only.",
+        NULL
     },
-    {   "remove_message_queue",
-        (PyCFunction)sysv_ipc_remove_message_queue,
-        METH_VARARGS,
-        "Remove the message queue identified by id"
+    {   "offset",
+        (getter)arena_get_offset,
+        (setter)NULL,
+        "The arena's offset in the memory segment. Read only.",
+        NULL
+    },
+    {   "size",
+        (getter)arena_get_size,
+        (setter)NULL,
+        "The arena's size in bytes, including its header. Read only.",
+        NULL
+    },
+    {   "bytes_in_use",
+        (getter)arena_get_bytes_in_use,
+        (setter)NULL,
+        "The total size of the allocated blocks. Read only.",
+        NULL
+    },
+    {   "blocks_in_use",
+        (getter)arena_get_blocks_in_use,
+        (setter)NULL,
+        "The number of allocated blocks. Read only.",
+        NULL
     },
     {NULL} /* Sentinel */
 };
 
 
-static struct PyModuleDef this_module = {
-	PyModuleDef_HEAD_INIT,  // m_base
-	"sysv_ipc",             // m_name
-	"SYSV IPC module",      // m_doc
-	-1,                     // m_size (space allocated for module globals)
-	module_methods,         // m_methods
-	NULL,                   // m_reload
-	NULL,                   // m_traverse
-	NULL,                   // m_clear
-	NULL                    // m_free
+PyTypeObject SharedArenaType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.SharedArena",                     // tp_name
+    sizeof(SharedArena),                        // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)SharedArena_dealloc,            // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    (reprfunc)arena_repr,                       // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "Allocator for the space in a shared memory segment", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    SharedArena_methods,                        // tp_methods
+    0,                                          // tp_members
+    SharedArena_gets_and_sets,                  // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)SharedArena_init,                 // tp_init
+    0,                                          // tp_alloc
+    SharedArena_new,                            // tp_new
 };
 
-/* Module init function */
-PyMODINIT_FUNC
-PyInit_sysv_ipc(void) {
-    PyObject *module;
-    PyObject *module_dict;
-
-    // I seed the random number generator in case I'm asked to make some
-    // random keys.
-    srand((unsigned int)time(NULL));
-
-    module = PyModule_Create(&this_module);
-
-    if (!module)
-        goto error_return;
 
-    if (PyType_Ready(&SemaphoreType) < 0)
-        goto error_return;
+/*
 
-    if (PyType_Ready(&SharedMemoryType) < 0)
-        goto error_return;
+    Shared hash map stuff
 
-    if (PyType_Ready(&MessageQueueType) < 0)
-        goto error_return;
+*/
 
-#ifdef SEMTIMEDOP_EXISTS
-    Py_INCREF(Py_True);
-    PyModule_AddObject(module, "SEMAPHORE_TIMEOUT_SUPPORTED", Py_True);
-#else
-    Py_INCREF(Py_False);
-    PyModule_AddObject(module, "SEMAPHORE_TIMEOUT_SUPPORTED", Py_False);
-#endif
 
-    PyModule_AddStringConstant(module, "VERSION", SYSV_IPC_VERSION);
-    PyModule_AddStringConstant(module, "__version__", SYSV_IPC_VERSION);
-    PyModule_AddStringConstant(module, "__copyright__", "Copyright 2008 - 2026, Philip Semanchuk and contributors");
-    PyModule_AddStringConstant(module, "__author__", "Philip Semanchuk");
-    PyModule_AddStringConstant(module, "__license__", "BSD");
+static PyMethodDef SharedHashMap_methods[] = {
+    {   "get",
+        (PyCFunction)SharedHashMap_get,
+        METH_VARARGS | METH_KEYWORDS,
+        "Return the value for the key, or default if the key isn't in the table"
+    },
+    {   "put",
+        (PyCFunction)SharedHashMap_put,
+        METH_VARARGS | METH_KEYWORDS,
+        "Add the key to the table or replace its value"
+    },
+    {   "delete",
+        (PyCFunction)SharedHashMap_delete,
+        METH_O,
+        "Remove the key from the table"
+    },
+    {   "items",
+        (PyCFunction)SharedHashMap_items,
+        METH_NOARGS,
+        "Return a list of (key, value) tuples"
+    },
+    {   "required_size",
+        (PyCFunction)SharedHashMap_required_size,
+        METH_VARARGS | METH_KEYWORDS | METH_STATIC,
+        "Return the number of bytes a table with the given capacity, key_size and value_size needs"
+    },
+    {NULL, NULL, 0, NULL}
+};
 
-    PyModule_AddIntConstant(module, "PAGE_SIZE", PAGE_SIZE);
-    PyModule_AddIntConstant(module, "KEY_MIN", KEY_MIN);
-    PyModule_AddIntConstant(module, "KEY_MAX", KEY_MAX);
-    PyModule_AddIntConstant(module, "SEMAPHORE_VALUE_MAX", SEMVMX);
-    PyModule_AddIntConstant(module, "IPC_CREAT", IPC_CREAT);
-    PyModule_AddIntConstant(module, "IPC_EXCL", IPC_EXCL);
-    PyModule_AddIntConstant(module, "IPC_CREX", IPC_CREX);
-    PyModule_AddIntConstant(module, "IPC_PRIVATE", IPC_PRIVATE);
-    PyModule_AddIntConstant(module, "SHM_RND", SHM_RND);
-    PyModule_AddIntConstant(module, "SHM_RDONLY", SHM_RDONLY);
 
+static PyGetSetDef SharedHashMap_gets_and_sets[] = {
+    {   "memory",
+        (getter)hashmap_get_memory,
+        (setter)NULL,
+        "The SharedMemory object that holds the table. Read only.",
+        NULL
+    },
+    {   "offset",
+        (getter)hashmap_get_offset,
+        (setter)NULL,
+        "The table's offset in the memory segment. Read only.",
+        NULL
+    },
+    {   "capacity",
+        (getter)hashmap_get_capacity,
+        (setter)NULL,
+        "The number of buckets in the table. Read only.",
+        NULL
+    },
+    {   "key_size",
+        (getter)hashmap_get_key_size,
+        (setter)NULL,
+        "The size of every key in bytes. Read only.",
+        NULL
+    },
+    {   "value_size",
+        (getter)hashmap_get_value_size,
+        (setter)NULL,
+        "The size of every value in bytes. Read only.",
+        NULL
+    },
+    {   "tombstones",
+        (getter)hashmap_get_tombstones,
+        (setter)NULL,
+        "The number of buckets that held deleted entries and haven't been reused. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
 
-    // These flags are Linux-specific.
-#ifdef SHM_HUGETLB
-    PyModule_AddIntConstant(module, "SHM_HUGETLB", SHM_HUGETLB);
-#endif
-#ifdef SHM_NORESERVE
-    PyModule_AddIntConstant(module, "SHM_NORESERVE", SHM_NORESERVE);
-#endif
-#ifdef SHM_REMAP
-    PyModule_AddIntConstant(module, "SHM_REMAP", SHM_REMAP);
-#endif
+PyMappingMethods SharedHashMap_as_mapping = {
+    (lenfunc)hashmap_length,
+    (binaryfunc)hashmap_subscript,
+    (objobjargproc)hashmap_ass_subscript,
+};
 
-    Py_INCREF(&SemaphoreType);
-    PyModule_AddObject(module, "Semaphore", (PyObject *)&SemaphoreType);
+PySequenceMethods SharedHashMap_as_sequence = {
+    .sq_contains = (objobjproc)hashmap_contains,
+};
 
-    Py_INCREF(&SharedMemoryType);
-    PyModule_AddObject(module, "SharedMemory", (PyObject *)&SharedMemoryType);
 
-    Py_INCREF(&MessageQueueType);
-    PyModule_AddObject(module, "MessageQueue", (PyObject *)&MessageQueueType);
+static PyTypeObject SharedHashMapType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.SharedHashMap",                   // tp_name
+    sizeof(SharedHashMap),                      // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)SharedHashMap_dealloc,          // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    (reprfunc)hashmap_repr,                     // tp_repr
+    0,                                          // tp_as_number
+    &SharedHashMap_as_sequence,                 // tp_as_sequence
+    &SharedHashMap_as_mapping,                  // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "Fixed-capacity hash table in a shared memory segment", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    SharedHashMap_methods,                      // tp_methods
+    0,                                          // tp_members
+    SharedHashMap_gets_and_sets,                // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)SharedHashMap_init,               // tp_init
+    0,                                          // tp_alloc
+    SharedHashMap_new,                          // tp_new
+};
+
+
+/*
+
+    RWLock stuff
+
+*/
+
+static PyMemberDef RWLock_members[] = {
+    {"id", T_INT, offsetof(RWLock, id), READONLY, "The id assigned by the system"},
+    {NULL} /* Sentinel */
+};
+
+
+static PyMethodDef RWLock_methods[] = {
+    {   "create_many",
+        (PyCFunction)ipc_create_many,
+        METH_VARARGS | METH_KEYWORDS | METH_CLASS,
+        "Create n new locks with randomly chosen keys"
+    },
+    {   "acquire_read",
+        (PyCFunction)RWLock_acquire_read,
+        METH_VARARGS | METH_KEYWORDS,
+        "Acquire the lock for reading, waiting until no writer holds it"
+    },
+    {   "release_read",
+        (PyCFunction)RWLock_release_read,
+        METH_NOARGS,
+        "Release the lock after reading"
+    },
+    {   "acquire_write",
+        (PyCFunction)RWLock_acquire_write,
+        METH_VARARGS | METH_KEYWORDS,
+        "Acquire the lock for writing, waiting until no one else holds it"
+    },
+    {   "release_write",
+        (PyCFunction)RWLock_release_write,
+        METH_NOARGS,
+        "Release the lock after writing"
+    },
+    {   "remove",
+        (PyCFunction)RWLock_remove,
+        METH_NOARGS,
+        "Removes (deletes) the lock from the system"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef RWLock_gets_and_sets[] = {
+    {   "key",
+        (getter)rwlock_get_key,
+        (setter)NULL,
+        "The key passed to the constructor. Read only.",
+        NULL
+    },
+    {   "undo",
+        (getter)rwlock_get_undo,
+        (setter)rwlock_set_undo,
+        "When True, acquire/release operations will be undone when the process exits. Non-portable.",
+        NULL
+    },
+    {   "prefer_writers",
+        (getter)rwlock_get_prefer_writers,
+        (setter)NULL,
+        "When True, readers wait while a writer is waiting. Read only.",
+        NULL
+    },
+    {   "readers",
+        (getter)rwlock_get_readers,
+        (setter)NULL,
+        "The number of processes holding the lock for reading. Read only.",
+        NULL
+    },
+    {   "writer",
+        (getter)rwlock_get_writer,
+        (setter)NULL,
+        "True if a process holds the lock for writing. Read only.",
+        NULL
+    },
+    {   "waiting_writers",
+        (getter)rwlock_get_waiting_writers,
+        (setter)NULL,
+        "The number of writers waiting for a writer-preferring lock. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+static PyTypeObject RWLockType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.RWLock",                          // tp_name
+    sizeof(RWLock),                             // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)RWLock_dealloc,                 // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    (reprfunc)rwlock_repr,                      // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "System V semaphore-based reader/writer lock", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    RWLock_methods,                             // tp_methods
+    RWLock_members,                             // tp_members
+    RWLock_gets_and_sets,                       // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)RWLock_init,                      // tp_init
+    0,                                          // tp_alloc
+    RWLock_new,                                 // tp_new
+};
+
+
+/*
+
+    Barrier and CountDownLatch stuff
+
+*/
+
+static PyMemberDef Barrier_members[] = {
+    {"id", T_INT, offsetof(Barrier, id), READONLY, "The id assigned by the system"},
+    {"parties", T_INT, offsetof(Barrier, parties), READONLY, "The number of parties"},
+    {NULL} /* Sentinel */
+};
+
+
+static PyMethodDef Barrier_methods[] = {
+    {   "create_many",
+        (PyCFunction)ipc_create_many,
+        METH_VARARGS | METH_KEYWORDS | METH_CLASS,
+        "Create n new barriers with randomly chosen keys"
+    },
+    {   "wait",
+        (PyCFunction)Barrier_wait,
+        METH_VARARGS | METH_KEYWORDS,
+        "Arrive at the barrier and wait for the other parties"
+    },
+    {   "remove",
+        (PyCFunction)Barrier_remove,
+        METH_NOARGS,
+        "Removes (deletes) the barrier from the system"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef Barrier_gets_and_sets[] = {
+    {   "key",
+        (getter)barrier_get_key,
+        (setter)NULL,
+        "The key passed to the constructor. Read only.",
+        NULL
+    },
+    {   "n_waiting",
+        (getter)barrier_get_n_waiting,
+        (setter)NULL,
+        "The number of parties waiting at the barrier. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+static PyTypeObject BarrierType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.Barrier",                         // tp_name
+    sizeof(Barrier),                            // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)Barrier_dealloc,                // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    (reprfunc)barrier_repr,                     // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "System V semaphore-based barrier",         // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    Barrier_methods,                            // tp_methods
+    Barrier_members,                            // tp_members
+    Barrier_gets_and_sets,                      // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)Barrier_init,                     // tp_init
+    0,                                          // tp_alloc
+    Barrier_new,                                // tp_new
+};
+
+
+static PyMemberDef CountDownLatch_members[] = {
+    {"id", T_INT, offsetof(CountDownLatch, id), READONLY, "The id assigned by the system"},
+    {NULL} /* Sentinel */
+};
+
+
+static PyMethodDef CountDownLatch_methods[] = {
+    {   "create_many",
+        (PyCFunction)ipc_create_many,
+        METH_VARARGS | METH_KEYWORDS | METH_CLASS,
+        "Create n new latches with randomly chosen keys"
+    },
+    {   "count_down",
+        (PyCFunction)CountDownLatch_count_down,
+        METH_NOARGS,
+        "Decrement the count, releasing the waiters when it reaches zero"
+    },
+    {   "wait",
+        (PyCFunction)CountDownLatch_wait,
+        METH_VARARGS | METH_KEYWORDS,
+        "Wait until the count reaches zero"
+    },
+    {   "remove",
+        (PyCFunction)CountDownLatch_remove,
+        METH_NOARGS,
+        "Removes (deletes) the latch from the system"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef CountDownLatch_gets_and_sets[] = {
+    {   "key",
+        (getter)latch_get_key,
+        (setter)NULL,
+        "The key passed to the constructor. Read only.",
+        NULL
+    },
+    {   "count",
+        (getter)latch_get_count,
+        (setter)NULL,
+        "The current count. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+static PyTypeObject CountDownLatchType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.CountDownLatch",                  // tp_name
+    sizeof(CountDownLatch),                     // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)CountDownLatch_dealloc,         // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    (reprfunc)latch_repr,                       // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "System V semaphore-based count down latch", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    CountDownLatch_methods,                     // tp_methods
+    CountDownLatch_members,                     // tp_members
+    CountDownLatch_gets_and_sets,               // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)CountDownLatch_init,              // tp_init
+    0,                                          // tp_alloc
+    CountDownLatch_new,                         // tp_new
+};
+
+
+/*
+
+    Event stuff
+
+*/
+
+static PyMemberDef Event_members[] = {
+    {"id", T_INT, offsetof(Event, id), READONLY, "The id assigned by the system"},
+    {NULL} /* Sentinel */
+};
+
+
+static PyMethodDef Event_methods[] = {
+    {   "create_many",
+        (PyCFunction)ipc_create_many,
+        METH_VARARGS | METH_KEYWORDS | METH_CLASS,
+        "Create n new events with randomly chosen keys"
+    },
+    {   "set",
+        (PyCFunction)Event_set,
+        METH_NOARGS,
+        "Set the event, waking every waiting process"
+    },
+    {   "clear",
+        (PyCFunction)Event_clear,
+        METH_NOARGS,
+        "Clear the event"
+    },
+    {   "is_set",
+        (PyCFunction)Event_is_set,
+        METH_NOARGS,
+        "Return True if the event is set"
+    },
+    {   "wait",
+        (PyCFunction)Event_wait,
+        METH_VARARGS | METH_KEYWORDS,
+        "Wait until the event is set"
+    },
+    {   "remove",
+        (PyCFunction)Event_remove,
+        METH_NOARGS,
+        "Removes (deletes) the event from the system"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef Event_gets_and_sets[] = {
+    {   "key",
+        (getter)event_get_key,
+        (setter)NULL,
+        "The key passed to the constructor. Read only.",
+        NULL
+    },
+    {   "n_waiting",
+        (getter)event_get_n_waiting,
+        (setter)NULL,
+        "The number of processes waiting for the event. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+static PyTypeObject EventType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.Event",                           // tp_name
+    sizeof(Event),                              // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)Event_dealloc,                  // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    (reprfunc)event_repr,                       // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "System V semaphore-based event",           // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    Event_methods,                              // tp_methods
+    Event_members,                              // tp_members
+    Event_gets_and_sets,                        // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)Event_init,                       // tp_init
+    0,                                          // tp_alloc
+    Event_new,                                  // tp_new
+};
+
+
+/*
+
+    Futex-based mutex and condition stuff
+
+*/
+
+static PyMethodDef SharedMutex_methods[] = {
+    {   "__enter__",
+        (PyCFunction)SharedMutex_enter,
+        METH_NOARGS,
+    },
+    {   "__exit__",
+        (PyCFunction)SharedMutex_exit,
+        METH_VARARGS,
+    },
+    {   "acquire",
+        (PyCFunction)SharedMutex_acquire,
+        METH_VARARGS | METH_KEYWORDS,
+        "Acquire the mutex, waiting if necessary"
+    },
+    {   "release",
+        (PyCFunction)SharedMutex_release,
+        METH_NOARGS,
+        "Release the mutex"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef SharedMutex_gets_and_sets[] = {
+    {   "memory",
+        (getter)mutex_get_memory,
+        (setter)NULL,
+        "The SharedMemory object that holds the mutex. Read only.",
+        NULL
+    },
+    {   "offset",
+        (getter)mutex_get_offset,
+        (setter)NULL,
+        "The mutex's offset in the memory segment. Read only.",
+        NULL
+    },
+    {   "robust",
+        (getter)mutex_get_robust,
+        (setter)NULL,
+        "True if the mutex is taken over from owners that have died. Read only.",
+        NULL
+    },
+    {   "locked",
+        (getter)mutex_get_locked,
+        (setter)NULL,
+        "True if the mutex is held. Read only.",
+        NULL
+    },
+    {   "owner",
+        (getter)mutex_get_owner,
+        (setter)NULL,
+        "The pid of the process holding the mutex, or None. Read only.",
+        NULL
+    },
+    {   "owner_died",
+        (getter)mutex_get_owner_died,
+        (setter)NULL,
+        "True if the last acquire() took the mutex over from a dead owner. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+PyTypeObject SharedMutexType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.SharedMutex",                     // tp_name
+    sizeof(SharedMutex),                        // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)SharedMutex_dealloc,            // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    (reprfunc)mutex_repr,                       // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "Process-shared mutex in a shared memory segment", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    SharedMutex_methods,                        // tp_methods
+    0,                                          // tp_members
+    SharedMutex_gets_and_sets,                  // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)SharedMutex_init,                 // tp_init
+    0,                                          // tp_alloc
+    SharedMutex_new,                            // tp_new
+};
+
+
+static PyMethodDef SharedCondition_methods[] = {
+    {   "wait",
+        (PyCFunction)SharedCondition_wait,
+        METH_VARARGS | METH_KEYWORDS,
+        "Release the mutex, wait for a notification and reacquire the mutex"
+    },
+    {   "notify",
+        (PyCFunction)SharedCondition_notify,
+        METH_VARARGS | METH_KEYWORDS,
+        "Wake up to n waiters"
+    },
+    {   "notify_all",
+        (PyCFunction)SharedCondition_notify_all,
+        METH_NOARGS,
+        "Wake every waiter"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef SharedCondition_gets_and_sets[] = {
+    {   "memory",
+        (getter)condition_get_memory,
+        (setter)NULL,
+        "The SharedMemory object that holds the condition. Read only.",
+        NULL
+    },
+    {   "offset",
+        (getter)condition_get_offset,
+        (setter)NULL,
+        "The condition's offset in the memory segment. Read only.",
+        NULL
+    },
+    {   "n_waiting",
+        (getter)condition_get_n_waiting,
+        (setter)NULL,
+        "The number of processes waiting on the condition. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+static PyTypeObject SharedConditionType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.SharedCondition",                 // tp_name
+    sizeof(SharedCondition),                    // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)SharedCondition_dealloc,        // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    (reprfunc)condition_repr,                   // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "Process-shared condition variable in a shared memory segment", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    SharedCondition_methods,                    // tp_methods
+    0,                                          // tp_members
+    SharedCondition_gets_and_sets,              // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)SharedCondition_init,             // tp_init
+    0,                                          // tp_alloc
+    SharedCondition_new,                        // tp_new
+};
+
+
+/*
+
+    Notifier stuff
+
+*/
+
+static PyMethodDef Notifier_methods[] = {
+    {   "__enter__",
+        (PyCFunction)Notifier_enter,
+        METH_NOARGS,
+    },
+    {   "__exit__",
+        (PyCFunction)Notifier_exit,
+        METH_VARARGS,
+    },
+    {   "fileno",
+        (PyCFunction)Notifier_fileno,
+        METH_NOARGS,
+        "Returns the file descriptor that's readable while the object is ready"
+    },
+    {   "clear",
+        (PyCFunction)Notifier_clear,
+        METH_NOARGS,
+        "Empties the file descriptor and resumes watching the object"
+    },
+    {   "close",
+        (PyCFunction)Notifier_close,
+        METH_NOARGS,
+        "Stops watching the object and closes the file descriptor"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef Notifier_gets_and_sets[] = {
+    {   "object",
+        (getter)notifier_get_object,
+        (setter)NULL,
+        "The MessageQueue or Semaphore being watched. Read only.",
+        NULL
+    },
+    {   "closed",
+        (getter)notifier_get_closed,
+        (setter)NULL,
+        "True if close() has been called. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+static PyTypeObject NotifierType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.Notifier",                        // tp_name
+    sizeof(Notifier),                           // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)Notifier_dealloc,               // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    (reprfunc)notifier_repr,                    // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "File descriptor that's readable while a queue or semaphore is ready", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    Notifier_methods,                           // tp_methods
+    0,                                          // tp_members
+    Notifier_gets_and_sets,                     // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)Notifier_init,                    // tp_init
+    0,                                          // tp_alloc
+    Notifier_new,                               // tp_new
+};
+
+
+/*
+
+    Spilled message stuff
+
+*/
+
+static PyMethodDef SpilledMessage_methods[] = {
+    {   "__enter__",
+        (PyCFunction)SpilledMessage_enter,
+        METH_NOARGS,
+    },
+    {   "__exit__",
+        (PyCFunction)SpilledMessage_exit,
+        METH_VARARGS,
+    },
+    {   "release",
+        (PyCFunction)SpilledMessage_release,
+        METH_NOARGS,
+        "Frees the message's block in the spill arena"
+    },
+    {   "tobytes",
+        (PyCFunction)SpilledMessage_tobytes,
+        METH_NOARGS,
+        "Returns a copy of the message as bytes"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef SpilledMessage_gets_and_sets[] = {
+    {   "released",
+        (getter)spill_get_released,
+        (setter)NULL,
+        "True if release() has been called. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+PyBufferProcs SpilledMessage_as_buffer = {
+    (getbufferproc)spill_get_buffer,
+    (releasebufferproc)spill_release_buffer,
+};
+
+
+PySequenceMethods SpilledMessage_as_sequence = {
+    .sq_length = (lenfunc)spill_length,
+};
+
+
+PyTypeObject SpilledMessageType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.SpilledMessage",                  // tp_name
+    sizeof(SpilledMessage),                     // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)SpilledMessage_dealloc,         // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    (reprfunc)spill_repr,                       // tp_repr
+    0,                                          // tp_as_number
+    &SpilledMessage_as_sequence,                // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    &SpilledMessage_as_buffer,                  // tp_as_buffer
+    Py_TPFLAGS_DEFAULT,                         // tp_flags
+    "A message that was received from a queue's spill arena", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    SpilledMessage_methods,                     // tp_methods
+    0,                                          // tp_members
+    SpilledMessage_gets_and_sets,               // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    0,                                          // tp_init
+    0,                                          // tp_alloc
+    0,                                          // tp_new
+};
+
+
+/*
+
+    Message schema stuff
+
+*/
+
+static PyMethodDef MessageSchema_methods[] = {
+    {   "pack",
+        (PyCFunction)MessageSchema_pack,
+        METH_VARARGS,
+        "Returns the arguments encoded as bytes, like struct.pack()"
+    },
+    {   "unpack",
+        (PyCFunction)MessageSchema_unpack,
+        METH_O,
+        "Returns a tuple of the values encoded in a buffer, like struct.unpack()"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef MessageSchema_gets_and_sets[] = {
+    {   "format",
+        (getter)schema_get_format,
+        (setter)NULL,
+        "The format string passed to the constructor. Read only.",
+        NULL
+    },
+    {   "size",
+        (getter)schema_get_size,
+        (setter)NULL,
+        "The size of an encoded record in bytes. Read only.",
+        NULL
+    },
+    {   "field_count",
+        (getter)schema_get_field_count,
+        (setter)NULL,
+        "The number of values in a record. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+PyTypeObject MessageSchemaType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.MessageSchema",                   // tp_name
+    sizeof(MessageSchema),                      // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)MessageSchema_dealloc,          // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    (reprfunc)schema_repr,                      // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "Compiled record format for MessageQueue.send_record() and receive_record()", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    MessageSchema_methods,                      // tp_methods
+    0,                                          // tp_members
+    MessageSchema_gets_and_sets,                // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)MessageSchema_init,               // tp_init
+    0,                                          // tp_alloc
+    MessageSchema_new,                          // tp_new
+};
+
+
+/*
+
+    Coalescing writer stuff
+
+*/
+
+static PyMemberDef CoalescingWriter_members[] = {
+    {"type", T_LONG, offsetof(CoalescingWriter, type), READONLY,
+     "The type of the messages (frames) that the writer sends"},
+    {NULL} /* Sentinel */
+};
+
+
+static PyMethodDef CoalescingWriter_methods[] = {
+    {   "__enter__",
+        (PyCFunction)CoalescingWriter_enter,
+        METH_NOARGS,
+    },
+    {   "__exit__",
+        (PyCFunction)CoalescingWriter_exit,
+        METH_VARARGS,
+    },
+    {   "write",
+        (PyCFunction)CoalescingWriter_write,
+        METH_VARARGS | METH_KEYWORDS,
+        "Adds a message to the current frame, sending the frame first if the message doesn't fit"
+    },
+    {   "flush",
+        (PyCFunction)CoalescingWriter_flush,
+        METH_VARARGS | METH_KEYWORDS,
+        "Sends the current frame"
+    },
+    {   "close",
+        (PyCFunction)CoalescingWriter_close,
+        METH_NOARGS,
+        "Sends the current frame and stops the writer"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef CoalescingWriter_gets_and_sets[] = {
+    {   "queue",
+        (getter)writer_get_queue,
+        (setter)NULL,
+        "The MessageQueue that frames are sent to. Read only.",
+        NULL
+    },
+    {   "max_delay",
+        (getter)writer_get_max_delay,
+        (setter)NULL,
+        "The longest a message waits before its frame is sent, or None. Read only.",
+        NULL
+    },
+    {   "pending",
+        (getter)writer_get_pending,
+        (setter)NULL,
+        "The number of messages in the current frame. Read only.",
+        NULL
+    },
+    {   "closed",
+        (getter)writer_get_closed,
+        (setter)NULL,
+        "True if close() has been called. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+static PyTypeObject CoalescingWriterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.CoalescingWriter",                // tp_name
+    sizeof(CoalescingWriter),                   // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)CoalescingWriter_dealloc,       // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    0,                                          // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "Packs small messages into one queue message", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    CoalescingWriter_methods,                   // tp_methods
+    CoalescingWriter_members,                   // tp_members
+    CoalescingWriter_gets_and_sets,             // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)CoalescingWriter_init,            // tp_init
+    0,                                          // tp_alloc
+    CoalescingWriter_new,                       // tp_new
+};
+
+
+/*
+
+    Coalescing reader stuff
+
+*/
+
+static PyMemberDef CoalescingReader_members[] = {
+    {"type", T_LONG, offsetof(CoalescingReader, type), READONLY,
+     "The type passed to receive() when the reader needs another frame"},
+    {NULL} /* Sentinel */
+};
+
+
+static PyMethodDef CoalescingReader_methods[] = {
+    {   "read",
+        (PyCFunction)CoalescingReader_read,
+        METH_VARARGS | METH_KEYWORDS,
+        "Returns the next message, receiving another frame if necessary"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef CoalescingReader_gets_and_sets[] = {
+    {   "queue",
+        (getter)reader_get_queue,
+        (setter)NULL,
+        "The MessageQueue that frames are received from. Read only.",
+        NULL
+    },
+    {   "pending",
+        (getter)reader_get_pending,
+        (setter)NULL,
+        "The number of messages left in the current frame. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+static PyTypeObject CoalescingReaderType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.CoalescingReader",                // tp_name
+    sizeof(CoalescingReader),                   // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)CoalescingReader_dealloc,       // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    0,                                          // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "Splits frames sent by a CoalescingWriter back into messages", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    CoalescingReader_methods,                   // tp_methods
+    CoalescingReader_members,                   // tp_members
+    CoalescingReader_gets_and_sets,             // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)CoalescingReader_init,            // tp_init
+    0,                                          // tp_alloc
+    CoalescingReader_new,                       // tp_new
+};
+
+
+/*
+
+    Snapshot publisher stuff
+
+*/
+
+static PyMemberDef SnapshotPublisher_members[] = {
+    {"offset", T_ULONG, offsetof(SnapshotPublisher, offset), READONLY,
+     "The offset of the snapshot header in the segment"},
+    {NULL} /* Sentinel */
+};
+
+
+static PyMethodDef SnapshotPublisher_methods[] = {
+    {   "begin",
+        (PyCFunction)SnapshotPublisher_begin,
+        METH_NOARGS,
+        "Returns a writable draft of the next snapshot"
+    },
+    {   "commit",
+        (PyCFunction)SnapshotPublisher_commit,
+        METH_VARARGS | METH_KEYWORDS,
+        "Publishes the draft and returns its sequence number"
+    },
+    {   "abort",
+        (PyCFunction)SnapshotPublisher_abort,
+        METH_NOARGS,
+        "Discards the draft without publishing it"
+    },
+    {   "publish",
+        (PyCFunction)SnapshotPublisher_publish,
+        METH_VARARGS | METH_KEYWORDS,
+        "Copies the data into a buffer, publishes it and returns its sequence number"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef SnapshotPublisher_gets_and_sets[] = {
+    {   "memory",
+        (getter)publisher_get_memory,
+        (setter)NULL,
+        "The SharedMemory segment that holds the snapshots. Read only.",
+        NULL
+    },
+    {   "buffers",
+        (getter)publisher_get_buffers,
+        (setter)NULL,
+        "The number of buffers. Read only.",
+        NULL
+    },
+    {   "buffer_size",
+        (getter)publisher_get_buffer_size,
+        (setter)NULL,
+        "The size of each buffer. Read only.",
+        NULL
+    },
+    {   "sequence",
+        (getter)publisher_get_sequence,
+        (setter)NULL,
+        "The sequence number of the published snapshot, or 0. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+static PyTypeObject SnapshotPublisherType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.SnapshotPublisher",               // tp_name
+    sizeof(SnapshotPublisher),                  // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)SnapshotPublisher_dealloc,      // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    0,                                          // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "Publishes snapshots to readers through a SharedMemory segment", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    SnapshotPublisher_methods,                  // tp_methods
+    SnapshotPublisher_members,                  // tp_members
+    SnapshotPublisher_gets_and_sets,            // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)SnapshotPublisher_init,           // tp_init
+    0,                                          // tp_alloc
+    SnapshotPublisher_new,                      // tp_new
+};
+
+
+/*
+
+    Snapshot reader stuff
+
+*/
+
+static PyMemberDef SnapshotReader_members[] = {
+    {"offset", T_ULONG, offsetof(SnapshotReader, offset), READONLY,
+     "The offset of the snapshot header in the segment"},
+    {NULL} /* Sentinel */
+};
+
+
+static PyMethodDef SnapshotReader_methods[] = {
+    {   "acquire",
+        (PyCFunction)SnapshotReader_acquire,
+        METH_NOARGS,
+        "Returns the published snapshot, or None if there isn't one"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef SnapshotReader_gets_and_sets[] = {
+    {   "memory",
+        (getter)snapshot_reader_get_memory,
+        (setter)NULL,
+        "The SharedMemory segment that holds the snapshots. Read only.",
+        NULL
+    },
+    {   "buffers",
+        (getter)snapshot_reader_get_buffers,
+        (setter)NULL,
+        "The number of buffers. Read only.",
+        NULL
+    },
+    {   "buffer_size",
+        (getter)snapshot_reader_get_buffer_size,
+        (setter)NULL,
+        "The size of each buffer. Read only.",
+        NULL
+    },
+    {   "sequence",
+        (getter)snapshot_reader_get_sequence,
+        (setter)NULL,
+        "The sequence number of the published snapshot, or 0. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+static PyTypeObject SnapshotReaderType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.SnapshotReader",                  // tp_name
+    sizeof(SnapshotReader),                     // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)SnapshotReader_dealloc,         // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    0,                                          // tp_repr
+    0,                                          // tp_as_number
+    0,                                          // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    0,                                          // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+    "Reads snapshots published by a SnapshotPublisher", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    SnapshotReader_methods,                     // tp_methods
+    SnapshotReader_members,                     // tp_members
+    SnapshotReader_gets_and_sets,               // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    (initproc)SnapshotReader_init,              // tp_init
+    0,                                          // tp_alloc
+    SnapshotReader_new,                         // tp_new
+};
+
+
+/*
+
+    Snapshot stuff
+
+*/
+
+static PyMethodDef Snapshot_methods[] = {
+    {   "__enter__",
+        (PyCFunction)Snapshot_enter,
+        METH_NOARGS,
+    },
+    {   "__exit__",
+        (PyCFunction)Snapshot_exit,
+        METH_VARARGS,
+    },
+    {   "release",
+        (PyCFunction)Snapshot_release,
+        METH_NOARGS,
+        "Unpins the snapshot's buffer, or discards a draft"
+    },
+    {   "tobytes",
+        (PyCFunction)Snapshot_tobytes,
+        METH_NOARGS,
+        "Returns a copy of the snapshot as bytes"
+    },
+    {NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef Snapshot_gets_and_sets[] = {
+    {   "sequence",
+        (getter)snapshot_get_sequence,
+        (setter)NULL,
+        "The snapshot's sequence number, or None for a draft. Read only.",
+        NULL
+    },
+    {   "released",
+        (getter)snapshot_get_released,
+        (setter)NULL,
+        "True if the snapshot has been released. Read only.",
+        NULL
+    },
+    {NULL} /* Sentinel */
+};
+
+
+PyBufferProcs Snapshot_as_buffer = {
+    (getbufferproc)snapshot_get_buffer,
+    (releasebufferproc)snapshot_release_buffer,
+};
+
+
+PySequenceMethods Snapshot_as_sequence = {
+    .sq_length = (lenfunc)snapshot_length,
+};
+
+
+PyTypeObject SnapshotType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sysv_ipc.Snapshot",                        // tp_name
+    sizeof(Snapshot),                           // tp_basicsize
+    0,                                          // tp_itemsize
+    (destructor)Snapshot_dealloc,               // tp_dealloc
+    0,                                          // tp_print
+    0,                                          // tp_getattr
+    0,                                          // tp_setattr
+    0,                                          // tp_compare
+    (reprfunc)snapshot_repr,                    // tp_repr
+    0,                                          // tp_as_number
+    &Snapshot_as_sequence,                      // tp_as_sequence
+    0,                                          // tp_as_mapping
+    0,                                          // tp_hash
+    0,                                          // tp_call
+    0,                                          // tp_str
+    0,                                          // tp_getattro
+    0,                                          // tp_setattro
+    &Snapshot_as_buffer,                        // tp_as_buffer
+    Py_TPFLAGS_DEFAULT,                         // tp_flags
+    "A pinned snapshot, or a publisher's draft", // tp_doc
+    0,                                          // tp_traverse
+    0,                                          // tp_clear
+    0,                                          // tp_richcompare
+    0,                                          // tp_weaklistoffset
+    0,                                          // tp_iter
+    0,                                          // tp_iternext
+    Snapshot_methods,                           // tp_methods
+    0,                                          // tp_members
+    Snapshot_gets_and_sets,                     // tp_getset
+    0,                                          // tp_base
+    0,                                          // tp_dict
+    0,                                          // tp_descr_get
+    0,                                          // tp_descr_set
+    0,                                          // tp_dictoffset
+    0,                                          // tp_init
+    0,                                          // tp_alloc
+    0,                                          // tp_new
+};
+
+
+/*
+
+    Module level stuff
+
+*/
+
+static PyMethodDef module_methods[ ] = {
+   {   "attach",
+        (PyCFunction)sysv_ipc_attach,
+        METH_VARARGS | METH_KEYWORDS,
+        "Attaches the memory identified by the id and returns a new SharedMemory object."
+    },
+   {   "ftok",
+        (PyCFunction)sysv_ipc_ftok,
+        METH_VARARGS | METH_KEYWORDS,
+        "Calls ftok(). Not recommended; see sysv_ipc documentation."
+    },
+    {   "shared_stats",
+        (PyCFunction)sysv_ipc_shared_stats,
+        METH_VARARGS | METH_KEYWORDS,
+        "Returns the operation statistics held in the shared stats segment identified by key"
+    },
+    {   "remove_semaphore",
+        (PyCFunction)sysv_ipc_remove_semaphore,
+        METH_VARARGS,
+        "Remove (delete) the semaphore identified by id"
+    },
+    {   "remove_shared_memory",
+        (PyCFunction)sysv_ipc_remove_shared_memory,
+        METH_VARARGS,
+        "Remove shared memory identified by id"
+    },
+    {   "remove_message_queue",
+        (PyCFunction)sysv_ipc_remove_message_queue,
+        METH_VARARGS,
+        "Remove the message queue identified by id"
+    },
+    {   "wait_any",
+        (PyCFunction)ipc_wait_any,
+        METH_VARARGS | METH_KEYWORDS,
+        "Waits until at least one of the MessageQueues and Semaphores is ready and returns the ready ones"
+    },
+    {NULL} /* Sentinel */
+};
+
+
+static struct PyModuleDef this_module = {
+	PyModuleDef_HEAD_INIT,  // m_base
+	"sysv_ipc",             // m_name
+	"SYSV IPC module",      // m_doc
+	-1,                     // m_size (space allocated for module globals)
+	module_methods,         // m_methods
+	NULL,                   // m_reload
+	NULL,                   // m_traverse
+	NULL,                   // m_clear
+	NULL                    // m_free
+};
+
+/* Module init function */
+PyMODINIT_FUNC
+PyInit_sysv_ipc(void) {
+    PyObject *module;
+    PyObject *module_dict;
+
+    module = PyModule_Create(&this_module);
+
+    if (!module)
+        goto error_return;
+
+    if (PyType_Ready(&SemaphoreType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&SharedMemoryType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&MessageQueueType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&SharedArenaType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&SharedHashMapType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&RWLockType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&BarrierType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&CountDownLatchType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&EventType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&SharedMutexType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&SharedConditionType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&NotifierType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&SpilledMessageType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&MessageSchemaType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&CoalescingWriterType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&CoalescingReaderType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&SnapshotPublisherType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&SnapshotReaderType) < 0)
+        goto error_return;
+
+    if (PyType_Ready(&SnapshotType) < 0)
+        goto error_return;
+
+#ifdef SEMTIMEDOP_EXISTS
+    Py_INCREF(Py_True);
+    PyModule_AddObject(module, "SEMAPHORE_TIMEOUT_SUPPORTED", Py_True);
+#else
+    Py_INCREF(Py_False);
+    PyModule_AddObject(module, "SEMAPHORE_TIMEOUT_SUPPORTED", Py_False);
+#endif
+
+#ifdef FUTEX_EXISTS
+    Py_INCREF(Py_True);
+    PyModule_AddObject(module, "FUTEX_SUPPORTED", Py_True);
+#else
+    Py_INCREF(Py_False);
+    PyModule_AddObject(module, "FUTEX_SUPPORTED", Py_False);
+#endif
+
+#ifdef MBIND_EXISTS
+    Py_INCREF(Py_True);
+    PyModule_AddObject(module, "NUMA_SUPPORTED", Py_True);
+#else
+    Py_INCREF(Py_False);
+    PyModule_AddObject(module, "NUMA_SUPPORTED", Py_False);
+#endif
+
+    PyModule_AddStringConstant(module, "VERSION", SYSV_IPC_VERSION);
+    PyModule_AddStringConstant(module, "__version__", SYSV_IPC_VERSION);
+    PyModule_AddStringConstant(module, "__copyright__", "Copyright 2008 - 2026, Philip Semanchuk and contributors");
+    PyModule_AddStringConstant(module, "__author__", "Philip Semanchuk");
+    PyModule_AddStringConstant(module, "__license__", "BSD");
+
+    PyModule_AddIntConstant(module, "PAGE_SIZE", PAGE_SIZE);
+    PyModule_AddIntConstant(module, "KEY_MIN", KEY_MIN);
+    PyModule_AddIntConstant(module, "KEY_MAX", KEY_MAX);
+    PyModule_AddIntConstant(module, "SEMAPHORE_VALUE_MAX", SEMVMX);
+    PyModule_AddIntConstant(module, "IPC_CREAT", IPC_CREAT);
+    PyModule_AddIntConstant(module, "IPC_EXCL", IPC_EXCL);
+    PyModule_AddIntConstant(module, "IPC_CREX", IPC_CREX);
+    PyModule_AddIntConstant(module, "IPC_PRIVATE", IPC_PRIVATE);
+    PyModule_AddIntConstant(module, "SHM_RND", SHM_RND);
+    PyModule_AddIntConstant(module, "SHM_RDONLY", SHM_RDONLY);
+    PyModule_AddIntConstant(module, "STATS_HISTOGRAM_BUCKETS", STATS_HISTOGRAM_BUCKETS);
+    PyModule_AddIntConstant(module, "SHM_GIL_RELEASE_THRESHOLD", SHM_GIL_RELEASE_THRESHOLD);
+    PyModule_AddIntConstant(module, "ATOMIC_RELAXED", __ATOMIC_RELAXED);
+    PyModule_AddIntConstant(module, "ATOMIC_ACQUIRE", __ATOMIC_ACQUIRE);
+    PyModule_AddIntConstant(module, "ATOMIC_RELEASE", __ATOMIC_RELEASE);
+    PyModule_AddIntConstant(module, "ATOMIC_ACQ_REL", __ATOMIC_ACQ_REL);
+    PyModule_AddIntConstant(module, "ATOMIC_SEQ_CST", __ATOMIC_SEQ_CST);
+    PyModule_AddIntConstant(module, "SHARED_MUTEX_SIZE", sizeof(SharedMutexData));
+    PyModule_AddIntConstant(module, "SHARED_CONDITION_SIZE", sizeof(SharedConditionData));
+
+
+    // These flags are Linux-specific.
+#ifdef SHM_HUGETLB
+    PyModule_AddIntConstant(module, "SHM_HUGETLB", SHM_HUGETLB);
+#endif
+#ifdef SHM_NORESERVE
+    PyModule_AddIntConstant(module, "SHM_NORESERVE", SHM_NORESERVE);
+#endif
+#ifdef SHM_REMAP
+    PyModule_AddIntConstant(module, "SHM_REMAP", SHM_REMAP);
+#endif
+
+    Py_INCREF(&SemaphoreType);
+    PyModule_AddObject(module, "Semaphore", (PyObject *)&SemaphoreType);
+
+    Py_INCREF(&SharedMemoryType);
+    PyModule_AddObject(module, "SharedMemory", (PyObject *)&SharedMemoryType);
+
+    Py_INCREF(&MessageQueueType);
+    PyModule_AddObject(module, "MessageQueue", (PyObject *)&MessageQueueType);
+
+    Py_INCREF(&SharedArenaType);
+    PyModule_AddObject(module, "SharedArena", (PyObject *)&SharedArenaType);
+
+    Py_INCREF(&SharedHashMapType);
+    PyModule_AddObject(module, "SharedHashMap", (PyObject *)&SharedHashMapType);
+
+    Py_INCREF(&RWLockType);
+    PyModule_AddObject(module, "RWLock", (PyObject *)&RWLockType);
+
+    Py_INCREF(&BarrierType);
+    PyModule_AddObject(module, "Barrier", (PyObject *)&BarrierType);
+
+    Py_INCREF(&CountDownLatchType);
+    PyModule_AddObject(module, "CountDownLatch", (PyObject *)&CountDownLatchType);
+
+    Py_INCREF(&EventType);
+    PyModule_AddObject(module, "Event", (PyObject *)&EventType);
+
+    Py_INCREF(&SharedMutexType);
+    PyModule_AddObject(module, "SharedMutex", (PyObject *)&SharedMutexType);
+
+    Py_INCREF(&SharedConditionType);
+    PyModule_AddObject(module, "SharedCondition", (PyObject *)&SharedConditionType);
+
+    Py_INCREF(&NotifierType);
+    PyModule_AddObject(module, "Notifier", (PyObject *)&NotifierType);
+
+    Py_INCREF(&SpilledMessageType);
+    PyModule_AddObject(module, "SpilledMessage", (PyObject *)&SpilledMessageType);
+
+    Py_INCREF(&MessageSchemaType);
+    PyModule_AddObject(module, "MessageSchema", (PyObject *)&MessageSchemaType);
+
+    Py_INCREF(&CoalescingWriterType);
+    PyModule_AddObject(module, "CoalescingWriter", (PyObject *)&CoalescingWriterType);
+
+    Py_INCREF(&CoalescingReaderType);
+    PyModule_AddObject(module, "CoalescingReader", (PyObject *)&CoalescingReaderType);
+
+    Py_INCREF(&SnapshotPublisherType);
+    PyModule_AddObject(module, "SnapshotPublisher", (PyObject *)&SnapshotPublisherType);
+
+    Py_INCREF(&SnapshotReaderType);
+    PyModule_AddObject(module, "SnapshotReader", (PyObject *)&SnapshotReaderType);
+
+    Py_INCREF(&SnapshotType);
+    PyModule_AddObject(module, "Snapshot", (PyObject *)&SnapshotType);
 
     // Exceptions
     if (!(module_dict = PyModule_GetDict(module)))
@@ -0,0 +1,635 @@
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "structmember.h"
+
+#include "common.h"
+#include "stats.h"
+#include "semaphore.h"
+#include "mq.h"
+#include "waitany.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ONE_BILLION 1000000000
+#define ONE_MILLION 1000000
+
+/* One call to wait_any() that has handed its objects to helpers, or one
+alarm. The caller doesn't return (or free an alarm) until pending is 0.
+Everything here is protected by pool_lock. */
+typedef struct {
+    pthread_cond_t done;
+    int cancelled;
+    int ready;
+    int pending;
+} WaitCall;
+
+typedef struct Helper {
+    pthread_t thread;
+    pthread_cond_t wakeup;
+    WaitCall *call;             // NULL while the helper is idle
+    int kind;
+    int id;
+    // Used only by alarms
+    pthread_t target;
+    struct timespec deadline;
+    struct Helper *next;
+} Helper;
+
+// An alarm is a WaitCall with a single job.
+struct WaitAlarm {
+    WaitCall call;
+};
+
+// pool_lock protects the pool list, every helper and every WaitCall.
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static Helper *pool = NULL;
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static int init_error = 0;
+
+
+/******************    Internal use only     **********************/
+
+static void
+wake_signal_handler(int signal_number) {
+    // Nothing to do; the signal exists only to interrupt a blocked call.
+}
+
+
+static void
+reset_pool_in_child(void) {
+    // The helpers don't exist in a forked child. Their memory is abandoned
+    // rather than freed, since the parent might have forked while a helper
+    // was being added to the list.
+    pool = NULL;
+    pthread_mutex_init(&pool_lock, NULL);
+}
+
+
+static void
+init(void) {
+    // Runs once per process. Sets init_error to 0 or an errno value.
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = wake_signal_handler;
+    sigemptyset(&action.sa_mask);
+    // No SA_RESTART; the point is to make the helper's call fail with EINTR.
+    action.sa_flags = 0;
+
+    if (-1 == sigaction(WAIT_ANY_SIGNAL, &action, NULL))
+        init_error = errno;
+    else if (pthread_atfork(NULL, NULL, reset_pool_in_child))
+        init_error = ENOMEM;
+}
+
+
+static void
+add_time(struct timespec *t, time_t seconds, long nanoseconds) {
+    t->tv_sec += seconds;
+    t->tv_nsec += nanoseconds;
+    if (t->tv_nsec >= ONE_BILLION) {
+        t->tv_sec++;
+        t->tv_nsec -= ONE_BILLION;
+    }
+}
+
+
+static long
+get_remaining_ns(const struct timespec *deadline) {
+    // Returns the time left before the deadline, capped at one slice.
+    struct timespec now;
+    long long remaining;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    remaining = (long long)(deadline->tv_sec - now.tv_sec) * ONE_BILLION +
+                (deadline->tv_nsec - now.tv_nsec);
+
+    if (remaining < 0)
+        return 0;
+    if (remaining > (long long)WAIT_ANY_SLICE_MS * ONE_MILLION)
+        return WAIT_ANY_SLICE_MS * ONE_MILLION;
+
+    return (long)remaining;
+}
+
+
+static void
+run_alarm(Helper *helper, WaitCall *call) {
+    // Called with pool_lock held. Once the deadline passes, the target is
+    // interrupted every millisecond until the alarm is stopped, because a
+    // signal that arrives before the target blocks doesn't interrupt anything.
+    struct timespec until;
+    long slice;
+
+    while (!call->cancelled) {
+        if (!(slice = get_remaining_ns(&helper->deadline))) {
+            call->ready = 1;
+            pthread_kill(helper->target, WAIT_ANY_SIGNAL);
+            slice = ONE_MILLION;
+        }
+
+        clock_gettime(CLOCK_REALTIME, &until);
+        add_time(&until, 0, slice);
+        pthread_cond_timedwait(&helper->wakeup, &pool_lock, &until);
+    }
+}
+
+
+static void
+remove_helper(Helper *helper) {
+    // Called with pool_lock held. Unlinks an idle helper from the pool.
+    Helper **link;
+
+    for (link = &pool; *link; link = &(*link)->next)
+        if (*link == helper) {
+            *link = helper->next;
+            break;
+        }
+}
+
+
+static void *
+helper_main(void *arg) {
+    Helper *helper = (Helper *)arg;
+    WaitCall *call;
+    struct timespec until;
+    int ready;
+
+    pthread_mutex_lock(&pool_lock);
+
+    for (;;) {
+        while (!helper->call) {
+            // A helper that has been idle for a while exits, so that the
+            // pool shrinks again after waiting on many objects at once.
+            clock_gettime(CLOCK_REALTIME, &until);
+            add_time(&until, WAIT_ANY_IDLE_SECONDS, 0);
+            if ((ETIMEDOUT == pthread_cond_timedwait(&helper->wakeup, &pool_lock, &until)) &&
+                (!helper->call)) {
+                remove_helper(helper);
+                pthread_mutex_unlock(&pool_lock);
+                DPRINTF("wait_any() helper thread exiting after being idle\n");
+                pthread_cond_destroy(&helper->wakeup);
+                free(helper);
+                return NULL;
+            }
+        }
+
+        call = helper->call;
+
+        if (WAIT_KIND_ALARM == helper->kind)
+            run_alarm(helper, call);
+        else if (!call->cancelled) {
+            pthread_mutex_unlock(&pool_lock);
+            ready = wait_block_until_ready(helper->kind, helper->id);
+            pthread_mutex_lock(&pool_lock);
+
+            if (ready)
+                call->ready = 1;
+        }
+
+        helper->call = NULL;
+        call->pending--;
+        pthread_cond_signal(&call->done);
+    }
+
+    return NULL;
+}
+
+
+static Helper *
+get_idle_helper(int *error) {
+    // Called with pool_lock held. Returns an idle helper, starting a new one
+    // if necessary, or NULL with *error set.
+    Helper *helper;
+
+    for (helper = pool; helper; helper = helper->next)
+        if (!helper->call)
+            return helper;
+
+    if (!(helper = (Helper *)malloc(sizeof(Helper)))) {
+        *error = ENOMEM;
+        return NULL;
+    }
+
+    helper->call = NULL;
+    pthread_cond_init(&helper->wakeup, NULL);
+
+    if ((*error = wait_start_thread(&helper->thread, helper_main, helper))) {
+        pthread_cond_destroy(&helper->wakeup);
+        free(helper);
+        return NULL;
+    }
+
+    pthread_detach(helper->thread);
+
+    DPRINTF("wait_any() started a helper thread\n");
+
+    helper->next = pool;
+    pool = helper;
+
+    return helper;
+}
+
+
+static void
+cancel_helpers(WaitCall *call) {
+    // Called with pool_lock held. Interrupts the call's helpers and waits
+    // for them to let go of it. A signal can arrive just before a helper
+    // blocks and be missed, so it's resent until every helper has finished.
+    Helper *helper;
+    struct timespec until;
+
+    call->cancelled = 1;
+
+    while (call->pending) {
+        for (helper = pool; helper; helper = helper->next)
+            if (helper->call == call) {
+                if (WAIT_KIND_ALARM == helper->kind)
+                    pthread_cond_signal(&helper->wakeup);
+                else
+                    pthread_kill(helper->thread, WAIT_ANY_SIGNAL);
+            }
+
+        clock_gettime(CLOCK_REALTIME, &until);
+        add_time(&until, 0, ONE_MILLION);
+        pthread_cond_timedwait(&call->done, &pool_lock, &until);
+    }
+}
+
+
+static int
+wait_for_helpers(int *kinds, int *ids, Py_ssize_t count,
+                 const struct timespec *deadline) {
+    /* Hands the objects to helpers and waits until one of them is ready, the
+       deadline (if not NULL) passes or a Python signal handler raises an
+       error. Returns 0 or -1 with a Python error set.
+    */
+    WaitCall call;
+    Helper *helper;
+    struct timespec until;
+    Py_ssize_t i;
+    long slice;
+    int error = 0;
+    int ready = 0;
+    int rc = 0;
+
+    pthread_cond_init(&call.done, NULL);
+    call.cancelled = 0;
+    call.ready = 0;
+    call.pending = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&pool_lock);
+
+    for (i = 0; i < count; i++) {
+        if (!(helper = get_idle_helper(&error)))
+            break;
+
+        helper->kind = kinds[i];
+        helper->id = ids[i];
+        helper->call = &call;
+        call.pending++;
+        pthread_cond_signal(&helper->wakeup);
+    }
+
+    pthread_mutex_unlock(&pool_lock);
+    Py_END_ALLOW_THREADS
+
+    while ((!error) && (!ready)) {
+        slice = deadline ? get_remaining_ns(deadline) :
+                           WAIT_ANY_SLICE_MS * ONE_MILLION;
+        if (!slice)
+            break;
+
+        Py_BEGIN_ALLOW_THREADS
+        clock_gettime(CLOCK_REALTIME, &until);
+        add_time(&until, 0, slice);
+
+        pthread_mutex_lock(&pool_lock);
+        while ((!call.ready) &&
+               (ETIMEDOUT != pthread_cond_timedwait(&call.done, &pool_lock, &until)))
+            ;
+        ready = call.ready;
+        pthread_mutex_unlock(&pool_lock);
+        Py_END_ALLOW_THREADS
+
+        if ((!ready) && (-1 == PyErr_CheckSignals())) {
+            rc = -1;
+            break;
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&pool_lock);
+    cancel_helpers(&call);
+    pthread_mutex_unlock(&pool_lock);
+    Py_END_ALLOW_THREADS
+
+    pthread_cond_destroy(&call.done);
+
+    if (error) {
+        errno = error;
+        PyErr_SetFromErrno(PyExc_OSError);
+        rc = -1;
+    }
+
+    return rc;
+}
+
+
+static int
+is_ready(int kind, int id) {
+    // Checks the object without blocking. Returns 1 if it's ready, 0 if it's
+    // not and -1 with a Python error set if the check failed.
+    struct msqid_ds queue_info;
+    int value;
+
+    if (WAIT_KIND_QUEUE == kind) {
+        if (-1 == msgctl(id, IPC_STAT, &queue_info)) {
+            switch (errno) {
+                case EIDRM:
+                case EINVAL:
+                    PyErr_Format(pExistentialException,
+                                                    "The queue no longer exists");
+                break;
+
+                case EACCES:
+                    PyErr_SetString(pPermissionsException, "Permission denied");
+                break;
+
+                default:
+                    PyErr_SetFromErrno(PyExc_OSError);
+                break;
+            }
+            return -1;
+        }
+
+        return (queue_info.msg_qnum > 0);
+    }
+    else {
+        if (-1 == (value = semctl(id, 0, GETVAL))) {
+            sem_set_error();
+            return -1;
+        }
+
+        return (value > 0);
+    }
+}
+
+
+static PyObject *
+get_ready_objects(PyObject *sequence, int *kinds, int *ids, Py_ssize_t count) {
+    PyObject *ready_objects;
+    Py_ssize_t i;
+    int rc;
+
+    if (!(ready_objects = PyList_New(0)))
+        return NULL;
+
+    for (i = 0; i < count; i++) {
+        rc = is_ready(kinds[i], ids[i]);
+
+        if ((-1 == rc) ||
+            ((1 == rc) &&
+             (-1 == PyList_Append(ready_objects, PySequence_Fast_GET_ITEM(sequence, i))))) {
+            Py_DECREF(ready_objects);
+            return NULL;
+        }
+    }
+
+    return ready_objects;
+}
+
+
+/******************    Shared with notifier.c and mq.c     **********************/
+
+int
+wait_get_target(PyObject *py_object, int *kind, int *id) {
+    // Sets *kind and *id if py_object is a MessageQueue or a Semaphore and
+    // returns 0. Otherwise returns -1 with a TypeError set.
+    if (PyObject_TypeCheck(py_object, &MessageQueueType)) {
+        *kind = WAIT_KIND_QUEUE;
+        *id = ((MessageQueue *)py_object)->id;
+    }
+    else if (PyObject_TypeCheck(py_object, &SemaphoreType)) {
+        *kind = WAIT_KIND_SEMAPHORE;
+        *id = ((Semaphore *)py_object)->id;
+    }
+    else {
+        PyErr_SetString(PyExc_TypeError,
+                        "The objects must be MessageQueues or Semaphores");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int
+wait_block_until_ready(int kind, int id) {
+    /* Blocks until the object is ready without consuming anything. Returns 1
+       if the object is ready and 0 if the thread was interrupted. Errors
+       (e.g. the object was removed) count as ready; the caller's next check
+       of the object reports them.
+    */
+    struct msqid_ds queue_info;
+    struct sembuf op[2];
+    struct timespec pause;
+
+    if (WAIT_KIND_QUEUE == kind) {
+        // Blocking in msgrcv() would receive a message with no content, and
+        // there's no way to put it back where it was, so queues are polled.
+        // The polls start close together and back off.
+        pause.tv_sec = 0;
+        pause.tv_nsec = WAIT_ANY_POLL_MIN_NS;
+        for (;;) {
+            if (-1 == msgctl(id, IPC_STAT, &queue_info))
+                return 1;
+            if (queue_info.msg_qnum)
+                return 1;
+            if (-1 == nanosleep(&pause, NULL))
+                return (EINTR != errno);
+            pause.tv_nsec = MIN(pause.tv_nsec * 2, WAIT_ANY_POLL_MAX_NS);
+        }
+    }
+    else {
+        sem_set_op(&op[0], 0, -1, 0);
+        sem_set_op(&op[1], 0, 1, 0);
+
+        if (-1 == semop(id, op, 2))
+            return (EINTR != errno);
+
+        return 1;
+    }
+}
+
+
+int
+wait_start_thread(pthread_t *thread, void *(*start)(void *), void *arg) {
+    // Starts a thread that blocks every signal except WAIT_ANY_SIGNAL. A new
+    // thread inherits its creator's signal mask, so the mask is changed for
+    // the duration of pthread_create(). Returns 0 or an errno value.
+    sigset_t signals;
+    sigset_t old_signals;
+    int rc;
+
+    pthread_once(&init_once, init);
+    if (init_error)
+        return init_error;
+
+    sigfillset(&signals);
+    sigdelset(&signals, WAIT_ANY_SIGNAL);
+    pthread_sigmask(SIG_SETMASK, &signals, &old_signals);
+    rc = pthread_create(thread, NULL, start, arg);
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+
+    return rc;
+}
+
+
+int
+wait_alarm_start(WaitAlarm **p_alarm, time_t seconds, long nanoseconds) {
+    // Doesn't need the GIL. Returns 0 or an errno value.
+    WaitAlarm *alarm;
+    Helper *helper;
+    int error = 0;
+
+    if (!(alarm = (WaitAlarm *)malloc(sizeof(WaitAlarm))))
+        return ENOMEM;
+
+    pthread_cond_init(&alarm->call.done, NULL);
+    alarm->call.cancelled = 0;
+    alarm->call.ready = 0;
+    alarm->call.pending = 0;
+
+    pthread_mutex_lock(&pool_lock);
+
+    if ((helper = get_idle_helper(&error))) {
+        helper->kind = WAIT_KIND_ALARM;
+        helper->target = pthread_self();
+        clock_gettime(CLOCK_MONOTONIC, &helper->deadline);
+        add_time(&helper->deadline, seconds, nanoseconds);
+        helper->call = &alarm->call;
+        alarm->call.pending = 1;
+        pthread_cond_signal(&helper->wakeup);
+    }
+
+    pthread_mutex_unlock(&pool_lock);
+
+    if (error) {
+        pthread_cond_destroy(&alarm->call.done);
+        free(alarm);
+        return error;
+    }
+
+    *p_alarm = alarm;
+
+    return 0;
+}
+
+
+int
+wait_alarm_stop(WaitAlarm *alarm) {
+    // Doesn't need the GIL. Returns 1 if the alarm went off, 0 if not.
+    int fired;
+
+    pthread_mutex_lock(&pool_lock);
+    cancel_helpers(&alarm->call);
+    fired = alarm->call.ready;
+    pthread_mutex_unlock(&pool_lock);
+
+    pthread_cond_destroy(&alarm->call.done);
+    free(alarm);
+
+    return fired;
+}
+
+
+/******************    Exposed functions     **********************/
+
+PyObject *
+ipc_wait_any(PyObject *self, PyObject *args, PyObject *keywords) {
+    PyObject *py_objects;
+    PyObject *sequence = NULL;
+    PyObject *ready_objects = NULL;
+    NoneableTimeout timeout;
+    struct timespec deadline;
+    char *keyword_list[ ] = {"objects", "timeout", NULL};
+    Py_ssize_t count;
+    Py_ssize_t i;
+    int *kinds = NULL;
+    int *ids = NULL;
+
+    // wait_any(objects, [timeout = None])
+
+    timeout.is_none = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords, "O|O&", keyword_list,
+                                     &py_objects, convert_timeout, &timeout))
+        goto error_return;
+
+    if (!(sequence = PySequence_Fast(py_objects,
+                            "The objects must be a sequence")))
+        goto error_return;
+
+    count = PySequence_Fast_GET_SIZE(sequence);
+
+    if (!count) {
+        PyErr_SetString(PyExc_ValueError, "The objects must not be empty");
+        goto error_return;
+    }
+
+    kinds = PyMem_New(int, count);
+    ids = PyMem_New(int, count);
+    if ((!kinds) || (!ids)) {
+        PyErr_NoMemory();
+        goto error_return;
+    }
+
+    for (i = 0; i < count; i++)
+        if (-1 == wait_get_target(PySequence_Fast_GET_ITEM(sequence, i),
+                                  &kinds[i], &ids[i]))
+            goto error_return;
+
+    if (!timeout.is_none) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        add_time(&deadline, timeout.timestamp.tv_sec, timeout.timestamp.tv_nsec);
+    }
+
+    for (;;) {
+        if (!(ready_objects = get_ready_objects(sequence, kinds, ids, count)))
+            goto error_return;
+
+        if (PyList_GET_SIZE(ready_objects) ||
+            ((!timeout.is_none) && (!get_remaining_ns(&deadline))))
+            break;
+
+        Py_DECREF(ready_objects);
+        ready_objects = NULL;
+
+        // When this returns, a helper might have seen an object become
+        // ready, but another process can take it before the check at the
+        // top of the loop, so that check decides.
+        if (-1 == wait_for_helpers(kinds, ids, count,
+                                   timeout.is_none ? NULL : &deadline))
+            goto error_return;
+    }
+
+    PyMem_Free(kinds);
+    PyMem_Free(ids);
+    Py_DECREF(sequence);
+
+    return ready_objects;
+
+    error_return:
+    PyMem_Free(kinds);
+    PyMem_Free(ids);
+    Py_XDECREF(sequence);
+    return NULL;
+}
@@ -0,0 +1,67 @@
+#include <pthread.h>
+#include <signal.h>
+
+/* wait_any() waits until at least one of several MessageQueues and
+Semaphores is ready. A queue is ready when it holds at least one message, a
+semaphore when its value is greater than zero. Being ready is a snapshot; by
+the time the caller acts on it, another process may have taken the message or
+decremented the semaphore, so callers should still use block=False or a
+timeout when they receive or acquire.
+
+SysV IPC has no call that waits on more than one object, so wait_any() first
+checks each object without blocking. If none is ready, it hands each object
+to a helper thread from a small pool. A helper that has had nothing to do for
+WAIT_ANY_IDLE_SECONDS exits, so the pool shrinks again after a large wait.
+Each helper waits on its object in a way that doesn't consume anything:
+  - For a queue, it polls the message count with IPC_STAT, sleeping between
+    polls for WAIT_ANY_POLL_MIN_NS at first and then twice as long each time
+    up to WAIT_ANY_POLL_MAX_NS. (Blocking in msgrcv() with a buffer size of 0
+    would receive a message with no content, which can't be put back in its
+    place.)
+  - For a semaphore, it waits for a decrement by 1 and increment by 1 in the
+    same semop(), which leaves the value unchanged.
+The first helper to return wakes the calling thread. The caller then
+interrupts the helpers that are still waiting by sending each of them
+WAIT_ANY_SIGNAL, which has a handler that does nothing and is installed
+without SA_RESTART, so the blocked call (or sleep) fails with EINTR. Helpers block every
+other signal so they never steal signals meant for the application.
+*/
+
+// The signal that interrupts helper threads. The application shouldn't use
+// it for anything else.
+#ifdef SIGRTMIN
+#define WAIT_ANY_SIGNAL (SIGRTMIN + 1)
+#else
+#define WAIT_ANY_SIGNAL SIGUSR2
+#endif
+
+// The calling thread wakes up this often to check for Python signals
+// (e.g. Ctrl-C) while it waits.
+#define WAIT_ANY_SLICE_MS 100
+
+// An idle helper thread exits after this long.
+#define WAIT_ANY_IDLE_SECONDS 2
+
+// The shortest and longest sleeps between polls of a queue's message count
+#define WAIT_ANY_POLL_MIN_NS 50000
+#define WAIT_ANY_POLL_MAX_NS 10000000
+
+#define WAIT_KIND_QUEUE 0
+#define WAIT_KIND_SEMAPHORE 1
+#define WAIT_KIND_ALARM 2
+
+/* A WaitAlarm gives blocking calls that have no timeout of their own (e.g.
+msgsnd() and msgrcv()) one. Once its deadline passes, a helper interrupts the
+thread that started the alarm with WAIT_ANY_SIGNAL, so the call fails with
+EINTR. wait_alarm_stop() reports whether the alarm went off, which tells a
+timeout apart from other signals. */
+typedef struct WaitAlarm WaitAlarm;
+
+PyObject *ipc_wait_any(PyObject *, PyObject *, PyObject *);
+
+/* Shared with the Notifier class and MessageQueue */
+int wait_get_target(PyObject *, int *, int *);
+int wait_block_until_ready(int, int);
+int wait_start_thread(pthread_t *, void *(*)(void *), void *);
+int wait_alarm_start(WaitAlarm **, time_t, long);
+int wait_alarm_stop(WaitAlarm *);
@@ -0,0 +1,196 @@
+# Python imports
+import struct
+import unittest
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+
+class SharedArenaTestBase(Base):
+    """base class for SharedArena test classes"""
+    SIZE = 64 * 1024
+
+    def setUp(self):
+        self.mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=self.SIZE)
+        self.arena = sysv_ipc.SharedArena(self.mem, init=True)
+
+    def tearDown(self):
+        if self.mem.attached:
+            self.mem.detach()
+        self.mem.remove()
+
+
+class TestSharedArenaCreation(SharedArenaTestBase):
+    """Exercise the SharedArena constructor"""
+    def test_attributes(self):
+        """test the arena's attributes"""
+        self.assertIs(self.arena.memory, self.mem)
+        self.assertEqual(self.arena.offset, 0)
+        self.assertEqual(self.arena.size, self.mem.size)
+        self.assertEqual(self.arena.bytes_in_use, 0)
+        self.assertEqual(self.arena.blocks_in_use, 0)
+
+    def test_offset_and_size(self):
+        """test an arena that occupies only part of the segment"""
+        arena = sysv_ipc.SharedArena(self.mem, offset=4096, size=8192, init=True)
+        self.assertEqual(arena.offset, 4096)
+        self.assertEqual(arena.size, 8192)
+
+        offset = arena.alloc(100)
+        self.assertTrue(4096 < offset < 4096 + 8192)
+
+    def test_open_existing(self):
+        """test that a second arena object sees the same allocations"""
+        offset = self.arena.alloc(100)
+
+        other = sysv_ipc.SharedArena(self.mem)
+        self.assertEqual(other.blocks_in_use, 1)
+        other.free(offset)
+        self.assertEqual(self.arena.blocks_in_use, 0)
+
+    def test_open_via_different_address(self):
+        """test that offsets work when the segment is attached at another address"""
+        offset = self.arena.alloc(5)
+        self.mem.write(b'hello', offset)
+
+        mem = sysv_ipc.attach(self.mem.id)
+        try:
+            self.assertNotEqual(mem.address, self.mem.address)
+            other = sysv_ipc.SharedArena(mem)
+            self.assertEqual(mem.read(5, offset), b'hello')
+            other.free(offset)
+            self.assertEqual(self.arena.blocks_in_use, 0)
+        finally:
+            mem.detach()
+
+    def test_no_arena(self):
+        """ensure ValueError is raised if there's no arena at the offset"""
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedArena(self.mem, offset=8192)
+
+    def test_bad_params(self):
+        """ensure bad constructor params are rejected"""
+        with self.assertRaises(TypeError):
+            sysv_ipc.SharedArena(42)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedArena(self.mem, offset=3, init=True)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedArena(self.mem, offset=self.SIZE, init=True)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedArena(self.mem, size=self.SIZE + 16, init=True)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedArena(self.mem, size=64, init=True)
+        # The header fits, but the offset pushes the first block past the end.
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedArena(self.mem, offset=16, size=416, init=True)
+
+    def test_corrupt_header(self):
+        """ensure a header whose bounds don't make sense is rejected"""
+        start, end, top = struct.unpack('=QQQ', self.mem.read(24, 16))
+        self.mem.write(struct.pack('=Q', end + 64), 32)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedArena(self.mem)
+        self.mem.write(struct.pack('=QQQ', end, start, start), 16)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedArena(self.mem)
+
+    def test_detached(self):
+        """ensure NotAttachedError is raised when the segment is detached"""
+        self.mem.detach()
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            self.arena.alloc(10)
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            sysv_ipc.SharedArena(self.mem)
+
+
+class TestSharedArenaAllocation(SharedArenaTestBase):
+    """Exercise alloc(), free() and generation()"""
+    def test_alloc(self):
+        """test that allocations don't overlap and stay inside the segment"""
+        sizes = (1, 10, 100, 1000, 0, 17)
+        offsets = [self.arena.alloc(size) for size in sizes]
+
+        ranges = sorted(zip(offsets, sizes))
+        for (offset, size), (next_offset, _) in zip(ranges, ranges[1:]):
+            self.assertLessEqual(offset + size, next_offset)
+        for offset, size in ranges:
+            self.assertEqual(offset % 16, 0)
+            self.assertLessEqual(offset + size, self.SIZE)
+
+        self.assertEqual(self.arena.blocks_in_use, len(sizes))
+        self.assertGreaterEqual(self.arena.bytes_in_use, sum(sizes))
+
+    def test_align(self):
+        """test the align param of alloc()"""
+        for align in (1, 8, 64, 256, 4096):
+            offset = self.arena.alloc(10, align=align)
+            self.assertEqual(offset % align, 0)
+            self.arena.free(offset)
+
+        with self.assertRaises(ValueError):
+            self.arena.alloc(10, align=3)
+        with self.assertRaises(ValueError):
+            self.arena.alloc(10, align=0)
+
+    def test_free_and_reuse(self):
+        """test that a freed block is reused for the same size class"""
+        offset = self.arena.alloc(100)
+        self.arena.free(offset)
+        self.assertEqual(self.arena.bytes_in_use, 0)
+        self.assertEqual(self.arena.alloc(90), offset)
+
+    def test_generation(self):
+        """test that reusing a block changes its generation"""
+        offset = self.arena.alloc(100)
+        generation = self.arena.generation(offset)
+        self.arena.free(offset)
+        with self.assertRaises(ValueError):
+            self.arena.generation(offset)
+        self.assertEqual(self.arena.alloc(100), offset)
+        self.assertNotEqual(self.arena.generation(offset), generation)
+
+    def test_bad_free(self):
+        """ensure ValueError is raised for offsets that aren't allocated blocks"""
+        offset = self.arena.alloc(100)
+
+        for bad_offset in (0, offset + 16, offset - 16, self.SIZE * 2):
+            with self.assertRaises(ValueError):
+                self.arena.free(bad_offset)
+
+        with self.assertRaises(ValueError):
+            self.arena.free(-1)
+        with self.assertRaises(TypeError):
+            self.arena.free('x')
+
+        self.arena.free(offset)
+
+        # double free
+        with self.assertRaises(ValueError):
+            self.arena.free(offset)
+
+    def test_bad_size(self):
+        """ensure bad sizes are rejected"""
+        with self.assertRaises(ValueError):
+            self.arena.alloc(-1)
+        with self.assertRaises(MemoryError):
+            self.arena.alloc(self.SIZE)
+
+    def test_full(self):
+        """test that MemoryError is raised when the arena is full"""
+        offsets = []
+        with self.assertRaises(MemoryError):
+            while True:
+                offsets.append(self.arena.alloc(1000))
+
+        self.assertTrue(offsets)
+        for offset in offsets:
+            self.arena.free(offset)
+        self.assertEqual(self.arena.blocks_in_use, 0)
+
+        # The space is available again.
+        self.arena.alloc(1000)
+
+
+if __name__ == '__main__':
+    unittest.main()
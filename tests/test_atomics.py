@@ -0,0 +1,122 @@
+# Python imports
+import os
+import sys
+import unittest
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+ORDERS = (sysv_ipc.ATOMIC_RELAXED, sysv_ipc.ATOMIC_ACQUIRE, sysv_ipc.ATOMIC_RELEASE,
+          sysv_ipc.ATOMIC_ACQ_REL, sysv_ipc.ATOMIC_SEQ_CST)
+
+
+class TestAtomics(Base):
+    """Exercise SharedMemory's atomic integer operations"""
+    def setUp(self):
+        self.mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, init_character=b'\0')
+
+    def tearDown(self):
+        if self.mem.attached:
+            self.mem.detach()
+        self.mem.remove()
+
+    def test_load_store(self):
+        """test atomic_load() and atomic_store() for both sizes"""
+        self.mem.atomic_store(8, -5)
+        self.assertEqual(self.mem.atomic_load(8), -5)
+        self.assertEqual(self.mem.read(8, 8), (-5).to_bytes(8, sys.byteorder, signed=True))
+
+        self.mem.atomic_store(4, 2 ** 31 - 1, size=4)
+        self.assertEqual(self.mem.atomic_load(4, size=4), 2 ** 31 - 1)
+        self.assertEqual(self.mem.atomic_load(0, size=4), 0)
+
+        self.mem.atomic_store(16, 7, order=sysv_ipc.ATOMIC_RELEASE)
+        self.assertEqual(self.mem.atomic_load(16, order=sysv_ipc.ATOMIC_ACQUIRE), 7)
+
+    def test_fetch_add(self):
+        """test that fetch_add() returns the previous value and wraps around"""
+        self.assertEqual(self.mem.fetch_add(0, 3), 0)
+        self.assertEqual(self.mem.fetch_add(0, -1), 3)
+        self.assertEqual(self.mem.atomic_load(0), 2)
+
+        self.mem.atomic_store(8, 2 ** 31 - 1, size=4)
+        self.assertEqual(self.mem.fetch_add(8, 1, size=4), 2 ** 31 - 1)
+        self.assertEqual(self.mem.atomic_load(8, size=4), -2 ** 31)
+
+    def test_exchange(self):
+        """test exchange()"""
+        self.mem.atomic_store(0, 10)
+        self.assertEqual(self.mem.exchange(0, 20), 10)
+        self.assertEqual(self.mem.atomic_load(0), 20)
+
+    def test_compare_exchange(self):
+        """test compare_exchange() when it succeeds and when it fails"""
+        self.mem.atomic_store(0, 1, size=4)
+        self.assertEqual(self.mem.compare_exchange(0, 1, 2, size=4), (True, 1))
+        self.assertEqual(self.mem.compare_exchange(0, 1, 3, size=4), (False, 2))
+        self.assertEqual(self.mem.atomic_load(0, size=4), 2)
+
+    def test_orders(self):
+        """test that every order is accepted where it's valid"""
+        for order in ORDERS:
+            self.mem.fetch_add(0, 1, order=order)
+            self.mem.exchange(8, 1, order=order)
+            self.mem.compare_exchange(16, 0, 0, order=order)
+            if order not in (sysv_ipc.ATOMIC_RELEASE, sysv_ipc.ATOMIC_ACQ_REL):
+                self.mem.atomic_load(0, order=order)
+            else:
+                with self.assertRaises(ValueError):
+                    self.mem.atomic_load(0, order=order)
+            if order not in (sysv_ipc.ATOMIC_ACQUIRE, sysv_ipc.ATOMIC_ACQ_REL):
+                self.mem.atomic_store(0, 1, order=order)
+            else:
+                with self.assertRaises(ValueError):
+                    self.mem.atomic_store(0, 1, order=order)
+        with self.assertRaises(ValueError):
+            self.mem.atomic_load(0, order=99)
+
+    def test_processes(self):
+        """test that increments from several processes aren't lost"""
+        pids = []
+        for i in range(4):
+            pid = os.fork()
+            if not pid:
+                try:
+                    for j in range(10000):
+                        self.mem.fetch_add(64, 1, size=4)
+                finally:
+                    os._exit(0)
+            pids.append(pid)
+        for pid in pids:
+            os.waitpid(pid, 0)
+        self.assertEqual(self.mem.atomic_load(64, size=4), 40000)
+
+    def test_errors(self):
+        """test bad offsets, sizes and values"""
+        with self.assertRaises(ValueError):
+            self.mem.atomic_load(4)
+        with self.assertRaises(ValueError):
+            self.mem.atomic_load(0, size=2)
+        with self.assertRaises(ValueError):
+            self.mem.atomic_load(self.mem.size)
+        with self.assertRaises(ValueError):
+            self.mem.atomic_load(self.mem.size - 4, size=8)
+        self.mem.atomic_load(self.mem.size - 4, size=4)
+        with self.assertRaises(OverflowError):
+            self.mem.atomic_store(0, 2 ** 31, size=4)
+        with self.assertRaises(OverflowError):
+            self.mem.atomic_store(0, 2 ** 63)
+
+        # Without write permission, the segment is attached read-only.
+        mem = sysv_ipc.SharedMemory(self.mem.key, mode=0o400)
+        self.assertEqual(mem.atomic_load(0), 0)
+        with self.assertRaises(OSError):
+            mem.fetch_add(0, 1)
+        mem.detach()
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            mem.atomic_load(0)
+
+
+if __name__ == '__main__':
+    unittest.main()
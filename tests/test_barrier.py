@@ -0,0 +1,175 @@
+# Python imports
+import unittest
+import threading
+import time
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+
+class TestBarrier(Base):
+    """Exercise the Barrier class"""
+    PARTIES = 3
+
+    def setUp(self):
+        self.barrier = sysv_ipc.Barrier(None, self.PARTIES, sysv_ipc.IPC_CREX)
+
+    def tearDown(self):
+        if self.barrier:
+            self.barrier.remove()
+
+    def test_attributes(self):
+        """test the barrier's attributes"""
+        self.assertEqual(self.barrier.parties, self.PARTIES)
+        self.assertEqual(self.barrier.n_waiting, 0)
+        self.assertIsInstance(self.barrier.id, int)
+
+    def test_open_existing(self):
+        """test opening an existing barrier with and without parties"""
+        other = sysv_ipc.Barrier(self.barrier.key)
+        self.assertEqual(other.id, self.barrier.id)
+        self.assertEqual(other.parties, self.PARTIES)
+        sysv_ipc.Barrier(self.barrier.key, self.PARTIES, sysv_ipc.IPC_CREAT)
+        with self.assertRaises(ValueError):
+            sysv_ipc.Barrier(self.barrier.key, self.PARTIES + 1)
+
+    def test_bad_params(self):
+        """ensure bad constructor params are rejected"""
+        with self.assertRaises(ValueError):
+            sysv_ipc.Barrier(None, 0, sysv_ipc.IPC_CREX)
+        with self.assertRaises(ValueError):
+            sysv_ipc.Barrier(None, -1, sysv_ipc.IPC_CREX)
+        with self.assertRaises(ValueError):
+            sysv_ipc.Barrier(None, sysv_ipc.SEMAPHORE_VALUE_MAX + 1, sysv_ipc.IPC_CREX)
+        with self.assertRaises(sysv_ipc.ExistentialError):
+            sysv_ipc.Barrier(self.barrier.key, self.PARTIES, sysv_ipc.IPC_CREX)
+
+    def test_phases(self):
+        """test that no party starts a phase before every party finishes the last one"""
+        phases = 50
+        progress = [0] * self.PARTIES
+        failures = []
+
+        def party(n):
+            # Each party uses its own object, as separate processes would.
+            barrier = sysv_ipc.Barrier(self.barrier.key)
+            for phase in range(phases):
+                progress[n] = phase
+                barrier.wait()
+                if min(progress) < phase:
+                    failures.append((n, phase, list(progress)))
+
+        threads = [threading.Thread(target=party, args=(n, )) for n in range(self.PARTIES)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        self.assertEqual(failures, [])
+
+    def test_stale_object(self):
+        """test that an object that sat out some phases finds the current one"""
+        others = [sysv_ipc.Barrier(self.barrier.key) for _ in range(self.PARTIES - 1)]
+
+        def others_wait(barrier):
+            threads = [threading.Thread(target=other.wait) for other in others]
+            for thread in threads:
+                thread.start()
+            barrier.wait()
+            for thread in threads:
+                thread.join()
+
+        # Move the barrier on through two phases without self.barrier.
+        for _ in range(2):
+            others_wait(sysv_ipc.Barrier(self.barrier.key))
+
+        others_wait(self.barrier)
+
+    def test_zero_timeout(self):
+        """test that a timeout withdraws the party from the barrier"""
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.barrier.wait(0)
+        self.assertEqual(self.barrier.n_waiting, 0)
+
+        # The barrier still needs all of the parties.
+        others = [sysv_ipc.Barrier(self.barrier.key) for _ in range(self.PARTIES - 1)]
+        threads = [threading.Thread(target=other.wait) for other in others]
+        for thread in threads:
+            thread.start()
+        for _ in range(500):
+            if self.barrier.n_waiting == self.PARTIES - 1:
+                break
+            time.sleep(.01)
+        self.assertEqual(self.barrier.n_waiting, self.PARTIES - 1)
+        self.barrier.wait()
+        for thread in threads:
+            thread.join()
+
+    @unittest.skipUnless(sysv_ipc.SEMAPHORE_TIMEOUT_SUPPORTED, "Requires Semaphore timeout support")
+    def test_timeout(self):
+        """test that a nonzero timeout waits and then raises BusyError"""
+        start = time.monotonic()
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.barrier.wait(timeout=.2)
+        self.assertGreaterEqual(time.monotonic() - start, .15)
+
+    def test_remove(self):
+        """test that remove() deletes the semaphore set"""
+        self.barrier.remove()
+        with self.assertRaises(sysv_ipc.ExistentialError):
+            sysv_ipc.Barrier(self.barrier.key)
+        self.barrier = None
+
+
+class TestCountDownLatch(Base):
+    """Exercise the CountDownLatch class"""
+    def setUp(self):
+        self.latch = sysv_ipc.CountDownLatch(None, 2, sysv_ipc.IPC_CREX)
+
+    def tearDown(self):
+        self.latch.remove()
+
+    def test_count_down(self):
+        """test that wait() returns once the count reaches zero"""
+        self.assertEqual(self.latch.count, 2)
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.latch.wait(0)
+        self.latch.count_down()
+        self.assertEqual(self.latch.count, 1)
+        self.latch.count_down()
+        self.assertEqual(self.latch.count, 0)
+        self.latch.wait()
+        self.latch.wait(0)
+
+        # Counting down past zero does nothing.
+        self.latch.count_down()
+        self.assertEqual(self.latch.count, 0)
+
+    def test_waiters_released(self):
+        """test that every waiting thread is released"""
+        other = sysv_ipc.CountDownLatch(self.latch.key)
+        threads = [threading.Thread(target=other.wait) for _ in range(4)]
+        for thread in threads:
+            thread.start()
+        self.latch.count_down()
+        self.latch.count_down()
+        for thread in threads:
+            thread.join()
+
+    def test_bad_params(self):
+        """ensure bad constructor params are rejected"""
+        with self.assertRaises(ValueError):
+            sysv_ipc.CountDownLatch(None, -1, sysv_ipc.IPC_CREX)
+        with self.assertRaises(ValueError):
+            sysv_ipc.CountDownLatch(None, 1)
+        # A count that would be ignored is refused.
+        with self.assertRaises(ValueError):
+            sysv_ipc.CountDownLatch(self.latch.key, 1)
+        with self.assertRaises(ValueError):
+            sysv_ipc.CountDownLatch(self.latch.key, 1, sysv_ipc.IPC_CREAT)
+        self.assertEqual(sysv_ipc.CountDownLatch(self.latch.key, 0, sysv_ipc.IPC_CREAT).count, 2)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,157 @@
+# Python imports
+import os
+import threading
+import unittest
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+MASK64 = 2 ** 64 - 1
+PRIME64_1 = 0x9E3779B185EBCA87
+PRIME64_2 = 0xC2B2AE3D27D4EB4F
+PRIME64_3 = 0x165667B19E3779F9
+PRIME64_4 = 0x85EBCA77C2B2AE63
+PRIME64_5 = 0x27D4EB2F165667C5
+
+CRC32C_TABLE = []
+for n in range(256):
+    crc = n
+    for k in range(8):
+        crc = (crc >> 1) ^ 0x82F63B78 if crc & 1 else crc >> 1
+    CRC32C_TABLE.append(crc)
+
+
+def reference_crc32c(data, value=0):
+    """A slow but simple CRC-32C to check the module's against"""
+    crc = value ^ 0xFFFFFFFF
+    for byte in data:
+        crc = CRC32C_TABLE[(crc ^ byte) & 0xFF] ^ (crc >> 8)
+    return crc ^ 0xFFFFFFFF
+
+
+def rotl64(value, bits):
+    return ((value << bits) | (value >> (64 - bits))) & MASK64
+
+
+def xxh64_round(accumulator, value):
+    accumulator = (accumulator + value * PRIME64_2) & MASK64
+    return (rotl64(accumulator, 31) * PRIME64_1) & MASK64
+
+
+def reference_xxhash64(data, seed=0):
+    """A slow but simple XXH64 to check the module's against"""
+    length = len(data)
+    position = 0
+    if length >= 32:
+        v = [(seed + PRIME64_1 + PRIME64_2) & MASK64, (seed + PRIME64_2) & MASK64,
+             seed, (seed - PRIME64_1) & MASK64]
+        while length - position >= 32:
+            for i in range(4):
+                word = int.from_bytes(data[position:position + 8], 'little')
+                v[i] = xxh64_round(v[i], word)
+                position += 8
+        h = (rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18)) & MASK64
+        for accumulator in v:
+            h ^= xxh64_round(0, accumulator)
+            h = (h * PRIME64_1 + PRIME64_4) & MASK64
+    else:
+        h = (seed + PRIME64_5) & MASK64
+
+    h = (h + length) & MASK64
+    while length - position >= 8:
+        h ^= xxh64_round(0, int.from_bytes(data[position:position + 8], 'little'))
+        h = (rotl64(h, 27) * PRIME64_1 + PRIME64_4) & MASK64
+        position += 8
+    if length - position >= 4:
+        h ^= (int.from_bytes(data[position:position + 4], 'little') * PRIME64_1) & MASK64
+        h = (rotl64(h, 23) * PRIME64_2 + PRIME64_3) & MASK64
+        position += 4
+    while position < length:
+        h ^= (data[position] * PRIME64_5) & MASK64
+        h = (rotl64(h, 11) * PRIME64_1) & MASK64
+        position += 1
+
+    h ^= h >> 33
+    h = (h * PRIME64_2) & MASK64
+    h ^= h >> 29
+    h = (h * PRIME64_3) & MASK64
+    h ^= h >> 32
+    return h
+
+
+class TestChecksums(Base):
+    """Exercise SharedMemory.crc32c() and xxhash64()"""
+    def setUp(self):
+        self.mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=64 * 1024)
+        self.data = os.urandom(self.mem.size)
+        self.mem.write(self.data)
+
+    def tearDown(self):
+        if self.mem.attached:
+            self.mem.detach()
+        self.mem.remove()
+
+    def test_known_values(self):
+        """test against published check values"""
+        self.mem.write(b'123456789')
+        self.assertEqual(self.mem.crc32c(0, 9), 0xE3069283)
+        self.assertEqual(self.mem.crc32c(0, 0), 0)
+        self.assertEqual(self.mem.xxhash64(0, 0), 0xEF46DB3751D8E999)
+        self.mem.write(b'abc')
+        self.assertEqual(self.mem.xxhash64(0, 3), 0x44BC2CF5AD770999)
+
+    def test_ranges(self):
+        """test odd offsets and lengths against the reference versions"""
+        for offset in (0, 1, 3, 8):
+            for length in (0, 1, 7, 8, 31, 32, 33, 100, 4099):
+                data = self.data[offset:offset + length]
+                self.assertEqual(self.mem.crc32c(offset, length), reference_crc32c(data))
+                self.assertEqual(self.mem.xxhash64(offset, length), reference_xxhash64(data))
+
+    def test_whole_segment(self):
+        """test that the default range is the rest of the segment"""
+        self.assertEqual(self.mem.crc32c(), reference_crc32c(self.data))
+        self.assertEqual(self.mem.xxhash64(), reference_xxhash64(self.data))
+        self.assertEqual(self.mem.crc32c(5), reference_crc32c(self.data[5:]))
+        self.assertEqual(self.mem.crc32c(self.mem.size), 0)
+
+    def test_continue_and_seed(self):
+        """test that crc32c() continues from a value and xxhash64() takes a seed"""
+        crc = self.mem.crc32c(0, 1000)
+        self.assertEqual(self.mem.crc32c(1000, 3000, value=crc), self.mem.crc32c(0, 4000))
+        self.assertEqual(self.mem.xxhash64(0, 100, seed=12345),
+                         reference_xxhash64(self.data[:100], 12345))
+        self.assertNotEqual(self.mem.xxhash64(0, 100, seed=1), self.mem.xxhash64(0, 100))
+
+    def test_gil_released(self):
+        """test that hashing a large range from several threads agrees"""
+        self.mem.gil_release_threshold = 0
+        expected = self.mem.crc32c()
+        results = []
+        threads = [threading.Thread(target=lambda: results.append(self.mem.crc32c()))
+                   for i in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(results, [expected] * 4)
+
+    def test_errors(self):
+        """test bad ranges and an unattached segment"""
+        with self.assertRaises(ValueError):
+            self.mem.crc32c(self.mem.size + 1)
+        with self.assertRaises(ValueError):
+            self.mem.crc32c(1, self.mem.size)
+        with self.assertRaises(ValueError):
+            self.mem.xxhash64(0, -1)
+
+        self.mem.detach()
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            self.mem.crc32c()
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            self.mem.xxhash64()
+
+
+if __name__ == '__main__':
+    unittest.main()
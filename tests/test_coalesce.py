@@ -0,0 +1,144 @@
+# Python imports
+import time
+import unittest
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+
+class TestCoalescing(Base):
+    """Exercise the CoalescingWriter and CoalescingReader classes"""
+    def setUp(self):
+        self.mq = sysv_ipc.MessageQueue(None, sysv_ipc.IPC_CREX)
+        self.reader = sysv_ipc.CoalescingReader(self.mq)
+
+    def tearDown(self):
+        self.mq.remove()
+
+    def test_attributes(self):
+        """test the writer's and reader's attributes"""
+        with sysv_ipc.CoalescingWriter(self.mq, type=3) as writer:
+            self.assertIs(writer.queue, self.mq)
+            self.assertEqual(writer.type, 3)
+            self.assertIsNone(writer.max_delay)
+            self.assertEqual(writer.pending, 0)
+            self.assertFalse(writer.closed)
+        self.assertTrue(writer.closed)
+
+        self.assertIs(self.reader.queue, self.mq)
+        self.assertEqual(self.reader.type, 0)
+        self.assertEqual(self.reader.pending, 0)
+
+        with self.assertRaises(TypeError):
+            sysv_ipc.CoalescingWriter('not a queue')
+        with self.assertRaises(ValueError):
+            sysv_ipc.CoalescingWriter(self.mq, type=0)
+        with self.assertRaises(ValueError):
+            sysv_ipc.CoalescingWriter(self.mq, max_delay=-1)
+
+    def test_flush(self):
+        """test that messages are sent as one frame when flushed"""
+        writer = sysv_ipc.CoalescingWriter(self.mq)
+        messages = [b'%032d' % i for i in range(10)] + [b'']
+        for message in messages:
+            writer.write(message)
+        self.assertEqual(writer.pending, len(messages))
+        self.assertEqual(self.mq.current_messages, 0)
+
+        writer.flush()
+        self.assertEqual(writer.pending, 0)
+        self.assertEqual(self.mq.current_messages, 1)
+
+        self.assertEqual([self.reader.read() for message in messages], messages)
+        self.assertEqual(self.reader.pending, 0)
+        writer.close()
+
+    def test_flush_when_full(self):
+        """test that a full frame is sent before a message that doesn't fit"""
+        writer = sysv_ipc.CoalescingWriter(self.mq)
+        # The default max_message_size is 2048, and each message takes 36
+        # bytes with its length, so 56 messages fit in a frame.
+        messages = [b'%032d' % i for i in range(100)]
+        for message in messages:
+            writer.write(message)
+        self.assertEqual(self.mq.current_messages, 1)
+        self.assertEqual(writer.pending, 100 - 56)
+
+        writer.close()
+        self.assertEqual(self.mq.current_messages, 2)
+        self.assertEqual([self.reader.read() for message in messages], messages)
+
+    def test_max_delay(self):
+        """test that a frame is sent once its first message has waited max_delay"""
+        with sysv_ipc.CoalescingWriter(self.mq, max_delay=0.05) as writer:
+            self.assertEqual(writer.max_delay, 0.05)
+            start = time.monotonic()
+            writer.write(b'late')
+            self.assertEqual(self.reader.read(timeout=5), b'late')
+            self.assertGreaterEqual(time.monotonic() - start, 0.04)
+            self.assertEqual(writer.pending, 0)
+
+    def test_too_large(self):
+        """test that a message that can't fit in a frame is refused"""
+        writer = sysv_ipc.CoalescingWriter(self.mq)
+        writer.write(b'x' * (2048 - 4))
+        with self.assertRaises(ValueError):
+            writer.write(b'x' * (2048 - 3))
+        writer.close()
+        self.assertEqual(len(self.reader.read()), 2048 - 4)
+
+    def test_busy(self):
+        """test that a frame that can't be sent is kept"""
+        writer = sysv_ipc.CoalescingWriter(self.mq)
+        # Fill the queue, topping it up byte by byte.
+        for size in (2000, 1):
+            with self.assertRaises(sysv_ipc.BusyError):
+                while True:
+                    self.mq.send(b'x' * size, block=False)
+        writer.write(b'kept')
+        with self.assertRaises(sysv_ipc.BusyError):
+            writer.flush(block=False)
+        self.assertEqual(writer.pending, 1)
+        with self.assertRaises(sysv_ipc.BusyError):
+            writer.flush(timeout=0.05)
+
+        while self.mq.current_messages:
+            self.mq.receive()
+        writer.flush(block=False)
+        self.assertEqual(self.reader.read(), b'kept')
+        writer.close()
+
+        with self.assertRaises(ValueError):
+            writer.write(b'closed')
+        with self.assertRaises(ValueError):
+            writer.flush()
+        # close() is harmless on a closed writer.
+        writer.close()
+
+    def test_spill_arena_framing(self):
+        """test that frames work on a queue with a spill_arena"""
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=64 * 1024)
+        self.mq.spill_arena = sysv_ipc.SharedArena(mem, init=True)
+
+        with sysv_ipc.CoalescingWriter(self.mq) as writer:
+            writer.write(b'one')
+            writer.write(b'two')
+        self.assertEqual(self.reader.read(), b'one')
+        self.assertEqual(self.reader.read(), b'two')
+
+        self.mq.spill_arena = None
+        mem.detach()
+        mem.remove()
+
+    def test_not_a_frame(self):
+        """test that a message from send() is refused"""
+        self.mq.send(b'\x10\x00\x00\x00short')
+        with self.assertRaises(ValueError):
+            self.reader.read()
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.reader.read(block=False)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,94 @@
+# Python imports
+import unittest
+import threading
+import time
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+
+class TestEvent(Base):
+    """Exercise the Event class"""
+    def setUp(self):
+        self.event = sysv_ipc.Event(None, sysv_ipc.IPC_CREX)
+
+    def tearDown(self):
+        if self.event:
+            self.event.remove()
+
+    def wait_for(self, condition):
+        """Polls condition() for up to 5 seconds"""
+        for _ in range(500):
+            if condition():
+                return
+            time.sleep(.01)
+        self.fail("Timed out waiting for condition")
+
+    def test_attributes(self):
+        """test the event's initial state"""
+        self.assertFalse(self.event.is_set())
+        self.assertEqual(self.event.n_waiting, 0)
+        self.assertIsInstance(self.event.id, int)
+
+    def test_set_and_clear(self):
+        """test that set() and clear() are idempotent"""
+        self.event.set()
+        self.event.set()
+        self.assertTrue(self.event.is_set())
+        self.event.wait()
+        self.event.wait(0)
+        self.assertTrue(self.event.is_set())
+
+        self.event.clear()
+        self.event.clear()
+        self.assertFalse(self.event.is_set())
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.event.wait(0)
+
+    def test_open_existing(self):
+        """test that IPC_CREAT doesn't change an existing event"""
+        self.event.set()
+        other = sysv_ipc.Event(self.event.key, sysv_ipc.IPC_CREAT)
+        self.assertEqual(other.id, self.event.id)
+        self.assertTrue(other.is_set())
+
+    def test_broadcast(self):
+        """test that one set() wakes every waiter"""
+        waiters = 8
+        other = sysv_ipc.Event(self.event.key)
+        threads = [threading.Thread(target=other.wait) for _ in range(waiters)]
+        for thread in threads:
+            thread.start()
+        self.wait_for(lambda: self.event.n_waiting == waiters)
+
+        self.event.set()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(self.event.n_waiting, 0)
+
+    @unittest.skipUnless(sysv_ipc.SEMAPHORE_TIMEOUT_SUPPORTED, "Requires Semaphore timeout support")
+    def test_timeout(self):
+        """test that a nonzero timeout waits and then raises BusyError"""
+        start = time.monotonic()
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.event.wait(timeout=.2)
+        self.assertGreaterEqual(time.monotonic() - start, .15)
+
+    def test_bad_params(self):
+        """ensure bad constructor params are rejected"""
+        with self.assertRaises(ValueError):
+            sysv_ipc.Event(None)
+        with self.assertRaises(sysv_ipc.ExistentialError):
+            sysv_ipc.Event(self.event.key, sysv_ipc.IPC_CREX)
+
+    def test_remove(self):
+        """test that remove() deletes the semaphore"""
+        self.event.remove()
+        with self.assertRaises(sysv_ipc.ExistentialError):
+            sysv_ipc.Event(self.event.key)
+        self.event = None
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,252 @@
+# Python imports
+import unittest
+import os
+import signal
+import sys
+import threading
+import time
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+CONDITION_OFFSET = 64
+COUNTER_OFFSET = 128
+
+
+class FutexTestBase(Base):
+    """base class for SharedMutex and SharedCondition test classes"""
+    def setUp(self):
+        self.mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=4096)
+        self.mutex = sysv_ipc.SharedMutex(self.mem, init=True)
+        self.condition = sysv_ipc.SharedCondition(self.mem, CONDITION_OFFSET, init=True)
+
+    def tearDown(self):
+        if self.mem.attached:
+            self.mem.detach()
+        self.mem.remove()
+
+    def wait_for(self, condition):
+        """Polls condition() for up to 5 seconds"""
+        for _ in range(500):
+            if condition():
+                return
+            time.sleep(.01)
+        self.fail("Timed out waiting for condition")
+
+
+class TestSharedMutex(FutexTestBase):
+    """Exercise the SharedMutex class"""
+    def test_attributes(self):
+        """test the mutex's attributes"""
+        self.assertIs(self.mutex.memory, self.mem)
+        self.assertEqual(self.mutex.offset, 0)
+        self.assertFalse(self.mutex.robust)
+        self.assertFalse(self.mutex.locked)
+        self.assertIsNone(self.mutex.owner)
+        self.assertFalse(self.mutex.owner_died)
+        self.assertIsInstance(sysv_ipc.FUTEX_SUPPORTED, bool)
+
+    def test_acquire_release(self):
+        """test acquire(), release() and the context manager"""
+        self.mutex.acquire()
+        self.assertTrue(self.mutex.locked)
+        self.assertEqual(self.mutex.owner, os.getpid())
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mutex.acquire(0)
+        self.mutex.release()
+        self.assertFalse(self.mutex.locked)
+
+        with self.mutex:
+            self.assertTrue(self.mutex.locked)
+        self.assertFalse(self.mutex.locked)
+
+    def test_release_not_held(self):
+        """ensure releasing a mutex that isn't held raises ValueError"""
+        with self.assertRaises(ValueError):
+            self.mutex.release()
+
+    def test_timeout(self):
+        """test that a nonzero timeout waits and then raises BusyError"""
+        self.mutex.acquire()
+        start = time.monotonic()
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mutex.acquire(timeout=.2)
+        self.assertGreaterEqual(time.monotonic() - start, .15)
+        self.mutex.release()
+
+    def test_open_existing(self):
+        """test that a second object shares the mutex"""
+        other = sysv_ipc.SharedMutex(self.mem)
+        with other:
+            self.assertTrue(self.mutex.locked)
+
+    def test_bad_params(self):
+        """ensure bad constructor params are rejected"""
+        with self.assertRaises(TypeError):
+            sysv_ipc.SharedMutex(42)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedMutex(self.mem, offset=8)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedMutex(self.mem, offset=4, init=True)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedMutex(self.mem, offset=self.mem.size, init=True)
+
+    def test_threads(self):
+        """test that the mutex serializes threads"""
+        def worker():
+            other = sysv_ipc.SharedMutex(self.mem)
+            for _ in range(1000):
+                with other:
+                    value = int.from_bytes(self.mem.read(4, COUNTER_OFFSET), 'little')
+                    self.mem.write((value + 1).to_bytes(4, 'little'), COUNTER_OFFSET)
+
+        self.mem.write(bytes(4), COUNTER_OFFSET)
+        threads = [threading.Thread(target=worker) for _ in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        self.assertEqual(int.from_bytes(self.mem.read(4, COUNTER_OFFSET), 'little'), 4000)
+
+    def test_detach_while_waiting(self):
+        """ensure the segment can't be detached while a thread waits in it"""
+        self.mutex.acquire()
+        thread = threading.Thread(target=self.mutex.acquire)
+        thread.start()
+        # Wait until the waiter has set the mutex word's waiters bit.
+        self.wait_for(lambda: int.from_bytes(self.mem.read(4, 4), sys.byteorder) & 0x80000000)
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mem.detach()
+        self.mutex.release()
+        thread.join()
+        self.mutex.release()
+
+    @unittest.skipUnless(hasattr(os, 'fork'), "Requires fork()")
+    def test_robust(self):
+        """test that a robust mutex is taken over from a dead owner"""
+        pid = os.fork()
+        if not pid:
+            # Take the mutex and die without releasing it.
+            sysv_ipc.SharedMutex(self.mem).acquire()
+            os._exit(0)
+        os.waitpid(pid, 0)
+
+        self.assertEqual(self.mutex.owner, pid)
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mutex.acquire(0)
+
+        robust = sysv_ipc.SharedMutex(self.mem, robust=True)
+        robust.acquire(timeout=5)
+        self.assertTrue(robust.owner_died)
+        self.assertEqual(robust.owner, os.getpid())
+        robust.release()
+
+        robust.acquire()
+        self.assertFalse(robust.owner_died)
+        robust.release()
+
+
+class TestSharedCondition(FutexTestBase):
+    """Exercise the SharedCondition class"""
+    def test_attributes(self):
+        """test the condition's attributes"""
+        self.assertIs(self.condition.memory, self.mem)
+        self.assertEqual(self.condition.offset, CONDITION_OFFSET)
+        self.assertEqual(self.condition.n_waiting, 0)
+
+    def test_wait_notify(self):
+        """test that notify() wakes a waiter, which then holds the mutex"""
+        ready = []
+
+        def waiter():
+            with self.mutex:
+                while not ready:
+                    self.condition.wait(self.mutex)
+                self.assertEqual(self.mutex.owner, os.getpid())
+
+        thread = threading.Thread(target=waiter)
+        thread.start()
+        self.wait_for(lambda: self.condition.n_waiting == 1)
+        with self.mutex:
+            ready.append(True)
+            self.condition.notify()
+        thread.join()
+        self.assertFalse(self.mutex.locked)
+
+    def test_notify_all(self):
+        """test that notify_all() wakes every waiter"""
+        waiters = 4
+        ready = []
+
+        def waiter():
+            with self.mutex:
+                while not ready:
+                    self.condition.wait(self.mutex)
+
+        threads = [threading.Thread(target=waiter) for _ in range(waiters)]
+        for thread in threads:
+            thread.start()
+        self.wait_for(lambda: self.condition.n_waiting == waiters)
+        with self.mutex:
+            ready.append(True)
+            self.condition.notify_all()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(self.condition.n_waiting, 0)
+
+    def test_timeout(self):
+        """test that a timeout raises BusyError with the mutex reacquired"""
+        with self.mutex:
+            with self.assertRaises(sysv_ipc.BusyError):
+                self.condition.wait(self.mutex, timeout=.1)
+            self.assertEqual(self.mutex.owner, os.getpid())
+
+    @unittest.skipUnless(hasattr(os, 'fork'), "Requires fork()")
+    def test_signal_while_reacquiring(self):
+        """test that a signal doesn't stop wait() from reacquiring the mutex"""
+        signals = []
+        old_handler = signal.signal(signal.SIGUSR1, lambda signum, frame: signals.append(signum))
+        parent = os.getpid()
+        pid = os.fork()
+        if not pid:
+            try:
+                mutex = sysv_ipc.SharedMutex(self.mem)
+                condition = sysv_ipc.SharedCondition(self.mem, CONDITION_OFFSET)
+                while not condition.n_waiting:
+                    time.sleep(.01)
+                # Wake the parent but keep the mutex, so that it's signaled
+                # while waiting for the mutex rather than for the condition.
+                with mutex:
+                    condition.notify()
+                    time.sleep(.2)
+                    os.kill(parent, signal.SIGUSR1)
+                    time.sleep(.2)
+            finally:
+                os._exit(0)
+
+        try:
+            with self.mutex:
+                with self.assertRaises(sysv_ipc.Error):
+                    self.condition.wait(self.mutex, timeout=5)
+                self.assertEqual(self.mutex.owner, os.getpid())
+        finally:
+            os.waitpid(pid, 0)
+            signal.signal(signal.SIGUSR1, old_handler)
+        self.assertEqual(signals, [signal.SIGUSR1])
+
+    def test_bad_params(self):
+        """ensure bad params are rejected"""
+        with self.assertRaises(ValueError):
+            self.condition.wait(self.mutex)
+        with self.assertRaises(TypeError):
+            self.condition.wait(42)
+        with self.assertRaises(ValueError):
+            self.condition.notify(0)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedCondition(self.mem, offset=8)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,223 @@
+# Python imports
+import struct
+import unittest
+import threading
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+
+class SharedHashMapTestBase(Base):
+    """base class for SharedHashMap test classes"""
+    CAPACITY = 100
+    KEY_SIZE = 8
+    VALUE_SIZE = 4
+
+    def setUp(self):
+        size = sysv_ipc.SharedHashMap.required_size(self.CAPACITY, self.KEY_SIZE,
+                                                    self.VALUE_SIZE)
+        self.mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=size)
+        self.map = sysv_ipc.SharedHashMap(self.mem, capacity=self.CAPACITY,
+                                          key_size=self.KEY_SIZE,
+                                          value_size=self.VALUE_SIZE, init=True)
+
+    def tearDown(self):
+        if self.mem.attached:
+            self.mem.detach()
+        self.mem.remove()
+
+    @staticmethod
+    def key(n):
+        return n.to_bytes(8, 'little')
+
+    @staticmethod
+    def value(n):
+        return n.to_bytes(4, 'little')
+
+
+class TestSharedHashMapCreation(SharedHashMapTestBase):
+    """Exercise the SharedHashMap constructor"""
+    def test_attributes(self):
+        """test the table's attributes"""
+        self.assertIs(self.map.memory, self.mem)
+        self.assertEqual(self.map.offset, 0)
+        # The capacity is rounded up to a power of 2.
+        self.assertEqual(self.map.capacity, 128)
+        self.assertEqual(self.map.key_size, self.KEY_SIZE)
+        self.assertEqual(self.map.value_size, self.VALUE_SIZE)
+        self.assertEqual(len(self.map), 0)
+        self.assertEqual(self.map.tombstones, 0)
+
+    def test_open_existing(self):
+        """test that a second object sees the same table"""
+        self.map.put(self.key(1), self.value(1))
+
+        mem = sysv_ipc.attach(self.mem.id)
+        try:
+            other = sysv_ipc.SharedHashMap(mem)
+            self.assertEqual(other.key_size, self.KEY_SIZE)
+            self.assertEqual(other.get(self.key(1)), self.value(1))
+            other.put(self.key(2), self.value(2))
+            self.assertEqual(self.map.get(self.key(2)), self.value(2))
+        finally:
+            mem.detach()
+
+    def test_no_table(self):
+        """ensure ValueError is raised if there's no table at the offset"""
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedHashMap(self.mem, offset=8)
+
+    def test_mismatched_params(self):
+        """ensure ValueError is raised if the params don't match the existing table"""
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedHashMap(self.mem, key_size=4)
+
+    def test_bad_params(self):
+        """ensure bad constructor params are rejected"""
+        with self.assertRaises(TypeError):
+            sysv_ipc.SharedHashMap(42)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedHashMap(self.mem, capacity=10, key_size=0, init=True)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedHashMap(self.mem, capacity=0, key_size=4, init=True)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedHashMap(self.mem, capacity=1000, key_size=8, init=True)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedHashMap(self.mem, offset=4, capacity=10, key_size=8, init=True)
+
+    def test_required_size(self):
+        """test that required_size() is enough and rounds up the capacity"""
+        self.assertEqual(sysv_ipc.SharedHashMap.required_size(100, 8, 4),
+                         sysv_ipc.SharedHashMap.required_size(128, 8, 4))
+        self.assertLess(sysv_ipc.SharedHashMap.required_size(128, 8, 4),
+                        sysv_ipc.SharedHashMap.required_size(129, 8, 4))
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedHashMap.required_size(2 ** 63, 8, 4)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedHashMap.required_size(2 ** 61, 2 ** 32 - 1, 2 ** 32 - 1)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedHashMap.required_size(100, 2 ** 32, 4)
+
+    def test_corrupt_capacity(self):
+        """ensure a table whose capacity isn't a power of 2 is rejected"""
+        self.mem.write(struct.pack('=Q', 100), 16)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SharedHashMap(self.mem)
+
+
+class TestSharedHashMapOperations(SharedHashMapTestBase):
+    """Exercise get(), put(), delete() and items()"""
+    def test_put_get(self):
+        """test storing and retrieving values"""
+        for i in range(50):
+            self.map.put(self.key(i), self.value(i * 10))
+
+        self.assertEqual(len(self.map), 50)
+        for i in range(50):
+            self.assertEqual(self.map.get(self.key(i)), self.value(i * 10))
+
+    def test_replace(self):
+        """test that put() replaces the value of an existing key"""
+        self.map.put(self.key(1), self.value(1))
+        self.map.put(self.key(1), self.value(2))
+        self.assertEqual(len(self.map), 1)
+        self.assertEqual(self.map.get(self.key(1)), self.value(2))
+
+    def test_get_default(self):
+        """test get() for a missing key"""
+        self.assertIsNone(self.map.get(self.key(1)))
+        self.assertEqual(self.map.get(self.key(1), b'nope'), b'nope')
+        self.assertEqual(self.map.get(self.key(1), default=42), 42)
+
+    def test_delete(self):
+        """test that delete() removes a key and leaves a tombstone"""
+        self.map.put(self.key(1), self.value(1))
+        self.map.put(self.key(2), self.value(2))
+        self.map.delete(self.key(1))
+
+        self.assertEqual(len(self.map), 1)
+        self.assertEqual(self.map.tombstones, 1)
+        self.assertIsNone(self.map.get(self.key(1)))
+        self.assertEqual(self.map.get(self.key(2)), self.value(2))
+
+        with self.assertRaises(KeyError):
+            self.map.delete(self.key(1))
+
+        # Reinserting reuses the tombstone.
+        self.map.put(self.key(1), self.value(3))
+        self.assertEqual(self.map.tombstones, 0)
+        self.assertEqual(self.map.get(self.key(1)), self.value(3))
+
+    def test_items(self):
+        """test items()"""
+        expected = {self.key(i): self.value(i) for i in range(20)}
+        for key, value in expected.items():
+            self.map.put(key, value)
+        self.map.delete(self.key(5))
+        del expected[self.key(5)]
+
+        self.assertEqual(dict(self.map.items()), expected)
+
+    def test_mapping_protocol(self):
+        """test [], del and in"""
+        self.map[self.key(1)] = self.value(1)
+        self.assertEqual(self.map[self.key(1)], self.value(1))
+        self.assertIn(self.key(1), self.map)
+        self.assertNotIn(self.key(2), self.map)
+        del self.map[self.key(1)]
+        with self.assertRaises(KeyError):
+            self.map[self.key(1)]
+        with self.assertRaises(KeyError):
+            del self.map[self.key(1)]
+
+    def test_full(self):
+        """test that MemoryError is raised when every bucket is used"""
+        for i in range(self.map.capacity):
+            self.map.put(self.key(i), self.value(i))
+
+        with self.assertRaises(MemoryError):
+            self.map.put(self.key(self.map.capacity), self.value(0))
+
+        # Existing keys can still be updated and found.
+        self.map.put(self.key(0), self.value(99))
+        self.assertEqual(self.map.get(self.key(0)), self.value(99))
+        self.assertIsNone(self.map.get(self.key(self.map.capacity)))
+
+    def test_bad_sizes(self):
+        """ensure keys and values of the wrong size are rejected"""
+        with self.assertRaises(ValueError):
+            self.map.put(b'short', self.value(1))
+        with self.assertRaises(ValueError):
+            self.map.put(self.key(1), b'too long')
+        with self.assertRaises(ValueError):
+            self.map.get(b'short')
+        with self.assertRaises(TypeError):
+            self.map.get(42)
+
+    def test_detached(self):
+        """ensure NotAttachedError is raised when the segment is detached"""
+        self.mem.detach()
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            self.map.get(self.key(1))
+
+    def test_threads(self):
+        """test concurrent writers and readers"""
+        def writer(start):
+            for i in range(start, start + 25):
+                self.map.put(self.key(i), self.value(i))
+                self.assertEqual(self.map.get(self.key(i)), self.value(i))
+
+        threads = [threading.Thread(target=writer, args=(n * 25, )) for n in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        self.assertEqual(len(self.map), 100)
+        self.assertEqual(dict(self.map.items()),
+                         {self.key(i): self.value(i) for i in range(100)})
+
+
+if __name__ == '__main__':
+    unittest.main()
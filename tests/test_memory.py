@@ -92,6 +92,20 @@ class TestSharedMemoryCreation(SharedMemoryTestBase):
         mem.detach()
         mem.remove()
 
+    def test_create_many(self):
+        """tests create_many()"""
+        mems = sysv_ipc.SharedMemory.create_many(3, size=100)
+        try:
+            self.assertEqual(len(mems), 3)
+            self.assertEqual(len(set(mem.key for mem in mems)), 3)
+            for mem in mems:
+                self.assertIsInstance(mem, sysv_ipc.SharedMemory)
+                self.assertEqual(mem.size, 100)
+        finally:
+            for mem in mems:
+                mem.detach()
+                mem.remove()
+
     # don't bother testing mode, it's ignored by the OS?
 
     def test_default_flags(self):
@@ -459,5 +473,122 @@ class BufferProtocolTest(unittest.TestCase):
         self.assertEqual([chr(c) for c in mv[:6]], ['x', 'x', 'x', 'd', 'x', 'f'])
 
 
+
+class TestSharedMemoryStats(SharedMemoryTestBase):
+    """Exercise collect_stats, stats() and reset_stats()"""
+    def test_stats_off_by_default(self):
+        """test that stats are not collected unless asked for"""
+        self.assertFalse(self.mem.collect_stats)
+        self.assertIsNone(self.mem.stats())
+
+    def test_stats_counts(self):
+        """test that read and write are counted"""
+        self.mem.collect_stats = True
+        self.mem.write(b'hello')
+        self.mem.read(5)
+
+        stats = self.mem.stats()
+        self.assertEqual(stats['ops'], 2)
+        self.assertEqual(stats['bytes'], 10)
+        self.assertEqual(stats['errors'], 0)
+
+    def test_delete_collect_stats(self):
+        """ensure collect_stats can't be deleted"""
+        with self.assertRaises(AttributeError):
+            del self.mem.collect_stats
+
+
+class TestSharedMemoryGilRelease(SharedMemoryTestBase):
+    """Exercise gil_release_threshold"""
+    def test_default(self):
+        """test the default value"""
+        self.assertEqual(self.mem.gil_release_threshold, sysv_ipc.SHM_GIL_RELEASE_THRESHOLD)
+
+    def test_set(self):
+        """test that the threshold can be changed"""
+        self.mem.gil_release_threshold = 10
+        self.assertEqual(self.mem.gil_release_threshold, 10)
+
+    def test_bad_values(self):
+        """ensure bad values are rejected"""
+        with self.assertRaises(ValueError):
+            self.mem.gil_release_threshold = -1
+        with self.assertRaises(TypeError):
+            self.mem.gil_release_threshold = 'x'
+        with self.assertRaises(AttributeError):
+            del self.mem.gil_release_threshold
+
+    def test_read_write_without_gil(self):
+        """test that read() and write() work when every copy releases the GIL"""
+        self.mem.gil_release_threshold = 0
+        self.mem.write(b'abcdefg', 3)
+        self.assertEqual(self.mem.read(10), b'   abcdefg')
+        self.assertEqual(self.mem.read(), b'   abcdefg' + b' ' * (self.mem.size - 10))
+        self.mem.writev([(0, b'xyz')])
+        self.assertEqual(self.mem.readv([(0, 4)]), [b'xyza'])
+
+
+class TestSharedMemoryScatterGather(SharedMemoryTestBase):
+    """Exercise readv() and writev()"""
+    def test_writev_readv(self):
+        """test a round trip through writev() and readv()"""
+        self.mem.writev([(0, b'abc'), (10, b'defg'), (self.mem.size - 2, b'hi')])
+        self.assertEqual(self.mem.readv([(0, 3), (10, 4), (self.mem.size - 2, 2), (5, 0)]),
+                         [b'abc', b'defg', b'hi', b''])
+        self.assertEqual(self.mem.read(14), b'abc       defg')
+
+    def test_empty(self):
+        """test that empty sequences are allowed"""
+        self.mem.writev([])
+        self.assertEqual(self.mem.readv([]), [])
+
+    def test_large(self):
+        """test a copy big enough to be done with the GIL released"""
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=1024 * 1024)
+        try:
+            half = mem.size // 2
+            mem.writev([(0, b'a' * half), (half, b'b' * half)])
+            self.assertEqual(mem.readv([(0, half), (half, half)]), [b'a' * half, b'b' * half])
+        finally:
+            mem.detach()
+            mem.remove()
+
+    def test_writev_past_end_of_segment(self):
+        """ensure nothing is written if any chunk doesn't fit"""
+        with self.assertRaises(ValueError):
+            self.mem.writev([(0, b'abc'), (self.mem.size - 1, b'xx')])
+        with self.assertRaises(ValueError):
+            self.mem.writev([(self.mem.size + 1, b'')])
+        with self.assertRaises(ValueError):
+            self.mem.writev([(-1, b'x')])
+        self.assertEqual(self.mem.read(3), b'   ')
+
+    def test_readv_past_end_of_segment(self):
+        """ensure ValueError is raised if any range doesn't fit"""
+        with self.assertRaises(ValueError):
+            self.mem.readv([(0, 3), (self.mem.size - 1, 2)])
+        with self.assertRaises(ValueError):
+            self.mem.readv([(0, -1)])
+
+    def test_bad_items(self):
+        """ensure TypeError is raised for items that aren't tuples"""
+        with self.assertRaises(TypeError):
+            self.mem.writev([[0, b'abc']])
+        with self.assertRaises(TypeError):
+            self.mem.readv([0, 3])
+        with self.assertRaises(TypeError):
+            self.mem.readv(3)
+
+    def test_stats(self):
+        """test that each call counts as one op"""
+        self.mem.collect_stats = True
+        self.mem.writev([(0, b'abc'), (10, b'de')])
+        self.mem.readv([(0, 3), (10, 2)])
+
+        stats = self.mem.stats()
+        self.assertEqual(stats['ops'], 2)
+        self.assertEqual(stats['bytes'], 10)
+
+
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,111 @@
+# Python imports
+import os
+import threading
+import time
+import unittest
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+
+class TestMemoryWait(Base):
+    """Exercise SharedMemory.wait() and wake()"""
+    def setUp(self):
+        self.mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, init_character=b'\0')
+
+    def tearDown(self):
+        if self.mem.attached:
+            self.mem.detach()
+        self.mem.remove()
+
+    def test_value_already_changed(self):
+        """test that wait() returns at once if the word doesn't hold expected"""
+        self.mem.atomic_store(8, 5, size=4)
+        self.assertEqual(self.mem.wait(8, 4), 5)
+        self.assertEqual(self.mem.wait(8, 4, timeout=0), 5)
+
+    def test_timeout(self):
+        """test that wait() raises BusyError when it times out"""
+        start = time.monotonic()
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mem.wait(0, 0, timeout=0.05)
+        self.assertGreaterEqual(time.monotonic() - start, 0.04)
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mem.wait(0, 0, timeout=0)
+
+    def test_wake_thread(self):
+        """test that a thread waiting on a word wakes when it changes"""
+        results = []
+        thread = threading.Thread(target=lambda: results.append(self.mem.wait(0, 0, timeout=5)))
+        thread.start()
+        time.sleep(0.05)
+        self.mem.atomic_store(0, 1, size=4)
+        self.mem.wake(0)
+        thread.join()
+        self.assertEqual(results, [1])
+
+    def test_wake_without_change(self):
+        """test that wait() goes back to sleep if the word didn't change"""
+        results = []
+        thread = threading.Thread(target=lambda: results.append(self.mem.wait(0, 0, timeout=5)))
+        thread.start()
+        time.sleep(0.05)
+        self.mem.wake(0)
+        time.sleep(0.05)
+        self.assertTrue(thread.is_alive())
+        self.mem.atomic_store(0, -1, size=4)
+        self.mem.wake(0)
+        thread.join()
+        self.assertEqual(results, [-1])
+
+    @unittest.skipUnless(sysv_ipc.FUTEX_SUPPORTED, "Requires futex support")
+    def test_wake_processes(self):
+        """test that wake() wakes waiters in other processes"""
+        pids = []
+        for i in range(3):
+            pid = os.fork()
+            if not pid:
+                try:
+                    self.mem.wait(4, 0, timeout=5)
+                    self.mem.fetch_add(8, 1)
+                finally:
+                    os._exit(0)
+            pids.append(pid)
+
+        # A wake that doesn't change the word sends the waiters back to
+        # sleep, so this counts them until all three are asleep.
+        deadline = time.monotonic() + 5
+        while self.mem.wake(4, count=None) != 3:
+            self.assertLess(time.monotonic(), deadline)
+            time.sleep(0.01)
+
+        self.mem.atomic_store(4, 1, size=4)
+        self.mem.wake(4, count=None)
+        for pid in pids:
+            os.waitpid(pid, 0)
+        self.assertEqual(self.mem.atomic_load(8), 3)
+        self.assertEqual(self.mem.wake(4), 0)
+
+    def test_errors(self):
+        """test bad offsets, values and counts"""
+        with self.assertRaises(ValueError):
+            self.mem.wait(2, 0)
+        with self.assertRaises(ValueError):
+            self.mem.wait(self.mem.size, 0)
+        with self.assertRaises(OverflowError):
+            self.mem.wait(0, 2 ** 31)
+        with self.assertRaises(ValueError):
+            self.mem.wake(0, count=0)
+        with self.assertRaises(ValueError):
+            self.mem.wake(self.mem.size - 2)
+
+        self.mem.detach()
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            self.mem.wait(0, 0)
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            self.mem.wake(0)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -4,6 +4,7 @@ import time
 import os
 import numbers
 import sys
+import threading
 
 # Project imports
 import sysv_ipc
@@ -81,6 +82,19 @@ class TestMessageQueueCreation(MessageQueueTestBase):
         self.assertLessEqual(mq.key, sysv_ipc.KEY_MAX)
         mq.remove()
 
+    def test_create_many(self):
+        """tests create_many()"""
+        mqs = sysv_ipc.MessageQueue.create_many(3, mode=0o640)
+        try:
+            self.assertEqual(len(mqs), 3)
+            self.assertEqual(len(set(mq.key for mq in mqs)), 3)
+            for mq in mqs:
+                self.assertIsInstance(mq, sysv_ipc.MessageQueue)
+                self.assertEqual(mq.mode, 0o640)
+        finally:
+            for mq in mqs:
+                mq.remove()
+
     # don't bother testing mode, it's ignored by the OS?
 
     def test_default_flags(self):
@@ -208,6 +222,64 @@ class TestMessageQueueSendReceive(MessageQueueTestBase):
         self.mq.send(b'x', block=True, type=1)
         self.mq.receive(block=False, type=0)
 
+    def test_receive_timeout(self):
+        """Test that receive(timeout=n) waits up to n seconds, then raises BusyError"""
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.receive(timeout=0)
+
+        start = time.monotonic()
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.receive(timeout=0.2)
+        self.assertGreaterEqual(time.monotonic() - start, 0.19)
+
+        self.mq.send(b'x')
+        self.assertEqual(self.mq.receive(timeout=0.2), (b'x', 1))
+
+        # block=False wins over a timeout.
+        start = time.monotonic()
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.receive(block=False, timeout=5)
+        self.assertLess(time.monotonic() - start, 1)
+
+    def test_receive_timeout_woken(self):
+        """Test that a timed receive returns as soon as a message arrives"""
+        thread = threading.Thread(target=lambda: (time.sleep(0.1), self.mq.send(b'x')))
+        thread.start()
+        try:
+            start = time.monotonic()
+            self.assertEqual(self.mq.receive(timeout=5), (b'x', 1))
+            self.assertLess(time.monotonic() - start, 2)
+        finally:
+            thread.join()
+
+        # The alarm doesn't interrupt later calls.
+        self.mq.send(b'y')
+        time.sleep(0.1)
+        self.assertEqual(self.mq.receive(), (b'y', 1))
+
+    def test_send_timeout(self):
+        """Test that send(timeout=n) waits up to n seconds for room in the queue"""
+        self.mq.max_size = 10
+        self.mq.send(b' ' * 10)
+
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.send(b'x', timeout=0)
+
+        start = time.monotonic()
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.send(b'x', timeout=0.2)
+        self.assertGreaterEqual(time.monotonic() - start, 0.19)
+
+        self.mq.receive()
+        self.mq.send(b'x', timeout=0.2)
+
+    def test_bad_timeout(self):
+        """ensure bad timeouts are rejected"""
+        with self.assertRaises(TypeError):
+            self.mq.receive(timeout=-1)
+        with self.assertRaises(TypeError):
+            self.mq.send(b'x', timeout='x')
+
     def test_max_message_size_respected(self):
         '''ensure the max_message_size param is respected'''
         mq = sysv_ipc.MessageQueue(None, sysv_ipc.IPC_CREX, max_message_size=10)
@@ -340,5 +412,104 @@ class TestMessageQueuePropertiesAndAttributes(MessageQueueTestBase):
         self.assertWriteToReadOnlyPropertyFails('cgid', 42)
 
 
+
+class TestMessageQueueStats(MessageQueueTestBase):
+    """Exercise collect_stats, stats() and reset_stats()"""
+    def test_stats_off_by_default(self):
+        """test that stats are not collected unless asked for"""
+        self.assertFalse(self.mq.collect_stats)
+        self.assertIsNone(self.mq.stats())
+
+    def test_stats_counts(self):
+        """test that send and receive are counted"""
+        self.mq.collect_stats = True
+        self.mq.send(b'abc')
+        self.mq.receive()
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.receive(block=False)
+
+        stats = self.mq.stats()
+        self.assertEqual(stats['ops'], 3)
+        self.assertEqual(stats['bytes'], 6)
+        self.assertEqual(stats['errors'], 1)
+        self.assertEqual(stats['enomsg'], 1)
+        self.assertEqual(len(stats['histogram']), sysv_ipc.STATS_HISTOGRAM_BUCKETS)
+        self.assertEqual(sum(stats['histogram']), 3)
+
+    def test_stats_timeouts(self):
+        """test that timed out receives are counted as timeouts"""
+        self.mq.collect_stats = True
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.receive(timeout=0.01)
+
+        stats = self.mq.stats()
+        self.assertEqual(stats['errors'], 1)
+        self.assertEqual(stats['timeouts'], 1)
+
+    def test_stats_enabled_while_waiting(self):
+        """test that a call that started with stats off isn't counted"""
+        thread = threading.Thread(target=self.mq.receive)
+        thread.start()
+        # Queues don't count their waiters, so give the receive time to block.
+        time.sleep(.1)
+
+        self.mq.collect_stats = True
+        self.mq.send(b'abc')
+        thread.join()
+
+        stats = self.mq.stats()
+        self.assertEqual(stats['ops'], 1)
+        self.assertEqual(stats['histogram'][-1], 0)
+
+    def test_reset_stats(self):
+        """test that reset_stats() zeroes the counters"""
+        self.mq.collect_stats = True
+        self.mq.send(b'abc')
+        self.mq.reset_stats()
+        self.assertEqual(self.mq.stats()['ops'], 0)
+        self.mq.collect_stats = False
+        self.assertIsNone(self.mq.stats())
+
+    def test_share_stats(self):
+        """test that objects sharing a stats segment add to the same counters"""
+        # Borrow an unused key.
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX)
+        key = mem.key
+        mem.detach()
+        mem.remove()
+        mq_copy = sysv_ipc.MessageQueue(self.mq.key)
+
+        self.mq.share_stats(key)
+        mq_copy.share_stats(key)
+        self.assertTrue(self.mq.collect_stats)
+
+        self.mq.send(b'abcd')
+        mq_copy.receive()
+
+        self.assertEqual(self.mq.stats(), mq_copy.stats())
+        stats = sysv_ipc.shared_stats(key)
+        self.assertEqual(stats['ops'], 2)
+        self.assertEqual(stats['bytes'], 8)
+
+        # Turning collection off leaves the shared counters alone.
+        mq_copy.collect_stats = False
+        self.assertEqual(sysv_ipc.shared_stats(key)['ops'], 2)
+
+        self.mq.collect_stats = False
+        sysv_ipc.SharedMemory(key).remove()
+
+    def test_share_stats_not_stats(self):
+        """ensure share_stats() doesn't take over a segment it didn't create"""
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, init_character=b'\0')
+        with self.assertRaises(ValueError):
+            self.mq.share_stats(mem.key)
+        with self.assertRaises(ValueError):
+            sysv_ipc.shared_stats(mem.key)
+        self.assertEqual(mem.read(8), b'\0' * 8)
+        self.assertFalse(self.mq.collect_stats)
+        mem.detach()
+        mem.remove()
+
+
 if __name__ == '__main__':
     unittest.main()
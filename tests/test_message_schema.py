@@ -0,0 +1,152 @@
+# Python imports
+import struct
+import unittest
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+
+class TestMessageSchema(Base):
+    """Exercise the MessageSchema class"""
+    def test_attributes(self):
+        """test the schema's attributes"""
+        schema = sysv_ipc.MessageSchema('<iid')
+        self.assertEqual(schema.format, '<iid')
+        self.assertEqual(schema.size, 16)
+        self.assertEqual(schema.field_count, 3)
+        self.assertEqual(repr(schema), "sysv_ipc.MessageSchema('<iid')")
+
+    def test_sizes_match_struct(self):
+        """test that sizes, including native alignment, match the struct module"""
+        for format_ in ('<iid', 'bhiqd', '@bq', '@ci', '!HIQ10s', '=c?xfd',
+                        '3h2x4s', '> b B h H i I l L q Q f d'):
+            self.assertEqual(sysv_ipc.MessageSchema(format_).size,
+                             struct.calcsize(format_), format_)
+
+    def test_pack_unpack_match_struct(self):
+        """test that pack() and unpack() are interchangeable with struct's"""
+        cases = (
+            ('<bBhHiIlLqQfd', (-128, 255, -32768, 65535, -2 ** 31, 2 ** 32 - 1,
+                               -2 ** 31, 2 ** 32 - 1, -2 ** 63, 2 ** 64 - 1, 1.5, -2.25)),
+            ('>hq3s', (-2, 2 ** 40, b'abc')),
+            ('bhiqd?c5s', (1, -2, 3, -4, 5.0, True, b'c', b'ab')),
+            ('!xHx', (513, )),
+        )
+        for format_, values in cases:
+            schema = sysv_ipc.MessageSchema(format_)
+            packed = struct.pack(format_, *values)
+            self.assertEqual(schema.pack(*values), packed, format_)
+            self.assertEqual(schema.unpack(packed), struct.unpack(format_, packed), format_)
+
+    def test_bad_formats(self):
+        """test that unsupported formats are refused"""
+        for format_ in ('iZ', 'P', '3', 'e'):
+            with self.assertRaises(ValueError):
+                sysv_ipc.MessageSchema(format_)
+        with self.assertRaises(TypeError):
+            sysv_ipc.MessageSchema(b'i')
+
+    def test_bad_values(self):
+        """test that values that don't fit their fields are refused"""
+        schema = sysv_ipc.MessageSchema('bB')
+        with self.assertRaises(OverflowError):
+            schema.pack(128, 0)
+        with self.assertRaises(OverflowError):
+            schema.pack(0, -1)
+        with self.assertRaises(TypeError):
+            schema.pack(1.5, 0)
+        with self.assertRaises(TypeError):
+            schema.pack(1)
+        with self.assertRaises(TypeError):
+            sysv_ipc.MessageSchema('c').pack(b'ab')
+        with self.assertRaises(OverflowError):
+            sysv_ipc.MessageSchema('f').pack(1e300)
+        with self.assertRaises(ValueError):
+            schema.unpack(b'abc')
+
+
+class TestRecords(Base):
+    """Exercise MessageQueue.send_record() and receive_record()"""
+    def setUp(self):
+        self.mq = sysv_ipc.MessageQueue(None, sysv_ipc.IPC_CREX)
+        self.schema = sysv_ipc.MessageSchema('<qqddii')
+        self.mq.record_schema = self.schema
+
+    def tearDown(self):
+        self.mq.remove()
+
+    def test_record_schema_attribute(self):
+        """test the record_schema attribute"""
+        self.assertIs(self.mq.record_schema, self.schema)
+        self.mq.record_schema = None
+        self.assertIsNone(self.mq.record_schema)
+        with self.assertRaises(ValueError):
+            self.mq.send_record()
+        with self.assertRaises(ValueError):
+            self.mq.receive_record()
+        with self.assertRaises(TypeError):
+            self.mq.record_schema = '<qq'
+
+    def test_round_trip(self):
+        """test that a record is received as it was sent"""
+        values = (1, -2, 3.5, -4.25, 5, -6)
+        self.mq.send_record(*values, type=7)
+        self.assertEqual(self.mq.receive_record(), (values, 7))
+
+    def test_interoperates_with_send(self):
+        """test that records are struct-packed messages"""
+        values = (1, 2, 3.0, 4.0, 5, 6)
+        self.mq.send(struct.pack('<qqddii', *values))
+        self.assertEqual(self.mq.receive_record()[0], values)
+
+        self.mq.send_record(*values)
+        self.assertEqual(struct.unpack('<qqddii', self.mq.receive()[0]), values)
+
+    def test_wrong_size(self):
+        """test that a message that doesn't match the schema is refused"""
+        self.mq.send(b'short')
+        with self.assertRaises(ValueError):
+            self.mq.receive_record()
+
+        # A message longer than a record stays on the queue.
+        self.mq.send(b'x' * (self.schema.size + 1))
+        with self.assertRaises(OSError):
+            self.mq.receive_record()
+        self.assertEqual(self.mq.current_messages, 1)
+
+    def test_large_record(self):
+        """test a record too large for the stack buffer"""
+        self.mq.record_schema = sysv_ipc.MessageSchema('<i1500s')
+        self.mq.send_record(42, b'y' * 1500)
+        self.assertEqual(self.mq.receive_record(), ((42, b'y' * 1500), 1))
+
+    def test_spill_arena_framing(self):
+        """test that records work on a queue with a spill_arena"""
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=64 * 1024)
+        self.mq.spill_arena = sysv_ipc.SharedArena(mem, init=True)
+        self.mq.spill_threshold = 0
+
+        values = (1, 2, 3.0, 4.0, 5, 6)
+        self.mq.send_record(*values)
+        self.assertEqual(self.mq.receive_record()[0], values)
+
+        self.mq.spill_arena = None
+        mem.detach()
+        mem.remove()
+
+    def test_errors(self):
+        """test bad arguments to send_record() and receive_record()"""
+        with self.assertRaises(TypeError):
+            self.mq.send_record(1, 2)
+        with self.assertRaises(ValueError):
+            self.mq.send_record(1, 2, 3.0, 4.0, 5, 6, type=0)
+        with self.assertRaises(OverflowError):
+            self.mq.send_record(1, 2, 3.0, 4.0, 5, 2 ** 40)
+        self.assertEqual(self.mq.current_messages, 0)
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.receive_record(block=False)
+
+
+if __name__ == '__main__':
+    unittest.main()
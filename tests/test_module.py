@@ -20,6 +20,10 @@ class TestModuleConstants(Base):
         self.assertEqual(sysv_ipc.IPC_CREX, sysv_ipc.IPC_CREAT | sysv_ipc.IPC_EXCL)
         self.assertEqual(sysv_ipc.PAGE_SIZE, resource.getpagesize())
         self.assertIn(sysv_ipc.SEMAPHORE_TIMEOUT_SUPPORTED, (True, False))
+        self.assertIn(sysv_ipc.NUMA_SUPPORTED, (True, False))
+        for attr_name in ('ATOMIC_RELAXED', 'ATOMIC_ACQUIRE', 'ATOMIC_RELEASE', 'ATOMIC_ACQ_REL',
+                          'ATOMIC_SEQ_CST'):
+            self.assertIsInstance(getattr(sysv_ipc, attr_name), numbers.Integral)
         self.assertIsInstance(sysv_ipc.SEMAPHORE_VALUE_MAX, numbers.Integral)
         self.assertGreaterEqual(sysv_ipc.SEMAPHORE_VALUE_MAX, 1)
         self.assertIsInstance(sysv_ipc.VERSION, str)
@@ -151,6 +155,23 @@ class TestModuleFunctions(Base):
         with self.assertRaises(sysv_ipc.ExistentialError):
             sysv_ipc.MessageQueue(mq.key)
 
+    def test_shared_stats(self):
+        """Exercise shared_stats()"""
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX)
+
+        # The segment is filled with spaces, so it doesn't hold stats.
+        with self.assertRaises(ValueError):
+            sysv_ipc.shared_stats(mem.key)
+
+        mem.detach()
+        mem.remove()
+
+        with self.assertRaises(sysv_ipc.ExistentialError):
+            sysv_ipc.shared_stats(mem.key)
+
+        with self.assertRaises(ValueError):
+            sysv_ipc.shared_stats(None)
+
 
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,120 @@
+# Python imports
+import unittest
+import os
+import selectors
+import threading
+import time
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+
+class TestNotifier(Base):
+    """Exercise the Notifier class"""
+    def setUp(self):
+        self.mq = sysv_ipc.MessageQueue(None, sysv_ipc.IPC_CREX)
+        self.sem = sysv_ipc.Semaphore(None, sysv_ipc.IPC_CREX)
+        self.selector = selectors.DefaultSelector()
+
+    def tearDown(self):
+        self.selector.close()
+        self.mq.remove()
+        self.sem.remove()
+
+    def ready_notifiers(self, timeout):
+        return [key.fileobj for key, events in self.selector.select(timeout)]
+
+    def test_attributes(self):
+        """test the notifier's attributes and context manager support"""
+        with sysv_ipc.Notifier(self.mq) as notifier:
+            self.assertIs(notifier.object, self.mq)
+            self.assertFalse(notifier.closed)
+            self.assertIsInstance(notifier.fileno(), int)
+        self.assertTrue(notifier.closed)
+
+        # close() is harmless on a closed notifier.
+        notifier.close()
+
+        with self.assertRaises(ValueError):
+            notifier.fileno()
+        with self.assertRaises(ValueError):
+            notifier.clear()
+
+    def test_bad_params(self):
+        """ensure only queues and semaphores are accepted"""
+        with self.assertRaises(TypeError):
+            sysv_ipc.Notifier(42)
+        with self.assertRaises(TypeError):
+            sysv_ipc.Notifier()
+
+    def test_selector(self):
+        """test that the descriptor becomes readable when the objects are ready"""
+        mq_notifier = sysv_ipc.Notifier(self.mq)
+        sem_notifier = sysv_ipc.Notifier(self.sem)
+        try:
+            self.selector.register(mq_notifier, selectors.EVENT_READ)
+            self.selector.register(sem_notifier, selectors.EVENT_READ)
+
+            self.assertEqual(self.ready_notifiers(0.1), [])
+
+            self.mq.send(b'hello')
+            self.assertEqual(self.ready_notifiers(5), [mq_notifier])
+
+            self.sem.release()
+            time.sleep(0.1)
+            self.assertCountEqual(self.ready_notifiers(5), [mq_notifier, sem_notifier])
+
+            # Nothing was consumed.
+            self.assertEqual(self.mq.current_messages, 1)
+            self.assertEqual(self.sem.value, 1)
+        finally:
+            mq_notifier.close()
+            sem_notifier.close()
+
+    def test_clear(self):
+        """test that clear() rearms the notifier"""
+        with sysv_ipc.Notifier(self.mq) as notifier:
+            self.selector.register(notifier, selectors.EVENT_READ)
+
+            self.mq.send(b'1')
+            self.assertEqual(self.ready_notifiers(5), [notifier])
+
+            # Still readable because it hasn't been cleared
+            self.assertEqual(self.ready_notifiers(0), [notifier])
+
+            # The message is still there, so it becomes readable again.
+            notifier.clear()
+            self.assertEqual(self.ready_notifiers(5), [notifier])
+
+            # Once the queue is empty, clear() makes it unreadable.
+            self.mq.receive()
+            notifier.clear()
+            self.assertEqual(self.ready_notifiers(0.2), [])
+
+            # A message sent from another thread wakes the selector.
+            thread = threading.Thread(target=lambda: (time.sleep(0.1), self.mq.send(b'2')))
+            thread.start()
+            try:
+                self.assertEqual(self.ready_notifiers(5), [notifier])
+            finally:
+                thread.join()
+
+    def test_read_with_os(self):
+        """test that the descriptor works without a selector"""
+        with sysv_ipc.Notifier(self.sem) as notifier:
+            with self.assertRaises(BlockingIOError):
+                os.read(notifier.fileno(), 1)
+
+    def test_many(self):
+        """test opening and closing many notifiers"""
+        for i in range(50):
+            notifier = sysv_ipc.Notifier(self.mq)
+            notifier.close()
+        # Dropping an open notifier closes it.
+        notifier = sysv_ipc.Notifier(self.sem)
+        del notifier
+
+
+if __name__ == '__main__':
+    unittest.main()
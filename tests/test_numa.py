@@ -0,0 +1,75 @@
+# Python imports
+import unittest
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+SIZE = 64 * sysv_ipc.PAGE_SIZE
+
+
+@unittest.skipUnless(sysv_ipc.NUMA_SUPPORTED, "Requires NUMA support")
+class TestNuma(Base):
+    """Exercise SharedMemory's numa_node and interleave options and numa_stat()"""
+    def setUp(self):
+        self.segments = []
+
+    def tearDown(self):
+        for mem in self.segments:
+            if mem.attached:
+                mem.detach()
+            mem.remove()
+
+    def create(self, **kwargs):
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=SIZE, **kwargs)
+        self.segments.append(mem)
+        return mem
+
+    def test_numa_node(self):
+        """test that a segment bound to node 0 is resident there"""
+        mem = self.create(numa_node=0)
+        self.assertEqual(mem.numa_stat(), {0: SIZE // sysv_ipc.PAGE_SIZE})
+
+    def test_interleave(self):
+        """test that an interleaved segment is resident on the available nodes"""
+        mem = self.create(interleave=True)
+        stat = mem.numa_stat()
+        self.assertEqual(sum(stat.values()), SIZE // sysv_ipc.PAGE_SIZE)
+        self.assertTrue(all(node >= 0 for node in stat))
+
+    def test_existing_segment(self):
+        """test that the policy can be set when opening an existing segment"""
+        mem = self.create()
+        other = sysv_ipc.SharedMemory(mem.key, numa_node=0)
+        # Only pages that this attachment has touched are counted.
+        self.assertEqual(other.numa_stat(), {})
+        other.read()
+        self.assertEqual(sum(other.numa_stat().values()), SIZE // sysv_ipc.PAGE_SIZE)
+        other.detach()
+
+    def test_untouched_pages(self):
+        """test that pages that were never touched aren't counted"""
+        # A segment that's created read-only isn't initialized.
+        mem = self.create(mode=0o400)
+        self.assertEqual(mem.numa_stat(), {})
+
+    def test_errors(self):
+        """test bad options and an unattached segment"""
+        with self.assertRaises(ValueError):
+            self.create(numa_node=0, interleave=True)
+        with self.assertRaises(ValueError):
+            self.create(numa_node=-1)
+        with self.assertRaises(ValueError):
+            # Node numbers are limited to 1024.
+            self.create(numa_node=1024)
+        with self.assertRaises(TypeError):
+            self.create(numa_node='0')
+
+        mem = self.create()
+        mem.detach()
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            mem.numa_stat()
+
+
+if __name__ == '__main__':
+    unittest.main()
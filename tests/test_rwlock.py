@@ -0,0 +1,234 @@
+# Python imports
+import unittest
+import threading
+import time
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+
+class RWLockTestBase(Base):
+    """base class for RWLock test classes"""
+    PREFER_WRITERS = False
+
+    def setUp(self):
+        self.lock = sysv_ipc.RWLock(None, sysv_ipc.IPC_CREX,
+                                    prefer_writers=self.PREFER_WRITERS)
+
+    def tearDown(self):
+        if self.lock:
+            self.lock.remove()
+
+    def wait_for(self, condition):
+        """Polls condition() for up to 5 seconds"""
+        for _ in range(500):
+            if condition():
+                return
+            time.sleep(.01)
+        self.fail("Timed out waiting for condition")
+
+
+class TestRWLockCreation(RWLockTestBase):
+    """Exercise the RWLock constructor"""
+    def test_attributes(self):
+        """test the lock's initial attributes"""
+        self.assertEqual(self.lock.readers, 0)
+        self.assertFalse(self.lock.writer)
+        self.assertEqual(self.lock.waiting_writers, 0)
+        self.assertFalse(self.lock.prefer_writers)
+        self.assertFalse(self.lock.undo)
+        self.assertIsInstance(self.lock.id, int)
+
+    def test_open_existing(self):
+        """test that a second object with the same key shares the lock"""
+        self.lock.acquire_read()
+        other = sysv_ipc.RWLock(self.lock.key)
+        self.assertEqual(other.id, self.lock.id)
+        self.assertEqual(other.readers, 1)
+        self.lock.release_read()
+
+    def test_IPC_CREAT_existing(self):
+        """test that IPC_CREAT doesn't reset an existing lock"""
+        self.lock.acquire_write()
+        other = sysv_ipc.RWLock(self.lock.key, sysv_ipc.IPC_CREAT)
+        self.assertTrue(other.writer)
+        self.lock.release_write()
+
+    def test_preference_stored(self):
+        """test that opening a lock adopts its preference or rejects a different one"""
+        lock = sysv_ipc.RWLock(None, sysv_ipc.IPC_CREX, prefer_writers=True)
+        try:
+            self.assertTrue(sysv_ipc.RWLock(lock.key).prefer_writers)
+            self.assertTrue(sysv_ipc.RWLock(lock.key, prefer_writers=True).prefer_writers)
+            with self.assertRaises(ValueError):
+                sysv_ipc.RWLock(lock.key, prefer_writers=False)
+            with self.assertRaises(ValueError):
+                sysv_ipc.RWLock(self.lock.key, prefer_writers=True)
+        finally:
+            lock.remove()
+
+        # A lock created with IPC_CREAT alone records its creator's preference.
+        key = lock.key
+        lock = sysv_ipc.RWLock(key, sysv_ipc.IPC_CREAT, prefer_writers=True)
+        try:
+            self.assertTrue(sysv_ipc.RWLock(key).prefer_writers)
+        finally:
+            lock.remove()
+
+    def test_IPC_EXCL(self):
+        """test IPC_CREAT | IPC_EXCL with an existing key"""
+        with self.assertRaises(sysv_ipc.ExistentialError):
+            sysv_ipc.RWLock(self.lock.key, sysv_ipc.IPC_CREX)
+
+    def test_bad_params(self):
+        """ensure bad constructor params are rejected"""
+        with self.assertRaises(ValueError):
+            sysv_ipc.RWLock(None)
+        with self.assertRaises(ValueError):
+            sysv_ipc.RWLock(self.lock.key, sysv_ipc.IPC_EXCL)
+
+    def test_create_many(self):
+        """test that create_many() makes independent locks"""
+        locks = sysv_ipc.RWLock.create_many(3, prefer_writers=True)
+        try:
+            self.assertEqual(len(set(lock.key for lock in locks)), 3)
+            self.assertTrue(all(lock.prefer_writers for lock in locks))
+        finally:
+            for lock in locks:
+                lock.remove()
+
+    def test_remove(self):
+        """test that remove() deletes the semaphore set"""
+        self.lock.remove()
+        with self.assertRaises(sysv_ipc.ExistentialError):
+            sysv_ipc.RWLock(self.lock.key)
+        self.lock = None
+
+
+class TestRWLockOperations(RWLockTestBase):
+    """Exercise acquire_read(), acquire_write() and the release methods"""
+    def test_shared_readers(self):
+        """test that several readers can hold the lock at once"""
+        self.lock.acquire_read()
+        self.lock.acquire_read(timeout=0)
+        self.assertEqual(self.lock.readers, 2)
+        self.lock.release_read()
+        self.lock.release_read()
+        self.assertEqual(self.lock.readers, 0)
+
+    def test_writer_excludes_readers(self):
+        """test that a writer blocks readers and other writers"""
+        self.lock.acquire_write()
+        self.assertTrue(self.lock.writer)
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.lock.acquire_read(0)
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.lock.acquire_write(0)
+        self.lock.release_write()
+        self.assertFalse(self.lock.writer)
+        self.lock.acquire_read(0)
+        self.lock.release_read()
+
+    def test_readers_exclude_writer(self):
+        """test that a reader blocks writers"""
+        self.lock.acquire_read()
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.lock.acquire_write(0)
+        self.lock.release_read()
+        self.lock.acquire_write(0)
+        self.lock.release_write()
+
+    @unittest.skipUnless(sysv_ipc.SEMAPHORE_TIMEOUT_SUPPORTED, "Requires Semaphore timeout support")
+    def test_timeout(self):
+        """test that a nonzero timeout waits and then raises BusyError"""
+        self.lock.acquire_read()
+        start = time.monotonic()
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.lock.acquire_write(timeout=.2)
+        self.assertGreaterEqual(time.monotonic() - start, .15)
+        self.lock.release_read()
+
+    def test_release_not_held(self):
+        """ensure releasing a lock that isn't held raises ValueError"""
+        with self.assertRaises(ValueError):
+            self.lock.release_read()
+        with self.assertRaises(ValueError):
+            self.lock.release_write()
+
+    def test_writer_waits_for_reader(self):
+        """test that a blocked writer gets the lock when the reader releases it"""
+        self.lock.acquire_read()
+        acquired = threading.Event()
+
+        def writer():
+            self.lock.acquire_write()
+            acquired.set()
+
+        thread = threading.Thread(target=writer)
+        thread.start()
+        time.sleep(.1)
+        self.assertFalse(acquired.is_set())
+        self.lock.release_read()
+        thread.join()
+        self.assertTrue(self.lock.writer)
+        self.lock.release_write()
+
+    def test_undo(self):
+        """test the undo attribute"""
+        self.lock.undo = True
+        self.assertTrue(self.lock.undo)
+        self.lock.acquire_write()
+        self.lock.release_write()
+        self.lock.undo = False
+        self.assertFalse(self.lock.undo)
+
+        with self.assertRaises(AttributeError):
+            del self.lock.undo
+
+        class Untruthful:
+            def __bool__(self):
+                raise RuntimeError
+
+        with self.assertRaises(RuntimeError):
+            self.lock.undo = Untruthful()
+        self.assertFalse(self.lock.undo)
+
+
+class TestRWLockWriterPreference(RWLockTestBase):
+    """Exercise writer-preferring locks"""
+    PREFER_WRITERS = True
+
+    def test_waiting_writer_blocks_new_readers(self):
+        """test that new readers wait while a writer is waiting"""
+        self.assertTrue(self.lock.prefer_writers)
+        self.lock.acquire_read()
+
+        thread = threading.Thread(target=self.lock.acquire_write)
+        thread.start()
+        self.wait_for(lambda: self.lock.waiting_writers == 1)
+
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.lock.acquire_read(0)
+
+        self.lock.release_read()
+        thread.join()
+        self.assertTrue(self.lock.writer)
+        self.assertEqual(self.lock.waiting_writers, 0)
+        self.lock.release_write()
+        self.lock.acquire_read(0)
+        self.lock.release_read()
+
+    def test_timeout_withdraws_writer(self):
+        """test that a writer that gives up no longer blocks readers"""
+        self.lock.acquire_read()
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.lock.acquire_write(0)
+        self.assertEqual(self.lock.waiting_writers, 0)
+        self.lock.acquire_read(0)
+        self.lock.release_read()
+        self.lock.release_read()
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -1,6 +1,7 @@
 # Python imports
 import unittest
 import datetime
+import threading
 import time
 import os
 
@@ -105,6 +106,58 @@ class TestSemaphoreCreation(SemaphoreTestBase):
         self.assertLessEqual(sem.key, sysv_ipc.KEY_MAX)
         sem.remove()
 
+    def test_randomly_generated_keys_are_wide(self):
+        """tests that random keys aren't limited to SHRT_MAX"""
+        sems = sysv_ipc.Semaphore.create_many(20)
+        try:
+            self.assertTrue(any(sem.key > 32767 for sem in sems))
+        finally:
+            for sem in sems:
+                sem.remove()
+
+    def test_create_many(self):
+        """tests create_many()"""
+        sems = sysv_ipc.Semaphore.create_many(5, initial_value=3)
+        try:
+            self.assertEqual(len(sems), 5)
+            self.assertEqual(len(set(sem.key for sem in sems)), 5)
+            for sem in sems:
+                self.assertIsInstance(sem, sysv_ipc.Semaphore)
+                self.assertEqual(sem.value, 3)
+        finally:
+            for sem in sems:
+                sem.remove()
+
+        self.assertEqual(sysv_ipc.Semaphore.create_many(0), [])
+
+    def test_create_many_bad_params(self):
+        """tests that create_many() rejects bad params"""
+        with self.assertRaises(ValueError):
+            sysv_ipc.Semaphore.create_many(-1)
+        with self.assertRaises(TypeError):
+            sysv_ipc.Semaphore.create_many(2, key=42)
+        with self.assertRaises(TypeError):
+            sysv_ipc.Semaphore.create_many(2, flags=0)
+
+    def test_create_many_failure_cleanup(self):
+        """tests that create_many() removes what it created when a creation fails"""
+        created = []
+
+        class FlakySemaphore(sysv_ipc.Semaphore):
+            def __init__(self, *args, **kwargs):
+                if len(created) == 3:
+                    raise RuntimeError('flaky')
+                super().__init__(*args, **kwargs)
+                created.append(self.key)
+
+        with self.assertRaises(RuntimeError):
+            FlakySemaphore.create_many(5)
+
+        self.assertEqual(len(created), 3)
+        for key in created:
+            with self.assertRaises(sysv_ipc.ExistentialError):
+                sysv_ipc.Semaphore(key)
+
     # # don't bother testing mode, it's ignored by the OS?
 
     def test_default_initial_value(self):
@@ -432,5 +485,106 @@ class TestSemaphorePropertiesAndAttributes(SemaphoreTestBase):
         sem.remove()
 
 
+
+class TestSemaphoreStats(SemaphoreTestBase):
+    """Exercise collect_stats, stats() and reset_stats()"""
+    def test_stats_off_by_default(self):
+        """test that stats are not collected unless asked for"""
+        self.assertFalse(self.sem.collect_stats)
+        self.assertIsNone(self.sem.stats())
+
+    def test_stats_counts(self):
+        """test that acquire, release and busy results are counted"""
+        self.sem.collect_stats = True
+        # The semaphore's initial value is 1.
+        self.sem.acquire()
+        self.sem.release()
+        self.sem.acquire()
+        self.sem.block = False
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.sem.acquire()
+
+        stats = self.sem.stats()
+        self.assertEqual(stats['ops'], 4)
+        self.assertEqual(stats['errors'], 1)
+        self.assertEqual(stats['eagain'], 1)
+        self.assertEqual(stats['timeouts'], 0)
+        self.assertEqual(sum(stats['histogram']), 4)
+
+    @unittest.skipUnless(sysv_ipc.SEMAPHORE_TIMEOUT_SUPPORTED, "Requires Semaphore timeout support")
+    def test_stats_timeout(self):
+        """test that an expired timeout is counted as a timeout"""
+        self.sem.acquire()
+        self.sem.collect_stats = True
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.sem.acquire(0.01)
+
+        stats = self.sem.stats()
+        self.assertEqual(stats['timeouts'], 1)
+        self.assertEqual(stats['eagain'], 0)
+        self.assertGreaterEqual(stats['wait_ns'], 10 * 1000 * 1000)
+
+    def test_share_stats(self):
+        """test that share_stats() moves the counters to a shared segment"""
+        # Borrow an unused key.
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX)
+        key = mem.key
+        mem.detach()
+        mem.remove()
+
+        self.sem.share_stats(key)
+        self.sem.release()
+        self.sem.reset_stats()
+        self.sem.acquire()
+
+        self.assertEqual(sysv_ipc.shared_stats(key)['ops'], 1)
+
+        self.sem.collect_stats = False
+        sysv_ipc.SharedMemory(key).remove()
+
+    def wait_for_waiter(self):
+        """Polls waiting_for_nonzero for up to 5 seconds"""
+        for _ in range(500):
+            if self.sem.waiting_for_nonzero:
+                return
+            time.sleep(.01)
+        self.fail("Timed out waiting for a waiter")
+
+    def test_stats_changed_while_waiting(self):
+        """test that stats can be moved and turned off while a call waits"""
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX)
+        key = mem.key
+        mem.detach()
+        mem.remove()
+
+        self.sem.acquire()
+        self.sem.share_stats(key)
+        thread = threading.Thread(target=self.sem.acquire)
+        thread.start()
+        self.wait_for_waiter()
+
+        # This detaches the segment that the waiting call started with.
+        self.sem.collect_stats = False
+        self.sem.release()
+        thread.join()
+        self.assertIsNone(self.sem.stats())
+        sysv_ipc.SharedMemory(key).remove()
+
+    def test_stats_enabled_while_waiting(self):
+        """test that a call that started with stats off isn't counted"""
+        self.sem.acquire()
+        thread = threading.Thread(target=self.sem.acquire)
+        thread.start()
+        self.wait_for_waiter()
+
+        self.sem.collect_stats = True
+        self.sem.release()
+        thread.join()
+
+        stats = self.sem.stats()
+        self.assertEqual(stats['ops'], 1)
+        self.assertEqual(stats['histogram'][-1], 0)
+
+
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,118 @@
+# Python imports
+import pickle
+import threading
+import unittest
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+
+class ZeroCopyByteArray(bytearray):
+    """A bytearray that pickles its contents out of band, as numpy arrays do"""
+    def __reduce_ex__(self, protocol):
+        return type(self)._reconstruct, (pickle.PickleBuffer(self),), None
+
+    @classmethod
+    def _reconstruct(cls, obj):
+        with memoryview(obj) as view:
+            # Keep a reference to the buffer's owner so the test can see it.
+            instance = cls(view)
+        instance.owner = obj
+        return instance
+
+
+class TestSendObject(Base):
+    """Exercise MessageQueue.send_object() and receive_object()"""
+    def setUp(self):
+        self.mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=1024 * 1024)
+        self.arena = sysv_ipc.SharedArena(self.mem, init=True)
+        self.mq = sysv_ipc.MessageQueue(None, sysv_ipc.IPC_CREX)
+
+    def tearDown(self):
+        self.mq.remove()
+        self.mem.detach()
+        self.mem.remove()
+
+    def test_without_arena(self):
+        """test that objects are pickled in band when there's no spill arena"""
+        obj = {'a': [1, 2.5, None], 'b': b'bytes', 'c': ZeroCopyByteArray(b'zz')}
+        self.mq.send_object(obj, type=3)
+        received, type_ = self.mq.receive_object()
+        self.assertEqual(received, obj)
+        self.assertEqual(type_, 3)
+
+    def test_out_of_band(self):
+        """test that a large buffer is spilled and received without a copy"""
+        self.mq.spill_arena = self.arena
+        payload = bytes(range(256)) * 100
+        self.mq.send_object(pickle.PickleBuffer(payload))
+        self.assertEqual(self.arena.blocks_in_use, 1)
+
+        received, type_ = self.mq.receive_object()
+        # A bare read-only PickleBuffer comes back as a memoryview of the
+        # buffer it was sent in.
+        self.assertIsInstance(received.obj, sysv_ipc.SpilledMessage)
+        self.assertEqual(received.tobytes(), payload)
+
+        received.release()
+        self.assertEqual(self.arena.blocks_in_use, 0)
+
+    def test_small_buffers_in_band(self):
+        """test that buffers at or below spill_threshold stay in the pickle"""
+        self.mq.spill_arena = self.arena
+        self.mq.spill_threshold = 1000
+        self.mq.send_object(ZeroCopyByteArray(b'x' * 500))
+        self.assertEqual(self.arena.blocks_in_use, 0)
+        received, _ = self.mq.receive_object()
+        self.assertEqual(received, b'x' * 500)
+        self.assertNotIsInstance(received.owner, sysv_ipc.SpilledMessage)
+
+    def test_mixed(self):
+        """test an object with several out-of-band buffers and a large pickle"""
+        self.mq.spill_arena = self.arena
+        obj = [ZeroCopyByteArray(b'a' * 5000), 'text' * 2000,
+               ZeroCopyByteArray(b'b' * 6000), 42]
+        self.mq.send_object(obj)
+        # Two buffers plus the pickle itself, which is over the threshold
+        self.assertEqual(self.arena.blocks_in_use, 3)
+
+        received, _ = self.mq.receive_object()
+        self.assertEqual(received, obj)
+        self.assertIsInstance(received[0].owner, sysv_ipc.SpilledMessage)
+        # ZeroCopyByteArray copied its buffers, so only the references in
+        # owner keep the blocks. The pickle's block is already free.
+        self.assertEqual(self.arena.blocks_in_use, 2)
+        del received
+        self.assertEqual(self.arena.blocks_in_use, 0)
+
+    def test_failed_send_frees_blocks(self):
+        """test that spilled buffers are freed when the message can't be sent"""
+        self.mq.spill_arena = self.arena
+        with self.assertRaises(ValueError):
+            self.mq.send_object(ZeroCopyByteArray(b'c' * 5000), type=0)
+        self.assertEqual(self.arena.blocks_in_use, 0)
+
+        with self.assertRaises(TypeError):
+            self.mq.send_object(threading.Lock())
+
+    def test_not_an_object(self):
+        """test that a message from send() is refused"""
+        self.mq.send(b'not a pickle')
+        with self.assertRaises(ValueError):
+            self.mq.receive_object()
+
+        self.mq.send(b'')
+        with self.assertRaises(ValueError):
+            self.mq.receive_object()
+
+    def test_receive_object_nonblocking(self):
+        """test that receive_object() honors block and timeout"""
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.receive_object(block=False)
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.receive_object(timeout=0.05)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,240 @@
+# Python imports
+import os
+import unittest
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+SEGMENT_SIZE = 64 * 1024
+
+
+class TestSnapshots(Base):
+    """Exercise the SnapshotPublisher, SnapshotReader and Snapshot classes"""
+    def setUp(self):
+        self.mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=SEGMENT_SIZE)
+        self.publisher = sysv_ipc.SnapshotPublisher(self.mem, init=True)
+        self.reader = sysv_ipc.SnapshotReader(self.mem)
+
+    def tearDown(self):
+        if self.mem.attached:
+            self.mem.detach()
+        self.mem.remove()
+
+    def test_attributes(self):
+        """test the publisher's and reader's attributes"""
+        for o in (self.publisher, self.reader):
+            self.assertIs(o.memory, self.mem)
+            self.assertEqual(o.offset, 0)
+            self.assertEqual(o.buffers, 2)
+            self.assertLess(o.buffer_size * 2, SEGMENT_SIZE)
+            self.assertEqual(o.buffer_size % 64, 0)
+            self.assertEqual(o.sequence, 0)
+
+        publisher = sysv_ipc.SnapshotPublisher(self.mem, offset=128, buffers=3,
+                                               buffer_size=1000, init=True)
+        reader = sysv_ipc.SnapshotReader(self.mem, offset=128)
+        self.assertEqual((reader.buffers, reader.buffer_size), (3, 1000))
+        self.assertEqual(publisher.offset, 128)
+
+    def test_publish(self):
+        """test that readers see each published snapshot"""
+        self.assertIsNone(self.reader.acquire())
+
+        self.assertEqual(self.publisher.publish(b'first'), 1)
+        self.assertEqual(self.reader.sequence, 1)
+        with self.reader.acquire() as snapshot:
+            self.assertEqual(snapshot.sequence, 1)
+            self.assertEqual(len(snapshot), 5)
+            self.assertEqual(bytes(snapshot), b'first')
+            with memoryview(snapshot) as view:
+                self.assertTrue(view.readonly)
+        self.assertTrue(snapshot.released)
+
+        self.assertEqual(self.publisher.publish(b''), 2)
+        self.assertEqual(self.reader.acquire().tobytes(), b'')
+        self.assertEqual(self.publisher.publish(b'third'), 3)
+        self.assertEqual(self.reader.acquire().tobytes(), b'third')
+
+    def test_draft(self):
+        """test writing a snapshot in place with begin() and commit()"""
+        draft = self.publisher.begin()
+        self.assertIsNone(draft.sequence)
+        self.assertEqual(len(draft), self.publisher.buffer_size)
+        view = memoryview(draft)
+        view[:5] = b'draft'
+        with self.assertRaises(BufferError):
+            self.publisher.commit(5)
+        view.release()
+
+        # Nothing is visible until the commit.
+        self.assertIsNone(self.reader.acquire())
+        self.assertEqual(self.publisher.commit(5), 1)
+        self.assertTrue(draft.released)
+        self.assertEqual(self.reader.acquire().tobytes(), b'draft')
+
+        with self.assertRaises(ValueError):
+            self.publisher.commit()
+
+        # An aborted draft isn't published, and the buffer can be reused.
+        draft = self.publisher.begin()
+        with self.assertRaises(ValueError):
+            self.publisher.begin()
+        with self.assertRaises(ValueError):
+            self.publisher.publish(b'x')
+        memoryview(draft)[:3] = b'bad'
+        self.publisher.abort()
+        self.assertTrue(draft.released)
+        self.assertEqual(self.publisher.sequence, 1)
+        self.assertEqual(self.publisher.publish(b'good'), 2)
+        self.assertEqual(self.reader.acquire().tobytes(), b'good')
+
+    def test_pinned_buffers(self):
+        """test that a pinned buffer isn't written until it's released"""
+        self.publisher.publish(b'one')
+        old = self.reader.acquire()
+        self.publisher.publish(b'two')
+        # Both buffers are in use now: one is published and one is pinned.
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.publisher.publish(b'three')
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.publisher.begin()
+        self.assertEqual(old.tobytes(), b'one')
+
+        old.release()
+        self.publisher.publish(b'three')
+        self.assertEqual(self.reader.acquire().tobytes(), b'three')
+
+        with self.assertRaises(BufferError):
+            with self.reader.acquire() as snapshot:
+                view = memoryview(snapshot)
+        view.release()
+        snapshot.release()
+
+    def test_more_buffers(self):
+        """test that with three buffers, a held snapshot doesn't stop the publisher"""
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=SEGMENT_SIZE)
+        publisher = sysv_ipc.SnapshotPublisher(mem, buffers=3, init=True)
+        reader = sysv_ipc.SnapshotReader(mem)
+
+        publisher.publish(b'held')
+        held = reader.acquire()
+        for i in range(10):
+            publisher.publish(b'%d' % i)
+            self.assertEqual(reader.acquire().tobytes(), b'%d' % i)
+        self.assertEqual(held.tobytes(), b'held')
+        held.release()
+
+        mem.detach()
+        mem.remove()
+
+    def test_concurrent(self):
+        """test that a reader never sees a snapshot that's partly written"""
+        size = 4096
+        # The child publishes until the parent sets this flag.
+        flag = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, init_character=b'\0')
+        pid = os.fork()
+        if not pid:
+            try:
+                publisher = sysv_ipc.SnapshotPublisher(self.mem)
+                i = 0
+                while not flag.atomic_load(0):
+                    i += 1
+                    try:
+                        publisher.publish(bytes([i % 256]) * size)
+                    except sysv_ipc.BusyError:
+                        pass
+            finally:
+                os._exit(0)
+
+        sequences = set()
+        try:
+            while len(sequences) < 100:
+                snapshot = self.reader.acquire()
+                if snapshot:
+                    with snapshot:
+                        data = snapshot.tobytes()
+                        sequences.add(snapshot.sequence)
+                    self.assertEqual(len(data), size)
+                    self.assertEqual(data.count(data[:1]), size)
+        finally:
+            flag.atomic_store(0, 1)
+            os.waitpid(pid, 0)
+            flag.detach()
+            flag.remove()
+
+    def test_writer(self):
+        """test that only one publisher writes at a time"""
+        other = sysv_ipc.SnapshotPublisher(self.mem)
+        draft = self.publisher.begin()
+        with self.assertRaises(sysv_ipc.BusyError):
+            other.publish(b'x')
+        draft.release()
+        other.publish(b'x')
+
+        # A publisher that dies while writing is taken over.
+        pid = os.fork()
+        if not pid:
+            try:
+                self.publisher.begin()
+            finally:
+                os._exit(0)
+        os.waitpid(pid, 0)
+        self.assertEqual(self.publisher.publish(b'y'), 2)
+
+    def test_fork(self):
+        """test that a child doesn't give back its parent's pins"""
+        self.publisher.publish(b'one')
+        snapshot = self.reader.acquire()
+        pid = os.fork()
+        if not pid:
+            try:
+                snapshot.release()
+            finally:
+                os._exit(0)
+        os.waitpid(pid, 0)
+
+        self.publisher.publish(b'two')
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.publisher.publish(b'three')
+        snapshot.release()
+        self.publisher.publish(b'three')
+
+    def test_errors(self):
+        """test bad arguments and segments"""
+        with self.assertRaises(ValueError):
+            self.publisher.publish(b'x' * (self.publisher.buffer_size + 1))
+        with self.assertRaises(ValueError):
+            sysv_ipc.SnapshotReader(self.mem, offset=64)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SnapshotPublisher(self.mem, offset=100, init=True)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SnapshotPublisher(self.mem, buffers=1, init=True)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SnapshotPublisher(self.mem, buffers=256, init=True)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SnapshotPublisher(self.mem, buffer_size=SEGMENT_SIZE, init=True)
+        with self.assertRaises(ValueError):
+            sysv_ipc.SnapshotPublisher(self.mem, offset=SEGMENT_SIZE, init=True)
+
+        mem = sysv_ipc.SharedMemory(self.mem.key, mode=0o400)
+        with self.assertRaises(OSError):
+            sysv_ipc.SnapshotReader(mem)
+        mem.detach()
+
+        self.publisher.publish(b'x')
+        snapshot = self.reader.acquire()
+        self.mem.detach()
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            self.reader.acquire()
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            self.publisher.publish(b'x')
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            snapshot.tobytes()
+        with self.assertRaises(sysv_ipc.NotAttachedError):
+            snapshot.release()
+        self.assertTrue(snapshot.released)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,184 @@
+# Python imports
+import struct
+import unittest
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+
+class TestSpill(Base):
+    """Exercise MessageQueue's spill_arena and the SpilledMessage class"""
+    def setUp(self):
+        self.mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=256 * 1024)
+        self.arena = sysv_ipc.SharedArena(self.mem, init=True)
+        self.mq = sysv_ipc.MessageQueue(None, sysv_ipc.IPC_CREX)
+        self.mq.spill_arena = self.arena
+        self.mq.spill_threshold = 100
+
+    def tearDown(self):
+        self.mq.remove()
+        self.mem.detach()
+        self.mem.remove()
+
+    def test_attributes(self):
+        """test the spill_arena and spill_threshold attributes"""
+        mq = sysv_ipc.MessageQueue(None, sysv_ipc.IPC_CREX)
+        self.assertIsNone(mq.spill_arena)
+        self.assertEqual(mq.spill_threshold, 4096)
+        mq.remove()
+
+        self.assertIs(self.mq.spill_arena, self.arena)
+        self.mq.spill_arena = None
+        self.assertIsNone(self.mq.spill_arena)
+
+        with self.assertRaises(TypeError):
+            self.mq.spill_arena = self.mem
+        with self.assertRaises(TypeError):
+            self.mq.spill_threshold = 'foo'
+        with self.assertRaises(ValueError):
+            self.mq.spill_threshold = -1
+        with self.assertRaises(AttributeError):
+            del self.mq.spill_threshold
+
+    def test_inline(self):
+        """test that a message at or below the threshold is sent as usual"""
+        self.mq.send(b'a' * 100, type=2)
+        self.assertEqual(self.mq.receive(), (b'a' * 100, 2))
+        self.assertEqual(self.arena.blocks_in_use, 0)
+
+        # An empty message and one that starts with a frame byte both work.
+        self.mq.send(b'')
+        self.mq.send(b'\x01abc')
+        self.assertEqual(self.mq.receive()[0], b'')
+        self.assertEqual(self.mq.receive()[0], b'\x01abc')
+
+    def test_spilled(self):
+        """test that a message above the threshold is spilled and read in place"""
+        payload = bytes(range(256)) * 40
+        self.mq.send(payload, type=3)
+        self.assertEqual(self.arena.blocks_in_use, 1)
+
+        message, type_ = self.mq.receive()
+        self.assertIsInstance(message, sysv_ipc.SpilledMessage)
+        self.assertEqual(type_, 3)
+        self.assertEqual(len(message), len(payload))
+        self.assertEqual(message.tobytes(), payload)
+
+        view = memoryview(message)
+        self.assertEqual(view.tobytes(), payload)
+        view.release()
+
+        self.assertFalse(message.released)
+        message.release()
+        self.assertTrue(message.released)
+        self.assertEqual(self.arena.blocks_in_use, 0)
+
+        # release() is harmless on a released message.
+        message.release()
+        with self.assertRaises(ValueError):
+            message.tobytes()
+        with self.assertRaises(ValueError):
+            memoryview(message)
+
+    def test_zero_copy(self):
+        """test that the buffer refers to the arena's memory"""
+        self.mq.send(b'z' * 1000)
+        with self.mq.receive()[0] as message:
+            view = memoryview(message)
+            self.assertFalse(view.readonly)
+            view[0:4] = b'abcd'
+            self.assertEqual(message.tobytes()[:5], b'abcdz')
+            view.release()
+        self.assertTrue(message.released)
+        self.assertEqual(self.arena.blocks_in_use, 0)
+
+    def test_release_with_view(self):
+        """test that a message can't be released while its buffer is in use"""
+        self.mq.send(b'v' * 1000)
+        message = self.mq.receive()[0]
+        view = memoryview(message)
+        with self.assertRaises(BufferError):
+            message.release()
+        self.assertFalse(message.released)
+        view.release()
+        message.release()
+        self.assertEqual(self.arena.blocks_in_use, 0)
+
+    def test_dealloc_releases(self):
+        """test that a message frees its block when it's garbage collected"""
+        self.mq.send(b'g' * 1000)
+        message = self.mq.receive()[0]
+        self.assertEqual(self.arena.blocks_in_use, 1)
+        del message
+        self.assertEqual(self.arena.blocks_in_use, 0)
+
+    def test_larger_than_max_message_size(self):
+        """test that a spilled message can exceed the queue's max_message_size"""
+        mq = sysv_ipc.MessageQueue(self.mq.key, max_message_size=200)
+        mq.spill_arena = self.arena
+        mq.spill_threshold = 100
+
+        payload = b'L' * 2000
+        mq.send(payload)
+        with mq.receive()[0] as message:
+            self.assertEqual(message.tobytes(), payload)
+
+        # Inline messages are still limited, and the frame byte counts.
+        mq.spill_threshold = 200
+        with self.assertRaises(ValueError):
+            mq.send(b'x' * 200)
+
+    def test_failed_send_frees_block(self):
+        """test that the block is freed when a spilled message can't be sent"""
+        # Fill the queue so that a non-blocking send fails.
+        self.mq.spill_threshold = 0
+        with self.assertRaises(sysv_ipc.BusyError):
+            for i in range(100000):
+                self.mq.send(b'f', block=False)
+        self.assertEqual(self.arena.blocks_in_use, self.mq.current_messages)
+
+        while self.mq.current_messages:
+            self.mq.receive()[0].release()
+        self.assertEqual(self.arena.blocks_in_use, 0)
+
+    def test_wrong_arena(self):
+        """test that a message spilled to a different arena is refused"""
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=64 * 1024)
+        other = sysv_ipc.SharedArena(mem, init=True)
+
+        self.mq.send(b'w' * 1000)
+        self.mq.spill_arena = other
+        with self.assertRaises(ValueError):
+            self.mq.receive()
+
+        mem.detach()
+        mem.remove()
+
+    def test_length_past_block(self):
+        """test that a descriptor whose length runs past its block is refused"""
+        self.mq.send(b'x' * 1000)
+        self.mq.spill_arena = None
+        frame = self.mq.receive()[0]
+        shm_id, generation, arena_offset, offset, length = struct.unpack('=iIQQQ', frame[1:])
+        self.assertEqual(length, 1000)
+
+        forged = struct.pack('=iIQQQ', shm_id, generation, arena_offset, offset, 1 << 30)
+        self.mq.send(frame[:1] + forged)
+        self.mq.spill_arena = self.arena
+        with self.assertRaises(ValueError):
+            self.mq.receive()
+
+        self.arena.free(offset)
+
+    def test_not_spilled(self):
+        """test that a message sent without spilling is refused"""
+        self.mq.spill_arena = None
+        self.mq.send(b'plain')
+        self.mq.spill_arena = self.arena
+        with self.assertRaises(ValueError):
+            self.mq.receive()
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,164 @@
+# Python imports
+import os
+import struct
+import threading
+import time
+import unittest
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+HEADER_SIZE = 32
+STREAM_MAGIC = 0x53545231
+CHUNK_SIZE = 2048 - HEADER_SIZE
+
+
+class TestStreams(Base):
+    """Exercise MessageQueue.send_stream() and receive_stream()"""
+    def setUp(self):
+        self.mq = sysv_ipc.MessageQueue(None, sysv_ipc.IPC_CREX)
+        self.payload = os.urandom(100000)
+
+    def tearDown(self):
+        self.mq.remove()
+
+    def send_in_child(self, payload, type_=1):
+        """Sends a stream from a child process and returns its pid"""
+        pid = os.fork()
+        if not pid:
+            try:
+                self.mq.send_stream(payload, type=type_)
+            finally:
+                os._exit(0)
+        return pid
+
+    def test_round_trip(self):
+        """test that a payload larger than max_message_size arrives whole"""
+        pid = self.send_in_child(self.payload, 3)
+        self.assertEqual(self.mq.receive_stream(), (self.payload, 3))
+        os.waitpid(pid, 0)
+
+    def test_chunks(self):
+        """test that a stream is split into chunks that fill the queue's messages"""
+        self.mq.send_stream(b'x' * 5000)
+        self.assertEqual(self.mq.current_messages, 3)
+        self.assertEqual(self.mq.receive_stream()[0], b'x' * 5000)
+
+    def test_small_and_empty(self):
+        """test streams that fit in one chunk"""
+        for payload in (b'', b'a', b'b' * CHUNK_SIZE):
+            self.mq.send_stream(payload)
+            self.assertEqual(self.mq.current_messages, 1)
+            self.assertEqual(self.mq.receive_stream(), (payload, 1))
+
+    def test_interleaved_senders(self):
+        """test that streams from several senders are reassembled separately"""
+        payloads = [bytes([i]) * (30000 + i) for i in range(4)]
+        pids = [self.send_in_child(payload, i + 1) for i, payload in enumerate(payloads)]
+        received = [self.mq.receive_stream(timeout=10) for payload in payloads]
+        for pid in pids:
+            os.waitpid(pid, 0)
+        self.assertEqual(sorted(received),
+                         sorted((payload, i + 1) for i, payload in enumerate(payloads)))
+
+    def test_partial_stream_kept(self):
+        """test that a stream that's partly received is finished by a later call"""
+        payload = self.payload[:5000]
+        self.mq.send_stream(payload)
+        chunks = [self.mq.receive()[0] for i in range(3)]
+
+        # Put back all but the last chunk.
+        for chunk in chunks[:2]:
+            self.mq.send(chunk)
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.receive_stream(block=False)
+        self.assertEqual(self.mq.current_messages, 0)
+
+        self.mq.send(chunks[2])
+        self.assertEqual(self.mq.receive_stream(block=False), (payload, 1))
+
+    def test_mismatched_chunk(self):
+        """test that a chunk whose total length doesn't match its stream is refused"""
+        def chunk(total_length, offset, data):
+            return struct.pack('=IiQQQ', STREAM_MAGIC, 4242, 1, total_length, offset) + data
+
+        self.mq.send(chunk(16, 0, b'a' * 8))
+        self.mq.send(chunk(1024 * 1024, 4000, b'b' * 2000))
+        with self.assertRaises(ValueError):
+            self.mq.receive_stream(block=False)
+
+        # The stream that was there is unharmed.
+        self.mq.send(chunk(16, 8, b'c' * 8))
+        self.assertEqual(self.mq.receive_stream(block=False), (b'a' * 8 + b'c' * 8, 1))
+
+    def test_stats(self):
+        """test that each chunk is counted"""
+        self.mq.collect_stats = True
+        pid = self.send_in_child(b'x' * (CHUNK_SIZE * 2 + 1))
+        self.mq.receive_stream()
+        os.waitpid(pid, 0)
+        stats = self.mq.stats()
+        self.assertEqual(stats['ops'], 3)
+        self.assertEqual(stats['bytes'], CHUNK_SIZE * 2 + 1 + HEADER_SIZE * 3)
+
+    def test_stats_turned_off_while_waiting(self):
+        """test that stats can be turned off while receive_stream() waits"""
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX)
+        key = mem.key
+        mem.detach()
+        mem.remove()
+
+        self.mq.share_stats(key)
+        thread = threading.Thread(target=self.mq.receive_stream)
+        thread.start()
+        # Queues don't count their waiters, so give the receive time to block.
+        time.sleep(.1)
+        self.mq.collect_stats = False
+        self.mq.send_stream(b'abc')
+        thread.join()
+        self.assertIsNone(self.mq.stats())
+        sysv_ipc.SharedMemory(key).remove()
+
+    def test_type(self):
+        """test that the type selects streams"""
+        self.mq.send_stream(b'one' * 1000, type=1)
+        self.mq.send_stream(b'two' * 1000, type=2)
+        self.assertEqual(self.mq.receive_stream(type=2), (b'two' * 1000, 2))
+        self.assertEqual(self.mq.receive_stream(type=1), (b'one' * 1000, 1))
+
+    def test_spill_arena_framing(self):
+        """test that streams work on a queue with a spill_arena"""
+        mem = sysv_ipc.SharedMemory(None, sysv_ipc.IPC_CREX, size=64 * 1024)
+        self.mq.spill_arena = sysv_ipc.SharedArena(mem, init=True)
+
+        self.mq.send_stream(b'z' * 3000)
+        self.assertEqual(self.mq.receive_stream(), (b'z' * 3000, 1))
+
+        self.mq.spill_arena = None
+        mem.detach()
+        mem.remove()
+
+    def test_errors(self):
+        """test bad arguments and messages that aren't streams"""
+        with self.assertRaises(ValueError):
+            self.mq.send_stream(b'x', type=0)
+        with self.assertRaises(TypeError):
+            self.mq.send_stream('not bytes')
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.receive_stream(block=False)
+        with self.assertRaises(sysv_ipc.BusyError):
+            self.mq.receive_stream(timeout=0.01)
+
+        self.mq.send(b'not a stream chunk, but long enough to have a header')
+        with self.assertRaises(ValueError):
+            self.mq.receive_stream()
+        self.assertEqual(self.mq.current_messages, 0)
+
+        mq = sysv_ipc.MessageQueue(self.mq.key, max_message_size=HEADER_SIZE)
+        with self.assertRaises(ValueError):
+            mq.send_stream(b'x')
+
+
+if __name__ == '__main__':
+    unittest.main()
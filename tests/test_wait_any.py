@@ -0,0 +1,138 @@
+# Python imports
+import os
+import unittest
+import threading
+import time
+
+# Project imports
+from .base import Base
+import sysv_ipc
+
+
+class TestWaitAny(Base):
+    """Exercise wait_any()"""
+    def setUp(self):
+        self.mq1 = sysv_ipc.MessageQueue(None, sysv_ipc.IPC_CREX)
+        self.mq2 = sysv_ipc.MessageQueue(None, sysv_ipc.IPC_CREX)
+        self.sem = sysv_ipc.Semaphore(None, sysv_ipc.IPC_CREX)
+
+    def tearDown(self):
+        self.mq1.remove()
+        self.mq2.remove()
+        self.sem.remove()
+
+    def start_thread(self, target, delay=0.1):
+        def run():
+            time.sleep(delay)
+            target()
+
+        thread = threading.Thread(target=run)
+        thread.start()
+        return thread
+
+    def test_already_ready(self):
+        """test that objects that are already ready are returned right away"""
+        self.mq2.send(b'hello')
+        self.sem.release()
+        self.assertEqual(sysv_ipc.wait_any([self.mq1, self.mq2, self.sem]),
+                         [self.mq2, self.sem])
+
+        # Nothing was consumed.
+        self.assertEqual(self.mq2.current_messages, 1)
+        self.assertEqual(self.sem.value, 1)
+
+    def test_timeout(self):
+        """test that an empty list is returned when the timeout expires"""
+        objects = [self.mq1, self.mq2, self.sem]
+        self.assertEqual(sysv_ipc.wait_any(objects, 0), [])
+
+        start = time.monotonic()
+        self.assertEqual(sysv_ipc.wait_any(objects, timeout=0.2), [])
+        self.assertGreaterEqual(time.monotonic() - start, 0.19)
+
+    def test_wake_on_message(self):
+        """test that a message sent while waiting wakes the waiter"""
+        thread = self.start_thread(lambda: self.mq2.send(b'hello'))
+        try:
+            ready = sysv_ipc.wait_any([self.mq1, self.mq2, self.sem], timeout=5)
+        finally:
+            thread.join()
+
+        self.assertEqual(ready, [self.mq2])
+        self.assertEqual(self.mq2.receive(block=False), (b'hello', 1))
+
+    def test_wake_on_empty_message(self):
+        """test that a message with no content wakes the waiter and stays first"""
+        def send():
+            self.mq1.send(b'', type=7)
+            self.mq1.send(b'later', type=8)
+
+        thread = self.start_thread(send)
+        try:
+            ready = sysv_ipc.wait_any([self.mq1], timeout=5)
+        finally:
+            thread.join()
+
+        self.assertEqual(ready, [self.mq1])
+        self.assertEqual(self.mq1.receive(block=False), (b'', 7))
+        self.assertEqual(self.mq1.receive(block=False), (b'later', 8))
+
+    def test_wake_on_release(self):
+        """test that releasing a semaphore wakes the waiter"""
+        thread = self.start_thread(self.sem.release)
+        try:
+            ready = sysv_ipc.wait_any([self.mq1, self.sem], timeout=5)
+        finally:
+            thread.join()
+
+        self.assertEqual(ready, [self.sem])
+        self.assertEqual(self.sem.value, 1)
+
+    def test_repeated(self):
+        """test that helpers are reused across calls"""
+        for i in range(20):
+            self.assertEqual(sysv_ipc.wait_any([self.mq1, self.mq2, self.sem], 0.01), [])
+
+        self.mq1.send(b'x')
+        self.assertEqual(sysv_ipc.wait_any([self.mq1, self.mq2, self.sem], 1), [self.mq1])
+
+    @unittest.skipUnless(os.path.isdir('/proc/self/task'), "Requires /proc/self/task")
+    def test_idle_helpers_exit(self):
+        """test that the pool shrinks again after a large wait"""
+        def thread_count():
+            return len(os.listdir('/proc/self/task'))
+
+        before = thread_count()
+        self.assertEqual(sysv_ipc.wait_any([self.sem] * 8, 0.01), [])
+        # The main thread and a helper for each object
+        self.assertGreaterEqual(thread_count(), 9)
+
+        deadline = time.time() + 10
+        while (thread_count() > before) and (time.time() < deadline):
+            time.sleep(.1)
+        self.assertLessEqual(thread_count(), before)
+
+    def test_removed(self):
+        """ensure ExistentialError is raised when an object is removed while waiting"""
+        mq = sysv_ipc.MessageQueue(None, sysv_ipc.IPC_CREX)
+        thread = self.start_thread(mq.remove)
+        try:
+            with self.assertRaises(sysv_ipc.ExistentialError):
+                sysv_ipc.wait_any([self.mq1, mq], timeout=5)
+        finally:
+            thread.join()
+
+    def test_bad_params(self):
+        """ensure bad params are rejected"""
+        with self.assertRaises(TypeError):
+            sysv_ipc.wait_any(42)
+        with self.assertRaises(TypeError):
+            sysv_ipc.wait_any([self.mq1, 'foo'])
+        with self.assertRaises(TypeError):
+            sysv_ipc.wait_any([self.mq1], timeout=-1)
+        with self.assertRaises(ValueError):
+            sysv_ipc.wait_any([])
+
+
+if __name__ == '__main__':
+    unittest.main()